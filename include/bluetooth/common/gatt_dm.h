@@ -50,6 +50,8 @@ struct bt_gatt_dm_cb {
 	/** @brief Service not found callback.
 	 *
 	 * The targeted service could not be found during the discovery.
+	 * If more than one service is searched, it means that no more
+	 * services are present on the server.
 	 *
 	 * @param[in,out] conn Connection object.
 	 * @param[in,out] context The value passed to
@@ -251,8 +253,13 @@ const struct bt_gatt_attr *bt_gatt_dm_desc_next(
  * another one, wait for the result of the previous procedure to finish
  * and call @ref bt_gatt_dm_data_release if it was successful.
  *
+ * @note If the CONFIG_BT_GATT_DM_CACHE option is set and the service was
+ * already discovered on the bonded peer, the result is served from the cache.
+ * In such case, the callbacks are called from the system workqueue.
+ *
  * @param[in]     conn Connection object.
- * @param[in]     svc_uuid UUID of target service.
+ * @param[in]     svc_uuid UUID of target service or NULL to discover
+ *                all services, see @ref bt_gatt_dm_continue.
  * @param[in]     cb Callback structure.
  * @param[in,out] context Context argument that would be passed to
  *                callback functions
@@ -265,6 +272,52 @@ int bt_gatt_dm_start(struct bt_conn *conn,
 		     const struct bt_gatt_dm_cb *cb,
 		     void *context);
 
+/** @brief Start discovery of any service from the list.
+ *
+ * This function is asynchronous. The primary services are traversed once
+ * and the completed callback is called for the first service found that
+ * matches any of the given UUIDs. Call @ref bt_gatt_dm_continue to
+ * discover the next matching service.
+ *
+ * @param[in]     conn Connection object.
+ * @param[in]     svc_uuids UUIDs of target services. The array must stay
+ *                valid until the discovery procedure is finished.
+ * @param[in]     svc_uuid_cnt Number of UUIDs in the array.
+ * @param[in]     cb Callback structure.
+ * @param[in,out] context Context argument that would be passed to
+ *                callback functions
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int bt_gatt_dm_start_list(struct bt_conn *conn,
+			  const struct bt_uuid *const *svc_uuids,
+			  size_t svc_uuid_cnt,
+			  const struct bt_gatt_dm_cb *cb,
+			  void *context);
+
+/** @brief Continue service discovery.
+ *
+ * This function continues the search from the end of the previously
+ * discovered service, with the same target services and callbacks.
+ * It is used to discover all services, services from the list or the next
+ * instance of the same service.
+ * The @ref bt_gatt_dm_cb.service_not_found callback is called when no
+ * more services are found.
+ *
+ * @note The data of the previous service must be released with
+ * @ref bt_gatt_dm_data_release first.
+ *
+ * @param[in,out] dm Discovery Manager instance.
+ * @param[in,out] context Context argument that would be passed to
+ *                callback functions
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -ENOENT If the previous service was the last one on the server.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int bt_gatt_dm_continue(struct bt_gatt_dm *dm, void *context);
+
 /** @brief Release data associated with service discovery.
  *
  * After calling this function, you cannot rely on the discovery data that was
@@ -277,6 +330,26 @@ int bt_gatt_dm_start(struct bt_conn *conn,
  */
 int bt_gatt_dm_data_release(struct bt_gatt_dm *dm);
 
+/** @brief Invalidate cached service discovery data.
+ *
+ * This function removes the cached services of the given peer that overlap
+ * the given handle range. The library already does it when the peer
+ * indicates Service Changed or when the bond with the peer is removed.
+ *
+ * @note Available only if the CONFIG_BT_GATT_DM_CACHE option is set.
+ *
+ * @param[in] addr Identity address of the peer or @ref BT_ADDR_LE_ANY
+ *                 to invalidate the services of all peers.
+ * @param[in] start_handle First handle of the affected range.
+ * @param[in] end_handle Last handle of the affected range.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int bt_gatt_dm_cache_invalidate(const bt_addr_le_t *addr,
+				u16_t start_handle,
+				u16_t end_handle);
+
 /** @brief Print service discovery data.
  *
  * This function prints GATT attributes that belong to the discovered service.
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef BT_CTLR_HCI_STATS_H_
+#define BT_CTLR_HCI_STATS_H_
+
+/**
+ * @file
+ * @defgroup bt_ctlr_hci_stats BLE controller HCI driver statistics
+ * @{
+ * @brief Statistics of the HCI driver of the Nordic BLE controller.
+ */
+
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_BLECTLR_HCI_STATS
+
+/** @brief Statistics of an HCI command opcode.
+ *
+ * @param opcode Command opcode.
+ * @param count Number of completed commands.
+ * @param rtt_us Total round-trip time from sending the command to receiving
+ *		 its Command Complete or Command Status event
+ *		 (in microseconds).
+ * @param rtt_us_max Longest round-trip time (in microseconds).
+ */
+struct bt_ctlr_hci_cmd_stats {
+	u16_t opcode;
+	u32_t count;
+	u64_t rtt_us;
+	u32_t rtt_us_max;
+};
+
+/** @brief HCI driver statistics.
+ *
+ * @param rx_wakeups Number of passes of the receive thread.
+ * @param rx_packets Number of events and data packets passed to the host.
+ * @param rx_packets_per_wakeup_max Maximum number of packets passed to
+ *				    the host in one pass.
+ * @param rx_budget_exhausted Number of passes that ended because the
+ *			      packet budget was used.
+ * @param rx_buf_waits Number of times the receive thread waited for a host
+ *		       buffer.
+ * @param rx_buf_wait_timeouts Number of waits for a host buffer that timed
+ *			       out.
+ * @param rx_buf_wait_us Total time spent waiting for host buffers
+ *			 (in microseconds).
+ * @param rx_buf_wait_us_max Longest wait for a host buffer
+ *			     (in microseconds).
+ * @param rx_evt_packets Number of events passed to the host.
+ * @param rx_acl_packets Number of ACL data packets passed to the host.
+ * @param rx_acl_bytes Number of ACL data bytes passed to the host,
+ *		       including headers.
+ * @param tx_cmd_packets Number of commands sent to the controller.
+ * @param tx_acl_packets Number of ACL data packets sent to the controller.
+ * @param tx_acl_bytes Number of ACL data bytes sent to the controller,
+ *		       including headers.
+ * @param signals Number of controller signals handled by the receive
+ *		  thread.
+ * @param signal_latency_us Total time from a controller signal to the
+ *			    start of its processing (in microseconds).
+ * @param signal_latency_us_max Longest time from a controller signal to
+ *				the start of its processing
+ *				(in microseconds).
+ * @param cmd_untracked Number of completed commands whose opcode did not
+ *			fit in the command statistics.
+ * @param cmd Statistics of the command opcodes, in order of first use.
+ *	      Unused entries have the opcode set to zero.
+ */
+struct bt_ctlr_hci_stats {
+	u32_t rx_wakeups;
+	u32_t rx_packets;
+	u32_t rx_packets_per_wakeup_max;
+	u32_t rx_budget_exhausted;
+	u32_t rx_buf_waits;
+	u32_t rx_buf_wait_timeouts;
+	u64_t rx_buf_wait_us;
+	u32_t rx_buf_wait_us_max;
+	u32_t rx_evt_packets;
+	u32_t rx_acl_packets;
+	u64_t rx_acl_bytes;
+	u32_t tx_cmd_packets;
+	u32_t tx_acl_packets;
+	u64_t tx_acl_bytes;
+	u32_t signals;
+	u64_t signal_latency_us;
+	u32_t signal_latency_us_max;
+	u32_t cmd_untracked;
+	struct bt_ctlr_hci_cmd_stats cmd[CONFIG_BLECTLR_HCI_STATS_CMD_MAX];
+};
+
+/** @brief Get the HCI driver statistics.
+ *
+ * @param[out] stats Statistics.
+ */
+void bt_ctlr_hci_stats_get(struct bt_ctlr_hci_stats *stats);
+
+/** @brief Reset the HCI driver statistics.
+ */
+void bt_ctlr_hci_stats_reset(void);
+
+#endif /* CONFIG_BLECTLR_HCI_STATS */
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BT_CTLR_HCI_STATS_H_ */
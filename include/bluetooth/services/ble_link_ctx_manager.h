@@ -47,15 +47,31 @@ struct ble_link_conn_ctx {
 
 	 /** Pointer to Connection Object. */
 	struct bt_conn *conn;
+
+	/** Number of context users, including the connection itself. */
+	atomic_t ref;
+
+	/** Context data allocated while the previous context was in use. */
+	void *next_data;
+
+	/** Connection Object of the context allocated while the previous
+	 *  context was in use.
+	 */
+	struct bt_conn *next_conn;
+
+	/** Set while the context allocated while the previous context was
+	 *  in use is waiting for the previous context to be released.
+	 */
+	atomic_t next_pending;
 };
 
 /** @brief BLE Link Context manager structure.
  */
 struct ble_link_ctx_manager {
-	/** Connection context. */
+	/** Connection context, indexed by the connection index. */
 	struct ble_link_conn_ctx conn_ctx[CONFIG_BT_MAX_CONN];
 
-	/** Context data Mutex. */
+	/** Mutex serializing context allocation and freeing. */
 	struct k_mutex * const mutex;
 
 	/** Memory Slab Instance. */
@@ -90,6 +106,11 @@ static inline size_t ble_link_ctx_manager_get_ctx_num(struct ble_link_ctx_manage
  * @brief Function for allocating memory for connection context data.
  *        The function can set the pointer to the allocated memory.
  *
+ * The context is stored under the connection index
+ * (see @ref bt_conn_index). If the context of a previous connection with
+ * the same index is still in use, the new context is returned right away,
+ * but lookups find it only after the last user released the previous one.
+ *
  * @param ctx_manager Pointer to BLE Link Context manager structure.
  * @param conn        Pointer to Connection object.
  *
@@ -105,6 +126,9 @@ void *ble_link_ctx_manager_alloc(struct ble_link_ctx_manager *ctx_manager,
 /**
  * @brief Function for free allocated memory for connection.
  *
+ * New lookups of the context fail after this call. The memory is released
+ * when the last user releases the context.
+ *
  * @param ctx_manager Pointer to BLE Link Context manager structure.
  * @param conn        Pointer to Connection object.
  *
@@ -125,7 +149,8 @@ void ble_link_ctx_manager_free_all(struct ble_link_ctx_manager *ctx_manager);
  * @brief Function for getting the link's context data from the link memory pool.
  *
  * This function finds the link's context data in the memory pool.
- * The link to find is identified by the Connection object.
+ * The link to find is identified by the Connection object. The lookup
+ * uses the connection index and does not lock the context manager.
  *
  * @param ctx_manager         Pointer to BLE Link Context manager structure.
  * @param conn                Pointer to Connection object.
@@ -147,7 +172,6 @@ void *ble_link_ctx_manager_get(struct ble_link_ctx_manager *ctx_manager,
  * by its index in connection context array.
  *
  * @param ctx_manager         Pointer to BLE Link Context manager structure.
- * @param conn_ctx            Pointer to Connection context.
  * @param id                  Connection context index.
  *
  * @warning This function should be used in conjunction with the @ref ble_link_ctx_manager_release
@@ -162,17 +186,19 @@ const struct ble_link_conn_ctx *ble_link_ctx_manager_context_get(struct ble_link
 /**
  * @brief Function for releasing the link context from the link memory pool.
  *
- * This function finds and release the link context in the memory pool.
- * The link to find is identified by the Context data.
+ * This function releases the link context in the memory pool.
+ * The link is identified by its index in connection context array,
+ * that is the connection index (see @ref bt_conn_index).
  *
- * @warning This function should be used in conjunction with the @ref ble_link_ctx_manager_get
- *	    or @ref ble_link_ctx_manager_get_by_id to ensure proper operation.
+ * @warning This function should be used in conjunction with the
+ *	    @ref ble_link_ctx_manager_alloc, @ref ble_link_ctx_manager_get
+ *	    or @ref ble_link_ctx_manager_context_get to ensure proper operation.
  *
  * @param ctx_manager         Pointer to BLE Link Context manager structure.
- * @param ctx_data            Pointer to data with context for the connection.
+ * @param id                  Connection context index.
  */
 void ble_link_ctx_manager_release(struct ble_link_ctx_manager *ctx_manager,
-				  void *ctx_data);
+				  u8_t id);
 
 #ifdef __cplusplus
 }
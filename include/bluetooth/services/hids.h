@@ -38,9 +38,31 @@ extern "C" {
  * @param ...               Lengths of HIDS reports
  */
 #define HIDS_DEF(_name, ...)				                       \
+	_HIDS_DEF(_name, _BLE_HIDS_LINK_CTX_SIZE_CALC(__VA_ARGS__))
+
+/**
+ * @brief Declare a HIDS instance that uses Input Report filtering.
+ *
+ * Input Report filtering keeps the last notified report and the report
+ * waiting for sending for each Input Report and connection, so the lengths
+ * of the Input Reports are given separately.
+ *
+ * @param _name Name of the HIDS instance.
+ * @param _inp_rep_sizes Lengths of HIDS Input Reports, in parentheses.
+ * @param ...               Lengths of HIDS Output and Feature Reports
+ */
+#define HIDS_INP_REP_FILTER_DEF(_name, _inp_rep_sizes, ...)		       \
+	_HIDS_DEF(_name,						       \
+		  _BLE_HIDS_INP_REP_FILTER_SIZE_CALC _inp_rep_sizes +	       \
+		  _BLE_HIDS_LINK_CTX_SIZE_CALC(0, ##__VA_ARGS__))
+
+/**@brief Helping macro for @ref HIDS_DEF, that declares a HIDS instance
+ *        with the given link context size.
+ */
+#define _HIDS_DEF(_name, _ctx_size)					       \
 	BLE_LINK_CTX_MANAGER_DEF(_name,                                        \
 				 CONFIG_BT_GATT_HIDS_MAX_CLIENT_COUNT,         \
-				 _BLE_HIDS_LINK_CTX_SIZE_CALC(__VA_ARGS__));   \
+				 _ctx_size);				       \
 	static struct bt_gatt_attr					       \
 		CONCAT(_name, _attr_tab)[CONFIG_BT_GATT_HIDS_ATTR_MAX] = { 0 };\
 	static struct hids _name =					       \
@@ -62,6 +84,22 @@ extern "C" {
  */
 #define _BLE_HIDS_REPORT_ADD(_report_size) (_report_size) +
 
+/**@brief Helping macro for @ref HIDS_INP_REP_FILTER_DEF, that calculates
+ *        the link context size used by the Input Reports.
+ */
+#define _BLE_HIDS_INP_REP_FILTER_SIZE_CALC(...)             \
+	(MACRO_MAP(_BLE_HIDS_INP_REP_FILTER_ADD, __VA_ARGS__) 0)
+
+/**@brief Helping macro for @ref HIDS_INP_REP_FILTER_DEF, that adds
+ *        the stored, last notified and pending Input Report lengths.
+ */
+#define _BLE_HIDS_INP_REP_FILTER_ADD(_report_size) \
+	(_BLE_HIDS_INP_REP_BUF_CNT * (_report_size)) +
+
+/**@brief Number of buffers used per Input Report by Input Report filtering.
+ */
+#define _BLE_HIDS_INP_REP_BUF_CNT 3
+
 /** HID Service information flags. */
 enum hids_flags {
 	/** Device is capable of sending a wake-signal to a host. */
@@ -131,6 +169,21 @@ typedef void (*hids_notif_handler_t) (enum hids_notif_evt evt);
 typedef void (*hids_rep_handler_t) (struct hids_rep const *rep,
 				    struct bt_conn *conn);
 
+/** @brief Input Report merge handler.
+ *
+ * Merges a new relative Input Report (for example, mouse motion) into
+ * the report waiting for sending.
+ *
+ * @param pending Report waiting for sending, updated with the merged data.
+ * @param rep     New report.
+ * @param len     Length of the reports.
+ *
+ * @return True if the reports were merged, false if they cannot be merged
+ *	   without losing data (for example, button state differs).
+ */
+typedef bool (*hids_inp_rep_merge_t) (u8_t *pending, u8_t const *rep,
+				      u8_t len);
+
 /** @brief Input Report.
  */
 struct hids_inp_rep {
@@ -166,6 +219,20 @@ struct hids_inp_rep {
 
 	/** Callback with the notification event. */
 	hids_notif_handler_t handler;
+
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	/** Drop the report if it is identical to the last one notified
+	 * to the connection. Use it only for reports that carry absolute
+	 * state, for example keyboard keys.
+	 */
+	bool drop_unchanged;
+
+	/** Callback merging relative reports. If set, a report sent while
+	 * the previous notification of this report is not completed waits
+	 * for sending and the following reports are merged into it.
+	 */
+	hids_inp_rep_merge_t merge;
+#endif
 };
 
 
@@ -384,8 +451,28 @@ struct hids {
 
 	/** Pointer to BLE Link Context manager instance. */
 	struct ble_link_ctx_manager *ctx_manager;
+
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	/** Work sending the Input Reports waiting for sending. */
+	struct k_work inp_rep_work;
+
+	/** Mutex serializing the senders of filtered Input Reports. */
+	struct k_mutex inp_rep_mutex;
+#endif
 };
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+/** @brief Input Report notification in progress.
+ */
+struct hids_inp_rep_tx {
+	/** Index of the Input Report. */
+	u8_t rep_idx;
+
+	/** Notification complete callback of the user. */
+	bt_gatt_notify_complete_func_t cb;
+};
+#endif
+
 /** @brief HID Connection context data structure.
  */
 struct hids_conn_data {
@@ -409,6 +496,36 @@ struct hids_conn_data {
 
 	/** Pointer to Feature Reports Context data. */
 	u8_t *feat_rep_ctx;
+
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	/** Pointer to the last notified Input Reports. */
+	u8_t *inp_rep_sent;
+
+	/** Pointer to the Input Reports waiting for sending. */
+	u8_t *inp_rep_pending;
+
+	/** Bitmask of Input Reports notified at least once. */
+	u32_t inp_rep_sent_bm;
+
+	/** Bitmask of Input Reports waiting for sending. */
+	u32_t inp_rep_pending_bm;
+
+	/** Callbacks of the Input Reports waiting for sending. */
+	bt_gatt_notify_complete_func_t
+		inp_rep_pending_cb[CONFIG_BT_GATT_HIDS_INPUT_REP_MAX];
+
+	/** Number of notifications in progress per Input Report. */
+	u8_t inp_rep_tx_cnt[CONFIG_BT_GATT_HIDS_INPUT_REP_MAX];
+
+	/** Queue of notifications in progress, in the sending order. */
+	struct hids_inp_rep_tx inp_rep_tx[CONFIG_BT_GATT_HIDS_INP_REP_TX_MAX];
+
+	/** Index of the oldest notification in progress. */
+	u8_t inp_rep_tx_head;
+
+	/** Number of notifications in progress. */
+	u8_t inp_rep_tx_num;
+#endif
 };
 
 
@@ -460,6 +577,10 @@ int hids_notify_disconnected(struct hids *hids_obj, struct bt_conn *conn);
  *  @warning The function is not thread safe.
  *	     It can not be called from multiple threads at the same time.
  *
+ *  @note If CONFIG_BT_GATT_HIDS_INP_REP_FILTER is set, a report that is
+ *	  dropped as unchanged or merged into the report waiting for sending
+ *	  returns -EALREADY and its callback is not called.
+ *
  *  @param hids_obj Pointer to HIDS instance.
  *  @param conn Pointer to Connection Object.
  *  @param rep_index Index of report descriptor.
@@ -36,6 +36,30 @@ typedef void (*nus_received_cb_t)(const u8_t *const data, u16_t len);
 /** @brief Callback type for data sent. */
 typedef void (*nus_sent_cb_t)(const u8_t *data, u16_t len);
 
+/** @brief Statistics of a completed stream transfer. */
+struct nus_stream_stats {
+	/** Number of bytes sent. */
+	u32_t bytes;
+
+	/** Number of notifications sent. */
+	u32_t notifications;
+
+	/** Transfer duration in milliseconds. */
+	u32_t duration_ms;
+
+	/** Achieved throughput in bits per second. */
+	u32_t throughput_bps;
+};
+
+/** @brief Callback type for stream transfer completion.
+ *
+ * @param conn  Connection object the stream was sent to.
+ * @param err   0 if all data was sent, otherwise a negative error code.
+ * @param stats Statistics of the transfer.
+ */
+typedef void (*nus_stream_done_cb_t)(struct bt_conn *conn, int err,
+				     const struct nus_stream_stats *stats);
+
 /** @brief Pointers to the callback functions for service events. */
 struct bt_nus_cb {
 	nus_received_cb_t received_cb;
@@ -72,6 +96,32 @@ int nus_init(struct bt_nus_cb *callbacks);
  */
 int nus_send(const u8_t *data, u16_t len);
 
+/**@brief Send a data stream to a connection.
+ *
+ * @details This function splits the data into notifications of the maximum
+ *          size allowed by the ATT MTU of the connection and sends them.
+ *          At most CONFIG_BT_GATT_NUS_STREAM_TX_MAX notifications are in
+ *          progress at a time, the following ones are sent when the previous
+ *          ones complete. Only one stream per connection can be in progress.
+ *
+ * @note The data buffer must be valid until the completion callback is
+ *       called.
+ *
+ * @param[in] conn    Connection object. Must not be NULL.
+ * @param[in] data    Pointer to a data buffer.
+ * @param[in] len     Length of the data in the buffer.
+ * @param[in] done_cb Callback called when the transfer is completed or
+ *                    aborted. Can be NULL.
+ *
+ * @retval 0 If the transfer is started.
+ * @retval -EINVAL If a parameter is invalid.
+ * @retval -EFAULT If the peer of the connection has not enabled
+ *                 notifications.
+ * @retval -EBUSY If a stream to this connection is already in progress.
+ */
+int nus_send_stream(struct bt_conn *conn, const u8_t *data, size_t len,
+		    nus_stream_done_cb_t done_cb);
+
 #ifdef __cplusplus
 }
 #endif
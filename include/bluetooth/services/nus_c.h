@@ -71,6 +71,28 @@ struct bt_gatt_nus_c_cbs {
 	void (*tx_notif_disabled)(void);
 };
 
+#if CONFIG_BT_GATT_NUS_C_TX_QUEUE
+/** @brief NUS Client transmission queue.
+ *
+ * @param buf Queued data.
+ * @param head Write position in the buffer.
+ * @param tail Read position in the buffer.
+ * @param count Number of queued bytes.
+ * @param lock Mutex protecting the queue.
+ * @param space Semaphore signaled when space is released.
+ * @param work Work writing the queued data to the peer.
+ */
+struct bt_gatt_nus_c_tx_queue {
+	u8_t buf[CONFIG_BT_GATT_NUS_C_TX_QUEUE_SIZE];
+	u16_t head;
+	u16_t tail;
+	u16_t count;
+	struct k_mutex lock;
+	struct k_sem space;
+	struct k_work work;
+};
+#endif
+
 /** @brief NUS Client structure.
  *
  * @param bt_conn Connection object.
@@ -80,6 +102,7 @@ struct bt_gatt_nus_c_cbs {
  * @param tx_notif_params GATT subscribe parameters for NUS TX Characteristic.
  * @param rx_write_params GATT write parameters for NUS RX Characteristic.
  * @param cbs Application callbacks.
+ * @param tx_queue Transmission queue used by the queued send API.
  */
 struct bt_gatt_nus_c {
 	struct bt_conn *conn;
@@ -88,6 +111,9 @@ struct bt_gatt_nus_c {
 	struct bt_gatt_subscribe_params tx_notif_params;
 	struct bt_gatt_write_params rx_write_params;
 	struct bt_gatt_nus_c_cbs cbs;
+#if CONFIG_BT_GATT_NUS_C_TX_QUEUE
+	struct bt_gatt_nus_c_tx_queue tx_queue;
+#endif
 };
 
 /** @brief NUS Client initialization structure.
@@ -129,6 +155,32 @@ int bt_gatt_nus_c_init(struct bt_gatt_nus_c *nus_c,
 int bt_gatt_nus_c_send(struct bt_gatt_nus_c *nus_c, const u8_t *data,
 		       u16_t len);
 
+/** @brief Queue data to be sent to the server.
+ *
+ * This function copies the data to the transmission queue of the instance.
+ * The queued data is written to the RX Characteristic of the server using
+ * Write Without Response, in chunks that fit in the ATT MTU. Several writes
+ * can be in progress at the same time, so the data is sent in every
+ * connection event. The data_sent callback is not called for the queued
+ * data.
+ *
+ * The data is queued as a whole or not at all. If there is not enough space
+ * in the queue, the function waits for the data to be written to the peer.
+ *
+ * @param[in,out] nus_c NUS Client instance.
+ * @param[in] data Data to be transmitted.
+ * @param[in] len Length of data.
+ * @param[in] timeout Time to wait for space in the queue (in milliseconds),
+ *		      K_NO_WAIT or K_FOREVER.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval (-ENOMEM) If there was no space in the queue.
+ * @retval (-EINVAL) If the data does not fit in the queue.
+ * @retval Otherwise, a negative error code is returned.
+ */
+int bt_gatt_nus_c_send_queued(struct bt_gatt_nus_c *nus_c, const u8_t *data,
+			      u16_t len, s32_t timeout);
+
 /** @brief Assign handles to the NUS Client instance.
  *
  * This function should be called when a link with a peer has been established
@@ -14,27 +14,87 @@
 #ifndef __GATT_THROUGHPUT_H
 #define __GATT_THROUGHPUT_H
 
+#include <zephyr/types.h>
+#include <toolchain.h>
 #include <bluetooth/uuid.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Number of buckets in the latency histogram. */
+#define THROUGHPUT_LATENCY_BUCKETS 16
+
+/** Upper limit of the first latency histogram bucket (in microseconds).
+ *  The limit doubles with every following bucket. The last bucket counts
+ *  all latencies above the limit of the previous one.
+ */
+#define THROUGHPUT_LATENCY_BUCKET_BASE_US 125
+
+/**@brief Per packet latency statistics.
+ *
+ * @param count Number of packets measured.
+ * @param min_us Minimum latency in microseconds.
+ * @param max_us Maximum latency in microseconds.
+ * @param sum_us Sum of all latencies in microseconds.
+ * @param bucket Latency histogram.
+ */
+struct throughput_latency {
+	u32_t count;
+	u32_t min_us;
+	u32_t max_us;
+	u64_t sum_us;
+	u32_t bucket[THROUGHPUT_LATENCY_BUCKETS];
+} __packed;
+
 /**@brief BLE GATT throughput metrics.
  *
  * @param write_count Number of GATT writes received.
  * @param write_len Number of bytes received.
  * @param write_rate Transfer speed in bits per second.
+ * @param notify_count Number of GATT notifications sent.
+ * @param notify_len Number of bytes sent in notifications.
+ * @param notify_latency Latency of the notifications sent, measured from
+ *			 queuing to completion.
  */
 struct metrics {
 	u32_t write_count;
 	u32_t write_len;
 	u32_t write_rate;
+	u32_t notify_count;
+	u32_t notify_len;
+	struct throughput_latency notify_latency;
+} __packed;
+
+/** Throughput control operation codes. */
+enum throughput_ctrl_op {
+	/** Reset the metrics. */
+	THROUGHPUT_CTRL_RESET,
+
+	/** Start sending notifications. */
+	THROUGHPUT_CTRL_NOTIFY,
 };
 
+/**@brief Throughput control request.
+ *
+ * @param op Operation code, see @ref throughput_ctrl_op.
+ * @param len Length of each notification.
+ * @param count Maximum number of notifications to send.
+ * @param duration_ms Maximum duration of sending in milliseconds.
+ */
+struct throughput_ctrl {
+	u8_t op;
+	u16_t len;
+	u32_t count;
+	u32_t duration_ms;
+} __packed;
+
 /** Throughput characteristic UUID. */
 #define BT_UUID_THROUGHPUT_CHAR BT_UUID_DECLARE_16(0x1524)
 
+/** Throughput control characteristic UUID. */
+#define BT_UUID_THROUGHPUT_CTRL BT_UUID_DECLARE_16(0x1525)
+
 /** Throughput Service UUID. */
 #define BT_UUID_THROUGHPUT                                                     \
 	BT_UUID_DECLARE_128(0xBB, 0x4A, 0xFF, 0x4F, 0xAD, 0x03, 0x41, 0x5D,    \
@@ -45,6 +105,43 @@ struct metrics {
  */
 void throughput_init(void);
 
+/**
+ * @brief Reset latency statistics.
+ *
+ * @param lat Latency statistics.
+ */
+static inline void throughput_latency_reset(struct throughput_latency *lat)
+{
+	*lat = (struct throughput_latency){ .min_us = UINT32_MAX };
+}
+
+/**
+ * @brief Add a latency sample to the statistics.
+ *
+ * @param lat Latency statistics.
+ * @param us Latency in microseconds.
+ */
+static inline void throughput_latency_add(struct throughput_latency *lat,
+					  u32_t us)
+{
+	size_t i = 0;
+
+	while ((i < THROUGHPUT_LATENCY_BUCKETS - 1) &&
+	       (us >= ((u32_t)THROUGHPUT_LATENCY_BUCKET_BASE_US << i))) {
+		i++;
+	}
+
+	lat->bucket[i]++;
+	lat->count++;
+	lat->sum_us += us;
+	if (us < lat->min_us) {
+		lat->min_us = us;
+	}
+	if (us > lat->max_us) {
+		lat->max_us = us;
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
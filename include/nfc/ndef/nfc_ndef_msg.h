@@ -41,6 +41,20 @@ struct nfc_ndef_msg_desc {
 	u32_t record_count;
 };
 
+/**
+ * @brief Function for calculating the size of an encoded NDEF message.
+ *
+ * The payload constructors of the records are only called to calculate the
+ * sizes of the payloads, which is cheaper than encoding the message.
+ *
+ * @param ndef_msg_desc Pointer to the message descriptor.
+ * @param msg_len Size of the encoded message as output.
+ *
+ * @return 0 on success, or (negative) error code on failure.
+ */
+int nfc_ndef_msg_size_get(struct nfc_ndef_msg_desc const *ndef_msg_desc,
+			  u32_t *msg_len);
+
 /**
  * @brief Function for encoding an NDEF message.
  *
@@ -53,7 +67,8 @@ struct nfc_ndef_msg_desc {
  *
  * @param ndef_msg_desc Pointer to the message descriptor.
  * @param msg_buffer Pointer to the message destination. If NULL, function
- * will calculate the expected size of the message.
+ * will calculate the expected size of the message, like
+ * @ref nfc_ndef_msg_size_get.
  * @param msg_len Size of the available memory for the message as input. Size
  * of the generated message as output.
  *
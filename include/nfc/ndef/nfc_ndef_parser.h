@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef _NFC_NDEF_PARSER_H__
+#define _NFC_NDEF_PARSER_H__
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+#include <nfc/ndef/nfc_ndef_record.h>
+#include <nfc/ndef/nfc_text_rec.h>
+#include <nfc/ndef/nfc_uri_rec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ *
+ * @defgroup nfc_ndef_parser NDEF message parser
+ * @{
+ * @ingroup nfc_ndef_msg
+ *
+ * @brief Parsing of NFC NDEF messages.
+ *
+ * The parser walks the records of a message in place. It does not copy or
+ * allocate anything: the descriptors of the parsed records point into the
+ * buffer of the message, which must stay valid while they are used.
+ */
+
+/**
+ * @brief State of the parser of an NDEF message.
+ *
+ * Initialize it with @ref nfc_ndef_parser_init. The fields are private.
+ */
+struct nfc_ndef_parser {
+	const u8_t *buf;	/* Encoded message. */
+	u32_t len;		/* Length of the encoded message. */
+	u32_t offset;		/* Offset of the next record. */
+	bool done;		/* The last record was parsed. */
+};
+
+/**
+ * @brief Descriptor of a parsed NDEF record.
+ *
+ * A chunked record is described as one record. The type and the ID are
+ * taken from the first chunk, and the payload length is the sum of the
+ * payload lengths of all chunks. The payload is not contiguous, so the
+ * payload pointer is NULL. Iterate over the chunks with
+ * @ref nfc_ndef_record_chunk_get for indexes from 0 to chunk_count - 1, or
+ * copy the payload with @ref nfc_ndef_record_payload_copy.
+ */
+struct nfc_ndef_parsed_record {
+	/** Value of the Type Name Format (TNF) field. */
+	enum nfc_ndef_record_tnf tnf;
+	/** Length of the type field. */
+	u8_t type_length;
+	/** Pointer to the type field. */
+	const u8_t *type;
+	/** Length of the ID field. Zero if the record has no ID. */
+	u8_t id_length;
+	/** Pointer to the ID field. Not relevant if id_length is 0. */
+	const u8_t *id;
+	/** Length of the payload of all chunks. */
+	u32_t payload_length;
+	/** Pointer to the payload. NULL if the record is chunked. */
+	const u8_t *payload;
+	/** Number of chunks. One for a record that is not chunked. */
+	u32_t chunk_count;
+	/* Encoded chunks, used to access the payload of each chunk. */
+	const u8_t *chunks;
+	u32_t chunks_len;
+};
+
+/**
+ * @brief Function for initializing the parser of an NDEF message.
+ *
+ * @param parser Pointer to the parser.
+ * @param buf Pointer to the encoded message, without the NLEN field.
+ * @param len Length of the encoded message.
+ *
+ * @return 0 on success, or (negative) error code on failure.
+ */
+int nfc_ndef_parser_init(struct nfc_ndef_parser *parser, const u8_t *buf,
+			 u32_t len);
+
+/**
+ * @brief Function for parsing the next record of an NDEF message.
+ *
+ * The function checks that all fields of the record lie within the buffer
+ * and that the record flags are consistent with its position in the
+ * message.
+ *
+ * @param parser Pointer to the parser.
+ * @param record Descriptor of the record as output.
+ *
+ * @retval 0 If a record was parsed.
+ * @retval -ENOENT If all records of the message were parsed.
+ * @retval -EBADMSG If the message is malformed. Parsing cannot continue.
+ */
+int nfc_ndef_parser_next(struct nfc_ndef_parser *parser,
+			 struct nfc_ndef_parsed_record *record);
+
+/**
+ * @brief Function for getting the payload of one chunk of a record.
+ *
+ * A record that is not chunked has one chunk, which holds the whole
+ * payload.
+ *
+ * @param record Pointer to the record descriptor.
+ * @param index Index of the chunk. Must be smaller than the chunk count of
+ * the record.
+ * @param payload Pointer to the payload of the chunk as output.
+ * @param payload_length Length of the payload of the chunk as output.
+ *
+ * @return 0 on success, or (negative) error code on failure.
+ */
+int nfc_ndef_record_chunk_get(const struct nfc_ndef_parsed_record *record,
+			      u32_t index,
+			      const u8_t **payload,
+			      u32_t *payload_length);
+
+/**
+ * @brief Function for copying the payload of all chunks of a record.
+ *
+ * @param record Pointer to the record descriptor.
+ * @param buf Pointer to the destination.
+ * @param len Size of the available memory as input. Size of the payload as
+ * output.
+ *
+ * @return 0 on success, or (negative) error code on failure.
+ */
+int nfc_ndef_record_payload_copy(const struct nfc_ndef_parsed_record *record,
+				 u8_t *buf,
+				 u32_t *len);
+
+/**
+ * @brief Function for decoding a text record.
+ *
+ * The pointers in the text descriptor point into the payload of the record.
+ *
+ * @param record Pointer to the record descriptor.
+ * @param text Text descriptor as output.
+ *
+ * @retval 0 If the record was decoded.
+ * @retval -EINVAL If the record is not a text record.
+ * @retval -EBADMSG If the payload of the record is malformed.
+ * @retval -ENOTSUP If the record is chunked.
+ */
+int nfc_ndef_text_rec_parse(const struct nfc_ndef_parsed_record *record,
+			    struct nfc_text_rec_payload_desc *text);
+
+/**
+ * @brief Function for decoding a URI record.
+ *
+ * The URI pointer in the URI descriptor points into the payload of the
+ * record. Reserved URI identifier codes are reported as @ref NFC_URI_RFU.
+ *
+ * @param record Pointer to the record descriptor.
+ * @param uri URI descriptor as output.
+ *
+ * @retval 0 If the record was decoded.
+ * @retval -EINVAL If the record is not a URI record.
+ * @retval -EBADMSG If the payload of the record is malformed.
+ * @retval -ENOTSUP If the record is chunked, or the URI is longer than 255
+ * bytes.
+ */
+int nfc_ndef_uri_rec_parse(const struct nfc_ndef_parsed_record *record,
+			   struct uri_payload_desc *uri);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NFC_NDEF_PARSER_H__ */
@@ -27,6 +27,10 @@ extern "C" {
 #define NDEF_RECORD_IL_MASK                0x08
 /** Mask of the TNF value field in the first byte of an NDEF record. */
 #define NDEF_RECORD_TNF_MASK               0x07
+/** Mask of the CF flag. If set, this flag indicates that the record is a
+ *  chunk of a chunked payload, and that more chunks follow.
+ */
+#define NDEF_RECORD_CF_MASK                0x20
 /** Mask of the SR flag. If set, this flag indicates that the PAYLOAD_LENGTH
  *  field has a size of 1 byte. Otherwise, PAYLOAD_LENGTH has 4 bytes.
  */
@@ -35,6 +39,8 @@ extern "C" {
 #define NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE  4
 /** Size of the Payload Length field in a short NDEF record. */
 #define NDEF_RECORD_PAYLOAD_LEN_SHORT_SIZE 1
+/** Largest payload that is encoded in a short NDEF record. */
+#define NDEF_RECORD_SHORT_PAYLOAD_MAX      255
 #define NDEF_RECORD_ID_LEN_SIZE            1
 
 /**
@@ -239,16 +245,37 @@ struct nfc_ndef_bin_payload_desc {
  */
 #define NFC_NDEF_BIN_PAYLOAD_DESC(name) (name##_nfc_ndef_bin_payload_desc)
 
+/**
+ * @brief Function for calculating the size of an encoded NDEF record.
+ *
+ * The payload constructor of the record is only called to calculate the
+ * size of the payload, which is cheaper than encoding the record.
+ *
+ * @param ndef_record_desc Pointer to the record descriptor.
+ * @param record_len Size of the encoded record as output.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int nfc_ndef_record_size_get(
+			struct nfc_ndef_record_desc const *ndef_record_desc,
+			u32_t *record_len);
+
 /**
  * @brief Function for encoding an NDEF record.
  *
  * @details This function encodes an NDEF record according to the provided
- * record descriptor.
+ * record descriptor. Records with a payload of up to
+ * @ref NDEF_RECORD_SHORT_PAYLOAD_MAX bytes are encoded as short records,
+ * with a 1-byte Payload Length field. The payload constructor is called
+ * once. The record is encoded with a long header and is moved into the
+ * short format if the payload fits, unless the buffer is too small for a
+ * long record, in which case the short format is used directly.
  *
  * @param ndef_record_desc Pointer to the record descriptor.
  * @param record_location Location of the record within the NDEF message.
  * @param record_buffer Pointer to the record destination. If NULL, function
- * will calculate the expected size of the record.
+ * will calculate the expected size of the record, like
+ * @ref nfc_ndef_record_size_get.
  * @param record_len Size of the available memory for the record as input.
  * Size of the generated record as output.
  *
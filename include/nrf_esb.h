@@ -10,6 +10,7 @@
 #include <misc/util.h>
 #include <nrf.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <zephyr/types.h>
 
 #ifdef __cplusplus
@@ -209,6 +210,73 @@ struct nrf_esb_evt {
 	u32_t tx_attempts;	/**< Number of TX retransmission attempts. */
 };
 
+/** Number of buckets in the histogram of transmission attempts. */
+#define NRF_ESB_STATS_ATTEMPTS_BUCKETS 8
+
+/** @brief Enhanced ShockBurst statistics of a pipe.
+ *
+ *  In PTX mode, the RSSI and ACK round-trip time are measured on the
+ *  acknowledgments. In PRX mode, the RSSI is measured on the received
+ *  packets, and a payload sent with an acknowledgment counts as a
+ *  successful transmission.
+ */
+struct nrf_esb_pipe_stats {
+	u32_t tx_success;	/**< Number of packets sent successfully. */
+	u32_t tx_failed;	/**< Number of packets that were not
+				  *  acknowledged after all retransmissions.
+				  */
+	/** Number of acknowledged packets by number of transmission attempts.
+	 *  Entry n counts the packets acknowledged after n + 1 attempts. The
+	 *  last entry also counts the packets that needed more attempts.
+	 */
+	u32_t tx_attempts[NRF_ESB_STATS_ATTEMPTS_BUCKETS];
+	u64_t ack_rtt_us;	/**< Total time from the first transmission of
+				  *  a packet to its acknowledgment
+				  *  (in microseconds). Divide by the sum of
+				  *  the tx_attempts entries for the average.
+				  */
+	u32_t ack_rtt_us_max;	/**< Longest time from the first transmission
+				  *  of a packet to its acknowledgment
+				  *  (in microseconds).
+				  */
+	u32_t rx_packets;	/**< Number of packets received. Retransmitted
+				  *  packets are not counted.
+				  */
+	u32_t rx_crc_errors;	/**< Number of packets received with a CRC
+				  *  error.
+				  */
+	u32_t rssi_samples;	/**< Number of RSSI measurements. */
+	u8_t rssi_avg;		/**< Moving average of the RSSI, in the unit of
+				  *  @ref nrf_esb_payload::rssi.
+				  */
+};
+
+/** @brief Enhanced ShockBurst statistics. */
+struct nrf_esb_stats {
+	/** Statistics of each pipe. */
+	struct nrf_esb_pipe_stats pipe[CONFIG_NRF_ESB_PIPE_COUNT];
+};
+
+/** @brief Statistics of a channel of the hop sequence. */
+struct nrf_esb_hop_channel_stats {
+	u8_t channel;		/**< Radio channel. */
+	bool blacklisted;	/**< The channel is currently skipped. */
+	u32_t tx_success;	/**< Number of packets acknowledged on the
+				  *  channel.
+				  */
+	u32_t tx_failed;	/**< Number of packets that were not
+				  *  acknowledged on the channel after all
+				  *  retransmissions.
+				  */
+	u32_t rx_packets;	/**< Number of packets received. */
+	u32_t rx_crc_errors;	/**< Number of packets received with a CRC
+				  *  error.
+				  */
+	u32_t blacklist_count;	/**< Number of times the channel was
+				  *  blacklisted.
+				  */
+};
+
 /** @brief Definition of the event handler for the module. */
 typedef void (*nrf_esb_event_handler)(const struct nrf_esb_evt *event);
 
@@ -293,6 +361,51 @@ bool nrf_esb_is_idle(void);
  */
 int nrf_esb_write_payload(const struct nrf_esb_payload *payload);
 
+/** @brief Reserve a payload in the TX FIFO.
+ *
+ *  This function provides a pointer to the next free entry of the TX FIFO,
+ *  so that the payload can be written in place instead of being copied by
+ *  @ref nrf_esb_write_payload. Set the length, pipe, noack, and data fields
+ *  of the payload, and queue it with @ref nrf_esb_tx_commit. Calling this
+ *  function again before the payload is committed provides the same payload.
+ *
+ *  The TX FIFO is shared with the radio interrupt without locking. It must
+ *  be filled from a single context.
+ *
+ *  @param[out] payload	Pointer to the payload.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_tx_reserve(struct nrf_esb_payload **payload);
+
+/** @brief Queue the payload reserved with @ref nrf_esb_tx_reserve.
+ *
+ *  The payload is checked and queued like a payload written with
+ *  @ref nrf_esb_write_payload. If the check fails, the payload stays
+ *  reserved.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_tx_commit(void);
+
+/** @brief Write several payloads for transmission or acknowledgement.
+ *
+ *  This function queues the payloads like @ref nrf_esb_write_payload, but
+ *  makes them available to the radio at once and starts the transmission
+ *  only once. Payloads are queued in order until the TX FIFO is full or an
+ *  invalid payload is found.
+ *
+ *  @param[in] payloads	Payloads.
+ *  @param[in] count	Number of payloads.
+ *
+ *  @return Number of payloads queued. If no payload could be queued, a
+ *          (negative) error code is returned instead.
+ */
+int nrf_esb_write_payloads(const struct nrf_esb_payload *payloads,
+			   size_t count);
+
 /** @brief Read a payload.
  *
  *  @param[in,out] payload	The payload to be received.
@@ -302,6 +415,48 @@ int nrf_esb_write_payload(const struct nrf_esb_payload *payload);
  */
 int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload);
 
+/** @brief Read several payloads.
+ *
+ *  This function reads the oldest received payloads like
+ *  @ref nrf_esb_read_rx_payload, and releases their RX FIFO entries at once.
+ *
+ *  @param[out] payloads	Buffer for the received payloads.
+ *  @param[in]  max_count	Maximum number of payloads to read.
+ *
+ *  @return Number of payloads read. If no payload could be read, a
+ *          (negative) error code is returned instead.
+ */
+int nrf_esb_read_rx_payloads(struct nrf_esb_payload *payloads,
+			     size_t max_count);
+
+/** @brief Borrow the oldest received payload.
+ *
+ *  Packets are received directly into the RX FIFO. Instead of copying the
+ *  payload like @ref nrf_esb_read_rx_payload, this function provides a
+ *  pointer to the payload in the RX FIFO. Calling it again before the payload
+ *  is released provides the same payload.
+ *
+ *  The payload stays valid until it is released with
+ *  @ref nrf_esb_release_rx_payload, or until @ref nrf_esb_flush_rx or
+ *  @ref nrf_esb_disable is called. A borrowed payload occupies an RX FIFO
+ *  entry, so it should be released as soon as possible.
+ *
+ *  @param[out] payload	Pointer to the payload.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_borrow_rx_payload(const struct nrf_esb_payload **payload);
+
+/** @brief Release the payload borrowed with @ref nrf_esb_borrow_rx_payload.
+ *
+ *  The RX FIFO entry of the payload is reused for receiving.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_release_rx_payload(void);
+
 /** @brief Start transmitting data.
  *
  * @retval 0 If successful.
@@ -471,6 +626,69 @@ int nrf_esb_set_retransmit_count(u16_t count);
  */
 int nrf_esb_set_bitrate(enum nrf_esb_bitrate bitrate);
 
+/** @brief Get the link statistics.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_STATS.
+ *
+ *  @param[out] stats	Statistics.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_get_stats(struct nrf_esb_stats *stats);
+
+/** @brief Reset the link statistics.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_STATS.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_reset_stats(void);
+
+/** @brief Enable channel hopping.
+ *
+ *  The hop sequence is a permutation of the given channels derived from the
+ *  seed. The PTX and the PRX must use the same channels and seed.
+ *
+ *  In PTX mode, a packet that is not acknowledged after all retransmissions
+ *  is retried on the next channel of the sequence, until it has been tried
+ *  on every channel. Channels on which too many packets fail are skipped
+ *  for a while. In PRX mode, the radio moves to the next channel when no
+ *  packet has been received for some time.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_HOP. The module must be idle.
+ *
+ *  @param[in] channels	Channels to hop on.
+ *  @param[in] count	Number of channels.
+ *  @param[in] seed	Seed of the hop sequence.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_hop_enable(const u8_t *channels, u8_t count, u32_t seed);
+
+/** @brief Disable channel hopping.
+ *
+ *  The radio stays on the current channel.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_hop_disable(void);
+
+/** @brief Get the statistics of the channels of the hop sequence.
+ *
+ *  @param[out]    stats	Statistics, in the order of the hop sequence.
+ *  @param[in,out] count	Number of entries in @p stats. Set to the
+ *				number of entries written.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_hop_get_stats(struct nrf_esb_hop_channel_stats *stats,
+			  u8_t *count);
+
 /** @brief Reuse a packet ID for a specific pipe.
  *
  *  The ESB protocol uses a 2-bit sequence number (packet ID) to identify
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#ifndef __NRF_ESB_FRAG_H
+#define __NRF_ESB_FRAG_H
+
+#include <stddef.h>
+#include <zephyr/types.h>
+#include <nrf_esb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup nrf_esb_frag Enhanced ShockBurst fragmentation
+ * @{
+ * @ingroup nrf_esb
+ *
+ * @brief Transport of messages larger than an Enhanced ShockBurst payload.
+ *
+ *        Messages are split into fragments that are sent as separate
+ *        payloads. The receiver reports which fragments it is missing,
+ *        and only those are sent again. Both sides must use the
+ *        @ref NRF_ESB_PROTOCOL_ESB_DPL protocol and the same
+ *        @ref CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH.
+ */
+
+/** Size of the fragment header. */
+#define NRF_ESB_FRAG_HDR_SIZE 6
+
+/** Maximum number of message bytes in a fragment. */
+#define NRF_ESB_FRAG_DATA_MAX                                                  \
+	(CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH - NRF_ESB_FRAG_HDR_SIZE)
+
+/** Maximum length of a message. */
+#define NRF_ESB_FRAG_MSG_MAX                                                   \
+	(CONFIG_NRF_ESB_FRAG_COUNT_MAX * NRF_ESB_FRAG_DATA_MAX)
+
+/** @brief Callbacks of the fragmentation transport.
+ *
+ *  The callbacks are called from the Enhanced ShockBurst event handler or
+ *  from the system work queue.
+ */
+struct nrf_esb_frag_cb {
+	/** @brief A message was received.
+	 *
+	 *  The data is valid until the callback returns.
+	 *
+	 *  @param pipe	Pipe on which the message was received.
+	 *  @param data	Message data.
+	 *  @param len	Message length.
+	 */
+	void (*received)(u8_t pipe, const u8_t *data, size_t len);
+
+	/** @brief Sending a message completed.
+	 *
+	 *  @param err	Zero if the receiver got the whole message,
+	 *		-ETIMEDOUT if it stopped responding.
+	 */
+	void (*sent)(int err);
+};
+
+/** @brief Initialize the fragmentation transport.
+ *
+ *  @param[in] cb		Callbacks.
+ *  @param[in] rx_buf		Buffer for reassembling received messages.
+ *  @param[in] rx_buf_size	Size of the buffer. Longer messages are
+ *				not received.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_frag_init(const struct nrf_esb_frag_cb *cb, u8_t *rx_buf,
+		      size_t rx_buf_size);
+
+/** @brief Handle an Enhanced ShockBurst event.
+ *
+ *  The transport refills the TX FIFO and reads the RX FIFO from the
+ *  Enhanced ShockBurst events. Set this function as the event handler in
+ *  @ref nrf_esb_config, or call it from the event handler of the
+ *  application. While the transport is used, the application must not
+ *  write or read payloads itself.
+ *
+ *  @param[in] event	Event.
+ */
+void nrf_esb_frag_event_handler(const struct nrf_esb_evt *event);
+
+/** @brief Send a message.
+ *
+ *  The message is queued as fragments as long as there is room in the
+ *  TX FIFO. The data must stay valid until the
+ *  @ref nrf_esb_frag_cb::sent callback is called.
+ *
+ *  In PRX mode, the fragments are sent as ACK payloads, so the PTX must
+ *  keep sending packets on the pipe.
+ *
+ *  @param[in] pipe	Pipe to send the message on.
+ *  @param[in] data	Message data.
+ *  @param[in] len	Message length.
+ *
+ * @retval 0 If successful.
+ * @retval -EBUSY If another message is being sent.
+ * @retval -EMSGSIZE If the message is longer than @ref NRF_ESB_FRAG_MSG_MAX.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_frag_send(u8_t pipe, const u8_t *data, size_t len);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NRF_ESB_FRAG_H */
@@ -43,19 +43,6 @@ static K_FIFO_DEFINE(fifo_uart_rx_data);
 static struct bt_conn *default_conn;
 static struct bt_gatt_nus_c gatt_nus_c;
 
-static void ble_data_sent(u8_t err, const u8_t *const data, u16_t len)
-{
-	struct uart_data_t *buf;
-
-	/* Retrieve buffer context. */
-	buf = CONTAINER_OF(data, struct uart_data_t, data);
-	k_free(buf);
-
-	if (err) {
-		printk("ATT error code: 0x%02X\n", err);
-	}
-}
-
 static u8_t ble_data_received(const u8_t *const data, u16_t len)
 {
 	for (u16_t pos = 0; pos != len;) {
@@ -315,7 +302,6 @@ static int nus_client_init(void)
 	struct bt_gatt_nus_c_init_param nus_c_init_obj = {
 		.cbs = {
 			.data_received = ble_data_received,
-			.data_sent = ble_data_sent,
 		}
 	};
 
@@ -390,10 +376,14 @@ void main(void)
 		struct uart_data_t *buf = k_fifo_get(&fifo_uart_rx_data,
 						     K_FOREVER);
 
-		err = bt_gatt_nus_c_send(&gatt_nus_c, buf->data, buf->len);
+		/* The data is copied, so the buffer can be released. */
+		err = bt_gatt_nus_c_send_queued(&gatt_nus_c, buf->data,
+						buf->len, K_FOREVER);
 		if (err) {
 			printk("Failed to send data over BLE connection"
 			       "(err %d)\n", err);
 		}
+
+		k_free(buf);
 	}
 }
@@ -59,10 +59,10 @@
 #define HIDS_QUEUE_SIZE 10
 
 /* HIDS instance. */
-HIDS_DEF(hids_obj,
-	 INPUT_REP_BUTTONS_LEN,
-	 INPUT_REP_MOVEMENT_LEN,
-	 INPUT_REP_MEDIA_PLAYER_LEN);
+HIDS_INP_REP_FILTER_DEF(hids_obj,
+			(INPUT_REP_BUTTONS_LEN,
+			 INPUT_REP_MOVEMENT_LEN,
+			 INPUT_REP_MEDIA_PLAYER_LEN));
 
 
 #ifdef CONFIG_BT_GATT_HIDS_SECURITY_LEVEL_LOW
@@ -242,6 +242,35 @@ static void hids_pm_evt_handler(enum hids_pm_evt evt, struct bt_conn *conn)
 }
 
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+static s16_t movement_axis_get(u16_t val)
+{
+	/* Sign extend the 12-bit value. */
+	return (s16_t)(val << 4) >> 4;
+}
+
+
+static bool mouse_movement_merge(u8_t *pending, u8_t const *rep, u8_t len)
+{
+	__ASSERT_NO_MSG(len == INPUT_REP_MOVEMENT_LEN);
+
+	s16_t x = movement_axis_get(pending[0] | ((pending[1] & 0x0f) << 8)) +
+		  movement_axis_get(rep[0] | ((rep[1] & 0x0f) << 8));
+	s16_t y = movement_axis_get((pending[1] >> 4) | (pending[2] << 4)) +
+		  movement_axis_get((rep[1] >> 4) | (rep[2] << 4));
+
+	x = max(min(x, 0x07ff), -0x07ff);
+	y = max(min(y, 0x07ff), -0x07ff);
+
+	pending[0] = x & 0xff;
+	pending[1] = ((y & 0x0f) << 4) | ((x >> 8) & 0x0f);
+	pending[2] = (y >> 4) & 0xff;
+
+	return true;
+}
+#endif
+
+
 static void hid_init(void)
 {
 	int err;
@@ -339,12 +368,18 @@ static void hid_init(void)
 	hids_inp_rep = &hids_init_param.inp_rep_group_init.reports[0];
 	hids_inp_rep->size = INPUT_REP_BUTTONS_LEN;
 	hids_inp_rep->id = INPUT_REP_REF_BUTTONS_ID;
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	hids_inp_rep->drop_unchanged = true;
+#endif
 	hids_init_param.inp_rep_group_init.cnt++;
 
 	hids_inp_rep++;
 	hids_inp_rep->size = INPUT_REP_MOVEMENT_LEN;
 	hids_inp_rep->id = INPUT_REP_REF_MOVEMENT_ID;
 	hids_inp_rep->rep_mask = mouse_movement_mask;
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	hids_inp_rep->merge = mouse_movement_merge;
+#endif
 	hids_init_param.inp_rep_group_init.cnt++;
 
 	hids_inp_rep++;
@@ -11,6 +11,7 @@
 #include <kernel.h>
 #include <console.h>
 #include <misc/printk.h>
+#include <misc/byteorder.h>
 #include <string.h>
 #include <zephyr/types.h>
 
@@ -28,17 +29,74 @@
 #define INTERVAL_MIN	0x140	/* 320 units, 400 ms */
 #define INTERVAL_MAX	0x140	/* 320 units, 400 ms */
 
+/* Duration of a single test run. */
+#define TEST_DURATION_MS	3000
+
+/* Time to wait for the last notifications after a notification test. */
+#define TEST_NOTIFY_TAIL_MS	1000
+
+#define ATT_TIMEOUT		K_SECONDS(30)
+#define PHY_UPDATE_TIMEOUT_MS	2000
+#define CONN_UPDATE_TIMEOUT_MS	10000
+
+enum test_mode {
+	TEST_MODE_WRITE_CMD,
+	TEST_MODE_WRITE_REQ,
+	TEST_MODE_NOTIFY,
+
+	TEST_MODE_COUNT
+};
+
+static const char * const test_mode_name[] = {
+	[TEST_MODE_WRITE_CMD] = "write_cmd",
+	[TEST_MODE_WRITE_REQ] = "write_req",
+	[TEST_MODE_NOTIFY] = "notify",
+};
+
+/* Parameters swept by the benchmark. */
+static const u8_t test_phys[] = {
+	BT_HCI_LE_PHY_PREFER_1M,
+	BT_HCI_LE_PHY_PREFER_2M,
+	BT_HCI_LE_PHY_PREFER_CODED,
+};
+static const u16_t test_data_lens[] = {27, 251};
+static const u16_t test_att_mtus[] = {23, 247};
+static const u16_t test_intervals[] = {6, 40, 320}; /* 1.25 ms units */
+
+struct test_result {
+	u32_t bytes;
+	u32_t duration_ms;
+	u32_t rate_bps;
+	struct throughput_latency latency;
+};
+
 static u16_t char_handle;
+static u16_t ctrl_handle;
+static u16_t ccc_handle;
 static volatile bool test_ready;
 static struct bt_conn *default_conn;
 static struct bt_uuid *uuid16 = BT_UUID_THROUGHPUT_CHAR;
 static struct bt_uuid *uuid128 = BT_UUID_THROUGHPUT;
 static struct bt_gatt_read_params read_param;
+static struct bt_gatt_write_params write_param;
 static struct bt_gatt_exchange_params exchange_params;
 static struct bt_gatt_discover_params discover_params;
+static struct bt_gatt_subscribe_params subscribe_params;
 static struct bt_le_conn_param *conn_param =
 	BT_LE_CONN_PARAM(INTERVAL_MIN, INTERVAL_MAX, 0, 400);
 
+static K_SEM_DEFINE(att_sem, 0, 1);
+static u8_t att_err;
+
+static struct metrics peer_met;
+static u16_t peer_met_len;
+
+static struct {
+	u32_t bytes;
+	u32_t first;
+	u32_t last;
+} notify_rx;
+
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
 	BT_DATA_BYTES(BT_DATA_UUID128_ALL,
@@ -88,6 +146,24 @@ static struct bt_scan_cb scan_cb = {
 	.connecting_error = scan_connecting_error,
 };
 
+static u8_t notify_func(struct bt_conn *conn,
+			struct bt_gatt_subscribe_params *params,
+			const void *data, u16_t length)
+{
+	if (!data) {
+		params->value_handle = 0;
+		return BT_GATT_ITER_STOP;
+	}
+
+	notify_rx.last = k_uptime_get_32();
+	if (!notify_rx.bytes) {
+		notify_rx.first = notify_rx.last;
+	}
+	notify_rx.bytes += length;
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
 static void exchange_func(struct bt_conn *conn, u8_t err,
 			  struct bt_gatt_exchange_params *params)
 {
@@ -96,9 +172,22 @@ static void exchange_func(struct bt_conn *conn, u8_t err,
 	printk("MTU exchange %s\n", err == 0 ? "successful" : "failed");
 
 	err = bt_conn_get_info(conn, &info);
-	if (info.role == BT_CONN_ROLE_MASTER) {
-		test_ready = true;
+	if (info.role != BT_CONN_ROLE_MASTER) {
+		return;
 	}
+
+	subscribe_params.notify = notify_func;
+	subscribe_params.value = BT_GATT_CCC_NOTIFY;
+	subscribe_params.value_handle = char_handle;
+	subscribe_params.ccc_handle = ccc_handle;
+
+	err = bt_gatt_subscribe(conn, &subscribe_params);
+	if (err) {
+		printk("Subscribe failed (err %d)\n", err);
+		return;
+	}
+
+	test_ready = true;
 }
 
 static u8_t discover_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
@@ -123,8 +212,31 @@ static u8_t discover_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 			printk("Discover failed (err %d)\n", err);
 		}
 	} else if (!bt_uuid_cmp(discover_params.uuid, uuid16)) {
-		/* characteristic found */
+		/* characteristic found, discover its CCC descriptor */
 		char_handle = attr->handle + 1;
+		discover_params.type = BT_GATT_DISCOVER_DESCRIPTOR;
+		discover_params.uuid = BT_UUID_GATT_CCC;
+		discover_params.start_handle = char_handle + 1;
+
+		err = bt_gatt_discover(conn, &discover_params);
+		if (err) {
+			printk("Discover failed (err %d)\n", err);
+		}
+	} else if (!bt_uuid_cmp(discover_params.uuid, BT_UUID_GATT_CCC)) {
+		/* CCC found, discover control characteristic */
+		ccc_handle = attr->handle;
+		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+		discover_params.uuid = BT_UUID_THROUGHPUT_CTRL;
+		discover_params.start_handle = ccc_handle + 1;
+
+		err = bt_gatt_discover(conn, &discover_params);
+		if (err) {
+			printk("Discover failed (err %d)\n", err);
+		}
+	} else if (!bt_uuid_cmp(discover_params.uuid,
+				BT_UUID_THROUGHPUT_CTRL)) {
+		/* control characteristic found */
+		ctrl_handle = attr->handle + 1;
 		exchange_params.func = exchange_func;
 
 		err = bt_gatt_exchange_mtu(conn, &exchange_params);
@@ -239,6 +351,10 @@ static void disconnected(struct bt_conn *conn, u8_t reason)
 		default_conn = NULL;
 	}
 
+	/* Unblock a test waiting for an ATT response. */
+	att_err = BT_ATT_ERR_UNLIKELY;
+	k_sem_give(&att_sem);
+
 	advertise_and_scan();
 }
 
@@ -260,85 +376,520 @@ static u8_t read_fn(struct bt_conn *conn, u8_t err,
 		    struct bt_gatt_read_params *params, const void *data,
 		    u16_t len)
 {
-	struct metrics met = {0};
+	if (err || !data) {
+		att_err = err;
+		k_sem_give(&att_sem);
+		return BT_GATT_ITER_STOP;
+	}
+
+	/* The metrics can be received in several Read Blob Responses. */
+	len = min(len, sizeof(peer_met) - peer_met_len);
+	memcpy((u8_t *)&peer_met + peer_met_len, data, len);
+	peer_met_len += len;
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void write_fn(struct bt_conn *conn, u8_t err,
+		     struct bt_gatt_write_params *params)
+{
+	att_err = err;
+	k_sem_give(&att_sem);
+}
+
+static int att_wait(void)
+{
+	if (k_sem_take(&att_sem, ATT_TIMEOUT)) {
+		return -ETIMEDOUT;
+	}
+
+	return att_err ? -EIO : 0;
+}
+
+static int peer_metrics_read(void)
+{
+	int err;
+
+	k_sem_reset(&att_sem);
+	memset(&peer_met, 0, sizeof(peer_met));
+	peer_met_len = 0;
+
+	read_param.single.handle = char_handle;
+
+	err = bt_gatt_read(default_conn, &read_param);
+	if (err) {
+		return err;
+	}
+
+	return att_wait();
+}
+
+static int gatt_write_sync(u16_t handle, const void *data, u16_t len)
+{
+	int err;
+
+	k_sem_reset(&att_sem);
+
+	write_param.func = write_fn;
+	write_param.handle = handle;
+	write_param.offset = 0;
+	write_param.data = data;
+	write_param.length = len;
 
+	err = bt_gatt_write(default_conn, &write_param);
 	if (err) {
-		printk("GATT read callback failed (err: %d)\n", err);
-		return 0;
+		return err;
+	}
+
+	return att_wait();
+}
+
+static int phy_get(u8_t *tx_phy, u8_t *rx_phy)
+{
+	struct bt_hci_cp_le_read_phy *cp;
+	struct bt_hci_rp_le_read_phy *rp;
+	struct net_buf *buf;
+	struct net_buf *rsp;
+	u16_t handle;
+	int err;
+
+	err = bt_hci_get_conn_handle(default_conn, &handle);
+	if (err) {
+		return err;
 	}
 
-	if (data) {
-		len = min(len, sizeof(met));
-		memcpy(&met, data, len);
+	buf = bt_hci_cmd_create(BT_HCI_OP_LE_READ_PHY, sizeof(*cp));
+	if (!buf) {
+		return -ENOBUFS;
+	}
 
-		printk("[peer] received %u bytes (%u KB)"
-		       " in %u GATT writes at %u bps\n",
-		       met.write_len, met.write_len / 1024, met.write_count,
-		       met.write_rate);
+	cp = net_buf_add(buf, sizeof(*cp));
+	cp->handle = sys_cpu_to_le16(handle);
 
-		test_ready = true;
+	err = bt_hci_cmd_send_sync(BT_HCI_OP_LE_READ_PHY, buf, &rsp);
+	if (err) {
+		return err;
 	}
 
-	return BT_GATT_ITER_STOP;
+	rp = (void *)rsp->data;
+	*tx_phy = rp->tx_phy;
+	*rx_phy = rp->rx_phy;
+	net_buf_unref(rsp);
+
+	return 0;
 }
 
-static void test_run(void)
+static int phy_set(u8_t phy)
+{
+	struct bt_hci_cp_le_set_phy *cp;
+	struct net_buf *buf;
+	u32_t start;
+	u16_t handle;
+	u8_t want;
+	int err;
+
+	err = bt_hci_get_conn_handle(default_conn, &handle);
+	if (err) {
+		return err;
+	}
+
+	buf = bt_hci_cmd_create(BT_HCI_OP_LE_SET_PHY, sizeof(*cp));
+	if (!buf) {
+		return -ENOBUFS;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	cp->handle = sys_cpu_to_le16(handle);
+	cp->all_phys = 0;
+	cp->tx_phys = phy;
+	cp->rx_phys = phy;
+	cp->phy_opts = 0;
+
+	err = bt_hci_cmd_send_sync(BT_HCI_OP_LE_SET_PHY, buf, NULL);
+	if (err) {
+		return err;
+	}
+
+	switch (phy) {
+	case BT_HCI_LE_PHY_PREFER_2M:
+		want = BT_HCI_LE_PHY_2M;
+		break;
+	case BT_HCI_LE_PHY_PREFER_CODED:
+		want = BT_HCI_LE_PHY_CODED;
+		break;
+	default:
+		want = BT_HCI_LE_PHY_1M;
+		break;
+	}
+
+	/* The host does not report the PHY Update Complete event. */
+	start = k_uptime_get_32();
+	do {
+		u8_t tx_phy;
+		u8_t rx_phy;
+
+		err = phy_get(&tx_phy, &rx_phy);
+		if (err) {
+			return err;
+		}
+
+		if ((tx_phy == want) && (rx_phy == want)) {
+			return 0;
+		}
+
+		k_sleep(K_MSEC(50));
+	} while ((k_uptime_get_32() - start) < PHY_UPDATE_TIMEOUT_MS);
+
+	return -ENOTSUP;
+}
+
+static u16_t tx_time_get(u16_t octets, u8_t phy)
+{
+	/* Packet duration including MIC, see Core Vol 6, Part B, 4.5.10. */
+	switch (phy) {
+	case BT_HCI_LE_PHY_PREFER_2M:
+		return (octets + 15) * 4;
+	case BT_HCI_LE_PHY_PREFER_CODED:
+		return 400 + (octets + 9) * 64;
+	default:
+		return (octets + 14) * 8;
+	}
+}
+
+static int data_len_set(u16_t octets, u8_t phy)
 {
+	struct bt_hci_cp_le_set_data_len *cp;
+	struct net_buf *buf;
+	u16_t handle;
 	int err;
-	u64_t stamp;
-	u32_t delta;
-	u32_t data = 0;
+
+	err = bt_hci_get_conn_handle(default_conn, &handle);
+	if (err) {
+		return err;
+	}
+
+	buf = bt_hci_cmd_create(BT_HCI_OP_LE_SET_DATA_LEN, sizeof(*cp));
+	if (!buf) {
+		return -ENOBUFS;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	cp->handle = sys_cpu_to_le16(handle);
+	cp->tx_octets = sys_cpu_to_le16(octets);
+	cp->tx_time = sys_cpu_to_le16(tx_time_get(octets, phy));
+
+	err = bt_hci_cmd_send_sync(BT_HCI_OP_LE_SET_DATA_LEN, buf, NULL);
+	if (err) {
+		return err;
+	}
+
+	/* The host does not report the Data Length Change event. */
+	k_sleep(K_MSEC(200));
+
+	return 0;
+}
+
+static int conn_interval_set(u16_t interval)
+{
+	struct bt_le_conn_param param = {
+		.interval_min = interval,
+		.interval_max = interval,
+		.latency = 0,
+		.timeout = 400,
+	};
+	struct bt_conn_info info = {0};
+	u32_t start;
+	int err;
+
+	err = bt_conn_get_info(default_conn, &info);
+	if (err) {
+		return err;
+	}
+
+	if (info.le.interval == interval) {
+		return 0;
+	}
+
+	err = bt_conn_le_param_update(default_conn, &param);
+	if (err) {
+		return err;
+	}
+
+	start = k_uptime_get_32();
+	do {
+		k_sleep(K_MSEC(100));
+
+		err = bt_conn_get_info(default_conn, &info);
+		if (err) {
+			return err;
+		}
+
+		if (info.le.interval == interval) {
+			return 0;
+		}
+	} while ((k_uptime_get_32() - start) < CONN_UPDATE_TIMEOUT_MS);
+
+	return -ETIMEDOUT;
+}
+
+/* Print the image up to the progress of a test. */
+static void img_print(u32_t *prog, u32_t elapsed_ms)
+{
+	u32_t end = min((u64_t)elapsed_ms * IMG_SIZE / TEST_DURATION_MS,
+			(u64_t)IMG_SIZE);
+
+	while (*prog < end) {
+		printk("%c", img[*prog / IMG_X][*prog % IMG_X]);
+		(*prog)++;
+	}
+}
+
+static int test_write_cmd(u16_t len, struct test_result *res)
+{
+	static u8_t dummy[CONFIG_BT_L2CAP_TX_MTU];
+	u32_t start;
 	u32_t prog = 0;
+	int err;
 
-	/* a dummy data buffer */
-	static char dummy[256];
+	/* reset peer metrics */
+	err = bt_gatt_write_without_response(default_conn, char_handle,
+					     dummy, 1, false);
+	if (err) {
+		return err;
+	}
 
+	start = k_uptime_get_32();
+	while ((k_uptime_get_32() - start) < TEST_DURATION_MS) {
+		err = bt_gatt_write_without_response(default_conn, char_handle,
+						     dummy, len, false);
+		if (err) {
+			return err;
+		}
 
-	/* wait for user input to continue */
-	printk("Ready, press any key to start\n");
-	console_getchar();
+		/* print graphics */
+		img_print(&prog, k_uptime_get_32() - start);
+	}
 
-	if (!test_ready) {
-		/* disconnected while blocking inside _getchar() */
-		return;
+	img_print(&prog, TEST_DURATION_MS);
+
+	err = peer_metrics_read();
+	if (err) {
+		return err;
 	}
 
-	test_ready = false;
+	res->bytes = peer_met.write_len;
+	res->rate_bps = peer_met.write_rate;
+	res->duration_ms = res->rate_bps ?
+		((u64_t)res->bytes * 8 * 1000) / res->rate_bps : 0;
+
+	return 0;
+}
+
+static int test_write_req(u16_t len, struct test_result *res)
+{
+	static u8_t dummy[CONFIG_BT_L2CAP_TX_MTU];
+	u32_t start;
+	int err;
 
 	/* reset peer metrics */
-	err = bt_gatt_write_without_response(
-		default_conn, char_handle, dummy, 1, false);
+	err = gatt_write_sync(char_handle, dummy, 1);
+	if (err) {
+		return err;
+	}
 
-	/* get cycle stamp */
-	stamp = k_uptime_get_32();
+	start = k_uptime_get_32();
+	while ((k_uptime_get_32() - start) < TEST_DURATION_MS) {
+		u32_t stamp = k_cycle_get_32();
 
-	while (prog < IMG_SIZE) {
-		err = bt_gatt_write_without_response(
-			default_conn, char_handle, dummy, 244, false);
+		err = gatt_write_sync(char_handle, dummy, len);
 		if (err) {
-			printk("GATT write failed (err %d)\n", err);
-			break;
+			return err;
 		}
 
-		/* print graphics */
-		printk("%c", img[prog / IMG_X][prog % IMG_X]);
-		data += 244;
-		prog++;
+		throughput_latency_add(&res->latency,
+			SYS_CLOCK_HW_CYCLES_TO_NS64(k_cycle_get_32() - stamp) /
+			1000);
 	}
 
-	delta = k_uptime_delta_32(&stamp);
+	err = peer_metrics_read();
+	if (err) {
+		return err;
+	}
 
-	printk("\nDone\n");
-	printk("[local] sent %u bytes (%u KB) in %u ms at %llu kbps\n",
-	       data, data / 1024, delta, ((u64_t)data * 8 / delta));
+	res->bytes = peer_met.write_len;
+	res->rate_bps = peer_met.write_rate;
+	res->duration_ms = res->rate_bps ?
+		((u64_t)res->bytes * 8 * 1000) / res->rate_bps : 0;
 
-	/* read back char from peer */
-	read_param.single.handle = char_handle;
+	return 0;
+}
 
-	err = bt_gatt_read(default_conn, &read_param);
+static int test_notify(u16_t len, struct test_result *res)
+{
+	struct throughput_ctrl ctrl = {
+		.op = THROUGHPUT_CTRL_RESET,
+	};
+	int err;
+
+	err = gatt_write_sync(ctrl_handle, &ctrl, sizeof(ctrl));
+	if (err) {
+		return err;
+	}
+
+	memset(&notify_rx, 0, sizeof(notify_rx));
+
+	ctrl.op = THROUGHPUT_CTRL_NOTIFY;
+	ctrl.len = len;
+	ctrl.count = UINT32_MAX;
+	ctrl.duration_ms = TEST_DURATION_MS;
+
+	err = gatt_write_sync(ctrl_handle, &ctrl, sizeof(ctrl));
+	if (err) {
+		return err;
+	}
+
+	k_sleep(TEST_DURATION_MS + TEST_NOTIFY_TAIL_MS);
+
+	err = peer_metrics_read();
 	if (err) {
-		printk("GATT read failed (err %d)\n", err);
+		return err;
 	}
+
+	res->bytes = notify_rx.bytes;
+	res->duration_ms = notify_rx.last - notify_rx.first;
+	res->rate_bps = res->duration_ms ?
+		((u64_t)res->bytes * 8 * 1000) / res->duration_ms : 0;
+	res->latency = peer_met.notify_latency;
+
+	return 0;
+}
+
+static void result_header_print(void)
+{
+	printk("RESULT,mode,phy,data_len,att_mtu,interval_us,bytes,"
+	       "duration_ms,kbps,lat_count,lat_min_us,lat_avg_us,lat_max_us,"
+	       "lat_hist\n");
+}
+
+static void result_print(enum test_mode mode, u8_t phy, u16_t data_len,
+			 u16_t att_mtu, u16_t interval,
+			 const struct test_result *res)
+{
+	const struct throughput_latency *lat = &res->latency;
+
+	printk("RESULT,%s,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,",
+	       test_mode_name[mode],
+	       (phy == BT_HCI_LE_PHY_PREFER_2M) ? "2M" :
+	       (phy == BT_HCI_LE_PHY_PREFER_CODED) ? "coded" : "1M",
+	       data_len, att_mtu, interval * 1250, res->bytes,
+	       res->duration_ms, res->rate_bps / 1000, lat->count,
+	       lat->count ? lat->min_us : 0,
+	       lat->count ? (u32_t)(lat->sum_us / lat->count) : 0,
+	       lat->max_us);
+
+	for (size_t i = 0; i < ARRAY_SIZE(lat->bucket); i++) {
+		printk("%s%u", i ? ";" : "", lat->bucket[i]);
+	}
+	printk("\n");
+}
+
+static int test_run_single(enum test_mode mode, u8_t phy, u16_t data_len,
+			   u16_t att_mtu, u16_t interval)
+{
+	struct test_result res = {0};
+	u16_t len;
+	int err;
+
+	att_mtu = min(att_mtu, bt_gatt_get_mtu(default_conn));
+	len = att_mtu - 3;
+
+	throughput_latency_reset(&res.latency);
+
+	switch (mode) {
+	case TEST_MODE_WRITE_CMD:
+		err = test_write_cmd(len, &res);
+		break;
+	case TEST_MODE_WRITE_REQ:
+		err = test_write_req(len, &res);
+		break;
+	case TEST_MODE_NOTIFY:
+		err = test_notify(len, &res);
+		break;
+	default:
+		err = -EINVAL;
+		break;
+	}
+
+	if (err) {
+		printk("Test %s failed (err %d)\n", test_mode_name[mode], err);
+		return err;
+	}
+
+	result_print(mode, phy, data_len, att_mtu, interval, &res);
+
+	return 0;
+}
+
+static void test_run(void)
+{
+	/* wait for user input to continue */
+	printk("Ready, press any key to start\n");
+	console_getchar();
+
+	if (!test_ready) {
+		/* disconnected while blocking inside _getchar() */
+		return;
+	}
+
+	result_header_print();
+
+	for (size_t p = 0; p < ARRAY_SIZE(test_phys); p++) {
+		int err = phy_set(test_phys[p]);
+
+		if (err) {
+			printk("SKIP,PHY 0x%02x not used (err %d)\n",
+			       test_phys[p], err);
+			continue;
+		}
+
+		for (size_t d = 0; d < ARRAY_SIZE(test_data_lens); d++) {
+			err = data_len_set(test_data_lens[d], test_phys[p]);
+			if (err) {
+				printk("SKIP,data length %u not set (err %d)\n",
+				       test_data_lens[d], err);
+				continue;
+			}
+
+			for (size_t i = 0; i < ARRAY_SIZE(test_intervals);
+			     i++) {
+				err = conn_interval_set(test_intervals[i]);
+				if (err) {
+					printk("SKIP,interval %u not set "
+					       "(err %d)\n",
+					       test_intervals[i], err);
+					continue;
+				}
+
+				for (size_t m = 0;
+				     m < ARRAY_SIZE(test_att_mtus); m++) {
+					for (enum test_mode mode = 0;
+					     mode < TEST_MODE_COUNT; mode++) {
+						if (!test_ready) {
+							return;
+						}
+
+						test_run_single(mode,
+							test_phys[p],
+							test_data_lens[d],
+							test_att_mtus[m],
+							test_intervals[i]);
+					}
+				}
+			}
+		}
+	}
+
+	printk("Done\n");
 }
 
 static bool le_param_req(struct bt_conn *conn, struct bt_le_conn_param *param)
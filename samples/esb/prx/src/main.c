@@ -19,7 +19,6 @@ LOG_MODULE_REGISTER(esb_prx);
 #define LED_OFF 1
 
 static struct device *led_port;
-static struct nrf_esb_payload rx_payload;
 static struct nrf_esb_payload tx_payload = NRF_ESB_CREATE_PAYLOAD(0,
 	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17);
 
@@ -65,6 +64,8 @@ static void leds_update(u8_t value)
 
 void esb_event_handler(struct nrf_esb_evt const *event)
 {
+	const struct nrf_esb_payload *rx_payload;
+
 	switch (event->evt_id) {
 	case NRF_ESB_EVENT_TX_SUCCESS:
 		LOG_DBG("TX SUCCESS EVENT");
@@ -73,19 +74,19 @@ void esb_event_handler(struct nrf_esb_evt const *event)
 		LOG_DBG("TX FAILED EVENT");
 		break;
 	case NRF_ESB_EVENT_RX_RECEIVED:
-		if (nrf_esb_read_rx_payload(&rx_payload) == 0) {
+		while (nrf_esb_borrow_rx_payload(&rx_payload) == 0) {
 			LOG_DBG("Packet received, len %d : "
 				"0x%02x, 0x%02x, 0x%02x, 0x%02x, "
 				"0x%02x, 0x%02x, 0x%02x, 0x%02x",
-				rx_payload.length, rx_payload.data[0],
-				rx_payload.data[1], rx_payload.data[2],
-				rx_payload.data[3], rx_payload.data[4],
-				rx_payload.data[5], rx_payload.data[6],
-				rx_payload.data[7]);
-
-			leds_update(rx_payload.data[1]);
-		} else {
-			LOG_ERR("Error while reading rx packet");
+				rx_payload->length, rx_payload->data[0],
+				rx_payload->data[1], rx_payload->data[2],
+				rx_payload->data[3], rx_payload->data[4],
+				rx_payload->data[5], rx_payload->data[6],
+				rx_payload->data[7]);
+
+			leds_update(rx_payload->data[1]);
+
+			nrf_esb_release_rx_payload();
 		}
 		break;
 	}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <esb_sim.h>
+#include <misc/printk.h>
+#include <misc/util.h>
+#include <nrf_esb.h>
+#include <string.h>
+#include <zephyr.h>
+#include <zephyr/types.h>
+
+#define RUN_TIME_US 1000000
+#define LATENCY_PACKETS 100
+
+static const u8_t base_addr_0[4] = {0xE7, 0xE7, 0xE7, 0xE7};
+static const u8_t base_addr_1[4] = {0xC2, 0xC2, 0xC2, 0xC2};
+static const u8_t addr_prefix[2] = {0xE7, 0xC2};
+
+static K_SEM_DEFINE(tx_done, 0, 1);
+
+static u32_t tx_success;
+static u32_t tx_failed;
+static u32_t rx_packets;
+static u32_t rx_bytes;
+
+static void esb_event_handler(struct nrf_esb_evt const *event)
+{
+	const struct nrf_esb_payload *payload;
+
+	switch (event->evt_id) {
+	case NRF_ESB_EVENT_TX_SUCCESS:
+		tx_success++;
+		k_sem_give(&tx_done);
+		break;
+	case NRF_ESB_EVENT_TX_FAILED:
+		tx_failed++;
+		nrf_esb_pop_tx();
+		nrf_esb_start_tx();
+		k_sem_give(&tx_done);
+		break;
+	case NRF_ESB_EVENT_RX_RECEIVED:
+		while (nrf_esb_borrow_rx_payload(&payload) == 0) {
+			rx_packets++;
+			rx_bytes += payload->length;
+			nrf_esb_release_rx_payload();
+		}
+		break;
+	}
+}
+
+static int esb_setup(enum nrf_esb_mode mode)
+{
+	struct nrf_esb_config config = NRF_ESB_DEFAULT_CONFIG;
+	int err;
+
+	config.mode = mode;
+	config.retransmit_delay = 250;
+	config.event_handler = esb_event_handler;
+
+	nrf_esb_disable();
+
+	err = nrf_esb_init(&config);
+	if (err) {
+		return err;
+	}
+
+	err = nrf_esb_set_base_address_0(base_addr_0);
+	if (err) {
+		return err;
+	}
+
+	err = nrf_esb_set_base_address_1(base_addr_1);
+	if (err) {
+		return err;
+	}
+
+	return nrf_esb_set_prefixes(addr_prefix, ARRAY_SIZE(addr_prefix));
+}
+
+static void peer_setup(enum esb_sim_peer_role role, u8_t pipe,
+		       u8_t payload_length, u32_t interval_us)
+{
+	struct esb_sim_peer_config config = {
+		.role = role,
+		.prefix = addr_prefix[pipe],
+		.channel = 2,
+		.rssi = 50,
+		.payload_length = payload_length,
+		.interval_us = interval_us,
+		.retransmit_delay_us = 250,
+		.retransmit_count = 3,
+	};
+
+	memcpy(config.base_addr, pipe ? base_addr_1 : base_addr_0,
+	       sizeof(config.base_addr));
+
+	if (esb_sim_peer_add(&config) < 0) {
+		printk("Could not add a simulated peer\n");
+	}
+}
+
+static void medium_setup(u32_t loss_permille)
+{
+	struct esb_sim_medium_config config = {
+		.loss_permille = loss_permille,
+		.seed = 1,
+	};
+
+	esb_sim_medium_configure(&config);
+	esb_sim_peers_clear();
+	esb_sim_stats_reset();
+
+	tx_success = 0;
+	tx_failed = 0;
+	rx_packets = 0;
+	rx_bytes = 0;
+}
+
+static void print_medium(void)
+{
+	struct esb_sim_stats stats;
+
+	esb_sim_stats_get(&stats);
+	printk("  medium: %u transmissions, %u collisions, %u lost\n",
+	       stats.transmissions, stats.collisions, stats.lost);
+}
+
+/* Keep the TX FIFO full for RUN_TIME_US and count the results. */
+static void ptx_run(u8_t length)
+{
+	struct nrf_esb_payload *payload;
+	u64_t start = esb_sim_time_us();
+	u32_t seq = 0;
+
+	while (esb_sim_time_us() - start < RUN_TIME_US) {
+		if (nrf_esb_tx_reserve(&payload)) {
+			k_sem_take(&tx_done, K_MSEC(10));
+			continue;
+		}
+
+		payload->pipe = 0;
+		payload->noack = false;
+		payload->length = length;
+		memset(payload->data, seq++, length);
+		nrf_esb_tx_commit();
+	}
+
+	nrf_esb_flush_tx();
+}
+
+static void bench_throughput(u8_t length, u32_t loss_permille,
+			     u8_t interferers)
+{
+	medium_setup(loss_permille);
+	peer_setup(ESB_SIM_PEER_PRX, 0, 0, 0);
+	for (u8_t i = 0; i < interferers; i++) {
+		/* Sends to pipe 1 of a PRX that does not exist */
+		peer_setup(ESB_SIM_PEER_PTX, 1, length, 2000);
+	}
+
+	ptx_run(length);
+
+	printk("PTX %u bytes, loss %u/1000, %u interferers:\n",
+	       length, loss_permille, interferers);
+	printk("  %u packets/s, %u bytes/s, %u failed\n",
+	       tx_success, tx_success * length, tx_failed);
+	print_medium();
+}
+
+static void bench_latency(void)
+{
+	struct nrf_esb_payload payload = NRF_ESB_CREATE_PAYLOAD(0, 0x01);
+	u64_t total = 0;
+	u32_t worst = 0;
+
+	medium_setup(0);
+	peer_setup(ESB_SIM_PEER_PRX, 0, 0, 0);
+
+	for (u32_t i = 0; i < LATENCY_PACKETS; i++) {
+		u64_t start = esb_sim_time_us();
+		u32_t us;
+
+		k_sem_reset(&tx_done);
+		if (nrf_esb_write_payload(&payload) ||
+		    k_sem_take(&tx_done, K_MSEC(100))) {
+			printk("Latency test failed\n");
+			return;
+		}
+
+		us = esb_sim_time_us() - start;
+		total += us;
+		worst = max(worst, us);
+	}
+
+	printk("PTX single packet latency: avg %u us, max %u us\n",
+	       (u32_t)(total / LATENCY_PACKETS), worst);
+}
+
+static void bench_ack_payload(void)
+{
+	medium_setup(0);
+	peer_setup(ESB_SIM_PEER_PRX, 0, CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH, 0);
+
+	ptx_run(1);
+
+	printk("PTX ACK payloads of %u bytes:\n",
+	       CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH);
+	printk("  %u packets/s, %u ACK payload bytes/s\n",
+	       rx_packets, rx_bytes);
+	print_medium();
+}
+
+static void bench_prx(u8_t senders)
+{
+	struct esb_sim_peer_stats stats;
+	u32_t acked = 0;
+	u32_t failed = 0;
+
+	medium_setup(0);
+	for (u8_t i = 0; i < senders; i++) {
+		peer_setup(ESB_SIM_PEER_PTX, i % ARRAY_SIZE(addr_prefix),
+			   CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH, 0);
+	}
+
+	nrf_esb_start_rx();
+	k_sleep(K_MSEC(RUN_TIME_US / 1000));
+	nrf_esb_stop_rx();
+
+	for (u8_t i = 0; i < senders; i++) {
+		esb_sim_peer_stats_get(i, &stats);
+		acked += stats.tx_success;
+		failed += stats.tx_failed;
+	}
+	esb_sim_peers_clear();
+
+	printk("PRX with %u senders:\n", senders);
+	printk("  %u packets/s, %u bytes/s, %u acknowledged, %u failed\n",
+	       rx_packets, rx_bytes, acked, failed);
+	print_medium();
+}
+
+void main(void)
+{
+	printk("Enhanced ShockBurst simulation benchmark\n");
+
+	if (esb_setup(NRF_ESB_MODE_PTX)) {
+		printk("ESB initialization failed\n");
+		return;
+	}
+
+	bench_throughput(CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH, 0, 0);
+	bench_throughput(8, 0, 0);
+	bench_throughput(CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH, 100, 0);
+	bench_throughput(CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH, 0, 3);
+	bench_latency();
+	bench_ack_payload();
+
+	if (esb_setup(NRF_ESB_MODE_PRX)) {
+		printk("ESB initialization failed\n");
+		return;
+	}
+
+	bench_prx(1);
+	bench_prx(4);
+
+	printk("Benchmark complete\n");
+}
@@ -19,6 +19,8 @@
 
 #include "ndef_file_m.h"
 #include <nfc/ndef/nfc_ndef_msg.h>
+#include <nfc/ndef/nfc_ndef_parser.h>
+#include <misc/byteorder.h>
 
 #include <soc.h>
 #include <device.h>
@@ -63,6 +65,63 @@ static void flash_buffer_prepare(size_t data_length)
 
 }
 
+/**
+ * @brief Function for printing a string that is not null-terminated.
+ */
+static void str_print(const u8_t *str, u32_t len)
+{
+	for (u32_t i = 0; i < len; i++) {
+		printk("%c", str[i]);
+	}
+}
+
+/**
+ * @brief Function for printing the records of an NDEF message with NLEN field.
+ */
+static void ndef_msg_print(const u8_t *buf, size_t len)
+{
+	struct nfc_ndef_parser parser;
+	struct nfc_ndef_parsed_record record;
+	struct nfc_text_rec_payload_desc text;
+	struct uri_payload_desc uri;
+	u16_t msg_len;
+	int err;
+
+	msg_len = sys_get_be16(buf);
+	if (msg_len > len - NLEN_FIELD_SIZE) {
+		printk("Invalid NDEF message length!\n");
+		return;
+	}
+
+	/* NLEN of zero marks a file without a message, which is valid. */
+	if (msg_len == 0) {
+		printk("Empty NDEF message\n");
+		return;
+	}
+
+	nfc_ndef_parser_init(&parser, &buf[NLEN_FIELD_SIZE], msg_len);
+
+	while ((err = nfc_ndef_parser_next(&parser, &record)) == 0) {
+		if (!nfc_ndef_text_rec_parse(&record, &text)) {
+			printk("Text record: ");
+			str_print(text.data, text.data_len);
+			printk("\n");
+		} else if (!nfc_ndef_uri_rec_parse(&record, &uri)) {
+			printk("URI record (prefix 0x%02x): ",
+			       uri.uri_id_code);
+			str_print(uri.uri_data, uri.uri_data_len);
+			printk("\n");
+		} else {
+			printk("Record with TNF %d, payload of %u bytes\n",
+			       record.tnf, record.payload_length);
+		}
+	}
+
+	if (err != -ENOENT) {
+		printk("Malformed NDEF message!\n");
+	}
+}
+
 /**
  * @brief Callback function for handling NFC events.
  */
@@ -223,6 +282,7 @@ int main(void)
 				printk("Cannot flash NDEF message!\n");
 			} else {
 				printk("NDEF message successfully flashed.\n");
+				ndef_msg_print(flash_buf, sizeof(flash_buf));
 			}
 
 			atomic_set(&op_flags, FLASH_WRITE_FINISHED);
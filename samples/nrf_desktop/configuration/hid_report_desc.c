@@ -5,6 +5,7 @@
  */
 
 #include <zephyr/types.h>
+#include <toolchain.h>
 
 #include "hid_report_desc.h"
 
@@ -26,16 +27,16 @@ const u8_t hid_report_desc[] = {
 	0x29, 0x08,         /* Usage Maximum (8) */
 	0x15, 0x00,         /* Logical Minimum (0) */
 	0x25, 0x01,         /* Logical Maximum (1) */
-	0x75, 0x01,         /* Report Size (1) */
-	0x95, 0x08,         /* Report Count (8) */
+	0x75, REPORT_MOUSE_BUTTONS_SIZE,  /* Report Size */
+	0x95, REPORT_MOUSE_BUTTONS_COUNT, /* Report Count */
 	0x81, 0x02,         /* Input (Data, Variable, Absolute) */
 
 	0x05, USAGE_PAGE_MOUSE_WHEEL,
 	0x09, 0x38,         /* Usage (Wheel) */
 	0x15, 0x81,         /* Logical Minimum (-127) */
 	0x25, 0x7F,         /* Logical Maximum (127) */
-	0x75, 0x08,         /* Report Size (8) */
-	0x95, 0x01,         /* Report Count (1) */
+	0x75, REPORT_MOUSE_WHEEL_SIZE, /* Report Size */
+	0x95, REPORT_MOUSE_WHEEL_COUNT, /* Report Count */
 	0x81, 0x06,         /* Input (Data, Variable, Relative) */
 
 	0x05, USAGE_PAGE_MOUSE_XY,
@@ -43,8 +44,8 @@ const u8_t hid_report_desc[] = {
 	0x09, 0x31,         /* Usage (Y) */
 	0x16, 0x01, 0xF8,   /* Logical Maximum (2047) */
 	0x26, 0xFF, 0x07,   /* Logical Minimum (-2047) */
-	0x75, 0x0C,         /* Report Size (12) */
-	0x95, 0x02,         /* Report Count (2) */
+	0x75, REPORT_MOUSE_XY_SIZE, /* Report Size */
+	0x95, REPORT_MOUSE_XY_COUNT, /* Report Count */
 	0x81, 0x06,         /* Input (Data, Variable, Relative) */
 	0xC0,             /* End Collection (Physical) */
 	0xC0,           /* End Collection (Application) */
@@ -66,12 +67,12 @@ const u8_t hid_report_desc[] = {
 	0x29, 0xe7,       /* Usage Maximum (Right GUI) */
 	0x15, 0x00,       /* Logical Minimum (0) */
 	0x25, 0x01,       /* Logical Maximum (1) */
-	0x75, 0x01,       /* Report Size (1) */
-	0x95, 0x08,       /* Report Count (8) */
+	0x75, REPORT_KEYBOARD_MODIFIERS_SIZE,  /* Report Size */
+	0x95, REPORT_KEYBOARD_MODIFIERS_COUNT, /* Report Count */
 	0x81, 0x02,       /* Input (Data, Variable, Absolute) */
 
 	/* Keyboard - Reserved */
-	0x75, 0x08,       /* Report Size (8) */
+	0x75, REPORT_KEYBOARD_RESERVED_SIZE, /* Report Size */
 	0x95, 0x01,       /* Report Count (1) */
 	0x81, 0x01,       /* Input (Constant) */
 
@@ -81,21 +82,21 @@ const u8_t hid_report_desc[] = {
 	0x29, 0x65,       /* Usage Maximum (101) */
 	0x15, 0x00,       /* Logical Minimum (0) */
 	0x25, 0x65,       /* Logical Maximum (101) */
-	0x75, 0x08,       /* Report Size (8) */
-	0x95, 0x06,       /* Report Count (6) */
+	0x75, REPORT_KEYBOARD_KEYS_SIZE,  /* Report Size */
+	0x95, REPORT_KEYBOARD_KEYS_COUNT, /* Report Count */
 	0x81, 0x00,       /* Input (Data, Array) */
 
 	/* Keyboard - LEDs */
 	0x05, USAGE_PAGE_LEDS,
 	0x19, 0x01,       /* Usage Minimum (1) */
 	0x29, 0x05,       /* Usage Maximum (5) */
-	0x95, 0x05,       /* Report Count (5) */
+	0x95, REPORT_KEYBOARD_LEDS_COUNT, /* Report Count */
 	0x75, 0x01,       /* Report Size (1) */
 	0x91, 0x02,       /* Output (Data, Variable, Absolute) */
 
 	/* Keyboard - LEDs padding */
 	0x95, 0x01,       /* Report Count (1) */
-	0x75, 0x03,       /* Report Size (3) (padding) */
+	0x75, REPORT_KEYBOARD_LEDS_PADDING, /* Report Size (padding) */
 	0x91, 0x01,       /* Output (Data, Variable, Absolute) */
 
 	0xC0,           /* End Collection (Application) */
@@ -136,3 +137,27 @@ const u8_t hid_report_desc[] = {
 };
 
 const size_t hid_report_desc_size = sizeof(hid_report_desc);
+
+/* Field layout must match the report sizes. */
+BUILD_ASSERT_MSG(REPORT_MOUSE_BUTTONS_POS +
+		 REPORT_MOUSE_BUTTONS_SIZE * REPORT_MOUSE_BUTTONS_COUNT ==
+		 REPORT_MOUSE_WHEEL_POS, "Invalid mouse report layout");
+BUILD_ASSERT_MSG(REPORT_MOUSE_WHEEL_POS +
+		 REPORT_MOUSE_WHEEL_SIZE * REPORT_MOUSE_WHEEL_COUNT ==
+		 REPORT_MOUSE_X_POS, "Invalid mouse report layout");
+BUILD_ASSERT_MSG(REPORT_MOUSE_X_POS + REPORT_MOUSE_XY_SIZE ==
+		 REPORT_MOUSE_Y_POS, "Invalid mouse report layout");
+BUILD_ASSERT_MSG(REPORT_MOUSE_X_POS +
+		 REPORT_MOUSE_XY_SIZE * REPORT_MOUSE_XY_COUNT ==
+		 REPORT_MOUSE_BITS, "Invalid mouse report layout");
+BUILD_ASSERT_MSG(REPORT_KEYBOARD_MODIFIERS_POS +
+		 REPORT_KEYBOARD_MODIFIERS_SIZE *
+		 REPORT_KEYBOARD_MODIFIERS_COUNT +
+		 REPORT_KEYBOARD_RESERVED_SIZE ==
+		 REPORT_KEYBOARD_KEYS_POS, "Invalid keyboard report layout");
+BUILD_ASSERT_MSG(REPORT_KEYBOARD_KEYS_POS +
+		 REPORT_KEYBOARD_KEYS_SIZE * REPORT_KEYBOARD_KEYS_COUNT ==
+		 REPORT_KEYBOARD_LEDS_POS, "Invalid keyboard report layout");
+BUILD_ASSERT_MSG(REPORT_KEYBOARD_LEDS_POS + REPORT_KEYBOARD_LEDS_COUNT +
+		 REPORT_KEYBOARD_LEDS_PADDING ==
+		 REPORT_KEYBOARD_BITS, "Invalid keyboard report layout");
@@ -8,14 +8,44 @@
 #define _HID_REPORT_DESC_H_
 
 #include <stddef.h>
+#include <string.h>
 #include <zephyr/types.h>
+#include <toolchain.h>
+#include <misc/util.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define REPORT_SIZE_MOUSE	5 /* bytes */
-#define REPORT_SIZE_KEYBOARD	9 /* bytes */
+/* Layout of the report fields. Position and size are given in bits,
+ * the report descriptor items are built from the same values.
+ */
+#define REPORT_MOUSE_BUTTONS_POS	0
+#define REPORT_MOUSE_BUTTONS_SIZE	1
+#define REPORT_MOUSE_BUTTONS_COUNT	8
+#define REPORT_MOUSE_WHEEL_POS		8
+#define REPORT_MOUSE_WHEEL_SIZE		8
+#define REPORT_MOUSE_WHEEL_COUNT	1
+#define REPORT_MOUSE_X_POS		16
+#define REPORT_MOUSE_Y_POS		28
+#define REPORT_MOUSE_XY_SIZE		12
+#define REPORT_MOUSE_XY_COUNT		2
+#define REPORT_MOUSE_BITS		40
+
+#define REPORT_KEYBOARD_MODIFIERS_POS	0
+#define REPORT_KEYBOARD_MODIFIERS_SIZE	1
+#define REPORT_KEYBOARD_MODIFIERS_COUNT	8
+#define REPORT_KEYBOARD_RESERVED_SIZE	8
+#define REPORT_KEYBOARD_KEYS_POS	16
+#define REPORT_KEYBOARD_KEYS_SIZE	8
+#define REPORT_KEYBOARD_KEYS_COUNT	6
+#define REPORT_KEYBOARD_LEDS_POS	64
+#define REPORT_KEYBOARD_LEDS_COUNT	5
+#define REPORT_KEYBOARD_LEDS_PADDING	3
+#define REPORT_KEYBOARD_BITS		72
+
+#define REPORT_SIZE_MOUSE	(REPORT_MOUSE_BITS / 8) /* bytes */
+#define REPORT_SIZE_KEYBOARD	(REPORT_KEYBOARD_BITS / 8) /* bytes */
 #define REPORT_SIZE_MPLAYER	1 /* bytes */
 
 #define USAGE_PAGE_MOUSE_XY		0x01
@@ -42,6 +72,61 @@ enum report_id {
 extern const u8_t hid_report_desc[];
 extern const size_t hid_report_desc_size;
 
+/**@brief Put a value into the report field.
+ *
+ * Field position and size are known at build time, so the function
+ * reduces to a few stores. Bits outside of the field are preserved, so the
+ * report must be cleared before the first field is put.
+ */
+static ALWAYS_INLINE void hid_report_field_put(u8_t *report, size_t pos,
+					       size_t size, u32_t value)
+{
+	for (size_t i = 0; i < size;) {
+		size_t byte = (pos + i) / 8;
+		size_t shift = (pos + i) % 8;
+		size_t len = min(8 - shift, size - i);
+		u8_t mask = BIT_MASK(len) << shift;
+
+		report[byte] = (report[byte] & ~mask) |
+			       ((value >> i) << shift & mask);
+		i += len;
+	}
+}
+
+/**@brief Encode the mouse report.
+ *
+ * Wheel and motion values must be within the report limits.
+ */
+static inline void hid_report_mouse_pack(u8_t *report, u8_t button_bm,
+					 s16_t wheel, s16_t dx, s16_t dy)
+{
+	memset(report, 0, REPORT_SIZE_MOUSE);
+	hid_report_field_put(report, REPORT_MOUSE_BUTTONS_POS,
+			     REPORT_MOUSE_BUTTONS_SIZE *
+			     REPORT_MOUSE_BUTTONS_COUNT, button_bm);
+	hid_report_field_put(report, REPORT_MOUSE_WHEEL_POS,
+			     REPORT_MOUSE_WHEEL_SIZE, wheel);
+	hid_report_field_put(report, REPORT_MOUSE_X_POS,
+			     REPORT_MOUSE_XY_SIZE, dx);
+	hid_report_field_put(report, REPORT_MOUSE_Y_POS,
+			     REPORT_MOUSE_XY_SIZE, dy);
+}
+
+/**@brief Encode the keyboard report.
+ *
+ * Reserved byte and LEDs are cleared.
+ */
+static inline void hid_report_keyboard_pack(u8_t *report, u8_t modifier_bm,
+					    const u8_t *keys)
+{
+	memset(report, 0, REPORT_SIZE_KEYBOARD);
+	hid_report_field_put(report, REPORT_KEYBOARD_MODIFIERS_POS,
+			     REPORT_KEYBOARD_MODIFIERS_SIZE *
+			     REPORT_KEYBOARD_MODIFIERS_COUNT, modifier_bm);
+	memcpy(&report[REPORT_KEYBOARD_KEYS_POS / 8], keys,
+	       REPORT_KEYBOARD_KEYS_COUNT * REPORT_KEYBOARD_KEYS_SIZE / 8);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,3 +30,14 @@ static void print_event(const struct event_header *eh)
 
 
 EVENT_TYPE_DEFINE(ble_peer_event, print_event, NULL);
+
+static void print_interval_event(const struct event_header *eh)
+{
+	struct ble_interval_event *event = cast_ble_interval_event(eh);
+
+	printk("id=%p interval=%u.%02u ms latency=%u", event->id,
+	       event->interval * 5 / 4, (event->interval * 125) % 100,
+	       event->latency);
+}
+
+EVENT_TYPE_DEFINE(ble_interval_event, print_interval_event, NULL);
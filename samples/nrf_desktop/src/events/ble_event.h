@@ -48,6 +48,16 @@ struct ble_peer_event {
 };
 EVENT_TYPE_DECLARE(ble_peer_event);
 
+/** @brief BLE connection interval event. */
+struct ble_interval_event {
+	struct event_header header;
+
+	void *id;
+	u16_t interval; /* Connection interval in 1.25 ms units. */
+	u16_t latency;  /* Slave latency in connection events. */
+};
+EVENT_TYPE_DECLARE(ble_interval_event);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,6 +24,7 @@ struct button_event {
 
 	u32_t key_id;
 	bool  pressed;
+	u32_t timestamp; /* Creation time in cycles. */
 };
 
 EVENT_TYPE_DECLARE(button_event);
@@ -81,9 +81,9 @@ static void print_hid_report_sent_event(const struct event_header *eh)
 		       target_report_name[event->report_type],
 		       event->subscriber);
 	} else {
-		printk("%s report sent by %p",
+		printk("%s report sent by %p latency:%u us",
 		       target_report_name[event->report_type],
-		       event->subscriber);
+		       event->subscriber, event->latency);
 	}
 }
 
@@ -97,11 +97,13 @@ static void log_args_report_sent(struct log_event_buf *buf,
 	profiler_log_encode_u32(buf, (u32_t)event->subscriber);
 	profiler_log_encode_u32(buf, event->report_type);
 	profiler_log_encode_u32(buf, event->error);
+	profiler_log_encode_u32(buf, event->latency);
 }
 
 EVENT_INFO_DEFINE(hid_report_sent_event,
-		  ENCODE(PROFILER_ARG_U32, PROFILER_ARG_U8, PROFILER_ARG_U8),
-		  ENCODE("subscriber", "report_type", "error"),
+		  ENCODE(PROFILER_ARG_U32, PROFILER_ARG_U8, PROFILER_ARG_U8,
+			 PROFILER_ARG_U32),
+		  ENCODE("subscriber", "report_type", "error", "latency"),
 		  log_args_report_sent);
 EVENT_TYPE_DEFINE(hid_report_sent_event, print_hid_report_sent_event,
 		  &hid_report_sent_event_info);
@@ -32,6 +32,8 @@ struct hid_keyboard_event {
 	const void *subscriber; /**< Id of the report subscriber. */
 	u8_t modifier_bm; /**< Bitmask indicating pressed modifier keys. */
 	u8_t keys[6];     /**< Array of pressed keys' usage values. */
+	u32_t timestamp;  /**< Time of the oldest input in the report [cycles]. */
+	bool has_timestamp; /**< True if the report carries new input. */
 };
 
 EVENT_TYPE_DECLARE(hid_keyboard_event);
@@ -46,6 +48,8 @@ struct hid_mouse_event {
 	s16_t wheel;      /**< Change of wheel (scroll). */
 	s16_t dx;         /**< Position change in x axis. */
 	s16_t dy;         /**< Position change in y axis. */
+	u32_t timestamp;  /**< Time of the oldest input in the report [cycles]. */
+	bool has_timestamp; /**< True if the report carries new input. */
 };
 
 EVENT_TYPE_DECLARE(hid_mouse_event);
@@ -69,11 +73,27 @@ struct hid_report_sent_event {
 	const void *subscriber;         /**< Id of the report subscriber. */
 	enum target_report report_type; /**< Type of the report. */
 	bool error;                     /**< If true error occured on send. */
+	u32_t latency; /**< Input to air latency [us], zero if not measured. */
 };
 
 EVENT_TYPE_DECLARE(hid_report_sent_event);
 
 
+/** @brief Get the time elapsed since the input creation.
+ *
+ * @param input_time Input creation time in cycles.
+ *
+ * @return Latency in microseconds, at least one.
+ */
+static inline u32_t hid_report_latency_get(u32_t input_time)
+{
+	u32_t cycles = k_cycle_get_32() - input_time;
+	u32_t latency = SYS_CLOCK_HW_CYCLES_TO_NS64(cycles) / NSEC_PER_USEC;
+
+	return max(latency, 1);
+}
+
+
 /** @brief Report subscription event. */
 struct hid_report_subscription_event {
 	struct event_header header; /**< Event header. */
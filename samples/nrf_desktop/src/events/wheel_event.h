@@ -23,6 +23,7 @@ struct wheel_event {
 	struct event_header header;
 
 	s16_t wheel;
+	u32_t timestamp; /* Creation time in cycles. */
 };
 
 EVENT_TYPE_DECLARE(wheel_event);
@@ -162,6 +162,7 @@ static void scan_fn(struct k_work *work)
 
 					event->key_id = KEY_ID(j, i);
 					event->pressed = true;
+					event->timestamp = k_cycle_get_32();
 					EVENT_SUBMIT(event);
 				} else if (!is_pressed && matrix[i][j]) {
 					struct button_event *event =
@@ -169,6 +170,7 @@ static void scan_fn(struct k_work *work)
 
 					event->key_id = KEY_ID(j, i);
 					event->pressed = false;
+					event->timestamp = k_cycle_get_32();
 					EVENT_SUBMIT(event);
 				}
 				matrix[i][j] = is_pressed;
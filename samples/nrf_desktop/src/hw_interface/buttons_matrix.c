@@ -136,6 +136,7 @@ static void matrix_scan_fn(struct k_work *work)
 
 				event->key_id = (i << 8) | (j & 0xFF);
 				event->pressed = is_pressed;
+				event->timestamp = k_cycle_get_32();
 				EVENT_SUBMIT(event);
 			}
 
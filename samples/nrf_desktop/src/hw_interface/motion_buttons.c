@@ -42,6 +42,7 @@ static void motion_event_send(s8_t dx, s8_t dy)
 	struct motion_event *event = new_motion_event();
 	event->dx = dx;
 	event->dy = dy;
+	event->timestamp = k_cycle_get_32();
 	EVENT_SUBMIT(event);
 }
 
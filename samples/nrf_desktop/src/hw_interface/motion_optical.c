@@ -16,6 +16,7 @@
 #include "motion_event.h"
 #include "power_event.h"
 #include "hid_event.h"
+#include "ble_event.h"
 
 #define MODULE motion
 #include "module_state_event.h"
@@ -153,6 +154,47 @@ static atomic_t state;
 static atomic_t connected;
 static bool last_read_burst;
 
+#if CONFIG_DESKTOP_MOTION_CONN_EVENT_SYNC
+/* Sampling is triggered the lead time before the next connection event
+ * of this peer. The time of the report sent event is used as the time
+ * of the connection event that sent the report.
+ */
+static struct k_timer sync_timer;
+static const void *sync_peer;
+static u32_t sync_interval_us;
+
+static void sync_timer_handler(struct k_timer *timer)
+{
+	if (atomic_get(&state) == STATE_FETCHING) {
+		k_sem_give(&sem);
+	}
+}
+
+static bool sample_sync(const void *subscriber)
+{
+	if (!sync_interval_us || (subscriber != sync_peer)) {
+		/* Not synchronized, sample at once. */
+		return false;
+	}
+
+	s32_t delay = 0;
+
+	if (sync_interval_us > CONFIG_DESKTOP_MOTION_CONN_EVENT_LEAD_US) {
+		delay = (sync_interval_us -
+			 CONFIG_DESKTOP_MOTION_CONN_EVENT_LEAD_US) /
+			USEC_PER_MSEC;
+	}
+
+	if (!delay) {
+		return false;
+	}
+
+	k_timer_start(&sync_timer, K_MSEC(delay), 0);
+
+	return true;
+}
+#endif
+
 static int spi_cs_ctrl(bool enable)
 {
 	if (!enable) {
@@ -523,6 +565,7 @@ static int motion_read(void)
 	if (event) {
 		event->dx =  ((s16_t)(data[5] << 8) | data[4]);
 		event->dy = -((s16_t)(data[3] << 8) | data[2]);
+		event->timestamp = k_cycle_get_32();
 
 		EVENT_SUBMIT(event);
 	} else {
@@ -712,12 +755,44 @@ static bool event_handler(const struct event_header *eh)
 
 		if ((event->report_type == TARGET_REPORT_MOUSE) &&
 		    (atomic_get(&state) == STATE_FETCHING)) {
+#if CONFIG_DESKTOP_MOTION_CONN_EVENT_SYNC
+			if (sample_sync(event->subscriber)) {
+				return false;
+			}
+#endif
 			k_sem_give(&sem);
 		}
 
 		return false;
 	}
 
+#if CONFIG_DESKTOP_MOTION_CONN_EVENT_SYNC
+	if (is_ble_interval_event(eh)) {
+		const struct ble_interval_event *event =
+			cast_ble_interval_event(eh);
+
+		/* Slave latency is not used while reports are sent. */
+		sync_peer = event->id;
+		sync_interval_us = event->interval * 1250;
+
+		return false;
+	}
+
+	if (is_ble_peer_event(eh)) {
+		const struct ble_peer_event *event =
+			cast_ble_peer_event(eh);
+
+		if ((event->state == PEER_STATE_DISCONNECTED) &&
+		    (event->id == sync_peer)) {
+			k_timer_stop(&sync_timer);
+			sync_peer = NULL;
+			sync_interval_us = 0;
+		}
+
+		return false;
+	}
+#endif
+
 	if (is_hid_report_subscription_event(eh)) {
 		const struct hid_report_subscription_event *event =
 			cast_hid_report_subscription_event(eh);
@@ -754,6 +829,10 @@ static bool event_handler(const struct event_header *eh)
 			__ASSERT_NO_MSG(!initialized);
 			initialized = true;
 
+#if CONFIG_DESKTOP_MOTION_CONN_EVENT_SYNC
+			k_timer_init(&sync_timer, sync_timer_handler, NULL);
+#endif
+
 			/* Start state machine thread */
 			k_thread_create(&thread, thread_stack,
 					OPTICAL_THREAD_STACK_SIZE,
@@ -805,4 +884,8 @@ EVENT_SUBSCRIBE(MODULE, module_state_event);
 EVENT_SUBSCRIBE(MODULE, wake_up_event);
 EVENT_SUBSCRIBE(MODULE, hid_report_sent_event);
 EVENT_SUBSCRIBE(MODULE, hid_report_subscription_event);
+#if CONFIG_DESKTOP_MOTION_CONN_EVENT_SYNC
+EVENT_SUBSCRIBE(MODULE, ble_interval_event);
+EVENT_SUBSCRIBE(MODULE, ble_peer_event);
+#endif
 EVENT_SUBSCRIBE_EARLY(MODULE, power_down_event);
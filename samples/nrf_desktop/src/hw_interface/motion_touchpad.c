@@ -89,6 +89,7 @@ static void scan_fn(struct k_work *work)
 			} else {
 				event->dy = -2 * pos[1];
 			}
+			event->timestamp = k_cycle_get_32();
 
 			EVENT_SUBMIT(event);
 		}
@@ -69,6 +69,7 @@ static void data_ready_handler(struct device *dev, struct sensor_trigger *trig)
 	}
 
 	event->wheel = max(min(wheel, SCHAR_MAX), SCHAR_MIN);
+	event->timestamp = k_cycle_get_32();
 
 	EVENT_SUBMIT(event);
 }
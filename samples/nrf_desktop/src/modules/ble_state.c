@@ -19,6 +19,17 @@
 LOG_MODULE_REGISTER(MODULE, CONFIG_DESKTOP_BLE_STATE_LOG_LEVEL);
 
 
+static void broadcast_interval(struct bt_conn *conn, u16_t interval,
+			       u16_t latency)
+{
+	struct ble_interval_event *event = new_ble_interval_event();
+
+	event->id = conn;
+	event->interval = interval;
+	event->latency = latency;
+	EVENT_SUBMIT(event);
+}
+
 static void connected(struct bt_conn *conn, u8_t err)
 {
 	char addr[BT_ADDR_LE_STR_LEN];
@@ -37,6 +48,12 @@ static void connected(struct bt_conn *conn, u8_t err)
 	event->state = PEER_STATE_CONNECTED;
 	EVENT_SUBMIT(event);
 
+	struct bt_conn_info info;
+
+	if (!bt_conn_get_info(conn, &info)) {
+		broadcast_interval(conn, info.le.interval, info.le.latency);
+	}
+
 	err = bt_conn_security(conn, BT_SECURITY_MEDIUM);
 	if (err) {
 		LOG_ERR("Failed to set security");
@@ -88,6 +105,8 @@ static void le_param_updated(struct bt_conn *conn, u16_t interval,
 	LOG_INF("Conn parameters updated:"
 		"\n\tinterval 0x%04x\n\tlat %d\n\ttimeout %d\n",
 		interval, latency, timeout);
+
+	broadcast_interval(conn, interval, latency);
 }
 
 static void bt_ready(int err)
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2026 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**
+ * @file hid_latency.c
+ *
+ * @brief Module for collecting the input to air latency of HID reports.
+ */
+
+#include <zephyr.h>
+#include <misc/util.h>
+#include <shell/shell.h>
+
+#include "hid_event.h"
+
+#define MODULE hid_latency
+#include "module_state_event.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_DESKTOP_HID_LATENCY_LOG_LEVEL);
+
+
+#define BUCKET_WIDTH	CONFIG_DESKTOP_HID_LATENCY_BUCKET_WIDTH
+#define BUCKET_COUNT	CONFIG_DESKTOP_HID_LATENCY_BUCKET_COUNT
+
+static const char * const target_report_name[] = {
+#define X(name) STRINGIFY(name),
+	TARGET_REPORT_LIST
+#undef X
+};
+
+/**@brief Latency histogram of a single report type. */
+struct histogram {
+	u32_t bucket[BUCKET_COUNT];	/**< Last bucket counts overflows. */
+	u32_t cnt;
+	u32_t min;
+	u32_t max;
+	u64_t sum;
+};
+
+static struct histogram histogram[TARGET_REPORT_COUNT];
+
+
+static void histogram_add(struct histogram *h, u32_t latency)
+{
+	size_t idx = min(latency / BUCKET_WIDTH, BUCKET_COUNT - 1);
+	unsigned int key = irq_lock();
+
+	h->bucket[idx]++;
+	if (!h->cnt || (latency < h->min)) {
+		h->min = latency;
+	}
+	h->max = max(h->max, latency);
+	h->sum += latency;
+	h->cnt++;
+
+	irq_unlock(key);
+}
+
+#if CONFIG_SHELL
+static int show(const struct shell *shell, size_t argc, char **argv)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(histogram); i++) {
+		struct histogram h;
+		unsigned int key = irq_lock();
+
+		h = histogram[i];
+		irq_unlock(key);
+
+		if (!h.cnt) {
+			continue;
+		}
+
+		shell_fprintf(shell, SHELL_NORMAL,
+			      "%s: count %u min %u avg %u max %u [us]\n",
+			      target_report_name[i], h.cnt, h.min,
+			      (u32_t)(h.sum / h.cnt), h.max);
+
+		for (size_t j = 0; j < BUCKET_COUNT; j++) {
+			if (!h.bucket[j]) {
+				continue;
+			}
+
+			if (j < BUCKET_COUNT - 1) {
+				shell_fprintf(shell, SHELL_NORMAL,
+					      "  %6u - %6u: %u\n",
+					      j * BUCKET_WIDTH,
+					      (j + 1) * BUCKET_WIDTH - 1,
+					      h.bucket[j]);
+			} else {
+				shell_fprintf(shell, SHELL_NORMAL,
+					      "  %6u -       : %u\n",
+					      j * BUCKET_WIDTH, h.bucket[j]);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int reset(const struct shell *shell, size_t argc, char **argv)
+{
+	unsigned int key = irq_lock();
+
+	memset(histogram, 0, sizeof(histogram));
+
+	irq_unlock(key);
+
+	shell_fprintf(shell, SHELL_NORMAL, "Latency statistics cleared\n");
+
+	return 0;
+}
+
+SHELL_CREATE_STATIC_SUBCMD_SET(sub_hid_latency)
+{
+	SHELL_CMD_ARG(show, NULL, "Display latency histogram", show, 0, 0),
+	SHELL_CMD_ARG(reset, NULL, "Clear latency histogram", reset, 0, 0),
+	SHELL_SUBCMD_SET_END
+};
+
+SHELL_CMD_REGISTER(hid_latency, &sub_hid_latency,
+		   "HID input to air latency", NULL);
+#endif /* CONFIG_SHELL */
+
+static bool event_handler(const struct event_header *eh)
+{
+	if (is_hid_report_sent_event(eh)) {
+		const struct hid_report_sent_event *event =
+			cast_hid_report_sent_event(eh);
+
+		if (!event->error && event->latency) {
+			__ASSERT_NO_MSG(event->report_type < TARGET_REPORT_COUNT);
+			histogram_add(&histogram[event->report_type],
+				      event->latency);
+
+			LOG_DBG("%s latency %u us",
+				target_report_name[event->report_type],
+				event->latency);
+		}
+
+		return false;
+	}
+
+	/* If event is unhandled, unsubscribe. */
+	__ASSERT_NO_MSG(false);
+
+	return false;
+}
+
+EVENT_LISTENER(MODULE, event_handler);
+EVENT_SUBSCRIBE(MODULE, hid_report_sent_event);
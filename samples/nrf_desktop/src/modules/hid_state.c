@@ -59,6 +59,7 @@ struct item_event {
 	sys_snode_t node;	/**< Event queue linked list node. */
 	struct item item;	/**< HID state item which has been enqueued. */
 	u32_t timestamp;	/**< HID event timestamp. */
+	u32_t input_time;	/**< Input creation time [cycles]. */
 };
 
 /**@brief Event queue. */
@@ -71,6 +72,8 @@ struct eventq {
 struct report_data {
 	struct items items;
 	struct eventq eventq;
+	u32_t input_time;	/**< Oldest not reported input [cycles]. */
+	bool input_pending;	/**< True if input_time is valid. */
 };
 
 struct report_state {
@@ -213,7 +216,8 @@ static struct item_event *eventq_get(struct eventq *eventq)
 	return CONTAINER_OF(node, struct item_event, node);
 }
 
-static void eventq_append(struct eventq *eventq, u16_t usage_id, s16_t value)
+static void eventq_append(struct eventq *eventq, u16_t usage_id, s16_t value,
+			  u32_t input_time)
 {
 	struct item_event *hid_event = k_malloc(sizeof(*hid_event));
 
@@ -225,6 +229,7 @@ static void eventq_append(struct eventq *eventq, u16_t usage_id, s16_t value)
 	hid_event->item.usage_id = usage_id;
 	hid_event->item.value = value;
 	hid_event->timestamp = MSEC(z_tick_get());
+	hid_event->input_time = input_time;
 
 	/* Add a new event to the queue. */
 	sys_slist_append(&eventq->root, &hid_event->node);
@@ -347,6 +352,24 @@ static void eventq_cleanup(struct eventq *eventq, u32_t timestamp)
 	}
 }
 
+/**@brief Record the time of input that is not yet reported. */
+static void input_mark(struct report_data *rd, u32_t input_time)
+{
+	if (!rd->input_pending) {
+		rd->input_time = input_time;
+		rd->input_pending = true;
+	}
+}
+
+/**@brief Move the input time to the report generated from it. */
+static void input_take(struct report_data *rd, u32_t *timestamp,
+		       bool *has_timestamp)
+{
+	*timestamp = rd->input_time;
+	*has_timestamp = rd->input_pending;
+	rd->input_pending = false;
+}
+
 static struct subscriber *get_subscriber(const void *subscriber_id)
 {
 	for (size_t i = 0; i < ARRAY_SIZE(state.subscriber); i++) {
@@ -547,6 +570,8 @@ static void send_report_keyboard(void)
 
 		event->modifier_bm = 0;
 
+		input_take(rd, &event->timestamp, &event->has_timestamp);
+
 		EVENT_SUBMIT(event);
 	} else {
 		/* Not supported. */
@@ -586,6 +611,8 @@ static void send_report_mouse(void)
 			}
 		}
 
+		input_take(rd, &event->timestamp, &event->has_timestamp);
+
 		EVENT_SUBMIT(event);
 	} else {
 		/* Not supported. */
@@ -628,8 +655,11 @@ static void report_send(enum target_report tr, bool check_state)
 
 			/* To make sure report is sampled on every connection
 			 * event, add one additional report to the pipeline.
+			 * Not needed if sampling is synchronized with
+			 * the connection events.
 			 */
-		} while ((rs->cnt == 1) && !state.selected->is_usb);
+		} while ((rs->cnt == 1) && !state.selected->is_usb &&
+			 !IS_ENABLED(CONFIG_DESKTOP_MOTION_CONN_EVENT_SYNC));
 
 		rs->state = STATE_CONNECTED_BUSY;
 	}
@@ -703,6 +733,10 @@ static void report_issued(const void *subscriber_id, enum target_report tr,
 					      event->item.usage_id,
 					      event->item.value);
 
+		if (update_needed) {
+			input_mark(rd, event->input_time);
+		}
+
 		k_free(event);
 
 		/* If no item was changed, try next event. */
@@ -774,11 +808,12 @@ static void disconnect(const void *subscriber_id, enum target_report tr)
 	LOG_INF("Clear report data (%d)", tr);
 	memset(&rd->items, 0, sizeof(rd->items));
 	eventq_reset(&rd->eventq);
+	rd->input_pending = false;
 }
 
 /**@brief Enqueue event that updates a given usage. */
 static void enqueue(enum target_report tr, u16_t usage_id, s16_t value,
-		    bool connected)
+		    bool connected, u32_t input_time)
 {
 	struct report_data *rd = &state.report_data[tr];
 
@@ -824,11 +859,12 @@ static void enqueue(enum target_report tr, u16_t usage_id, s16_t value,
 		}
 	}
 
-	eventq_append(&rd->eventq, usage_id, value);
+	eventq_append(&rd->eventq, usage_id, value, input_time);
 }
 
 /**@brief Function for updating the value linked to the HID usage. */
-static void update_key(const struct hid_keymap *map, s16_t value)
+static void update_key(const struct hid_keymap *map, s16_t value,
+		       u32_t input_time)
 {
 	enum target_report tr = map->target_report;
 
@@ -836,11 +872,13 @@ static void update_key(const struct hid_keymap *map, s16_t value)
 	    (state.selected->state[tr].state != STATE_CONNECTED_IDLE)) {
 		/* Report cannot be sent yet - enqueue this HID event. */
 		enqueue(map->target_report, map->usage_id, value,
-			state.selected->state[tr].state != STATE_DISCONNECTED);
+			state.selected->state[tr].state != STATE_DISCONNECTED,
+			input_time);
 	} else {
 		/* Update state and issue report generation event. */
 		struct report_data *rd = &state.report_data[tr];
 		if (key_value_set(&rd->items, map->usage_id, value)) {
+			input_mark(rd, input_time);
 			report_send(tr, false);
 		}
 	}
@@ -868,6 +906,8 @@ static bool event_handler(const struct event_header *eh)
 		/* Do not accumulate mouse motion data */
 		state.last_dx = event->dx;
 		state.last_dy = event->dy;
+		input_mark(&state.report_data[TARGET_REPORT_MOUSE],
+			   event->timestamp);
 
 		report_send(TARGET_REPORT_MOUSE, true);
 
@@ -888,6 +928,8 @@ static bool event_handler(const struct event_header *eh)
 		const struct wheel_event *event = cast_wheel_event(eh);
 
 		state.wheel_acc += event->wheel;
+		input_mark(&state.report_data[TARGET_REPORT_MOUSE],
+			   event->timestamp);
 
 		report_send(TARGET_REPORT_MOUSE, true);
 
@@ -908,7 +950,7 @@ static bool event_handler(const struct event_header *eh)
 
 			/* Keydown increases ref counter, keyup decreases it. */
 			s16_t value = (event->pressed != false) ? (1) : (-1);
-			update_key(map, value);
+			update_key(map, value, event->timestamp);
 
 			return false;
 		}
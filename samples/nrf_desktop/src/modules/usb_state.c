@@ -5,7 +5,6 @@
  */
 
 #include <zephyr/types.h>
-#include <misc/byteorder.h>
 
 #include <usb/usb_device.h>
 #include <usb/usb_common.h>
@@ -26,6 +25,10 @@ LOG_MODULE_REGISTER(MODULE, CONFIG_DESKTOP_USB_STATE_LOG_LEVEL);
 
 static enum usb_state state;
 
+/* Input time of the report being sent. */
+static u32_t report_input_time;
+static bool report_input_time_valid;
+
 
 static int get_report(struct usb_setup_packet *setup, s32_t *len, u8_t **data)
 {
@@ -42,6 +45,8 @@ static void mouse_report_sent(bool error)
 	event->report_type = TARGET_REPORT_MOUSE;
 	event->subscriber = &state;
 	event->error = error;
+	event->latency = (!error && report_input_time_valid) ?
+			 (hid_report_latency_get(report_input_time)) : (0);
 	EVENT_SUBMIT(event);
 }
 
@@ -69,24 +74,14 @@ static void send_mouse_report(const struct hid_mouse_event *event)
 	s16_t y = max(min(event->dy, REPORT_MOUSE_XY_MAX),
 		      REPORT_MOUSE_XY_MIN);
 
-	/* Convert to little-endian. */
-	u8_t x_buff[2];
-	u8_t y_buff[2];
-
-	sys_put_le16(x, x_buff);
-	sys_put_le16(y, y_buff);
-
 	/* Encode report. */
 	u8_t buffer[REPORT_SIZE_MOUSE + sizeof(u8_t)];
 
-	static_assert(sizeof(buffer) == 6, "Invalid report size");
-
 	buffer[0] = REPORT_ID_MOUSE;
-	buffer[1] = event->button_bm;
-	buffer[2] = wheel;
-	buffer[3] = x_buff[0];
-	buffer[4] = (y_buff[0] << 4) | (x_buff[1] & 0x0f);
-	buffer[5] = (y_buff[1] << 4) | (y_buff[0] >> 4);
+	hid_report_mouse_pack(&buffer[1], event->button_bm, wheel, x, y);
+
+	report_input_time = event->timestamp;
+	report_input_time_valid = event->has_timestamp;
 
 	int err = hid_int_ep_write(buffer, sizeof(buffer), NULL);
 	if (err) {
@@ -9,7 +9,6 @@
 
 #include <zephyr.h>
 #include <zephyr/types.h>
-#include <misc/byteorder.h>
 
 #include <bluetooth/services/hids.h>
 
@@ -47,6 +46,90 @@ static bool report_enabled[TARGET_REPORT_COUNT][REPORT_MODE_COUNT];
 
 static const struct bt_conn *cur_conn;
 
+/* Input time of the reports being sent, the reports complete in order.
+ * Reports sent while the queue is full are counted as untracked, and so are
+ * the reports that follow them until they complete, to keep the order.
+ */
+#define REPORT_TIME_QUEUE_LEN	4
+
+struct report_time_queue {
+	u32_t input_time[REPORT_TIME_QUEUE_LEN];
+	bool valid[REPORT_TIME_QUEUE_LEN];
+	u8_t head;
+	u8_t cnt;
+	u8_t untracked;
+};
+
+static struct report_time_queue report_time[TARGET_REPORT_COUNT];
+
+
+static void report_time_push(enum target_report tr, u32_t input_time,
+			     bool valid)
+{
+	struct report_time_queue *q = &report_time[tr];
+	unsigned int key = irq_lock();
+
+	if ((q->cnt < REPORT_TIME_QUEUE_LEN) && !q->untracked) {
+		u8_t idx = (q->head + q->cnt) % REPORT_TIME_QUEUE_LEN;
+
+		q->input_time[idx] = input_time;
+		q->valid[idx] = valid;
+		q->cnt++;
+	} else {
+		__ASSERT_NO_MSG(q->untracked < UCHAR_MAX);
+		q->untracked++;
+	}
+
+	irq_unlock(key);
+}
+
+/* Remove the entry of the report that failed to be sent. */
+static void report_time_drop_last(enum target_report tr)
+{
+	struct report_time_queue *q = &report_time[tr];
+	unsigned int key = irq_lock();
+
+	if (q->untracked > 0) {
+		q->untracked--;
+	} else if (q->cnt > 0) {
+		q->cnt--;
+	}
+
+	irq_unlock(key);
+}
+
+static u32_t report_time_pop_latency(enum target_report tr)
+{
+	struct report_time_queue *q = &report_time[tr];
+	u32_t latency = 0;
+	unsigned int key = irq_lock();
+
+	if (q->cnt > 0) {
+		if (q->valid[q->head]) {
+			latency = hid_report_latency_get(
+					q->input_time[q->head]);
+		}
+		q->head = (q->head + 1) % REPORT_TIME_QUEUE_LEN;
+		q->cnt--;
+	} else if (q->untracked > 0) {
+		/* Latency of this report is not measured. */
+		q->untracked--;
+	}
+
+	irq_unlock(key);
+
+	return latency;
+}
+
+static void report_time_reset(void)
+{
+	unsigned int key = irq_lock();
+
+	memset(report_time, 0, sizeof(report_time));
+
+	irq_unlock(key);
+}
+
 
 static void broadcast_subscription_change(enum target_report tr,
 					  enum report_mode old_mode,
@@ -227,6 +310,8 @@ static void mouse_report_sent(const struct bt_conn *conn, bool error)
 	event->report_type = TARGET_REPORT_MOUSE;
 	event->subscriber  = cur_conn;
 	event->error = error;
+	event->latency = (error) ? (0) :
+			 (report_time_pop_latency(TARGET_REPORT_MOUSE));
 	EVENT_SUBMIT(event);
 }
 
@@ -249,6 +334,9 @@ static void send_mouse_report(const struct hid_mouse_event *event)
 
 	int err;
 
+	report_time_push(TARGET_REPORT_MOUSE, event->timestamp,
+			 event->has_timestamp);
+
 	if (report_mode == REPORT_MODE_BOOT) {
 		s8_t x = max(min(event->dx, SCHAR_MAX), SCHAR_MIN);
 		s8_t y = max(min(event->dy, SCHAR_MAX), SCHAR_MIN);
@@ -264,23 +352,10 @@ static void send_mouse_report(const struct hid_mouse_event *event)
 		s16_t y = max(min(event->dy, REPORT_MOUSE_XY_MAX),
 			      REPORT_MOUSE_XY_MIN);
 
-		/* Convert to little-endian. */
-		u8_t x_buff[2];
-		u8_t y_buff[2];
-
-		sys_put_le16(x, x_buff);
-		sys_put_le16(y, y_buff);
-
 		/* Encode report. */
 		u8_t buffer[REPORT_SIZE_MOUSE];
 
-		static_assert(sizeof(buffer) == 5, "Invalid report size");
-
-		buffer[0] = event->button_bm;
-		buffer[1] = wheel;
-		buffer[2] = x_buff[0];
-		buffer[3] = (y_buff[0] << 4) | (x_buff[1] & 0x0f);
-		buffer[4] = (y_buff[1] << 4) | (y_buff[0] >> 4);
+		hid_report_mouse_pack(buffer, event->button_bm, wheel, x, y);
 
 		err = hids_inp_rep_send(&hids_obj, NULL,
 					report_index[REPORT_ID_MOUSE],
@@ -290,6 +365,7 @@ static void send_mouse_report(const struct hid_mouse_event *event)
 
 	if (err) {
 		LOG_ERR("Cannot send report (%d)", err);
+		report_time_drop_last(TARGET_REPORT_MOUSE);
 		mouse_report_sent(cur_conn, true);
 	}
 }
@@ -301,6 +377,8 @@ static void keyboard_report_sent(const struct bt_conn *conn, bool error)
 	event->report_type = TARGET_REPORT_KEYBOARD;
 	event->subscriber  = cur_conn;
 	event->error = error;
+	event->latency = (error) ? (0) :
+			 (report_time_pop_latency(TARGET_REPORT_KEYBOARD));
 	EVENT_SUBMIT(event);
 }
 
@@ -323,23 +401,16 @@ static void send_keyboard_report(const struct hid_keyboard_event *event)
 
 	u8_t report[REPORT_SIZE_KEYBOARD];
 
-	static_assert(ARRAY_SIZE(report) == ARRAY_SIZE(event->keys) + 3,
+	static_assert(ARRAY_SIZE(event->keys) == REPORT_KEYBOARD_KEYS_COUNT,
 			"Incorrect number of keys in event");
 
-	/* Modifiers */
-	report[0] = event->modifier_bm;
-
-	/* Reserved */
-	report[1] = 0;
-
-	/* Pressed keys */
-	memcpy(&report[2], &event->keys[0], sizeof(event->keys));
-
-	/* Led */
-	report[8] = 0;
+	hid_report_keyboard_pack(report, event->modifier_bm, event->keys);
 
 	int err;
 
+	report_time_push(TARGET_REPORT_KEYBOARD, event->timestamp,
+			 event->has_timestamp);
+
 	if (report_mode == REPORT_MODE_BOOT) {
 		err = hids_boot_kb_inp_rep_send(&hids_obj, NULL, report,
 						sizeof(report) - sizeof(report[8]),
@@ -353,6 +424,7 @@ static void send_keyboard_report(const struct hid_keyboard_event *event)
 
 	if (err) {
 		LOG_ERR("Cannot send report (%d)", err);
+		report_time_drop_last(TARGET_REPORT_KEYBOARD);
 		keyboard_report_sent(cur_conn, true);
 	}
 }
@@ -374,6 +446,7 @@ static void notify_hids(const struct ble_peer_event *event)
 		__ASSERT_NO_MSG(cur_conn == event->id);
 		err = hids_notify_disconnected(&hids_obj, event->id);
 		cur_conn = NULL;
+		report_time_reset();
 		break;
 
 	case PEER_STATE_SECURED:
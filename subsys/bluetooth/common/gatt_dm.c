@@ -5,15 +5,30 @@
  */
 
 #include <inttypes.h>
+#include <stdlib.h>
 #include <zephyr.h>
+#include <misc/byteorder.h>
+#include <misc/util.h>
+#include <settings/settings.h>
 #include <logging/log.h>
 
 #include <bluetooth/common/gatt_dm.h>
 
 LOG_MODULE_REGISTER(bt_gatt_dm, CONFIG_BT_GATT_DM_LOG_LEVEL);
 
-/* Available sizes: 128, 512, 2048... */
-#define CHUNK_SIZE (128 - sizeof(struct k_mem_block_id))
+/* UUID storage large enough for any UUID type */
+union dm_uuid {
+	struct bt_uuid uuid;
+	struct bt_uuid_16 u16;
+	struct bt_uuid_128 u128;
+};
+
+/* Services searched in the discovery */
+enum {
+	SEARCH_UUID,
+	SEARCH_UUID_LIST,
+	SEARCH_ALL,
+};
 
 /* Flags for parsed attribute array state */
 enum {
@@ -31,6 +46,17 @@ struct bt_gatt_dm {
 
 	/* The discovery parameters used */
 	struct bt_gatt_discover_params discover_params;
+	/* The services searched, one of SEARCH_* values */
+	u8_t search_type;
+	/* UUID of the searched service, for SEARCH_UUID */
+	union dm_uuid svc_uuid;
+	/* UUIDs of the searched services, for SEARCH_UUID_LIST */
+	const struct bt_uuid *const *svc_uuid_list;
+	size_t svc_uuid_cnt;
+	/* First handle of the current primary services search */
+	u16_t search_start_handle;
+	/* End handle of the last service found */
+	u16_t svc_end_handle;
 	/* Currently parsed attributes */
 	struct bt_gatt_attr attrs[CONFIG_BT_GATT_DM_MAX_ATTRS];
 	/* Currently accessed attribute */
@@ -38,75 +64,109 @@ struct bt_gatt_dm {
 	/* Flags with the status of the attributes */
 	ATOMIC_DEFINE(state_flags, STATE_NUM);
 
-	/* user data chunks */
+	/* User data storage, sized from the handle range of the service */
 	struct {
-		/* The pointers to the dynamically allocated memory */
-		u8_t *chunks[CONFIG_BT_GATT_DM_MAX_MEM_CHUNKS];
-		/* Currently processed index */
-		size_t cur_id;
-		/* The used length of the current chunk */
+		/* The pointer to the dynamically allocated memory */
+		u8_t *mem;
+		/* The allocated length of the memory */
+		size_t size;
+		/* The used length of the memory */
 		size_t cur_len;
-	} data_chunk;
+	} arena;
+
+	/* Characteristic attribute indexes sorted by the value UUID */
+	u16_t chrc_index[CONFIG_BT_GATT_DM_MAX_ATTRS];
+	/* Number of characteristics in the index */
+	size_t chrc_cnt;
 
 	/* The pointer to callback structure */
 	const struct bt_gatt_dm_cb *callback;
+
+#if CONFIG_BT_GATT_DM_CACHE
+	/* Work used to report the discovery served from the cache */
+	struct k_work cache_work;
+#endif
 };
 
 /* Currently only one instance is supported */
 static struct bt_gatt_dm bt_gatt_dm_inst;
 
+/* Worst-case size of a stored UUID */
+#define DM_UUID_DATA_SIZE \
+	ROUND_UP(sizeof(struct bt_uuid_128), sizeof(void *))
+/* Worst-case size of the data stored for the service declaration */
+#define DM_SVC_DATA_SIZE \
+	(2 * DM_UUID_DATA_SIZE + \
+	 ROUND_UP(sizeof(struct bt_gatt_service_val), sizeof(void *)))
+/* Worst-case size of the data stored for any two consecutive handles
+ * following the service declaration: a characteristic declaration with its
+ * value, or a pair of descriptors.
+ */
+#define DM_HANDLE_PAIR_DATA_SIZE \
+	(3 * DM_UUID_DATA_SIZE + \
+	 ROUND_UP(sizeof(struct bt_gatt_chrc), sizeof(void *)))
 
-static void *user_data_store(struct bt_gatt_dm *dm,
-			     const void *user_data,
-			     size_t len)
+static int arena_alloc(struct bt_gatt_dm *dm,
+		       u16_t start_handle,
+		       u16_t end_handle)
 {
-	u8_t *user_data_loc;
-	size_t cur_chunk_id = dm->data_chunk.cur_id;
+	size_t attr_cnt = MIN((size_t)(end_handle - start_handle) + 1,
+			      (size_t)CONFIG_BT_GATT_DM_MAX_ATTRS);
+	size_t size = DM_SVC_DATA_SIZE +
+		      (attr_cnt / 2) * DM_HANDLE_PAIR_DATA_SIZE;
 
-	__ASSERT_NO_MSG(len <= CHUNK_SIZE);
+	size = MIN(size, (size_t)CONFIG_BT_GATT_DM_DATA_SIZE);
 
-	if (!(dm->data_chunk.chunks[cur_chunk_id])) {
-		dm->data_chunk.chunks[cur_chunk_id] = k_malloc(CHUNK_SIZE);
-		dm->data_chunk.cur_len = 0;
+	LOG_DBG("Data memory for %zu attributes: %zu bytes", attr_cnt, size);
 
-		if (!(dm->data_chunk.chunks[cur_chunk_id])) {
-			return NULL;
-		}
+	dm->arena.mem = k_malloc(size);
+	if (!dm->arena.mem) {
+		LOG_ERR("Not enough memory for the discovery data.");
+		return -ENOMEM;
 	}
+	dm->arena.size = size;
+	dm->arena.cur_len = 0;
 
-	if (dm->data_chunk.cur_len + len > CHUNK_SIZE) {
-		cur_chunk_id++;
-		dm->data_chunk.cur_id = cur_chunk_id;
-		if ((dm->data_chunk.chunks[cur_chunk_id]) ||
-		    (cur_chunk_id >= ARRAY_SIZE(dm->data_chunk.chunks))) {
-			LOG_ERR("Not enough data chunks");
-			return NULL;
-		}
+	return 0;
+}
+
+static void *user_data_store(struct bt_gatt_dm *dm,
+			     const void *user_data,
+			     size_t len)
+{
+	u8_t *user_data_loc;
+	/* Keep the stored structures aligned */
+	size_t offset = ROUND_UP(dm->arena.cur_len, sizeof(void *));
 
-		return user_data_store(dm, user_data, len);
+	if (offset + len > dm->arena.size) {
+		LOG_ERR("Not enough memory for user data");
+		return NULL;
 	}
 
-	user_data_loc =
-		&dm->data_chunk.chunks[cur_chunk_id][dm->data_chunk.cur_len];
+	user_data_loc = &dm->arena.mem[offset];
 	memcpy(user_data_loc, user_data, len);
-	dm->data_chunk.cur_len += len;
+	dm->arena.cur_len = offset + len;
 
 	return user_data_loc;
 }
 
-static void svc_attr_memory_release(struct bt_gatt_dm *dm)
+static void svc_attr_data_clear(struct bt_gatt_dm *dm)
 {
-	LOG_DBG("Attr memory release");
 	/* Clear attributes */
 	memset(dm->attrs, 0, sizeof(dm->attrs));
 	dm->cur_attr_id = 0;
-	/* Release dynamic memory data chunks */
-	for (size_t i = 0; i <= dm->data_chunk.cur_id; i++) {
-		k_free(dm->data_chunk.chunks[i]);
-		dm->data_chunk.chunks[i] = NULL;
-	}
-	dm->data_chunk.cur_id = 0;
-	dm->data_chunk.cur_len = 0;
+	dm->chrc_cnt = 0;
+	dm->arena.cur_len = 0;
+}
+
+static void svc_attr_memory_release(struct bt_gatt_dm *dm)
+{
+	LOG_DBG("Attr memory release");
+	svc_attr_data_clear(dm);
+	/* Release dynamic memory */
+	k_free(dm->arena.mem);
+	dm->arena.mem = NULL;
+	dm->arena.size = 0;
 }
 
 static struct bt_gatt_attr *attr_store(struct bt_gatt_dm *dm,
@@ -217,9 +277,788 @@ static struct bt_uuid *uuid_store(struct bt_gatt_dm *dm,
 	}
 }
 
+static void uuid_copy(union dm_uuid *dst, const struct bt_uuid *src)
+{
+	if (src->type == BT_UUID_TYPE_16) {
+		memcpy(&dst->u16, BT_UUID_16(src), sizeof(dst->u16));
+	} else {
+		memcpy(&dst->u128, BT_UUID_128(src), sizeof(dst->u128));
+	}
+}
+
+static bool uuid_is_valid(const struct bt_uuid *uuid)
+{
+	return uuid && ((uuid->type == BT_UUID_TYPE_16) ||
+			(uuid->type == BT_UUID_TYPE_128));
+}
+
+static void uuid_to_uuid128(const struct bt_uuid *uuid, u8_t val[16])
+{
+	/* Bluetooth Base UUID, little endian */
+	static const u8_t base_uuid[16] = {
+		0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
+		0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+	};
+
+	if (uuid->type == BT_UUID_TYPE_16) {
+		memcpy(val, base_uuid, sizeof(base_uuid));
+		sys_put_le16(BT_UUID_16(uuid)->val, &val[12]);
+	} else {
+		memcpy(val, BT_UUID_128(uuid)->val, sizeof(base_uuid));
+	}
+}
+
+/* Total order of UUIDs, consistent with bt_uuid_cmp equality */
+static int uuid_order(const struct bt_uuid *u1, const struct bt_uuid *u2)
+{
+	u8_t val1[16];
+	u8_t val2[16];
+
+	uuid_to_uuid128(u1, val1);
+	uuid_to_uuid128(u2, val2);
+
+	return memcmp(val1, val2, sizeof(val1));
+}
+
+static const struct bt_uuid *chrc_index_uuid(const struct bt_gatt_dm *dm,
+					     size_t id)
+{
+	const struct bt_gatt_chrc *gatt_chrc =
+		dm->attrs[dm->chrc_index[id]].user_data;
+
+	return gatt_chrc->uuid;
+}
+
+static void chrc_index_build(struct bt_gatt_dm *dm)
+{
+	dm->chrc_cnt = 0;
+
+	for (size_t i = 0; i < dm->cur_attr_id; i++) {
+		if (bt_uuid_cmp(BT_UUID_GATT_CHRC, dm->attrs[i].uuid) ||
+		    !dm->attrs[i].user_data) {
+			continue;
+		}
+
+		/* Insertion sort keeps characteristics with the same UUID
+		 * in the handle order.
+		 */
+		size_t j = dm->chrc_cnt++;
+		const struct bt_gatt_chrc *gatt_chrc = dm->attrs[i].user_data;
+
+		while ((j > 0) &&
+		       (uuid_order(chrc_index_uuid(dm, j - 1),
+				   gatt_chrc->uuid) > 0)) {
+			dm->chrc_index[j] = dm->chrc_index[j - 1];
+			j--;
+		}
+		dm->chrc_index[j] = i;
+	}
+}
+
+#if CONFIG_BT_GATT_DM_CACHE
+
+#define DM_CACHE_SETTINGS_KEY "bt_dm"
+
+/* Discovered service serialized for the given peer */
+struct dm_cache_entry {
+	/* Identity address of the peer */
+	bt_addr_le_t addr;
+	/* Local identity used in the bond with the peer */
+	u8_t id;
+	/* UUID of the cached service */
+	union dm_uuid svc_uuid;
+	/* Handle range of the cached service */
+	u16_t start_handle;
+	u16_t end_handle;
+	/* The used length of the data, 0 if the entry is free */
+	u16_t len;
+	/* Serialized attributes */
+	u8_t data[CONFIG_BT_GATT_DM_CACHE_ENTRY_SIZE];
+};
+
+/* Serialized data reader */
+struct dm_cache_reader {
+	const u8_t *data;
+	size_t len;
+};
+
+/* Service Changed subscription of a bonded peer */
+struct dm_cache_sc {
+	/* Identity address of the peer, valid if in use */
+	bt_addr_le_t addr;
+	bool in_use;
+	struct bt_gatt_discover_params discover_params;
+	struct bt_gatt_subscribe_params subscribe_params;
+};
+
+static struct dm_cache_entry dm_cache[CONFIG_BT_GATT_DM_CACHE_ENTRIES];
+static size_t dm_cache_evict_id;
+/* Protects the entries, accessed from the application, the Bluetooth RX
+ * context and the system workqueue.
+ */
+static K_MUTEX_DEFINE(dm_cache_lock);
+/* Entries changed since they were last written to the settings */
+static ATOMIC_DEFINE(dm_cache_dirty, CONFIG_BT_GATT_DM_CACHE_ENTRIES);
+
+/* Accessed only from the Bluetooth RX context */
+static struct dm_cache_sc dm_cache_sc[CONFIG_BT_GATT_DM_CACHE_ENTRIES];
+
+
+static bool dm_cache_put(struct dm_cache_entry *entry,
+			 const void *data,
+			 size_t len)
+{
+	if (entry->len + len > sizeof(entry->data)) {
+		return false;
+	}
+
+	memcpy(&entry->data[entry->len], data, len);
+	entry->len += len;
+
+	return true;
+}
+
+static bool dm_cache_put_le16(struct dm_cache_entry *entry, u16_t val)
+{
+	u8_t buf[sizeof(val)];
+
+	sys_put_le16(val, buf);
+
+	return dm_cache_put(entry, buf, sizeof(buf));
+}
+
+static bool dm_cache_put_uuid(struct dm_cache_entry *entry,
+			      const struct bt_uuid *uuid)
+{
+	if (!dm_cache_put(entry, &uuid->type, sizeof(uuid->type))) {
+		return false;
+	}
+
+	switch (uuid->type) {
+	case BT_UUID_TYPE_16:
+		return dm_cache_put_le16(entry, BT_UUID_16(uuid)->val);
+	case BT_UUID_TYPE_128:
+		return dm_cache_put(entry, BT_UUID_128(uuid)->val,
+				    sizeof(BT_UUID_128(uuid)->val));
+	default:
+		return false;
+	}
+}
+
+static bool dm_cache_get(struct dm_cache_reader *reader,
+			 void *data,
+			 size_t len)
+{
+	if (reader->len < len) {
+		return false;
+	}
+
+	memcpy(data, reader->data, len);
+	reader->data += len;
+	reader->len -= len;
+
+	return true;
+}
+
+static bool dm_cache_get_le16(struct dm_cache_reader *reader, u16_t *val)
+{
+	u8_t buf[sizeof(*val)];
+
+	if (!dm_cache_get(reader, buf, sizeof(buf))) {
+		return false;
+	}
+	*val = sys_get_le16(buf);
+
+	return true;
+}
+
+static bool dm_cache_get_uuid(struct dm_cache_reader *reader,
+			      union dm_uuid *uuid)
+{
+	if (!dm_cache_get(reader, &uuid->uuid.type, sizeof(uuid->uuid.type))) {
+		return false;
+	}
+
+	switch (uuid->uuid.type) {
+	case BT_UUID_TYPE_16:
+		return dm_cache_get_le16(reader, &uuid->u16.val);
+	case BT_UUID_TYPE_128:
+		return dm_cache_get(reader, uuid->u128.val,
+				    sizeof(uuid->u128.val));
+	default:
+		return false;
+	}
+}
+
+static void dm_cache_save_work_handler(struct k_work *work)
+{
+	/* Copy of the entry, which can change while it is written */
+	static struct dm_cache_entry entry;
+	char key[sizeof(DM_CACHE_SETTINGS_KEY) + 4];
+	int err;
+
+	for (size_t i = 0; i < ARRAY_SIZE(dm_cache); i++) {
+		if (!atomic_test_and_clear_bit(dm_cache_dirty, i)) {
+			continue;
+		}
+
+		k_mutex_lock(&dm_cache_lock, K_FOREVER);
+		memcpy(&entry, &dm_cache[i], sizeof(entry));
+		k_mutex_unlock(&dm_cache_lock);
+
+		snprintk(key, sizeof(key), DM_CACHE_SETTINGS_KEY "/%u",
+			 (unsigned int)i);
+
+		if (entry.len) {
+			err = settings_save_one(key, &entry,
+					offsetof(struct dm_cache_entry, data) +
+					entry.len);
+		} else {
+			err = settings_save_one(key, NULL, 0);
+		}
+
+		if (err) {
+			LOG_ERR("Cannot store cache entry %s, error: %d.",
+				key, err);
+		}
+	}
+}
+
+static K_WORK_DEFINE(dm_cache_save_work, dm_cache_save_work_handler);
+
+static void dm_cache_save(struct dm_cache_entry *entry)
+{
+	/* The discovery completes in the Bluetooth RX context, which must
+	 * not be blocked by flash operations.
+	 */
+	atomic_set_bit(dm_cache_dirty, entry - dm_cache);
+	k_work_submit(&dm_cache_save_work);
+}
+
+static void dm_cache_remove(struct dm_cache_entry *entry)
+{
+	memset(entry, 0, sizeof(*entry));
+	dm_cache_save(entry);
+}
+
+static struct dm_cache_entry *dm_cache_find(u8_t id,
+					    const bt_addr_le_t *addr,
+					    const struct bt_uuid *svc_uuid)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(dm_cache); i++) {
+		struct dm_cache_entry *entry = &dm_cache[i];
+
+		if (entry->len && (entry->id == id) &&
+		    !bt_addr_le_cmp(addr, &entry->addr) &&
+		    !bt_uuid_cmp(svc_uuid, &entry->svc_uuid.uuid)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static struct dm_cache_entry *dm_cache_alloc(u8_t id,
+					     const bt_addr_le_t *addr,
+					     const struct bt_uuid *svc_uuid)
+{
+	struct dm_cache_entry *entry = dm_cache_find(id, addr, svc_uuid);
+
+	for (size_t i = 0; !entry && (i < ARRAY_SIZE(dm_cache)); i++) {
+		if (!dm_cache[i].len) {
+			entry = &dm_cache[i];
+		}
+	}
+
+	if (!entry) {
+		/* All entries in use, replace the oldest one */
+		entry = &dm_cache[dm_cache_evict_id];
+		dm_cache_evict_id = (dm_cache_evict_id + 1) %
+				    ARRAY_SIZE(dm_cache);
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	bt_addr_le_copy(&entry->addr, addr);
+	entry->id = id;
+	uuid_copy(&entry->svc_uuid, svc_uuid);
+
+	return entry;
+}
+
+static bool dm_cache_attr_put(struct dm_cache_entry *entry,
+			      const struct bt_gatt_attr *attr)
+{
+	const struct bt_gatt_service_val *service_val;
+	const struct bt_gatt_chrc *gatt_chrc;
+
+	if (!dm_cache_put_le16(entry, attr->handle) ||
+	    !dm_cache_put_uuid(entry, attr->uuid)) {
+		return false;
+	}
+
+	service_val = bt_gatt_dm_attr_service_val(attr);
+	if (service_val) {
+		return dm_cache_put_le16(entry, service_val->end_handle) &&
+		       dm_cache_put_uuid(entry, service_val->uuid);
+	}
+
+	gatt_chrc = bt_gatt_dm_attr_chrc_val(attr);
+	if (gatt_chrc) {
+		return dm_cache_put(entry, &gatt_chrc->properties,
+				    sizeof(gatt_chrc->properties)) &&
+		       dm_cache_put_uuid(entry, gatt_chrc->uuid);
+	}
+
+	return true;
+}
+
+/* Get the information about the peer, true if the peer is bonded */
+static bool dm_cache_peer_bonded(struct bt_conn *conn,
+				 struct bt_conn_info *info)
+{
+	return !bt_conn_get_info(conn, info) &&
+	       bt_addr_le_is_bonded(info->id, info->le.dst);
+}
+
+static void dm_cache_store(struct bt_gatt_dm *dm)
+{
+	const struct bt_gatt_service_val *service_val =
+		bt_gatt_dm_attr_service_val(&dm->attrs[0]);
+	struct dm_cache_entry *entry;
+	struct bt_conn_info info;
+
+	/* Without a bond, the peer database can change unnoticed */
+	if (!dm_cache_peer_bonded(dm->conn, &info)) {
+		LOG_DBG("Peer not bonded, discovery not cached");
+		return;
+	}
+
+	k_mutex_lock(&dm_cache_lock, K_FOREVER);
+
+	entry = dm_cache_alloc(info.id, info.le.dst, service_val->uuid);
+	entry->start_handle = dm->attrs[0].handle;
+	entry->end_handle = service_val->end_handle;
+
+	for (size_t i = 0; i < dm->cur_attr_id; i++) {
+		if (!dm_cache_attr_put(entry, &dm->attrs[i])) {
+			LOG_WRN("Service too large to be cached.");
+			dm_cache_remove(entry);
+			k_mutex_unlock(&dm_cache_lock);
+			return;
+		}
+	}
+
+	dm_cache_save(entry);
+
+	k_mutex_unlock(&dm_cache_lock);
+}
+
+static int dm_cache_attr_restore(struct bt_gatt_dm *dm,
+				 struct dm_cache_reader *reader)
+{
+	union dm_uuid uuid;
+	union dm_uuid val_uuid;
+	struct bt_gatt_attr attr = {
+		.uuid = &uuid.uuid,
+	};
+	struct bt_gatt_attr *cur_attr;
+
+	if (!dm_cache_get_le16(reader, &attr.handle) ||
+	    !dm_cache_get_uuid(reader, &uuid)) {
+		return -EINVAL;
+	}
+
+	cur_attr = attr_store(dm, &attr);
+	if (!cur_attr) {
+		return -ENOMEM;
+	}
+
+	cur_attr->uuid = uuid_store(dm, attr.uuid);
+	if (!cur_attr->uuid) {
+		return -ENOMEM;
+	}
+
+	if (!bt_uuid_cmp(BT_UUID_GATT_PRIMARY, attr.uuid) ||
+	    !bt_uuid_cmp(BT_UUID_GATT_SECONDARY, attr.uuid)) {
+		struct bt_gatt_service_val service_val = {
+			.uuid = &val_uuid.uuid,
+		};
+		struct bt_gatt_service_val *stored_val;
+
+		if (!dm_cache_get_le16(reader, &service_val.end_handle) ||
+		    !dm_cache_get_uuid(reader, &val_uuid)) {
+			return -EINVAL;
+		}
+
+		stored_val = user_data_store(dm, &service_val,
+					     sizeof(service_val));
+		if (!stored_val) {
+			return -ENOMEM;
+		}
+		stored_val->uuid = uuid_store(dm, service_val.uuid);
+		cur_attr->user_data = stored_val;
+		if (!stored_val->uuid) {
+			return -ENOMEM;
+		}
+	} else if (!bt_uuid_cmp(BT_UUID_GATT_CHRC, attr.uuid)) {
+		struct bt_gatt_chrc gatt_chrc = {
+			.uuid = &val_uuid.uuid,
+		};
+		struct bt_gatt_chrc *stored_chrc;
+
+		if (!dm_cache_get(reader, &gatt_chrc.properties,
+				  sizeof(gatt_chrc.properties)) ||
+		    !dm_cache_get_uuid(reader, &val_uuid)) {
+			return -EINVAL;
+		}
+
+		stored_chrc = user_data_store(dm, &gatt_chrc,
+					      sizeof(gatt_chrc));
+		if (!stored_chrc) {
+			return -ENOMEM;
+		}
+		stored_chrc->uuid = uuid_store(dm, gatt_chrc.uuid);
+		cur_attr->user_data = stored_chrc;
+		if (!stored_chrc->uuid) {
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void dm_cache_work_handler(struct k_work *work)
+{
+	struct bt_gatt_dm *dm = CONTAINER_OF(work, struct bt_gatt_dm,
+					     cache_work);
+
+	LOG_DBG("Discovery complete, served from cache.");
+	atomic_set_bit(dm->state_flags, STATE_ATTRS_RELEASE_PENDING);
+	if (dm->callback->completed) {
+		dm->callback->completed(dm, dm->context);
+	}
+}
+
+static int dm_cache_load(struct bt_gatt_dm *dm,
+			 const struct bt_uuid *svc_uuid)
+{
+	struct dm_cache_entry *entry;
+	struct dm_cache_reader reader;
+	struct bt_conn_info info;
+	int err = 0;
+
+	if (!dm_cache_peer_bonded(dm->conn, &info)) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&dm_cache_lock, K_FOREVER);
+
+	entry = dm_cache_find(info.id, info.le.dst, svc_uuid);
+	if (!entry) {
+		k_mutex_unlock(&dm_cache_lock);
+		return -ENOENT;
+	}
+
+	err = arena_alloc(dm, entry->start_handle, entry->end_handle);
+	if (err) {
+		k_mutex_unlock(&dm_cache_lock);
+		return err;
+	}
+
+	reader.data = entry->data;
+	reader.len = entry->len;
+	while (reader.len && !err) {
+		err = dm_cache_attr_restore(dm, &reader);
+	}
+
+	if (err) {
+		LOG_WRN("Cannot restore cached service, error: %d.", err);
+		svc_attr_memory_release(dm);
+		dm_cache_remove(entry);
+		k_mutex_unlock(&dm_cache_lock);
+		return err;
+	}
+
+	dm->svc_end_handle = entry->end_handle;
+
+	k_mutex_unlock(&dm_cache_lock);
+
+	chrc_index_build(dm);
+
+	k_work_init(&dm->cache_work, dm_cache_work_handler);
+	k_work_submit(&dm->cache_work);
+
+	return 0;
+}
+
+int bt_gatt_dm_cache_invalidate(const bt_addr_le_t *addr,
+				u16_t start_handle,
+				u16_t end_handle)
+{
+	if (!addr || (start_handle > end_handle)) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&dm_cache_lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(dm_cache); i++) {
+		struct dm_cache_entry *entry = &dm_cache[i];
+
+		if (!entry->len) {
+			continue;
+		}
+		if (bt_addr_le_cmp(addr, BT_ADDR_LE_ANY) &&
+		    bt_addr_le_cmp(addr, &entry->addr)) {
+			continue;
+		}
+		if ((entry->start_handle > end_handle) ||
+		    (entry->end_handle < start_handle)) {
+			continue;
+		}
+
+		LOG_DBG("Cache entry %zu invalidated", i);
+		dm_cache_remove(entry);
+	}
+
+	k_mutex_unlock(&dm_cache_lock);
+
+	return 0;
+}
+
+/* Remove the entries of the peers that are no longer bonded */
+static void dm_cache_unbonded_remove(void)
+{
+	k_mutex_lock(&dm_cache_lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(dm_cache); i++) {
+		struct dm_cache_entry *entry = &dm_cache[i];
+
+		if (entry->len &&
+		    !bt_addr_le_is_bonded(entry->id, &entry->addr)) {
+			LOG_DBG("Cache entry %zu removed, peer not bonded", i);
+			dm_cache_remove(entry);
+		}
+	}
+
+	k_mutex_unlock(&dm_cache_lock);
+}
+
+static void dm_cache_sc_free(struct dm_cache_sc *sc)
+{
+	memset(sc, 0, sizeof(*sc));
+}
+
+static u8_t dm_cache_sc_indicated(struct bt_conn *conn,
+				  struct bt_gatt_subscribe_params *params,
+				  const void *data, u16_t length)
+{
+	struct dm_cache_sc *sc = CONTAINER_OF(params, struct dm_cache_sc,
+					      subscribe_params);
+	u16_t start_handle;
+	u16_t end_handle;
+
+	if (!data) {
+		/* Subscription removed by the stack */
+		dm_cache_sc_free(sc);
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (length != 2 * sizeof(u16_t)) {
+		LOG_WRN("Invalid Service Changed length: %"PRIu16, length);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	start_handle = sys_get_le16(data);
+	end_handle = sys_get_le16((const u8_t *)data + sizeof(u16_t));
+	LOG_DBG("Service Changed, handles range: <%"PRIu16", %"PRIu16">",
+		start_handle, end_handle);
+
+	(void)bt_gatt_dm_cache_invalidate(&sc->addr, start_handle,
+					  end_handle);
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static u8_t dm_cache_sc_discovered(struct bt_conn *conn,
+				   const struct bt_gatt_attr *attr,
+				   struct bt_gatt_discover_params *params)
+{
+	struct dm_cache_sc *sc = CONTAINER_OF(params, struct dm_cache_sc,
+					      discover_params);
+	int err;
+
+	if (!attr) {
+		LOG_DBG("No Service Changed characteristic on the peer");
+		dm_cache_sc_free(sc);
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (params->type == BT_GATT_DISCOVER_CHARACTERISTIC) {
+		/* The value declaration follows the characteristic one */
+		sc->subscribe_params.value_handle = attr->handle + 1;
+
+		params->uuid = BT_UUID_GATT_CCC;
+		params->start_handle = attr->handle + 2;
+		params->type = BT_GATT_DISCOVER_DESCRIPTOR;
+		err = bt_gatt_discover(conn, params);
+	} else {
+		sc->subscribe_params.ccc_handle = attr->handle;
+		sc->subscribe_params.value = BT_GATT_CCC_INDICATE;
+		sc->subscribe_params.notify = dm_cache_sc_indicated;
+		err = bt_gatt_subscribe(conn, &sc->subscribe_params);
+	}
+
+	if (err) {
+		LOG_ERR("Service Changed subscription failed, error: %d.",
+			err);
+		dm_cache_sc_free(sc);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+static void dm_cache_sc_subscribe(struct bt_conn *conn,
+				  const bt_addr_le_t *addr)
+{
+	struct dm_cache_sc *sc = NULL;
+	int err;
+
+	for (size_t i = 0; i < ARRAY_SIZE(dm_cache_sc); i++) {
+		if (!dm_cache_sc[i].in_use) {
+			sc = sc ? sc : &dm_cache_sc[i];
+		} else if (!bt_addr_le_cmp(addr, &dm_cache_sc[i].addr)) {
+			/* The stack keeps the subscriptions of bonded peers */
+			return;
+		}
+	}
+
+	if (!sc) {
+		LOG_WRN("No space for Service Changed subscription.");
+		return;
+	}
+
+	sc->in_use = true;
+	bt_addr_le_copy(&sc->addr, addr);
+	sc->discover_params.uuid = BT_UUID_GATT_SC;
+	sc->discover_params.func = dm_cache_sc_discovered;
+	sc->discover_params.start_handle = 0x0001;
+	sc->discover_params.end_handle = 0xffff;
+	sc->discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(conn, &sc->discover_params);
+	if (err) {
+		LOG_ERR("Service Changed discover failed, error: %d.", err);
+		dm_cache_sc_free(sc);
+	}
+}
+
+static void dm_cache_security_changed(struct bt_conn *conn,
+				      bt_security_t level)
+{
+	struct bt_conn_info info;
+
+	ARG_UNUSED(level);
+
+	if (dm_cache_peer_bonded(conn, &info)) {
+		dm_cache_sc_subscribe(conn, info.le.dst);
+	}
+}
+
+static void dm_cache_disconnected(struct bt_conn *conn, u8_t reason)
+{
+	ARG_UNUSED(conn);
+	ARG_UNUSED(reason);
+
+	/* Removing the bond of a connected peer terminates the connection */
+	dm_cache_unbonded_remove();
+}
+
+static struct bt_conn_cb dm_cache_conn_callbacks = {
+	.disconnected = dm_cache_disconnected,
+	.security_changed = dm_cache_security_changed,
+};
+
+static int dm_cache_settings_set(int argc, char **argv, void *value_ctx)
+{
+	struct dm_cache_entry *entry;
+	unsigned long id;
+	int len;
+
+	if (argc != 1) {
+		return -ENOENT;
+	}
+
+	id = strtoul(argv[0], NULL, 10);
+	if (id >= ARRAY_SIZE(dm_cache)) {
+		LOG_WRN("Cache entry %s out of range, ignored.", argv[0]);
+		return 0;
+	}
+
+	k_mutex_lock(&dm_cache_lock, K_FOREVER);
+
+	entry = &dm_cache[id];
+	len = settings_val_read_cb(value_ctx, entry, sizeof(*entry));
+	if (len <= 0) {
+		/* Entry removed */
+		memset(entry, 0, sizeof(*entry));
+		len = 0;
+	} else if (((size_t)len < offsetof(struct dm_cache_entry, data)) ||
+		   (entry->len != len - offsetof(struct dm_cache_entry, data))) {
+		LOG_WRN("Invalid cache entry %s, ignored.", argv[0]);
+		memset(entry, 0, sizeof(*entry));
+		len = -EINVAL;
+	}
+
+	k_mutex_unlock(&dm_cache_lock);
+
+	return (len < 0) ? len : 0;
+}
+
+static int dm_cache_settings_commit(void)
+{
+	/* Bonds removed while the entries were not loaded */
+	dm_cache_unbonded_remove();
+
+	return 0;
+}
+
+static struct settings_handler dm_cache_settings = {
+	.name = DM_CACHE_SETTINGS_KEY,
+	.h_set = dm_cache_settings_set,
+	.h_commit = dm_cache_settings_commit,
+};
+
+static int dm_cache_init(struct device *unused)
+{
+	ARG_UNUSED(unused);
+
+	bt_conn_cb_register(&dm_cache_conn_callbacks);
+
+	int err = settings_subsys_init();
+
+	if (err) {
+		LOG_ERR("Settings initialization failed, error: %d.", err);
+		return err;
+	}
+
+	return settings_register(&dm_cache_settings);
+}
+
+SYS_INIT(dm_cache_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif /* CONFIG_BT_GATT_DM_CACHE */
+
 static void discovery_complete(struct bt_gatt_dm *dm)
 {
 	LOG_DBG("Discovery complete.");
+	chrc_index_build(dm);
+#if CONFIG_BT_GATT_DM_CACHE
+	/* Only the first instance of the service is cached */
+	if ((dm->search_type == SEARCH_UUID) &&
+	    (dm->search_start_handle == 0x0001)) {
+		dm_cache_store(dm);
+	}
+#endif
 	atomic_set_bit(dm->state_flags, STATE_ATTRS_RELEASE_PENDING);
 	if (dm->callback->completed) {
 		dm->callback->completed(dm, dm->context);
@@ -247,6 +1086,23 @@ static void discovery_complete_error(struct bt_gatt_dm *dm, int err)
 	}
 }
 
+static bool svc_is_searched(const struct bt_gatt_dm *dm,
+			    const struct bt_uuid *uuid)
+{
+	if (dm->search_type != SEARCH_UUID_LIST) {
+		/* Services are already filtered by the server */
+		return true;
+	}
+
+	for (size_t i = 0; i < dm->svc_uuid_cnt; i++) {
+		if (!bt_uuid_cmp(dm->svc_uuid_list[i], uuid)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static u8_t discovery_process_service(struct bt_gatt_dm *dm,
 				      const struct bt_gatt_attr *attr,
 				      struct bt_gatt_discover_params *params)
@@ -258,8 +1114,23 @@ static u8_t discovery_process_service(struct bt_gatt_dm *dm,
 		return BT_GATT_ITER_STOP;
 	}
 
-	struct bt_gatt_service_val *service_val = attr->user_data;
-	struct bt_gatt_attr *cur_attr = attr_store(dm, attr);
+	const struct bt_gatt_service_val *service_val = attr->user_data;
+	struct bt_gatt_service_val *stored_val;
+	struct bt_gatt_attr *cur_attr;
+
+	if (!svc_is_searched(dm, service_val->uuid)) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	dm->svc_end_handle = service_val->end_handle;
+
+	err = arena_alloc(dm, attr->handle, service_val->end_handle);
+	if (err) {
+		discovery_complete_error(dm, err);
+		return BT_GATT_ITER_STOP;
+	}
+
+	cur_attr = attr_store(dm, attr);
 
 	if (!cur_attr) {
 		LOG_ERR("Not enough memory for service attribute.");
@@ -271,13 +1142,13 @@ static u8_t discovery_process_service(struct bt_gatt_dm *dm,
 		service_val->end_handle);
 
 	cur_attr->uuid = uuid_store(dm, attr->uuid);
-	service_val = user_data_store(dm, service_val,
-				      sizeof(*service_val));
-	service_val->uuid = uuid_store(dm, service_val->uuid);
-	cur_attr->user_data = service_val;
+	stored_val = user_data_store(dm, service_val, sizeof(*service_val));
+	if (stored_val) {
+		stored_val->uuid = uuid_store(dm, service_val->uuid);
+	}
+	cur_attr->user_data = stored_val;
 
-	if (!cur_attr->uuid || !service_val ||
-	    !service_val->uuid) {
+	if (!cur_attr->uuid || !stored_val || !stored_val->uuid) {
 		LOG_ERR("Not enough memory for service attribute data.");
 		discovery_complete_error(dm, -ENOMEM);
 		return BT_GATT_ITER_STOP;
@@ -356,7 +1227,8 @@ static u8_t discovery_process_characteristic(
 	}
 
 	struct bt_gatt_attr *cur_attr = attr_find_by_handle(dm, attr->handle);
-	struct bt_gatt_chrc *gatt_chrc;
+	const struct bt_gatt_chrc *gatt_chrc = attr->user_data;
+	struct bt_gatt_chrc *stored_chrc;
 
 	if (!cur_attr) {
 		/* We should never be here is the server is working properly */
@@ -364,11 +1236,15 @@ static u8_t discovery_process_characteristic(
 		return BT_GATT_ITER_STOP;
 	}
 
-	gatt_chrc = attr->user_data;
-	gatt_chrc = user_data_store(dm, gatt_chrc, sizeof(*gatt_chrc));
-	gatt_chrc->uuid = uuid_store(dm, gatt_chrc->uuid);
-	cur_attr->user_data = gatt_chrc;
-	if (!gatt_chrc || !gatt_chrc->uuid) {
+	stored_chrc = user_data_store(dm, gatt_chrc, sizeof(*gatt_chrc));
+	if (stored_chrc) {
+		stored_chrc->uuid = uuid_store(dm, gatt_chrc->uuid);
+	}
+	cur_attr->user_data = stored_chrc;
+	if (!stored_chrc || !stored_chrc->uuid) {
+		LOG_ERR("Not enough memory for characteristic data"
+			" at handle %u.",
+			attr->handle);
 		discovery_complete_error(dm, -ENOMEM);
 		return BT_GATT_ITER_STOP;
 	}
@@ -471,16 +1347,24 @@ const struct bt_gatt_attr *bt_gatt_dm_char_by_uuid(
 	const struct bt_gatt_dm *dm,
 	const struct bt_uuid *uuid)
 {
-	const struct bt_gatt_attr *curr = NULL;
+	size_t lower = 0;
+	size_t upper = dm->chrc_cnt;
 
-	while ((curr = bt_gatt_dm_char_next(dm, curr)) != NULL) {
-		struct bt_gatt_chrc *chrc = bt_gatt_dm_attr_chrc_val(curr);
+	/* Find the first characteristic not ordered before the UUID */
+	while (lower < upper) {
+		size_t m = (lower + upper) / 2;
 
-		__ASSERT_NO_MSG(chrc != NULL);
-		if (!bt_uuid_cmp(uuid, chrc->uuid)) {
-			return curr;
+		if (uuid_order(chrc_index_uuid(dm, m), uuid) < 0) {
+			lower = m + 1;
+		} else {
+			upper = m;
 		}
 	}
+
+	if ((lower < dm->chrc_cnt) &&
+	    !bt_uuid_cmp(uuid, chrc_index_uuid(dm, lower))) {
+		return &dm->attrs[dm->chrc_index[lower]];
+	}
 	return NULL;
 }
 
@@ -537,16 +1421,49 @@ const struct bt_gatt_attr *bt_gatt_dm_desc_next(
 }
 
 
+static int discovery_start(struct bt_gatt_dm *dm, u16_t start_handle)
+{
+	int err;
+
+	svc_attr_data_clear(dm);
+
+	dm->search_start_handle = start_handle;
+
+#if CONFIG_BT_GATT_DM_CACHE
+	if ((dm->search_type == SEARCH_UUID) && (start_handle == 0x0001) &&
+	    !dm_cache_load(dm, &dm->svc_uuid.uuid)) {
+		return 0;
+	}
+#endif
+
+	if (dm->search_type == SEARCH_UUID) {
+		dm->discover_params.uuid = &dm->svc_uuid.uuid;
+	} else {
+		dm->discover_params.uuid = NULL;
+	}
+	dm->discover_params.func = discovery_callback;
+	dm->discover_params.start_handle = start_handle;
+	dm->discover_params.end_handle = 0xffff;
+	dm->discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+
+	err = bt_gatt_discover(dm->conn, &dm->discover_params);
+	if (err) {
+		LOG_ERR("Discover failed, error: %d.", err);
+		svc_attr_memory_release(dm);
+		atomic_clear_bit(dm->state_flags, STATE_ATTRS_LOCKED);
+	}
+
+	return err;
+}
+
 int bt_gatt_dm_start(struct bt_conn *conn,
 		     const struct bt_uuid *svc_uuid,
 		     const struct bt_gatt_dm_cb *cb,
 		     void *context)
 {
-	int err;
 	struct bt_gatt_dm *dm;
 
-	if ((svc_uuid->type != BT_UUID_TYPE_16) &&
-	    (svc_uuid->type != BT_UUID_TYPE_128)) {
+	if (svc_uuid && !uuid_is_valid(svc_uuid)) {
 		return -EINVAL;
 	}
 
@@ -563,23 +1480,71 @@ int bt_gatt_dm_start(struct bt_conn *conn,
 	dm->conn = conn;
 	dm->context = context;
 	dm->callback = cb;
-	dm->cur_attr_id = 0;
-	dm->data_chunk.cur_len = 0;
-	dm->data_chunk.cur_id = 0;
+	dm->svc_uuid_list = NULL;
+	dm->svc_uuid_cnt = 0;
 
-	dm->discover_params.uuid = uuid_store(dm, svc_uuid);
-	dm->discover_params.func = discovery_callback;
-	dm->discover_params.start_handle = 0x0001;
-	dm->discover_params.end_handle = 0xffff;
-	dm->discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+	if (svc_uuid) {
+		dm->search_type = SEARCH_UUID;
+		uuid_copy(&dm->svc_uuid, svc_uuid);
+	} else {
+		dm->search_type = SEARCH_ALL;
+	}
 
-	err = bt_gatt_discover(conn, &dm->discover_params);
-	if (err) {
-		LOG_ERR("Discover failed, error: %d.", err);
-		atomic_clear_bit(dm->state_flags, STATE_ATTRS_LOCKED);
+	return discovery_start(dm, 0x0001);
+}
+
+int bt_gatt_dm_start_list(struct bt_conn *conn,
+			  const struct bt_uuid *const *svc_uuids,
+			  size_t svc_uuid_cnt,
+			  const struct bt_gatt_dm_cb *cb,
+			  void *context)
+{
+	struct bt_gatt_dm *dm;
+
+	if (!svc_uuids || !svc_uuid_cnt || !cb) {
+		return -EINVAL;
 	}
 
-	return err;
+	for (size_t i = 0; i < svc_uuid_cnt; i++) {
+		if (!uuid_is_valid(svc_uuids[i])) {
+			return -EINVAL;
+		}
+	}
+
+	dm = &bt_gatt_dm_inst;
+
+	if (atomic_test_and_set_bit(dm->state_flags, STATE_ATTRS_LOCKED)) {
+		return -EALREADY;
+	}
+
+	dm->conn = conn;
+	dm->context = context;
+	dm->callback = cb;
+	dm->search_type = SEARCH_UUID_LIST;
+	dm->svc_uuid_list = svc_uuids;
+	dm->svc_uuid_cnt = svc_uuid_cnt;
+
+	return discovery_start(dm, 0x0001);
+}
+
+int bt_gatt_dm_continue(struct bt_gatt_dm *dm, void *context)
+{
+	if (!dm->conn) {
+		return -EINVAL;
+	}
+
+	if (dm->svc_end_handle == 0xffff) {
+		/* No more attributes on the server */
+		return -ENOENT;
+	}
+
+	if (atomic_test_and_set_bit(dm->state_flags, STATE_ATTRS_LOCKED)) {
+		return -EALREADY;
+	}
+
+	dm->context = context;
+
+	return discovery_start(dm, dm->svc_end_handle + 1);
 }
 
 int bt_gatt_dm_data_release(struct bt_gatt_dm *dm)
@@ -14,10 +14,27 @@
 #include <blectlr_hci.h>
 #include <blectlr_util.h>
 
+#include "hci_stats_priv.h"
+
 #define BT_DBG_ENABLED IS_ENABLED(CONFIG_BT_DEBUG_HCI_DRIVER)
 #define LOG_MODULE_NAME bt_ctlr_hci_driver
 #include "common/log.h"
 
+/* Largest HCI packet fetched from the controller. */
+#define HCI_RX_BUF_SIZE (256 + 4)
+
+/* Largest HCI ACL data packet, with the maximum LE data length. */
+#define HCI_ACL_PKT_MAX (BT_HCI_ACL_HDR_SIZE + 251)
+
+/* ACL data is fetched directly into the host buffer if it can hold the
+ * largest packet, so it is copied only once.
+ */
+#if defined(CONFIG_BT_CONN) && (CONFIG_BT_RX_BUF_LEN >= HCI_ACL_PKT_MAX)
+#define HCI_ACL_RX_DIRECT 1
+#else
+#define HCI_ACL_RX_DIRECT 0
+#endif
+
 static K_SEM_DEFINE(sem_recv, 0, UINT_MAX);
 static K_SEM_DEFINE(sem_signal, 0, UINT_MAX);
 
@@ -44,6 +61,8 @@ static int cmd_handle(struct net_buf *cmd)
 		return -ENOBUFS;
 	}
 
+	hci_stats_tx_cmd(cmd->data);
+
 	k_sem_give(&sem_recv);
 
 	return 0;
@@ -59,6 +78,8 @@ static int acl_handle(struct net_buf *acl)
 		return -ENOBUFS;
 	}
 
+	hci_stats_tx_acl(acl->len);
+
 	return 0;
 }
 
@@ -99,15 +120,8 @@ static int hci_driver_send(struct net_buf *buf)
 	return err;
 }
 
-static void data_packet_process(u8_t *hci_buf)
+static void data_packet_log(const u8_t *hci_buf)
 {
-	struct net_buf *data_buf = bt_buf_get_rx(BT_BUF_ACL_IN, K_FOREVER);
-
-	if (!data_buf) {
-		BT_ERR("No data buffer available");
-		return;
-	}
-
 	u16_t handle = hci_buf[0] | (hci_buf[1] & 0xF) << 8;
 	u16_t data_length = hci_buf[2] | hci_buf[3] << 8;
 	u8_t pb_flag = (hci_buf[1] >> 4) & 0x3;
@@ -116,36 +130,71 @@ static void data_packet_process(u8_t *hci_buf)
 	BT_DBG("Data: Handle(%02x), PB(%01d), "
 	       "BC(%01d), Length(%02x)",
 	       handle, pb_flag, bc_flag, data_length);
-
-	net_buf_add_mem(data_buf, &hci_buf[0], data_length + 4);
-	bt_recv(data_buf);
 }
 
-static void event_packet_process(u8_t *hci_buf)
+/* Returns 1 if a packet was passed to the host, 0 if the controller has no
+ * data pending and -ENOBUFS if no host buffer was available. If a host buffer
+ * is available, the packet is fetched directly into it. Otherwise, it is
+ * fetched into a local buffer and kept pending until a host buffer is
+ * available, like events are, so that the host buffers are only waited for
+ * if there is a packet to pass.
+ */
+static int data_packet_process(s32_t timeout)
 {
-	struct bt_hci_evt_hdr *hdr = (void *)hci_buf;
-	struct net_buf *evt_buf;
+	static u8_t data_rx_buf[HCI_RX_BUF_SIZE];
+	static bool pending;
 
-	if (hdr->evt == BT_HCI_EVT_CMD_COMPLETE ||
-	    hdr->evt == BT_HCI_EVT_CMD_STATUS) {
-		u16_t opcode = hci_buf[3] | hci_buf[4] << 8;
+	struct net_buf *data_buf = NULL;
+	u8_t *hci_buf = data_rx_buf;
+	u16_t data_length;
 
-		if (opcode == 0xC03) {
-			BT_DBG("Reset command complete");
-			cal_init();
-			blectlr_set_default_evt_length();
+	if (!pending) {
+#if HCI_ACL_RX_DIRECT
+		data_buf = bt_buf_get_rx(BT_BUF_ACL_IN, K_NO_WAIT);
+		if (data_buf) {
+			__ASSERT_NO_MSG(net_buf_tailroom(data_buf) >=
+					HCI_ACL_PKT_MAX);
+
+			hci_buf = net_buf_tail(data_buf);
 		}
+#endif
 
-		evt_buf = bt_buf_get_cmd_complete(K_FOREVER);
-	} else {
-		evt_buf = bt_buf_get_rx(BT_BUF_EVT, K_FOREVER);
+		if (!hci_data_packet_get(hci_buf)) {
+			if (data_buf) {
+				net_buf_unref(data_buf);
+			}
+
+			return 0;
+		}
+
+		data_packet_log(hci_buf);
 	}
 
-	if (!evt_buf) {
-		BT_ERR("No event buffer available");
-		return;
+	data_length = hci_buf[2] | hci_buf[3] << 8;
+
+	if (data_buf) {
+		net_buf_add(data_buf, data_length + 4);
+	} else {
+		data_buf = bt_buf_get_rx(BT_BUF_ACL_IN, timeout);
+		if (!data_buf) {
+			pending = true;
+			return -ENOBUFS;
+		}
+
+		pending = false;
+		net_buf_add_mem(data_buf, &hci_buf[0], data_length + 4);
 	}
 
+	hci_stats_rx_acl(data_length + 4);
+	bt_recv(data_buf);
+
+	return 1;
+}
+
+static void event_packet_log(const u8_t *hci_buf)
+{
+	const struct bt_hci_evt_hdr *hdr = (const void *)hci_buf;
+
 	if (hdr->evt == 0x3E) {
 		BT_DBG("LE Meta Event: subevent code "
 		       "(%02x), length (%d)",
@@ -155,6 +204,56 @@ static void event_packet_process(u8_t *hci_buf)
 		       "length (%d)",
 		       hci_buf[0], hci_buf[1]);
 	}
+}
+
+/* Return values as for data_packet_process(). The host buffer pool depends
+ * on the event code, so an event is fetched first and kept pending until
+ * a host buffer is available.
+ */
+static int event_packet_process(s32_t timeout)
+{
+	static u8_t hci_buf[HCI_RX_BUF_SIZE];
+	static bool pending;
+
+	struct bt_hci_evt_hdr *hdr = (void *)hci_buf;
+	struct net_buf *evt_buf;
+	bool cmd_complete;
+
+	if (!pending) {
+		if (!hci_event_packet_get(hci_buf)) {
+			return 0;
+		}
+
+		pending = true;
+		event_packet_log(hci_buf);
+	}
+
+	cmd_complete = (hdr->evt == BT_HCI_EVT_CMD_COMPLETE ||
+			hdr->evt == BT_HCI_EVT_CMD_STATUS);
+
+	if (cmd_complete) {
+		evt_buf = bt_buf_get_cmd_complete(timeout);
+	} else {
+		evt_buf = bt_buf_get_rx(BT_BUF_EVT, timeout);
+	}
+
+	if (!evt_buf) {
+		return -ENOBUFS;
+	}
+
+	pending = false;
+
+	hci_stats_rx_evt(hci_buf);
+
+	if (cmd_complete) {
+		u16_t opcode = hci_buf[3] | hci_buf[4] << 8;
+
+		if (opcode == 0xC03) {
+			BT_DBG("Reset command complete");
+			cal_init();
+			blectlr_set_default_evt_length();
+		}
+	}
 
 	net_buf_add_mem(evt_buf, &hci_buf[0], hdr->len + 2);
 	if (bt_hci_evt_is_prio(hdr->evt)) {
@@ -162,6 +261,52 @@ static void event_packet_process(u8_t *hci_buf)
 	} else {
 		bt_recv(evt_buf);
 	}
+
+	return 1;
+}
+
+static int packet_process(s32_t timeout)
+{
+	/* Pending events are passed to the host before data. */
+	int ret = event_packet_process(timeout);
+
+	if (!ret) {
+		ret = data_packet_process(timeout);
+	}
+
+	return ret;
+}
+
+/* Returns false if the packets were not drained, so another pass is needed. */
+static bool recv_drain(void)
+{
+	u32_t count = 0;
+	bool drained = false;
+
+	while (count < CONFIG_BLECTLR_RX_BUDGET) {
+		int ret = packet_process(K_NO_WAIT);
+
+		if (ret == -ENOBUFS) {
+			u32_t start = k_cycle_get_32();
+
+			ret = packet_process(
+				K_MSEC(CONFIG_BLECTLR_RX_BUF_WAIT_MS));
+			hci_stats_rx_buf_wait(k_cycle_get_32() - start,
+					  ret == -ENOBUFS);
+		}
+
+		if (ret <= 0) {
+			/* A buffer timeout is retried on the next pass. */
+			drained = !ret;
+			break;
+		}
+
+		count++;
+	}
+
+	hci_stats_rx_pass(count, count == CONFIG_BLECTLR_RX_BUDGET);
+
+	return drained;
 }
 
 static void recv_thread(void *p1, void *p2, void *p3)
@@ -170,21 +315,18 @@ static void recv_thread(void *p1, void *p2, void *p3)
 	ARG_UNUSED(p2);
 	ARG_UNUSED(p3);
 
-	static u8_t hci_buffer[256 + 4];
-	bool pkt;
-
 	BT_DBG("Started");
 	while (1) {
 		k_sem_take(&sem_recv, K_FOREVER);
+		hci_stats_signal_handled();
 
-		pkt = hci_data_packet_get(hci_buffer);
-		if (pkt) {
-			data_packet_process(hci_buffer);
-		}
+		/* Signals given from now on are for packets that may not be
+		 * drained by this pass.
+		 */
+		k_sem_reset(&sem_recv);
 
-		pkt = hci_event_packet_get(hci_buffer);
-		if (pkt) {
-			event_packet_process(hci_buffer);
+		if (!recv_drain()) {
+			k_sem_give(&sem_recv);
 		}
 
 		/* Let other threads of same priority run in between. */
@@ -194,6 +336,7 @@ static void recv_thread(void *p1, void *p2, void *p3)
 
 void _signal_handler_irq(void)
 {
+	hci_stats_signal();
 	k_sem_give(&sem_recv);
 }
 
@@ -213,6 +356,8 @@ static int hci_driver_open(void)
 {
 	BT_DBG("Open");
 
+	hci_stats_init();
+
 	k_thread_create(&recv_thread_data, recv_thread_stack,
 			K_THREAD_STACK_SIZEOF(recv_thread_stack), recv_thread,
 			NULL, NULL, NULL, K_PRIO_COOP(CONFIG_BLECTLR_PRIO), 0,
@@ -236,6 +381,7 @@ static const struct bt_hci_driver drv = {
 void host_signal(void)
 {
 	/* Wake up the RX event/data thread */
+	hci_stats_signal();
 	k_sem_give(&sem_recv);
 }
 
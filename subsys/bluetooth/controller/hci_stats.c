@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <kernel.h>
+#include <string.h>
+#include <misc/util.h>
+#include <misc/byteorder.h>
+#include <bluetooth/hci.h>
+#include <shell/shell.h>
+#include <profiler.h>
+
+#include <bluetooth/controller/hci_stats.h>
+
+#include "hci_stats_priv.h"
+
+static struct bt_ctlr_hci_stats stats;
+
+/* Send time of the command in progress for each tracked opcode. */
+static u32_t cmd_start[CONFIG_BLECTLR_HCI_STATS_CMD_MAX];
+
+static bool signal_pending;
+static u32_t signal_time;
+static u32_t signal_latency_last;
+
+enum {
+	PROFILER_EVT_RX_PASS,
+	PROFILER_EVT_BUF_WAIT,
+	PROFILER_EVT_CMD_RTT,
+
+	PROFILER_EVT_COUNT
+};
+
+#if CONFIG_BLECTLR_HCI_STATS_PROFILER
+static u16_t profiler_ids[PROFILER_EVT_COUNT];
+
+static void profiler_send(size_t evt, u32_t arg1, u32_t arg2)
+{
+	struct log_event_buf buf;
+
+	if (!is_profiling_enabled(profiler_ids[evt])) {
+		return;
+	}
+
+	profiler_log_start(&buf);
+	profiler_log_encode_u32(&buf, arg1);
+	profiler_log_encode_u32(&buf, arg2);
+	profiler_log_send(&buf, profiler_ids[evt]);
+}
+#else
+static inline void profiler_send(size_t evt, u32_t arg1, u32_t arg2) {}
+#endif /* CONFIG_BLECTLR_HCI_STATS_PROFILER */
+
+static u32_t cycles_to_us(u32_t cycles)
+{
+	return SYS_CLOCK_HW_CYCLES_TO_NS64(cycles) / 1000;
+}
+
+void hci_stats_init(void)
+{
+#if CONFIG_BLECTLR_HCI_STATS_PROFILER
+	static const enum profiler_arg types[] = {PROFILER_ARG_U32,
+						  PROFILER_ARG_U32};
+	static const char *rx_pass_labels[] = {"packets",
+					       "signal_latency_us"};
+	static const char *buf_wait_labels[] = {"wait_us", "timed_out"};
+	static const char *cmd_rtt_labels[] = {"opcode", "rtt_us"};
+
+	profiler_ids[PROFILER_EVT_RX_PASS] = profiler_register_event_type(
+		"hci_rx_pass", rx_pass_labels, types, ARRAY_SIZE(types));
+	profiler_ids[PROFILER_EVT_BUF_WAIT] = profiler_register_event_type(
+		"hci_buf_wait", buf_wait_labels, types, ARRAY_SIZE(types));
+	profiler_ids[PROFILER_EVT_CMD_RTT] = profiler_register_event_type(
+		"hci_cmd_rtt", cmd_rtt_labels, types, ARRAY_SIZE(types));
+#endif
+}
+
+void hci_stats_signal(void)
+{
+	unsigned int key = irq_lock();
+
+	if (!signal_pending) {
+		signal_time = k_cycle_get_32();
+		signal_pending = true;
+	}
+
+	irq_unlock(key);
+}
+
+void hci_stats_signal_handled(void)
+{
+	unsigned int key = irq_lock();
+	u32_t us;
+
+	if (!signal_pending) {
+		irq_unlock(key);
+		return;
+	}
+
+	us = cycles_to_us(k_cycle_get_32() - signal_time);
+	signal_pending = false;
+	signal_latency_last = us;
+
+	stats.signals++;
+	stats.signal_latency_us += us;
+	stats.signal_latency_us_max = max(stats.signal_latency_us_max, us);
+
+	irq_unlock(key);
+}
+
+void hci_stats_rx_pass(u32_t count, bool budget_exhausted)
+{
+	unsigned int key = irq_lock();
+
+	stats.rx_wakeups++;
+	stats.rx_packets += count;
+	stats.rx_packets_per_wakeup_max =
+		max(stats.rx_packets_per_wakeup_max, count);
+	if (budget_exhausted) {
+		stats.rx_budget_exhausted++;
+	}
+
+	irq_unlock(key);
+
+	profiler_send(PROFILER_EVT_RX_PASS, count, signal_latency_last);
+}
+
+void hci_stats_rx_buf_wait(u32_t cycles, bool timed_out)
+{
+	u32_t us = cycles_to_us(cycles);
+	unsigned int key = irq_lock();
+
+	stats.rx_buf_waits++;
+	stats.rx_buf_wait_us += us;
+	stats.rx_buf_wait_us_max = max(stats.rx_buf_wait_us_max, us);
+	if (timed_out) {
+		stats.rx_buf_wait_timeouts++;
+	}
+
+	irq_unlock(key);
+
+	profiler_send(PROFILER_EVT_BUF_WAIT, us, timed_out);
+}
+
+void hci_stats_rx_acl(u16_t len)
+{
+	unsigned int key = irq_lock();
+
+	stats.rx_acl_packets++;
+	stats.rx_acl_bytes += len;
+	irq_unlock(key);
+}
+
+static void cmd_complete(u16_t opcode)
+{
+	unsigned int key = irq_lock();
+
+	for (size_t i = 0; i < ARRAY_SIZE(stats.cmd); i++) {
+		struct bt_ctlr_hci_cmd_stats *cmd = &stats.cmd[i];
+
+		if (cmd->opcode == opcode) {
+			u32_t us = cycles_to_us(k_cycle_get_32() -
+						cmd_start[i]);
+
+			cmd->count++;
+			cmd->rtt_us += us;
+			cmd->rtt_us_max = max(cmd->rtt_us_max, us);
+			irq_unlock(key);
+
+			profiler_send(PROFILER_EVT_CMD_RTT, opcode, us);
+			return;
+		}
+
+		if (!cmd->opcode) {
+			break;
+		}
+	}
+
+	stats.cmd_untracked++;
+	irq_unlock(key);
+}
+
+void hci_stats_rx_evt(const u8_t *hci_buf)
+{
+	const struct bt_hci_evt_hdr *hdr = (const void *)hci_buf;
+	const u8_t *params = &hci_buf[sizeof(*hdr)];
+	unsigned int key = irq_lock();
+
+	stats.rx_evt_packets++;
+	irq_unlock(key);
+
+	if (hdr->evt == BT_HCI_EVT_CMD_COMPLETE) {
+		const struct bt_hci_evt_cmd_complete *evt =
+			(const void *)params;
+
+		cmd_complete(sys_le16_to_cpu(evt->opcode));
+	} else if (hdr->evt == BT_HCI_EVT_CMD_STATUS) {
+		const struct bt_hci_evt_cmd_status *evt =
+			(const void *)params;
+
+		cmd_complete(sys_le16_to_cpu(evt->opcode));
+	}
+}
+
+void hci_stats_tx_cmd(const u8_t *hci_buf)
+{
+	u16_t opcode = sys_get_le16(hci_buf);
+	unsigned int key = irq_lock();
+
+	stats.tx_cmd_packets++;
+
+	for (size_t i = 0; i < ARRAY_SIZE(stats.cmd); i++) {
+		struct bt_ctlr_hci_cmd_stats *cmd = &stats.cmd[i];
+
+		if (!cmd->opcode) {
+			cmd->opcode = opcode;
+		}
+
+		if (cmd->opcode == opcode) {
+			cmd_start[i] = k_cycle_get_32();
+			break;
+		}
+	}
+
+	irq_unlock(key);
+}
+
+void hci_stats_tx_acl(u16_t len)
+{
+	unsigned int key = irq_lock();
+
+	stats.tx_acl_packets++;
+	stats.tx_acl_bytes += len;
+	irq_unlock(key);
+}
+
+void bt_ctlr_hci_stats_get(struct bt_ctlr_hci_stats *out)
+{
+	unsigned int key = irq_lock();
+
+	*out = stats;
+	irq_unlock(key);
+}
+
+void bt_ctlr_hci_stats_reset(void)
+{
+	unsigned int key = irq_lock();
+
+	memset(&stats, 0, sizeof(stats));
+	irq_unlock(key);
+}
+
+#if CONFIG_SHELL
+static u32_t avg(u64_t sum, u32_t count)
+{
+	return count ? sum / count : 0;
+}
+
+static int show(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct bt_ctlr_hci_stats s;
+
+	bt_ctlr_hci_stats_get(&s);
+
+	shell_fprintf(shell, SHELL_NORMAL,
+		      "RX: %u events, %u ACL packets, %llu ACL bytes\n",
+		      s.rx_evt_packets, s.rx_acl_packets, s.rx_acl_bytes);
+	shell_fprintf(shell, SHELL_NORMAL,
+		      "TX: %u commands, %u ACL packets, %llu ACL bytes\n",
+		      s.tx_cmd_packets, s.tx_acl_packets, s.tx_acl_bytes);
+	shell_fprintf(shell, SHELL_NORMAL,
+		      "Passes: %u, packets avg %u max %u, budget used %u\n",
+		      s.rx_wakeups, avg(s.rx_packets, s.rx_wakeups),
+		      s.rx_packets_per_wakeup_max, s.rx_budget_exhausted);
+	shell_fprintf(shell, SHELL_NORMAL,
+		      "Signal latency: avg %u us max %u us\n",
+		      avg(s.signal_latency_us, s.signals),
+		      s.signal_latency_us_max);
+	shell_fprintf(shell, SHELL_NORMAL,
+		      "Buffer waits: %u (%u timed out), "
+		      "avg %u us max %u us\n",
+		      s.rx_buf_waits, s.rx_buf_wait_timeouts,
+		      avg(s.rx_buf_wait_us, s.rx_buf_waits),
+		      s.rx_buf_wait_us_max);
+
+	for (size_t i = 0; (i < ARRAY_SIZE(s.cmd)) && s.cmd[i].opcode; i++) {
+		shell_fprintf(shell, SHELL_NORMAL,
+			      "Command 0x%04x: %u, RTT avg %u us max %u us\n",
+			      s.cmd[i].opcode, s.cmd[i].count,
+			      avg(s.cmd[i].rtt_us, s.cmd[i].count),
+			      s.cmd[i].rtt_us_max);
+	}
+
+	if (s.cmd_untracked) {
+		shell_fprintf(shell, SHELL_NORMAL, "Untracked commands: %u\n",
+			      s.cmd_untracked);
+	}
+
+	return 0;
+}
+
+static int reset(const struct shell *shell, size_t argc, char **argv)
+{
+	bt_ctlr_hci_stats_reset();
+
+	shell_fprintf(shell, SHELL_NORMAL, "HCI statistics cleared\n");
+
+	return 0;
+}
+
+SHELL_CREATE_STATIC_SUBCMD_SET(sub_hci_stats)
+{
+	SHELL_CMD_ARG(show, NULL, "Display HCI driver statistics", show, 0, 0),
+	SHELL_CMD_ARG(reset, NULL, "Clear HCI driver statistics", reset, 0, 0),
+	SHELL_SUBCMD_SET_END
+};
+
+SHELL_CMD_REGISTER(hci_stats, &sub_hci_stats,
+		   "HCI driver statistics", NULL);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef HCI_STATS_PRIV_H_
+#define HCI_STATS_PRIV_H_
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_BLECTLR_HCI_STATS
+void hci_stats_init(void);
+void hci_stats_signal(void);
+void hci_stats_signal_handled(void);
+void hci_stats_rx_pass(u32_t count, bool budget_exhausted);
+void hci_stats_rx_buf_wait(u32_t cycles, bool timed_out);
+void hci_stats_rx_acl(u16_t len);
+void hci_stats_rx_evt(const u8_t *hci_buf);
+void hci_stats_tx_cmd(const u8_t *hci_buf);
+void hci_stats_tx_acl(u16_t len);
+#else
+static inline void hci_stats_init(void) {}
+static inline void hci_stats_signal(void) {}
+static inline void hci_stats_signal_handled(void) {}
+static inline void hci_stats_rx_pass(u32_t count, bool budget_exhausted) {}
+static inline void hci_stats_rx_buf_wait(u32_t cycles, bool timed_out) {}
+static inline void hci_stats_rx_acl(u16_t len) {}
+static inline void hci_stats_rx_evt(const u8_t *hci_buf) {}
+static inline void hci_stats_tx_cmd(const u8_t *hci_buf) {}
+static inline void hci_stats_tx_acl(u16_t len) {}
+#endif /* CONFIG_BLECTLR_HCI_STATS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HCI_STATS_PRIV_H_ */
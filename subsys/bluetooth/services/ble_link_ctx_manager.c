@@ -10,12 +10,69 @@
 LOG_MODULE_REGISTER(ble_link_ctx_manager,
 		    CONFIG_BT_LINK_CTX_MANAGER_LOG_LEVEL);
 
-static inline void ble_link_ctx_mem_free(struct k_mem_slab *mem_slab,
-					 void **data)
+static bool ble_link_ctx_ref_get(struct ble_link_conn_ctx *conn_ctx)
 {
-	k_mem_slab_free(mem_slab,
-			data);
-	*data = NULL;
+	atomic_val_t ref;
+
+	do {
+		ref = atomic_get(&conn_ctx->ref);
+		if (!ref) {
+			return false;
+		}
+	} while (!atomic_cas(&conn_ctx->ref, ref, ref + 1));
+
+	return true;
+}
+
+/* Make the context allocated while the previous one was in use current.
+ * Called once the previous context has no users, from the last release or
+ * from the allocation, whichever comes first.
+ */
+static void ble_link_ctx_next_set(struct ble_link_conn_ctx *conn_ctx)
+{
+	if (!atomic_cas(&conn_ctx->next_pending, 1, 0)) {
+		return;
+	}
+
+	conn_ctx->data = conn_ctx->next_data;
+	conn_ctx->conn = conn_ctx->next_conn;
+
+	/* The reference held until the context is freed. */
+	atomic_set(&conn_ctx->ref, 1);
+}
+
+/* Drop the context allocated while the previous one was in use, if it was
+ * not made current yet.
+ */
+static bool ble_link_ctx_next_cancel(struct ble_link_ctx_manager *ctx_manager,
+				     struct ble_link_conn_ctx *conn_ctx)
+{
+	if (!atomic_cas(&conn_ctx->next_pending, 1, 0)) {
+		return false;
+	}
+
+	k_mem_slab_free(ctx_manager->mem_slab, &conn_ctx->next_data);
+	conn_ctx->next_data = NULL;
+	conn_ctx->next_conn = NULL;
+
+	return true;
+}
+
+static void ble_link_ctx_ref_put(struct ble_link_ctx_manager *ctx_manager,
+				 struct ble_link_conn_ctx *conn_ctx)
+{
+	/* The context does not change while it is referenced. */
+	void *data = conn_ctx->data;
+
+	__ASSERT_NO_MSG(atomic_get(&conn_ctx->ref) > 0);
+
+	if (atomic_dec(&conn_ctx->ref) == 1) {
+		/* The last reference is dropped, the connection
+		 * was already freed.
+		 */
+		k_mem_slab_free(ctx_manager->mem_slab, &data);
+		ble_link_ctx_next_set(conn_ctx);
+	}
 }
 
 void *ble_link_ctx_manager_alloc(struct ble_link_ctx_manager *ctx_manager,
@@ -24,39 +81,59 @@ void *ble_link_ctx_manager_alloc(struct ble_link_ctx_manager *ctx_manager,
 	__ASSERT_NO_MSG(conn != NULL);
 	__ASSERT_NO_MSG(ctx_manager != NULL);
 
-	int err = -ENOMEM;
-	struct ble_link_conn_ctx *conn_ctx;
+	u8_t id = bt_conn_index(conn);
+	struct ble_link_conn_ctx *conn_ctx = &ctx_manager->conn_ctx[id];
+	void *data;
 
-	k_mutex_lock(ctx_manager->mutex, K_FOREVER);
+	__ASSERT_NO_MSG(id < ble_link_ctx_manager_get_ctx_num(ctx_manager));
 
-	for (size_t i = 0; i < CONFIG_BT_MAX_CONN; i++) {
-		conn_ctx = &ctx_manager->conn_ctx[i];
+	k_mutex_lock(ctx_manager->mutex, K_FOREVER);
 
-		if (!conn_ctx->conn &&
-		    !conn_ctx->data) {
-			err = k_mem_slab_alloc(ctx_manager->mem_slab,
-					       &conn_ctx->data,
-					       K_NO_WAIT);
-			if (!err) {
-				conn_ctx->conn = conn;
+	if (conn_ctx->conn || atomic_get(&conn_ctx->next_pending)) {
+		LOG_WRN("Context of the connection index %u is in use", id);
+		k_mutex_unlock(ctx_manager->mutex);
 
-				LOG_DBG("The memory for the connection context "
-					"has been allocated, conn %p, index: %u",
-					conn, i);
+		return NULL;
+	}
 
-				return conn_ctx->data;
+	if (k_mem_slab_alloc(ctx_manager->mem_slab, &data, K_NO_WAIT)) {
+		LOG_WRN("Memory can not be allocated");
+		k_mutex_unlock(ctx_manager->mutex);
 
-			} else {
-				break;
-			}
+		return NULL;
+	}
 
-		}
+	conn_ctx->next_data = data;
+	conn_ctx->next_conn = conn;
+	atomic_set(&conn_ctx->next_pending, 1);
+
+	/* The context of a previous connection with the same index can still
+	 * be in use, for example by a queued work item. The new context is
+	 * then made current when the last user releases the previous one,
+	 * and the reference taken here is returned to the caller.
+	 */
+	if (ble_link_ctx_ref_get(conn_ctx)) {
+		LOG_DBG("The context of the connection index %u is deferred "
+			"until the previous context is released", id);
+		k_mutex_unlock(ctx_manager->mutex);
+
+		return data;
 	}
 
-	LOG_WRN("Memory can not be allocated");
+	ble_link_ctx_next_set(conn_ctx);
+
+	/* One reference is held until the context is freed
+	 * and one is returned to the caller.
+	 */
+	atomic_inc(&conn_ctx->ref);
+
+	LOG_DBG("The memory for the connection context "
+		"has been allocated, conn %p, index: %u",
+		conn, id);
+
 	k_mutex_unlock(ctx_manager->mutex);
 
-	return NULL;
+	return data;
 }
 
 int ble_link_ctx_manager_free(struct ble_link_ctx_manager *ctx_manager,
@@ -65,32 +142,41 @@ int ble_link_ctx_manager_free(struct ble_link_ctx_manager *ctx_manager,
 	__ASSERT_NO_MSG(conn != NULL);
 	__ASSERT_NO_MSG(ctx_manager != NULL);
 
-	k_mutex_lock(ctx_manager->mutex, K_FOREVER);
-
-	for (size_t i = 0; i < CONFIG_BT_MAX_CONN; i++) {
-		struct ble_link_conn_ctx *conn_ctx =
-				&ctx_manager->conn_ctx[i];
+	u8_t id = bt_conn_index(conn);
+	struct ble_link_conn_ctx *conn_ctx = &ctx_manager->conn_ctx[id];
 
-		if (conn_ctx->conn == conn) {
-			ble_link_ctx_mem_free(ctx_manager->mem_slab,
-					      &conn_ctx->data);
-			conn_ctx->conn = NULL;
-			conn_ctx->data = NULL;
+	__ASSERT_NO_MSG(id < ble_link_ctx_manager_get_ctx_num(ctx_manager));
 
-			LOG_DBG("The context memory for the connection "
-				"has been released, conn %p index %u",
-				conn, i);
+	k_mutex_lock(ctx_manager->mutex, K_FOREVER);
 
+	if (conn_ctx->conn != conn) {
+		/* Disconnected before the previous context was released. */
+		if ((conn_ctx->next_conn == conn) &&
+		    ble_link_ctx_next_cancel(ctx_manager, conn_ctx)) {
 			k_mutex_unlock(ctx_manager->mutex);
 
 			return 0;
 		}
+
+		LOG_WRN("There is no allocated memory for this connection");
+		k_mutex_unlock(ctx_manager->mutex);
+
+		return -EINVAL;
 	}
 
-	LOG_WRN("There is no allocated memory for this connection");
+	/* New lookups fail from now on. The memory is released
+	 * when the last user releases the context.
+	 */
+	conn_ctx->conn = NULL;
+	ble_link_ctx_ref_put(ctx_manager, conn_ctx);
+
+	LOG_DBG("The context memory for the connection "
+		"has been released, conn %p index %u",
+		conn, id);
+
 	k_mutex_unlock(ctx_manager->mutex);
 
-	return  -EINVAL;
+	return 0;
 }
 
 void ble_link_ctx_manager_free_all(struct ble_link_ctx_manager *ctx_manager)
@@ -103,11 +189,11 @@ void ble_link_ctx_manager_free_all(struct ble_link_ctx_manager *ctx_manager)
 		struct ble_link_conn_ctx *conn_ctx =
 				&ctx_manager->conn_ctx[i];
 
-		if (conn_ctx->data != NULL) {
-			k_mem_slab_free(ctx_manager->mem_slab,
-					&conn_ctx->data);
+		ble_link_ctx_next_cancel(ctx_manager, conn_ctx);
+
+		if (conn_ctx->conn != NULL) {
 			conn_ctx->conn = NULL;
-			conn_ctx->data = NULL;
+			ble_link_ctx_ref_put(ctx_manager, conn_ctx);
 		}
 	}
 
@@ -122,24 +208,25 @@ void *ble_link_ctx_manager_get(struct ble_link_ctx_manager *ctx_manager,
 	__ASSERT_NO_MSG(conn != NULL);
 	__ASSERT_NO_MSG(ctx_manager != NULL);
 
-	k_mutex_lock(ctx_manager->mutex, K_FOREVER);
+	u8_t id = bt_conn_index(conn);
+	struct ble_link_conn_ctx *conn_ctx = &ctx_manager->conn_ctx[id];
 
-	for (size_t i = 0; i < CONFIG_BT_MAX_CONN; i++) {
-		struct ble_link_conn_ctx *conn_ctx =
-				&ctx_manager->conn_ctx[i];
-
-		if (conn_ctx->conn == conn) {
-			LOG_DBG("Memory block found for the connection");
+	__ASSERT_NO_MSG(id < ble_link_ctx_manager_get_ctx_num(ctx_manager));
 
-			return conn_ctx->data;
-		}
+	if (!ble_link_ctx_ref_get(conn_ctx)) {
+		LOG_WRN("No memory block for connection");
+		return NULL;
 	}
 
-	LOG_WRN("No memory block for connection");
+	if (conn_ctx->conn != conn) {
+		/* Freed in the meantime. */
+		ble_link_ctx_ref_put(ctx_manager, conn_ctx);
 
-	k_mutex_unlock(ctx_manager->mutex);
+		LOG_WRN("No memory block for connection");
+		return NULL;
+	}
 
-	return NULL;
+	return conn_ctx->data;
 }
 
 const struct ble_link_conn_ctx *ble_link_ctx_manager_context_get(struct ble_link_ctx_manager *ctx_manager,
@@ -148,36 +235,27 @@ const struct ble_link_conn_ctx *ble_link_ctx_manager_context_get(struct ble_link
 	__ASSERT_NO_MSG(ctx_manager != NULL);
 	__ASSERT_NO_MSG(id < ble_link_ctx_manager_get_ctx_num(ctx_manager));
 
-	k_mutex_lock(ctx_manager->mutex, K_FOREVER);
-
-	struct ble_link_conn_ctx *ctx =
+	struct ble_link_conn_ctx *conn_ctx =
 			&ctx_manager->conn_ctx[id];
 
-	if (ctx_manager->conn_ctx[id].conn != NULL) {
-		return ctx;
+	if (!ble_link_ctx_ref_get(conn_ctx)) {
+		return NULL;
 	}
 
-	k_mutex_unlock(ctx_manager->mutex);
+	if (conn_ctx->conn == NULL) {
+		ble_link_ctx_ref_put(ctx_manager, conn_ctx);
 
-	return NULL;
+		return NULL;
+	}
+
+	return conn_ctx;
 }
 
 void ble_link_ctx_manager_release(struct ble_link_ctx_manager *ctx_manager,
-				  void *ctx_data)
+				  u8_t id)
 {
 	__ASSERT_NO_MSG(ctx_manager != NULL);
-	__ASSERT_NO_MSG(ctx_data != NULL);
-
-	for (size_t i = 0; i < CONFIG_BT_MAX_CONN; i++) {
-		struct ble_link_conn_ctx *conn_ctx =
-				&ctx_manager->conn_ctx[i];
-
-		if (conn_ctx->data == ctx_data) {
-			k_mutex_unlock(ctx_manager->mutex);
-
-			return;
-		}
-	}
+	__ASSERT_NO_MSG(id < ble_link_ctx_manager_get_ctx_num(ctx_manager));
 
-	__ASSERT_NO_MSG(false);
+	ble_link_ctx_ref_put(ctx_manager, &ctx_manager->conn_ctx[id]);
 }
@@ -86,8 +86,21 @@ int hids_notify_connected(struct hids *hids_obj, struct bt_conn *conn)
 				hids_obj->outp_rep_group.reports[i].size;
 	}
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	/* Assign last notified and pending Input Report data. */
+	conn_data->inp_rep_sent = conn_data->feat_rep_ctx;
+
+	for (size_t i = 0; i < hids_obj->feat_rep_group.cnt; i++) {
+		conn_data->inp_rep_sent +=
+				hids_obj->feat_rep_group.reports[i].size;
+	}
+
+	conn_data->inp_rep_pending = conn_data->inp_rep_sent +
+		(conn_data->outp_rep_ctx - conn_data->inp_rep_ctx);
+#endif
+
 	ble_link_ctx_manager_release(hids_obj->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return 0;
 }
@@ -148,6 +161,8 @@ static ssize_t hids_protocol_mode_write(struct bt_conn *conn,
 	u8_t *cur_pm = &conn_data->pm_ctx_value;
 
 	if (offset + len > sizeof(u8_t)) {
+		ble_link_ctx_manager_release(hids_ctx->ctx_manager,
+					     bt_conn_index(conn));
 		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
 	}
 
@@ -163,13 +178,15 @@ static ssize_t hids_protocol_mode_write(struct bt_conn *conn,
 		}
 		break;
 	default:
+		ble_link_ctx_manager_release(hids_ctx->ctx_manager,
+					     bt_conn_index(conn));
 		return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
 	}
 
 	memcpy(cur_pm + offset, new_pm, len);
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return len;
 }
@@ -200,7 +217,7 @@ static ssize_t hids_protocol_mode_read(struct bt_conn *conn,
 				    protocol_mode, sizeof(*protocol_mode));
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return ret_len;
 }
@@ -250,7 +267,7 @@ static ssize_t hids_inp_rep_read(struct bt_conn *conn,
 				    rep_data, rep->size);
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return ret_len;
 }
@@ -302,7 +319,7 @@ static ssize_t hids_outp_rep_read(struct bt_conn *conn,
 				    rep->size);
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return ret_len;
 }
@@ -335,6 +352,8 @@ static ssize_t hids_outp_rep_write(struct bt_conn *conn,
 	rep_data = conn_data->outp_rep_ctx + rep->offset;
 
 	if (offset + len > rep->size) {
+		ble_link_ctx_manager_release(hids_ctx->ctx_manager,
+					     bt_conn_index(conn));
 		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
 	}
 	memcpy(rep_data + offset, buf, len);
@@ -348,7 +367,7 @@ static ssize_t hids_outp_rep_write(struct bt_conn *conn,
 	}
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return len;
 }
@@ -401,7 +420,7 @@ static ssize_t hids_feat_rep_read(struct bt_conn *conn,
 				     rep->size);
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return ret_len;
 }
@@ -434,6 +453,8 @@ static ssize_t hids_feat_rep_write(struct bt_conn *conn,
 	rep_data = conn_data->feat_rep_ctx + rep->offset;
 
 	if (offset + len > rep->size) {
+		ble_link_ctx_manager_release(hids_ctx->ctx_manager,
+					     bt_conn_index(conn));
 		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
 	}
 	memcpy(rep_data + offset, buf, len);
@@ -447,7 +468,7 @@ static ssize_t hids_feat_rep_write(struct bt_conn *conn,
 	}
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return len;
 }
@@ -521,7 +542,7 @@ static ssize_t hids_boot_mouse_inp_report_read(struct bt_conn *conn,
 				   rep_data,
 				   sizeof(conn_data->hids_boot_mouse_inp_rep_ctx));
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return ret_len;
 }
@@ -578,7 +599,7 @@ static ssize_t hids_boot_kb_inp_report_read(struct bt_conn *conn,
 				     rep_data,
 				     sizeof(conn_data->hids_boot_kb_inp_rep_ctx));
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return ret_len;
 }
@@ -637,7 +658,7 @@ static ssize_t hids_boot_kb_outp_report_read(struct bt_conn *conn,
 				    rep_data,
 				    sizeof(conn_data->hids_boot_kb_outp_rep_ctx));
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return ret_len;
 }
@@ -667,6 +688,8 @@ static ssize_t hids_boot_kb_outp_report_write(struct bt_conn *conn,
 	rep_data = conn_data->hids_boot_kb_outp_rep_ctx;
 
 	if (offset + len > sizeof(u8_t)) {
+		ble_link_ctx_manager_release(hids_ctx->ctx_manager,
+					     bt_conn_index(conn));
 		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
 	}
 	memcpy(rep_data + offset, buf, len);
@@ -681,7 +704,7 @@ static ssize_t hids_boot_kb_outp_report_write(struct bt_conn *conn,
 	}
 
 	ble_link_ctx_manager_release(hids_ctx->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return len;
 }
@@ -874,11 +897,58 @@ static void hids_feat_reports_register(struct hids *hids_obj,
 	}
 }
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+/* The notification complete callback carries only the connection,
+ * so the instance using the filtering is kept here.
+ */
+static struct hids *filter_hids_obj;
+
+static void inp_rep_work_handler(struct k_work *work);
+
+/* Link context size needed by the reports, see HIDS_INP_REP_FILTER_DEF. */
+static size_t
+inp_rep_filter_ctx_size_get(const struct hids_init_param *init_param)
+{
+	size_t size = sizeof(struct hids_conn_data);
+
+	for (size_t i = 0; i < init_param->inp_rep_group_init.cnt; i++) {
+		size += _BLE_HIDS_INP_REP_BUF_CNT *
+			init_param->inp_rep_group_init.reports[i].size;
+	}
+
+	for (size_t i = 0; i < init_param->outp_rep_group_init.cnt; i++) {
+		size += init_param->outp_rep_group_init.reports[i].size;
+	}
+
+	for (size_t i = 0; i < init_param->feat_rep_group_init.cnt; i++) {
+		size += init_param->feat_rep_group_init.reports[i].size;
+	}
+
+	return size;
+}
+#endif
 
 int hids_init(struct hids *hids_obj, const struct hids_init_param *init_param)
 {
 	LOG_DBG("Initializing HIDS.");
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	if (filter_hids_obj && (filter_hids_obj != hids_obj)) {
+		LOG_ERR("Input Report filtering used by another instance");
+		return -EALREADY;
+	}
+
+	if (inp_rep_filter_ctx_size_get(init_param) >
+	    ble_link_ctx_manager_get_block_size(hids_obj->ctx_manager)) {
+		LOG_ERR("Link context too small, use HIDS_INP_REP_FILTER_DEF");
+		return -ENOMEM;
+	}
+
+	filter_hids_obj = hids_obj;
+	k_work_init(&hids_obj->inp_rep_work, inp_rep_work_handler);
+	k_mutex_init(&hids_obj->inp_rep_mutex);
+#endif
+
 	hids_obj->pm.evt_handler = init_param->pm_evt_handler;
 	hids_obj->cp.evt_handler = init_param->cp_evt_handler;
 
@@ -1093,6 +1163,10 @@ int hids_uninit(struct hids *hids_obj)
 	/* Free all allocated memory. */
 	ble_link_ctx_manager_free_all(hids_obj->ctx_manager);
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	filter_hids_obj = NULL;
+#endif
+
 	/* Reset HIDS instance. */
 	memset(hids_obj, 0, sizeof(*hids_obj));
 	hids_obj->svc.attrs = attr_start;
@@ -1101,6 +1175,279 @@ int hids_uninit(struct hids *hids_obj)
 	return 0;
 }
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+/* The state of the notifications in progress and the pending bitmask are
+ * shared with the notification complete callback, called from the system
+ * workqueue. They are accessed with interrupts locked and the lock is never
+ * held while notifying. The inp_rep_mutex only serializes the senders, that
+ * is the application and the work item, to keep the notifications in the
+ * order of the queue. The callback never takes it, so it cannot block the
+ * work item running on the same workqueue.
+ */
+static void inp_rep_tx_complete(struct bt_conn *conn)
+{
+	struct hids *hids_obj = filter_hids_obj;
+	bt_gatt_notify_complete_func_t cb = NULL;
+	bool submit = false;
+	unsigned int key;
+
+	if (!hids_obj) {
+		return;
+	}
+
+	struct hids_conn_data *conn_data =
+			(struct hids_conn_data *)ble_link_ctx_manager_get(hids_obj->ctx_manager,
+									  conn);
+
+	if (!conn_data) {
+		/* Disconnected in the meantime. */
+		return;
+	}
+
+	key = irq_lock();
+
+	if (conn_data->inp_rep_tx_num > 0) {
+		struct hids_inp_rep_tx *tx =
+			&conn_data->inp_rep_tx[conn_data->inp_rep_tx_head];
+
+		conn_data->inp_rep_tx_head = (conn_data->inp_rep_tx_head + 1) %
+					     ARRAY_SIZE(conn_data->inp_rep_tx);
+		conn_data->inp_rep_tx_num--;
+		conn_data->inp_rep_tx_cnt[tx->rep_idx]--;
+		cb = tx->cb;
+
+		submit = (conn_data->inp_rep_pending_bm & BIT(tx->rep_idx)) &&
+			 !conn_data->inp_rep_tx_cnt[tx->rep_idx];
+	}
+
+	irq_unlock(key);
+
+	if (submit) {
+		/* Do not send from the Bluetooth stack context. */
+		k_work_submit(&hids_obj->inp_rep_work);
+	}
+
+	ble_link_ctx_manager_release(hids_obj->ctx_manager,
+				     bt_conn_index(conn));
+
+	if (cb) {
+		cb(conn);
+	}
+}
+
+static int inp_rep_tx(struct hids *hids_obj, struct bt_conn *conn,
+		      struct hids_conn_data *conn_data, u8_t rep_idx,
+		      u8_t const *rep, bt_gatt_notify_complete_func_t cb)
+{
+	struct hids_inp_rep *hids_inp_rep =
+		&hids_obj->inp_rep_group.reports[rep_idx];
+	unsigned int key;
+	size_t tail;
+
+	/* Queue the notification before sending it, as it can complete
+	 * before bt_gatt_notify_cb returns.
+	 */
+	key = irq_lock();
+
+	if (conn_data->inp_rep_tx_num >= ARRAY_SIZE(conn_data->inp_rep_tx)) {
+		irq_unlock(key);
+		return -ENOMEM;
+	}
+
+	tail = (conn_data->inp_rep_tx_head + conn_data->inp_rep_tx_num) %
+	       ARRAY_SIZE(conn_data->inp_rep_tx);
+
+	conn_data->inp_rep_tx[tail].rep_idx = rep_idx;
+	conn_data->inp_rep_tx[tail].cb = cb;
+	conn_data->inp_rep_tx_num++;
+	conn_data->inp_rep_tx_cnt[rep_idx]++;
+
+	irq_unlock(key);
+
+	int err = bt_gatt_notify_cb(conn,
+			&hids_obj->svc.attrs[hids_inp_rep->att_ind], rep,
+			hids_inp_rep->size, inp_rep_tx_complete);
+
+	if (err) {
+		/* The senders are serialized, so the notification is still
+		 * the last one in the queue.
+		 */
+		key = irq_lock();
+		conn_data->inp_rep_tx_num--;
+		conn_data->inp_rep_tx_cnt[rep_idx]--;
+		irq_unlock(key);
+
+		return err;
+	}
+
+	memcpy(conn_data->inp_rep_sent + hids_inp_rep->offset, rep,
+	       hids_inp_rep->size);
+	conn_data->inp_rep_sent_bm |= BIT(rep_idx);
+
+	return 0;
+}
+
+/* Hold the report back if its previous notification is in progress.
+ * The report must already be copied to the pending report buffer.
+ */
+static bool inp_rep_pending_set(struct hids_conn_data *conn_data,
+				u8_t rep_idx,
+				bt_gatt_notify_complete_func_t cb)
+{
+	unsigned int key = irq_lock();
+	bool in_progress = (conn_data->inp_rep_tx_cnt[rep_idx] > 0);
+
+	if (in_progress) {
+		conn_data->inp_rep_pending_cb[rep_idx] = cb;
+		conn_data->inp_rep_pending_bm |= BIT(rep_idx);
+	}
+
+	irq_unlock(key);
+
+	return in_progress;
+}
+
+static void inp_rep_pending_clear(struct hids_conn_data *conn_data,
+				  u8_t rep_idx)
+{
+	unsigned int key = irq_lock();
+
+	conn_data->inp_rep_pending_bm &= ~BIT(rep_idx);
+
+	irq_unlock(key);
+}
+
+static int inp_rep_filter_process(struct hids *hids_obj, struct bt_conn *conn,
+				  struct hids_conn_data *conn_data,
+				  struct hids_inp_rep *hids_inp_rep,
+				  u8_t const *rep,
+				  bt_gatt_notify_complete_func_t cb)
+{
+	u8_t rep_idx = hids_inp_rep->idx;
+	u8_t *sent = conn_data->inp_rep_sent + hids_inp_rep->offset;
+	u8_t *pending = conn_data->inp_rep_pending + hids_inp_rep->offset;
+	int err;
+
+	/* Only the senders modify the pending bit once it is set. */
+	if (conn_data->inp_rep_pending_bm & BIT(rep_idx)) {
+		if (hids_inp_rep->merge(pending, rep, hids_inp_rep->size)) {
+			return -EALREADY;
+		}
+
+		/* Reports cannot be merged, send the pending one first
+		 * to keep the order.
+		 */
+		inp_rep_pending_clear(conn_data, rep_idx);
+		err = inp_rep_tx(hids_obj, conn, conn_data, rep_idx, pending,
+				 conn_data->inp_rep_pending_cb[rep_idx]);
+		if (err) {
+			return err;
+		}
+	} else if (hids_inp_rep->drop_unchanged &&
+		   (conn_data->inp_rep_sent_bm & BIT(rep_idx)) &&
+		   !memcmp(sent, rep, hids_inp_rep->size)) {
+		return -EALREADY;
+	}
+
+	if (hids_inp_rep->merge) {
+		memcpy(pending, rep, hids_inp_rep->size);
+
+		if (inp_rep_pending_set(conn_data, rep_idx, cb)) {
+			return 0;
+		}
+	}
+
+	return inp_rep_tx(hids_obj, conn, conn_data, rep_idx, rep, cb);
+}
+
+static int inp_rep_filter_send(struct hids *hids_obj, struct bt_conn *conn,
+			       struct hids_conn_data *conn_data,
+			       struct hids_inp_rep *hids_inp_rep,
+			       u8_t const *rep,
+			       bt_gatt_notify_complete_func_t cb)
+{
+	k_mutex_lock(&hids_obj->inp_rep_mutex, K_FOREVER);
+
+	int err = inp_rep_filter_process(hids_obj, conn, conn_data,
+					 hids_inp_rep, rep, cb);
+
+	k_mutex_unlock(&hids_obj->inp_rep_mutex);
+
+	return err;
+}
+
+static void inp_rep_work_handler(struct k_work *work)
+{
+	struct hids *hids_obj = CONTAINER_OF(work, struct hids, inp_rep_work);
+	bool retry = false;
+
+	for (size_t i = 0; i < ble_link_ctx_manager_get_ctx_num(hids_obj->ctx_manager); i++) {
+		const struct ble_link_conn_ctx *conn_ctx =
+				ble_link_ctx_manager_context_get(hids_obj->ctx_manager, i);
+
+		if (!conn_ctx) {
+			continue;
+		}
+
+		struct hids_conn_data *conn_data =
+			(struct hids_conn_data *)conn_ctx->data;
+
+		k_mutex_lock(&hids_obj->inp_rep_mutex, K_FOREVER);
+
+		for (size_t j = 0; j < hids_obj->inp_rep_group.cnt; j++) {
+			struct hids_inp_rep *hids_inp_rep =
+				&hids_obj->inp_rep_group.reports[j];
+			unsigned int key = irq_lock();
+			bool send = (conn_data->inp_rep_pending_bm & BIT(j)) &&
+				    !conn_data->inp_rep_tx_cnt[j];
+
+			if (send) {
+				conn_data->inp_rep_pending_bm &= ~BIT(j);
+			}
+
+			irq_unlock(key);
+
+			if (!send) {
+				continue;
+			}
+
+			int err = inp_rep_tx(hids_obj, conn_ctx->conn,
+					     conn_data, j,
+					     conn_data->inp_rep_pending +
+					     hids_inp_rep->offset,
+					     conn_data->inp_rep_pending_cb[j]);
+			if ((err == -ENOMEM) || (err == -ENOBUFS)) {
+				/* Out of buffers, keep the merged report
+				 * pending. The senders are serialized, so it
+				 * was not changed in the meantime.
+				 */
+				key = irq_lock();
+				conn_data->inp_rep_pending_bm |= BIT(j);
+				irq_unlock(key);
+
+				retry = true;
+			} else if (err) {
+				LOG_WRN("Pending report %zu dropped (err %d)",
+					j, err);
+			}
+		}
+
+		k_mutex_unlock(&hids_obj->inp_rep_mutex);
+
+		ble_link_ctx_manager_release(hids_obj->ctx_manager,
+					     i);
+	}
+
+	if (retry) {
+		/* Sends from the system workqueue do not wait for buffers.
+		 * Try again after the queued work items, which include the
+		 * notification complete callbacks that free them.
+		 */
+		k_work_submit(&hids_obj->inp_rep_work);
+	}
+}
+#endif /* CONFIG_BT_GATT_HIDS_INP_REP_FILTER */
+
 static void store_input_report(struct hids_inp_rep *hids_inp_rep,
 			       u8_t *rep_data, u8_t const *rep,
 			       u8_t len)
@@ -1126,6 +1473,9 @@ static int inp_rep_notify_all(struct hids *hids_obj,
 {
 	struct hids_conn_data *conn_data;
 	u8_t *rep_data = NULL;
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	int ret = -ENODATA;
+#endif
 
 	for (size_t i = 0; i < ble_link_ctx_manager_get_ctx_num(hids_obj->ctx_manager); i++) {
 		const struct ble_link_conn_ctx *conn_ctx =
@@ -1141,13 +1491,27 @@ static int inp_rep_notify_all(struct hids *hids_obj,
 
 				store_input_report(hids_inp_rep, rep_data,
 						   rep, len);
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+				/* Reports are filtered per connection. */
+				int err = inp_rep_filter_send(hids_obj,
+							      conn_ctx->conn,
+							      conn_data,
+							      hids_inp_rep,
+							      rep, cb);
+				if (ret) {
+					ret = err;
+				}
+#endif
 			}
 
 			ble_link_ctx_manager_release(hids_obj->ctx_manager,
-						     (void *)conn_ctx->data);
+						     i);
 		}
 	}
 
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	return ret;
+#else
 	if (rep_data != NULL) {
 		return bt_gatt_notify_cb(NULL,
 			&hids_obj->svc.attrs[hids_inp_rep->att_ind],
@@ -1157,6 +1521,7 @@ static int inp_rep_notify_all(struct hids *hids_obj,
 	} else {
 		return -ENODATA;
 	}
+#endif
 }
 
 
@@ -1196,12 +1561,17 @@ int hids_inp_rep_send(struct hids *hids_obj, struct bt_conn *conn,
 	rep_data = conn_data->inp_rep_ctx + hids_inp_rep->offset;
 
 	store_input_report(hids_inp_rep, rep_data, rep, len);
+#if CONFIG_BT_GATT_HIDS_INP_REP_FILTER
+	int err = inp_rep_filter_send(hids_obj, conn, conn_data,
+				      hids_inp_rep, rep, cb);
+#else
 	int err = bt_gatt_notify_cb(conn,
 			&hids_obj->svc.attrs[hids_inp_rep->att_ind], rep,
 			hids_inp_rep->size, cb);
+#endif
 
 	ble_link_ctx_manager_release(hids_obj->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return err;
 }
@@ -1245,7 +1615,7 @@ static int boot_mouse_inp_report_notify_all(struct hids *hids_obj,
 			}
 
 			ble_link_ctx_manager_release(hids_obj->ctx_manager,
-						     (void *)conn_ctx->data);
+						     i);
 		}
 	}
 
@@ -1315,7 +1685,7 @@ int hids_boot_mouse_inp_rep_send(struct hids *hids_obj,
 	rep_data[2] = 0;
 
 	ble_link_ctx_manager_release(hids_obj->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return err;
 }
@@ -1349,7 +1719,7 @@ static int boot_kb_inp_notify_all(struct hids *hids_obj,
 			}
 
 			ble_link_ctx_manager_release(hids_obj->ctx_manager,
-						     (void *)conn_ctx->data);
+						     i);
 		}
 	}
 
@@ -1390,12 +1760,14 @@ int hids_boot_kb_inp_rep_send(struct hids *hids_obj,
 			(struct hids_conn_data *)ble_link_ctx_manager_get(hids_obj->ctx_manager,
 									  conn);
 
-	if (len > sizeof(conn_data->hids_boot_kb_inp_rep_ctx)) {
+	if (!conn_data) {
+		LOG_WRN("The context was not found");
 		return -EINVAL;
 	}
 
-	if (!conn_data) {
-		LOG_WRN("The context was not found");
+	if (len > sizeof(conn_data->hids_boot_kb_inp_rep_ctx)) {
+		ble_link_ctx_manager_release(hids_obj->ctx_manager,
+					     bt_conn_index(conn));
 		return -EINVAL;
 	}
 
@@ -1412,7 +1784,7 @@ int hids_boot_kb_inp_rep_send(struct hids *hids_obj,
 				 cb);
 
 	ble_link_ctx_manager_release(hids_obj->ctx_manager,
-				     (void *)conn_data);
+				     bt_conn_index(conn));
 
 	return err;
 }
@@ -8,23 +8,59 @@
  *  @brief Nordic UART Bridge Service (NUS) sample
  */
 
+#include <zephyr.h>
+#include <misc/util.h>
 #include <bluetooth/conn.h>
 #include <bluetooth/uuid.h>
 #include <bluetooth/gatt.h>
 
 #include <bluetooth/services/nus.h>
 
+/* ATT notification header: opcode and handle. */
+#define ATT_NOTIFY_HDR_LEN 3
+
 static struct bt_gatt_ccc_cfg nuslc_ccc_cfg[BT_GATT_CCC_MAX];
+/* Notifications are enabled by at least one peer. */
 static bool                   notify_enabled;
 
 static struct bt_nus_cb nus_cb;
 
+/* Stream transfer state of a connection. */
+struct nus_stream {
+	struct bt_conn *conn;
+	const u8_t *data;
+	size_t len;
+	size_t offset;
+	u8_t in_flight;
+	int err;
+	u32_t notifications;
+	u32_t start_time;
+	nus_stream_done_cb_t done_cb;
+};
+
+static struct nus_stream streams[CONFIG_BT_MAX_CONN];
+static struct k_work stream_work;
+
 static void nuslc_ccc_cfg_changed(const struct bt_gatt_attr *attr,
 				  u16_t value)
 {
 	notify_enabled = (value & BT_GATT_CCC_NOTIFY) ? true : false;
 }
 
+static bool nus_is_notification_enabled(struct bt_conn *conn)
+{
+	const bt_addr_le_t *conn_addr = bt_conn_get_dst(conn);
+
+	for (size_t i = 0; i < ARRAY_SIZE(nuslc_ccc_cfg); i++) {
+		if (!bt_addr_le_cmp(&nuslc_ccc_cfg[i].peer, conn_addr) &&
+		    (nuslc_ccc_cfg[i].value & BT_GATT_CCC_NOTIFY)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static ssize_t on_receive(struct bt_conn *conn,
 			  const struct bt_gatt_attr *attr,
 			  const void *buf,
@@ -69,6 +105,135 @@ static struct bt_gatt_attr attrs[] = {
 
 static struct bt_gatt_service nus_svc = BT_GATT_SERVICE(attrs);
 
+static void stream_finish(struct nus_stream *stream)
+{
+	struct nus_stream_stats stats = {
+		.bytes = stream->offset,
+		.notifications = stream->notifications,
+		.duration_ms = k_uptime_get_32() - stream->start_time,
+	};
+	struct bt_conn *conn = stream->conn;
+	nus_stream_done_cb_t done_cb = stream->done_cb;
+	int err = stream->err;
+
+	if (stats.duration_ms) {
+		stats.throughput_bps = ((u64_t)stats.bytes * 8 * MSEC_PER_SEC) /
+				       stats.duration_ms;
+	}
+
+	stream->conn = NULL;
+	stream->data = NULL;
+
+	if (done_cb) {
+		done_cb(conn, err, &stats);
+	}
+
+	bt_conn_unref(conn);
+}
+
+static void stream_sent(struct bt_conn *conn)
+{
+	struct nus_stream *stream = &streams[bt_conn_index(conn)];
+	unsigned int key = irq_lock();
+
+	/* Completions can still arrive after a disconnection. */
+	if ((stream->conn == conn) && stream->in_flight) {
+		stream->in_flight--;
+	}
+
+	irq_unlock(key);
+
+	/* Do not send from the Bluetooth stack context. */
+	k_work_submit(&stream_work);
+}
+
+static void stream_process(struct nus_stream *stream)
+{
+	while (!stream->err && (stream->offset < stream->len)) {
+		unsigned int key = irq_lock();
+
+		if (stream->in_flight >= CONFIG_BT_GATT_NUS_STREAM_TX_MAX) {
+			irq_unlock(key);
+			break;
+		}
+		stream->in_flight++;
+		irq_unlock(key);
+
+		u16_t mtu = bt_gatt_get_mtu(stream->conn);
+		size_t chunk = min(stream->len - stream->offset,
+				   (size_t)(mtu - ATT_NOTIFY_HDR_LEN));
+		int err;
+
+		/* The peer can disable notifications during the stream. */
+		if (!nus_is_notification_enabled(stream->conn)) {
+			err = -EFAULT;
+		} else {
+			err = bt_gatt_notify_cb(stream->conn, &attrs[2],
+						stream->data + stream->offset,
+						chunk, stream_sent);
+		}
+
+		if (err) {
+			key = irq_lock();
+			stream->in_flight--;
+			irq_unlock(key);
+
+			if ((err == -ENOMEM) || (err == -ENOBUFS)) {
+				/* Out of buffers, retry on next completion,
+				 * or after the other work items if none is in
+				 * progress. Sends from the system workqueue do
+				 * not wait for buffers.
+				 */
+				if (!stream->in_flight) {
+					k_work_submit(&stream_work);
+				}
+				break;
+			}
+			stream->err = err;
+			break;
+		}
+
+		stream->offset += chunk;
+		stream->notifications++;
+	}
+
+	if ((stream->err || (stream->offset == stream->len)) &&
+	    !stream->in_flight) {
+		stream_finish(stream);
+	}
+}
+
+static void stream_work_handler(struct k_work *work)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(streams); i++) {
+		if (streams[i].conn) {
+			stream_process(&streams[i]);
+		}
+	}
+}
+
+static void stream_disconnected(struct bt_conn *conn, u8_t reason)
+{
+	struct nus_stream *stream = &streams[bt_conn_index(conn)];
+
+	if (stream->conn != conn) {
+		return;
+	}
+
+	/* Notifications in progress are not completed. */
+	unsigned int key = irq_lock();
+
+	stream->err = -ENOTCONN;
+	stream->in_flight = 0;
+	irq_unlock(key);
+
+	k_work_submit(&stream_work);
+}
+
+static struct bt_conn_cb conn_callbacks = {
+	.disconnected = stream_disconnected,
+};
+
 int nus_init(struct bt_nus_cb *callbacks)
 {
 	if (callbacks) {
@@ -76,6 +241,9 @@ int nus_init(struct bt_nus_cb *callbacks)
 		nus_cb.sent_cb     = callbacks->sent_cb;
 	}
 
+	k_work_init(&stream_work, stream_work_handler);
+	bt_conn_cb_register(&conn_callbacks);
+
 	return bt_gatt_service_register(&nus_svc);
 }
 
@@ -88,3 +256,35 @@ int nus_send(const u8_t *data, uint16_t len)
 	return bt_gatt_notify(NULL, &attrs[2], data, len);
 }
 
+
+int nus_send_stream(struct bt_conn *conn, const u8_t *data, size_t len,
+		    nus_stream_done_cb_t done_cb)
+{
+	if (!conn || !data || !len) {
+		return -EINVAL;
+	}
+
+	if (!nus_is_notification_enabled(conn)) {
+		return -EFAULT;
+	}
+
+	struct nus_stream *stream = &streams[bt_conn_index(conn)];
+
+	if (stream->conn) {
+		return -EBUSY;
+	}
+
+	stream->data = data;
+	stream->len = len;
+	stream->offset = 0;
+	stream->in_flight = 0;
+	stream->err = 0;
+	stream->notifications = 0;
+	stream->done_cb = done_cb;
+	stream->start_time = k_uptime_get_32();
+	stream->conn = bt_conn_ref(conn);
+
+	k_work_submit(&stream_work);
+
+	return 0;
+}
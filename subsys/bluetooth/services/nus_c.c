@@ -21,6 +21,131 @@ enum {
 	NUS_C_RX_WRITE_PENDING
 };
 
+#if CONFIG_BT_GATT_NUS_C_TX_QUEUE
+/* Largest Write Without Response payload supported by the stack. */
+#define TX_CHUNK_MAX (CONFIG_BT_L2CAP_TX_MTU - 3)
+
+static K_THREAD_STACK_DEFINE(tx_queue_stack,
+			     CONFIG_BT_GATT_NUS_C_TX_STACK_SIZE);
+static struct k_work_q tx_work_q;
+static atomic_t tx_work_q_started;
+static u8_t tx_chunk[TX_CHUNK_MAX];
+
+static u16_t tx_queue_get(struct bt_gatt_nus_c_tx_queue *q, u8_t *data,
+			  u16_t len)
+{
+	u16_t size = 0;
+
+	k_mutex_lock(&q->lock, K_FOREVER);
+
+	len = min(len, q->count);
+	while (size < len) {
+		u16_t part = min(len - size, sizeof(q->buf) - q->tail);
+
+		memcpy(&data[size], &q->buf[q->tail], part);
+		q->tail = (q->tail + part) % sizeof(q->buf);
+		size += part;
+	}
+	q->count -= size;
+
+	k_mutex_unlock(&q->lock);
+
+	if (size) {
+		k_sem_give(&q->space);
+	}
+
+	return size;
+}
+
+static bool tx_queue_put(struct bt_gatt_nus_c_tx_queue *q, const u8_t *data,
+			 u16_t len)
+{
+	bool queued = false;
+
+	k_mutex_lock(&q->lock, K_FOREVER);
+
+	if (sizeof(q->buf) - q->count >= len) {
+		u16_t size = 0;
+
+		while (size < len) {
+			u16_t part = min(len - size,
+					 sizeof(q->buf) - q->head);
+
+			memcpy(&q->buf[q->head], &data[size], part);
+			q->head = (q->head + part) % sizeof(q->buf);
+			size += part;
+		}
+		q->count += len;
+		queued = true;
+	}
+
+	k_mutex_unlock(&q->lock);
+
+	return queued;
+}
+
+static void tx_queue_work_handler(struct k_work *work)
+{
+	struct bt_gatt_nus_c *nus_c;
+
+	/* Retrieve NUS Client module context. */
+	nus_c = CONTAINER_OF(work, struct bt_gatt_nus_c, tx_queue.work);
+
+	while (true) {
+		struct bt_conn *conn = nus_c->conn;
+		u16_t mtu = conn ? bt_gatt_get_mtu(conn) : 0;
+		u16_t len;
+		int err;
+
+		if (mtu <= 3) {
+			err = -ENOTCONN;
+		} else {
+			len = tx_queue_get(&nus_c->tx_queue, tx_chunk,
+					   min(mtu - 3, sizeof(tx_chunk)));
+			if (!len) {
+				break;
+			}
+
+			/* Blocks while all ACL TX buffers of the stack are
+			 * in use.
+			 */
+			err = bt_gatt_write_without_response(conn,
+							     nus_c->handles.rx,
+							     tx_chunk, len,
+							     false);
+		}
+
+		if (err) {
+			LOG_WRN("Queued write failed (err %d)", err);
+
+			/* Drop the data, it cannot be sent in order. */
+			while (tx_queue_get(&nus_c->tx_queue, tx_chunk,
+					    sizeof(tx_chunk))) {
+			}
+			break;
+		}
+	}
+}
+
+static void tx_queue_init(struct bt_gatt_nus_c *nus_c)
+{
+	struct bt_gatt_nus_c_tx_queue *q = &nus_c->tx_queue;
+
+	if (!atomic_set(&tx_work_q_started, true)) {
+		k_work_q_start(&tx_work_q, tx_queue_stack,
+			       K_THREAD_STACK_SIZEOF(tx_queue_stack),
+			       CONFIG_BT_GATT_NUS_C_TX_THREAD_PRIO);
+	}
+
+	q->head = 0;
+	q->tail = 0;
+	q->count = 0;
+	k_mutex_init(&q->lock);
+	k_sem_init(&q->space, 0, 1);
+	k_work_init(&q->work, tx_queue_work_handler);
+}
+#endif /* CONFIG_BT_GATT_NUS_C_TX_QUEUE */
+
 static u8_t on_received(struct bt_conn *conn,
 			struct bt_gatt_subscribe_params *params,
 			const void *data, u16_t length)
@@ -81,6 +206,10 @@ int bt_gatt_nus_c_init(struct bt_gatt_nus_c *nus_c,
 
 	memcpy(&nus_c->cbs, &nus_c_init->cbs, sizeof(nus_c->cbs));
 
+#if CONFIG_BT_GATT_NUS_C_TX_QUEUE
+	tx_queue_init(nus_c);
+#endif
+
 	return 0;
 }
 
@@ -107,6 +236,38 @@ int bt_gatt_nus_c_send(struct bt_gatt_nus_c *nus_c, const u8_t *data,
 	return err;
 }
 
+#if CONFIG_BT_GATT_NUS_C_TX_QUEUE
+int bt_gatt_nus_c_send_queued(struct bt_gatt_nus_c *nus_c, const u8_t *data,
+			      u16_t len, s32_t timeout)
+{
+	struct bt_gatt_nus_c_tx_queue *q = &nus_c->tx_queue;
+
+	if (!atomic_test_bit(&nus_c->state, NUS_C_INITIALIZED)) {
+		return -EINVAL;
+	}
+
+	if (len > sizeof(q->buf)) {
+		return -EINVAL;
+	}
+
+	if (!nus_c->conn) {
+		return -ENOTCONN;
+	}
+
+	while (!tx_queue_put(q, data, len)) {
+		k_work_submit_to_queue(&tx_work_q, &q->work);
+
+		if (k_sem_take(&q->space, timeout)) {
+			return -ENOMEM;
+		}
+	}
+
+	k_work_submit_to_queue(&tx_work_q, &q->work);
+
+	return 0;
+}
+#endif /* CONFIG_BT_GATT_NUS_C_TX_QUEUE */
+
 int bt_gatt_nus_c_handles_assign(struct bt_gatt_dm *dm,
 				 struct bt_gatt_nus_c *nus_c)
 {
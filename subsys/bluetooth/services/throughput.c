@@ -18,8 +18,25 @@
 
 #include <bluetooth/services/throughput.h>
 
+#define NOTIFY_LEN_MAX (CONFIG_BT_L2CAP_TX_MTU - 3)
+
 static struct metrics met;
 
+static struct {
+	struct k_work work;
+	struct bt_conn *conn;
+	u16_t len;
+	u32_t remaining;
+	u32_t end_time;
+	atomic_t in_flight;
+	u8_t time_head;
+	u8_t time_tail;
+	u32_t time[CONFIG_BT_GATT_THROUGHPUT_NOTIFY_TX_MAX];
+} notify;
+
+static const struct bt_gatt_attr *notify_attr;
+static struct bt_gatt_ccc_cfg ccc_cfg[BT_GATT_CCC_MAX];
+
 static ssize_t write_callback(struct bt_conn *conn,
 			      const struct bt_gatt_attr *attr, const void *buf,
 			      u16_t len, u16_t offset, u8_t flags)
@@ -62,29 +79,189 @@ static ssize_t read_callback(struct bt_conn *conn,
 			     u16_t len, u16_t offset)
 {
 	const struct metrics *metrics = attr->user_data;
-	len = min(sizeof(struct metrics), len);
 
-	printk("\n[local] received %u bytes (%u KB)"
-	       " in %u GATT writes at %u bps\n",
-	       metrics->write_len, metrics->write_len / 1024,
-	       metrics->write_count, metrics->write_rate);
+	if (!offset) {
+		printk("\n[local] received %u bytes (%u KB)"
+		       " in %u GATT writes at %u bps\n",
+		       metrics->write_len, metrics->write_len / 1024,
+		       metrics->write_count, metrics->write_rate);
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset,
+				 attr->user_data, sizeof(*metrics));
+}
+
+static void notify_stop(void)
+{
+	struct bt_conn *conn;
+	unsigned int key = irq_lock();
+
+	conn = notify.conn;
+	notify.conn = NULL;
+	notify.remaining = 0;
+
+	irq_unlock(key);
+
+	if (conn) {
+		bt_conn_unref(conn);
+	}
+}
+
+static void notify_sent(struct bt_conn *conn)
+{
+	u32_t now = k_cycle_get_32();
+	u32_t start;
+
+	if (!atomic_get(&notify.in_flight)) {
+		/* Completion after the transfer was aborted. */
+		return;
+	}
+
+	/* Notifications complete in the order they were queued. */
+	start = notify.time[notify.time_tail];
+	notify.time_tail = (notify.time_tail + 1) % ARRAY_SIZE(notify.time);
+
+	throughput_latency_add(&met.notify_latency,
+			       SYS_CLOCK_HW_CYCLES_TO_NS64(now - start) / 1000);
+
+	atomic_dec(&notify.in_flight);
+	k_work_submit(&notify.work);
+}
+
+static void notify_work_handler(struct k_work *work)
+{
+	static u8_t data[NOTIFY_LEN_MAX];
+
+	while (notify.remaining &&
+	       (atomic_get(&notify.in_flight) <
+		CONFIG_BT_GATT_THROUGHPUT_NOTIFY_TX_MAX)) {
+		struct bt_conn *conn = notify.conn;
+		u16_t len;
+		int err;
+
+		if (!conn) {
+			break;
+		}
+
+		if ((s32_t)(k_uptime_get_32() - notify.end_time) >= 0) {
+			notify_stop();
+			break;
+		}
+
+		len = min(notify.len, bt_gatt_get_mtu(conn) - 3);
+
+		notify.time[notify.time_head] = k_cycle_get_32();
+		atomic_inc(&notify.in_flight);
 
-	return bt_gatt_attr_read(
-		conn, attr, buf, len, offset, attr->user_data, len);
+		err = bt_gatt_notify_cb(conn, notify_attr, data, len,
+					notify_sent);
+		if (err) {
+			atomic_dec(&notify.in_flight);
+			if (err != -ENOMEM) {
+				printk("Notification failed (err %d)\n", err);
+				notify_stop();
+			}
+			/* Retry on the next completion. */
+			break;
+		}
+
+		notify.time_head = (notify.time_head + 1) %
+				   ARRAY_SIZE(notify.time);
+		notify.remaining--;
+		met.notify_count++;
+		met.notify_len += len;
+	}
+
+	if (!notify.remaining && !atomic_get(&notify.in_flight)) {
+		notify_stop();
+	}
+}
+
+static ssize_t ctrl_write_callback(struct bt_conn *conn,
+				   const struct bt_gatt_attr *attr,
+				   const void *buf, u16_t len, u16_t offset,
+				   u8_t flags)
+{
+	struct throughput_ctrl ctrl;
+
+	if (offset) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(ctrl)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	memcpy(&ctrl, buf, sizeof(ctrl));
+
+	switch (ctrl.op) {
+	case THROUGHPUT_CTRL_RESET:
+		met.notify_count = 0;
+		met.notify_len = 0;
+		throughput_latency_reset(&met.notify_latency);
+		break;
+
+	case THROUGHPUT_CTRL_NOTIFY:
+		if (notify.conn || atomic_get(&notify.in_flight)) {
+			return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+		}
+
+		if (!ctrl.len || (ctrl.len > NOTIFY_LEN_MAX)) {
+			return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+		}
+
+		notify.conn = bt_conn_ref(conn);
+		notify.len = ctrl.len;
+		notify.remaining = ctrl.count;
+		notify.end_time = k_uptime_get_32() + ctrl.duration_ms;
+		notify.time_head = 0;
+		notify.time_tail = 0;
+		k_work_submit(&notify.work);
+		break;
+
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+	}
+
+	return len;
 }
 
+static void disconnected(struct bt_conn *conn, u8_t reason)
+{
+	if (conn == notify.conn) {
+		/* Pending notifications are not completed. */
+		atomic_set(&notify.in_flight, 0);
+		notify_stop();
+	}
+}
+
+static struct bt_conn_cb conn_callbacks = {
+	.disconnected = disconnected,
+};
+
 /* Throughput service declaration */
 static struct bt_gatt_attr attrs[] = {
 	BT_GATT_PRIMARY_SERVICE(BT_UUID_THROUGHPUT),
 	BT_GATT_CHARACTERISTIC(BT_UUID_THROUGHPUT_CHAR,
-		BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+		BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+		BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_NOTIFY,
 		BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
 		read_callback, write_callback, &met),
+	BT_GATT_CCC(ccc_cfg, NULL),
+	BT_GATT_CHARACTERISTIC(BT_UUID_THROUGHPUT_CTRL,
+		BT_GATT_CHRC_WRITE,
+		BT_GATT_PERM_WRITE,
+		NULL, ctrl_write_callback, NULL),
 };
 
 static struct bt_gatt_service throughput_svc = BT_GATT_SERVICE(attrs);
 
 void throughput_init(void)
 {
+	throughput_latency_reset(&met.notify_latency);
+	k_work_init(&notify.work, notify_work_handler);
+	notify_attr = &attrs[2];
+	bt_conn_cb_register(&conn_callbacks);
+
 	bt_gatt_service_register(&throughput_svc);
 }
@@ -3,8 +3,10 @@
  *
  * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
  */
+#include <atomic.h>
 #include <errno.h>
 #include <irq.h>
+#include <kernel.h>
 #include <misc/byteorder.h>
 #include <nrf.h>
 #include <nrf_common.h>
@@ -12,6 +14,9 @@
 #include <stddef.h>
 #include <string.h>
 
+#include "nrf_esb_hal_priv.h"
+#include "nrf_esb_hop_priv.h"
+
 /* Constants */
 
 /* 2 Mb RX wait for acknowledgment time-out value.
@@ -120,26 +125,80 @@ struct pipe_info {
 	bool ack_payload; /* State of the transmission of ACK payloads. */
 };
 
-/* First-in, first-out queue of payloads to be transmitted. */
-struct payload_tx_fifo {
+/* Entry of the payload queues.
+ *
+ * The radio receives packets directly into the entry, and sends ACK
+ * payloads directly from it. The packet header (length and S1 fields)
+ * overlaps the noack and pid fields of the payload, so that the data field
+ * lines up with the packet data. A received packet header is converted to
+ * these fields once the packet has been received. The padding places the
+ * packet header on a word boundary.
+ */
+struct fifo_entry {
+	u8_t pad;
+	struct nrf_esb_payload payload;
+} __aligned(4);
+
+BUILD_ASSERT(offsetof(struct fifo_entry, payload.noack) % 4 == 0);
+BUILD_ASSERT(offsetof(struct nrf_esb_payload, pid) ==
+	     offsetof(struct nrf_esb_payload, noack) + 1);
+BUILD_ASSERT(offsetof(struct nrf_esb_payload, data) ==
+	     offsetof(struct nrf_esb_payload, noack) + 2);
+
+/* First-in, first-out queue of received payloads.
+ *
+ * The queue is filled by the radio interrupt and emptied by the
+ * application. See fifo_index_next() for how the indices are used.
+ */
+struct payload_rx_fifo {
 	 /* Payload queue */
-	struct nrf_esb_payload *payload[CONFIG_NRF_ESB_TX_FIFO_SIZE];
+	struct fifo_entry entry[CONFIG_NRF_ESB_RX_FIFO_SIZE];
 
-	u32_t back;	/* Back of the queue (last in). */
-	u32_t front;	/* Front of queue (first out). */
-	u32_t count;	/* Number of elements in the queue. */
+	atomic_t back;	/* Back of the queue (last in). */
+	atomic_t front;	/* Front of queue (first out). */
 };
 
-/* First-in, first-out queue of received payloads. */
-struct payload_rx_fifo {
+/* First-in, first-out queue of payloads to be transmitted.
+ *
+ * The queue is filled by the application and emptied by the radio
+ * interrupt. See fifo_index_next() for how the indices are used.
+ *
+ * With CONFIG_NRF_ESB_ACK_QUEUE, the entries are allocated separately from
+ * the queue, so that an ACK payload can be freed as soon as it is sent,
+ * whatever the position of the other payloads. The queue then holds the
+ * numbers of the entries in the order the payloads were written.
+ */
+struct payload_tx_fifo {
 	 /* Payload queue */
-	struct nrf_esb_payload *payload[CONFIG_NRF_ESB_RX_FIFO_SIZE];
+	struct fifo_entry entry[CONFIG_NRF_ESB_TX_FIFO_SIZE];
+#if CONFIG_NRF_ESB_ACK_QUEUE
+	u8_t order[CONFIG_NRF_ESB_TX_FIFO_SIZE];	/* Queued entries. */
+	atomic_t used;		/* Allocated entries, one bit each. */
+	u8_t next;		/* Entry to allocate first. */
+	bool back_reserved;	/* Entry allocated for the back index. */
+#endif
 
-	u32_t back;	/* Back of the queue (last in). */
-	u32_t front;	/* Front of queue (first out). */
-	u32_t count;	/* Number of elements in the queue. */
+	atomic_t back;	/* Back of the queue (last in). */
+	atomic_t front;	/* Front of queue (first out). */
 };
 
+#if CONFIG_NRF_ESB_ACK_QUEUE
+/* Queue of the ACK payloads of one pipe.
+ *
+ * The payloads stay in their TX FIFO entries. The queue holds the entries
+ * of the payloads for its pipe, in the order they were written. It can hold
+ * all entries of the TX FIFO, so it is never full. The queues are only
+ * accessed by the radio interrupt, or with interrupts locked.
+ */
+struct ack_queue {
+	u8_t entry[CONFIG_NRF_ESB_TX_FIFO_SIZE];	/* TX FIFO entries. */
+	u8_t front;	/* Position of the oldest entry. */
+	u8_t count;	/* Number of queued entries. */
+};
+
+BUILD_ASSERT(CONFIG_NRF_ESB_TX_FIFO_SIZE <= 32);
+#endif /* CONFIG_NRF_ESB_ACK_QUEUE */
+
 /* Enhanced ShockBurst address.
  *
  * Enhanced ShockBurst addresses consist of a base address and a prefix
@@ -182,15 +241,26 @@ static struct nrf_esb_payload *current_payload;
 /* FIFOs and buffers */
 static struct payload_tx_fifo tx_fifo;
 static struct payload_rx_fifo rx_fifo;
+#if CONFIG_NRF_ESB_ACK_QUEUE
+static struct ack_queue ack_queues[CONFIG_NRF_ESB_PIPE_COUNT];
+/* Order in which the TX FIFO entries were added to the ACK queues. */
+static u32_t ack_entry_seq[CONFIG_NRF_ESB_TX_FIFO_SIZE];
+static u32_t ack_seq;
+#endif
 static u8_t tx_payload_buffer[CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH + 2];
+/* Used for reception when the RX FIFO is full. */
 static u8_t rx_payload_buffer[CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH + 2];
+/* Buffer the radio receives the next packet into. */
+static u8_t *rx_radio_buffer = rx_payload_buffer;
 
 /* Run time variables */
 static u8_t pids[CONFIG_NRF_ESB_PIPE_COUNT];
 static struct pipe_info rx_pipe_info[CONFIG_NRF_ESB_PIPE_COUNT];
 static volatile u32_t interrupt_flags;
 static volatile u32_t retransmits_remaining;
+static volatile u32_t retransmit_budget;
 static volatile u32_t last_tx_attempts;
+static u32_t tx_start_cycles;
 static volatile u32_t wait_for_ack_timeout_us;
 
 static u32_t radio_shorts_common = RADIO_SHORTS_COMMON;
@@ -448,54 +518,396 @@ static bool update_radio_parameters(void)
 	return params_valid;
 }
 
-static void reset_fifos(void)
+/* Advance a FIFO index.
+ *
+ * The FIFO indices wrap at twice the FIFO size, which distinguishes a full
+ * FIFO from an empty one without an element counter. This way, the back index
+ * is only written by the producer and the front index only by the consumer,
+ * so the radio interrupt and the application can share the FIFOs without
+ * locking. The producer fills the back entry before it publishes the new
+ * back index, and the consumer is done with the front entry before it
+ * publishes the new front index.
+ */
+static u32_t fifo_index_next(u32_t index, u32_t size)
 {
-	tx_fifo.back = 0;
-	tx_fifo.front = 0;
-	tx_fifo.count = 0;
+	return (index + 1 < 2 * size) ? (index + 1) : 0;
+}
 
-	rx_fifo.back = 0;
-	rx_fifo.front = 0;
-	rx_fifo.count = 0;
+/* Get the FIFO entry of a FIFO index. */
+static u32_t fifo_index_entry(u32_t index, u32_t size)
+{
+	return (index < size) ? index : (index - size);
 }
 
-static void initialize_fifos(void)
+static u32_t fifo_index_count(u32_t back, u32_t front, u32_t size)
 {
-	static struct nrf_esb_payload rx_payload[CONFIG_NRF_ESB_RX_FIFO_SIZE];
-	static struct nrf_esb_payload tx_payload[CONFIG_NRF_ESB_TX_FIFO_SIZE];
+	if (back >= front) {
+		return back - front;
+	}
 
-	reset_fifos();
+	return back + 2 * size - front;
+}
+
+static u32_t fifo_count(const atomic_t *back, const atomic_t *front,
+			u32_t size)
+{
+	return fifo_index_count(atomic_get(back), atomic_get(front), size);
+}
+
+static u32_t tx_fifo_count(void)
+{
+	return fifo_count(&tx_fifo.back, &tx_fifo.front,
+			  CONFIG_NRF_ESB_TX_FIFO_SIZE);
+}
+
+#if CONFIG_NRF_ESB_ACK_QUEUE
+/* Get the entry of the payload at a TX FIFO index. */
+static u32_t tx_fifo_entry(u32_t index)
+{
+	return tx_fifo.order[fifo_index_entry(index,
+					      CONFIG_NRF_ESB_TX_FIFO_SIZE)];
+}
+
+/* Allocate a TX FIFO entry.
+ *
+ * Entries are only allocated by the application and only freed by the radio
+ * interrupt, so a free entry stays free until it is allocated. The search
+ * starts after the last allocated entry, so that a freed entry is not reused
+ * right away.
+ */
+static int tx_entry_alloc(void)
+{
+	u32_t used = atomic_get(&tx_fifo.used);
+
+	for (u32_t i = 0; i < CONFIG_NRF_ESB_TX_FIFO_SIZE; i++) {
+		u32_t entry = (tx_fifo.next + i) % CONFIG_NRF_ESB_TX_FIFO_SIZE;
+
+		if (!(used & BIT(entry))) {
+			atomic_set_bit(&tx_fifo.used, entry);
+			tx_fifo.next = (entry + 1) % CONFIG_NRF_ESB_TX_FIFO_SIZE;
+			return entry;
+		}
+	}
+
+	return -ENOMEM;
+}
+
+static void tx_entry_free(u32_t entry)
+{
+	atomic_clear_bit(&tx_fifo.used, entry);
+}
+
+/* Get the payload to write at a TX FIFO index that is not queued yet, or
+ * NULL if the TX FIFO is full. The entry at the back index stays reserved
+ * until it is queued, so that the same payload is provided again.
+ */
+static struct nrf_esb_payload *tx_fifo_reserve(u32_t index)
+{
+	bool back = (index == atomic_get(&tx_fifo.back));
+	int entry;
+
+	if (!back || !tx_fifo.back_reserved) {
+		entry = tx_entry_alloc();
+		if (entry < 0) {
+			return NULL;
+		}
+
+		tx_fifo.order[fifo_index_entry(index,
+				CONFIG_NRF_ESB_TX_FIFO_SIZE)] = entry;
+		if (back) {
+			tx_fifo.back_reserved = true;
+		}
+	}
+
+	return &tx_fifo.entry[tx_fifo_entry(index)].payload;
+}
+
+/* Queue the payloads written before a TX FIFO index. */
+static void tx_fifo_push(u32_t back)
+{
+	tx_fifo.back_reserved = false;
+	atomic_set(&tx_fifo.back, back);
+}
+
+static void tx_fifo_pop(void)
+{
+	u32_t front = atomic_get(&tx_fifo.front);
+	u32_t entry = tx_fifo_entry(front);
+
+	atomic_set(&tx_fifo.front,
+		   fifo_index_next(front, CONFIG_NRF_ESB_TX_FIFO_SIZE));
+	tx_entry_free(entry);
+}
+#else
+static u32_t tx_fifo_entry(u32_t index)
+{
+	return fifo_index_entry(index, CONFIG_NRF_ESB_TX_FIFO_SIZE);
+}
+
+/* Get the payload to write at a TX FIFO index that is not queued yet, or
+ * NULL if the TX FIFO is full.
+ */
+static struct nrf_esb_payload *tx_fifo_reserve(u32_t index)
+{
+	if (fifo_index_count(index, atomic_get(&tx_fifo.front),
+			     CONFIG_NRF_ESB_TX_FIFO_SIZE) >=
+	    CONFIG_NRF_ESB_TX_FIFO_SIZE) {
+		return NULL;
+	}
+
+	return &tx_fifo.entry[tx_fifo_entry(index)].payload;
+}
+
+/* Queue the payloads written before a TX FIFO index. */
+static void tx_fifo_push(u32_t back)
+{
+	atomic_set(&tx_fifo.back, back);
+}
+
+static void tx_fifo_pop(void)
+{
+	u32_t front = atomic_get(&tx_fifo.front);
+
+	atomic_set(&tx_fifo.front,
+		   fifo_index_next(front, CONFIG_NRF_ESB_TX_FIFO_SIZE));
+}
+#endif /* CONFIG_NRF_ESB_ACK_QUEUE */
+
+static struct nrf_esb_payload *tx_fifo_front(void)
+{
+	u32_t front = atomic_get(&tx_fifo.front);
+
+	return &tx_fifo.entry[tx_fifo_entry(front)].payload;
+}
+
+static u32_t rx_fifo_count(void)
+{
+	return fifo_count(&rx_fifo.back, &rx_fifo.front,
+			  CONFIG_NRF_ESB_RX_FIFO_SIZE);
+}
+
+static struct fifo_entry *rx_fifo_front(void)
+{
+	u32_t front = atomic_get(&rx_fifo.front);
+
+	return &rx_fifo.entry[fifo_index_entry(front,
+					CONFIG_NRF_ESB_RX_FIFO_SIZE)];
+}
+
+static struct fifo_entry *rx_fifo_back(void)
+{
+	u32_t back = atomic_get(&rx_fifo.back);
+
+	return &rx_fifo.entry[fifo_index_entry(back,
+					CONFIG_NRF_ESB_RX_FIFO_SIZE)];
+}
+
+static void rx_fifo_push(void)
+{
+	u32_t back = atomic_get(&rx_fifo.back);
+
+	atomic_set(&rx_fifo.back,
+		   fifo_index_next(back, CONFIG_NRF_ESB_RX_FIFO_SIZE));
+}
+
+static void rx_fifo_pop(void)
+{
+	u32_t front = atomic_get(&rx_fifo.front);
+
+	atomic_set(&rx_fifo.front,
+		   fifo_index_next(front, CONFIG_NRF_ESB_RX_FIFO_SIZE));
+}
+
+#if CONFIG_NRF_ESB_ACK_QUEUE
+/* Move the payloads written to the TX FIFO since the last call to the queues
+ * of their pipes. Their entries stay allocated until they are sent.
+ */
+static void ack_queues_fill(void)
+{
+	u32_t front = atomic_get(&tx_fifo.front);
+	u32_t back = atomic_get(&tx_fifo.back);
+
+	while (front != back) {
+		u32_t entry = tx_fifo_entry(front);
+		struct ack_queue *queue =
+			&ack_queues[tx_fifo.entry[entry].payload.pipe];
+
+		queue->entry[(queue->front + queue->count) %
+			     CONFIG_NRF_ESB_TX_FIFO_SIZE] = entry;
+		queue->count++;
+		ack_entry_seq[entry] = ack_seq++;
+
+		front = fifo_index_next(front, CONFIG_NRF_ESB_TX_FIFO_SIZE);
+	}
+
+	atomic_set(&tx_fifo.front, front);
+}
+
+static struct nrf_esb_payload *ack_payload_front(u8_t pipe)
+{
+	struct ack_queue *queue = &ack_queues[pipe];
+
+	ack_queues_fill();
+
+	if (queue->count == 0) {
+		return NULL;
+	}
+
+	return &tx_fifo.entry[queue->entry[queue->front]].payload;
+}
+
+/* Remove the sent payload of a pipe. Its entry is freed right away, whatever
+ * the payloads queued for the other pipes.
+ */
+static void ack_payload_pop(u8_t pipe)
+{
+	struct ack_queue *queue = &ack_queues[pipe];
+	u32_t entry = queue->entry[queue->front];
+
+	queue->front = (queue->front + 1) % CONFIG_NRF_ESB_TX_FIFO_SIZE;
+	queue->count--;
+
+	tx_entry_free(entry);
+}
+
+/* Remove the oldest payload, with interrupts locked. */
+static bool ack_tx_fifo_pop(void)
+{
+	struct ack_queue *oldest = NULL;
+
+	if (esb_cfg.mode != NRF_ESB_MODE_PRX) {
+		if (tx_fifo_count() == 0) {
+			return false;
+		}
+
+		tx_fifo_pop();
+		return true;
+	}
+
+	ack_queues_fill();
+
+	for (size_t i = 0; i < ARRAY_SIZE(ack_queues); i++) {
+		struct ack_queue *queue = &ack_queues[i];
+
+		if (queue->count == 0) {
+			continue;
+		}
+
+		if (!oldest ||
+		    ((s32_t)(ack_entry_seq[queue->entry[queue->front]] -
+			     ack_entry_seq[oldest->entry[oldest->front]]) < 0)) {
+			oldest = queue;
+		}
+	}
+
+	if (!oldest) {
+		return false;
+	}
 
-	for (size_t i = 0; i < CONFIG_NRF_ESB_TX_FIFO_SIZE; i++) {
-		tx_fifo.payload[i] = &tx_payload[i];
+	ack_payload_pop(oldest - ack_queues);
+
+	return true;
+}
+
+/* Empty the ACK queues and free all TX FIFO entries, except the one reserved
+ * for the next payload. An ACK payload that the radio may still be sending
+ * is not overwritten right away, because entries are allocated in turn.
+ */
+static void ack_queues_reset(void)
+{
+	u32_t back = atomic_get(&tx_fifo.back);
+
+	for (size_t i = 0; i < ARRAY_SIZE(ack_queues); i++) {
+		ack_queues[i].front = 0;
+		ack_queues[i].count = 0;
 	}
 
-	for (size_t i = 0; i < CONFIG_NRF_ESB_RX_FIFO_SIZE; i++) {
-		rx_fifo.payload[i] = &rx_payload[i];
+	atomic_set(&tx_fifo.used,
+		   tx_fifo.back_reserved ? BIT(tx_fifo_entry(back)) : 0);
+}
+
+static void tx_entries_reset(void)
+{
+	tx_fifo.back_reserved = false;
+	tx_fifo.next = 0;
+	ack_queues_reset();
+}
+#else
+static struct nrf_esb_payload *ack_payload_front(u8_t pipe)
+{
+	if ((tx_fifo_count() > 0) && (tx_fifo_front()->pipe == pipe)) {
+		return tx_fifo_front();
 	}
+
+	return NULL;
+}
+
+static void ack_payload_pop(u8_t pipe)
+{
+	tx_fifo_pop();
+}
+
+static bool ack_tx_fifo_pop(void)
+{
+	if (tx_fifo_count() == 0) {
+		return false;
+	}
+
+	tx_fifo_pop();
+
+	return true;
+}
+
+static inline void ack_queues_reset(void) {}
+static inline void tx_entries_reset(void) {}
+#endif /* CONFIG_NRF_ESB_ACK_QUEUE */
+
+static void reset_fifos(void)
+{
+	atomic_set(&tx_fifo.back, 0);
+	atomic_set(&tx_fifo.front, 0);
+	tx_entries_reset();
+
+	atomic_set(&rx_fifo.back, 0);
+	atomic_set(&rx_fifo.front, 0);
 }
 
 static void tx_fifo_remove_last(void)
 {
-	if (tx_fifo.count == 0) {
+	if (tx_fifo_count() == 0) {
 		return;
 	}
 
-	u32_t key = irq_lock();
+	tx_fifo_pop();
+}
 
-	tx_fifo.count--;
-	if (++tx_fifo.front >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
-		tx_fifo.front = 0;
+static u8_t *fifo_entry_rfbuf(struct fifo_entry *entry)
+{
+	return &entry->payload.noack;
+}
+
+/*  Function to point the radio to the buffer for the next received packet.
+ *
+ *  The radio receives directly into the back of the RX FIFO. If the RX FIFO
+ *  is full, the packet is received into rx_payload_buffer instead.
+ */
+static void rx_radio_buffer_set(void)
+{
+	if (rx_fifo_count() < CONFIG_NRF_ESB_RX_FIFO_SIZE) {
+		rx_radio_buffer = fifo_entry_rfbuf(rx_fifo_back());
+	} else {
+		rx_radio_buffer = rx_payload_buffer;
 	}
 
-	irq_unlock(key);
+	NRF_RADIO->PACKETPTR = (u32_t)rx_radio_buffer;
 }
 
-/*  Function to push the content of the rx_buffer to the RX FIFO.
+/*  Function to push the packet in rx_radio_buffer to the RX FIFO.
  *
- *  The module will point the register NRF_RADIO->PACKETPTR to a buffer for
- *  receiving packets. After receiving a packet the module will call this
- *  function to copy the received data to the RX FIFO.
+ *  The packet is normally received directly into the back of the RX FIFO,
+ *  in which case only the packet header is converted in place. It is copied
+ *  only if it was received into another buffer, for example because the RX
+ *  FIFO was full when the reception started.
  *
  *  @param  pipe Pipe number to set for the packet.
  *  @param  pid  Packet ID.
@@ -505,34 +917,43 @@ static void tx_fifo_remove_last(void)
  */
 static bool rx_fifo_push_rfbuf(u8_t pipe, u8_t pid)
 {
-	if (rx_fifo.count >= CONFIG_NRF_ESB_RX_FIFO_SIZE) {
+	struct nrf_esb_payload *payload;
+	u8_t *rfbuf;
+	u8_t length;
+	u8_t s1;
+
+	if (rx_fifo_count() >= CONFIG_NRF_ESB_RX_FIFO_SIZE) {
 		return false;
 	}
 
+	payload = &rx_fifo_back()->payload;
+	rfbuf = fifo_entry_rfbuf(rx_fifo_back());
+
 	if (esb_cfg.protocol == NRF_ESB_PROTOCOL_ESB_DPL) {
-		if (rx_payload_buffer[0] > CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH) {
+		if (rx_radio_buffer[0] > CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH) {
 			return false;
 		}
-		rx_fifo.payload[rx_fifo.back]->length = rx_payload_buffer[0];
+		length = rx_radio_buffer[0];
 	} else if (esb_cfg.mode == NRF_ESB_MODE_PTX) {
 		/* Received packet is an acknowledgment */
-		rx_fifo.payload[rx_fifo.back]->length = 0;
+		length = 0;
 	} else {
-		rx_fifo.payload[rx_fifo.back]->length = esb_cfg.payload_length;
+		length = esb_cfg.payload_length;
 	}
 
-	memcpy(rx_fifo.payload[rx_fifo.back]->data, &rx_payload_buffer[2],
-	       rx_fifo.payload[rx_fifo.back]->length);
+	if (rx_radio_buffer != rfbuf) {
+		memcpy(rfbuf, rx_radio_buffer, length + 2);
+	}
 
-	rx_fifo.payload[rx_fifo.back]->pipe = pipe;
-	rx_fifo.payload[rx_fifo.back]->rssi = NRF_RADIO->RSSISAMPLE;
-	rx_fifo.payload[rx_fifo.back]->pid = pid;
-	rx_fifo.payload[rx_fifo.back]->noack = !(rx_payload_buffer[1] & 0x01);
+	s1 = rfbuf[1];
 
-	if (++rx_fifo.back >= CONFIG_NRF_ESB_RX_FIFO_SIZE) {
-		rx_fifo.back = 0;
-	}
-	rx_fifo.count++;
+	payload->length = length;
+	payload->pipe = pipe;
+	payload->rssi = NRF_RADIO->RSSISAMPLE;
+	payload->pid = pid;
+	payload->noack = !(s1 & 0x01);
+
+	rx_fifo_push();
 
 	return true;
 }
@@ -569,13 +990,223 @@ static void ppi_init(void)
 		(u32_t)&NRF_RADIO->TASKS_TXEN;
 }
 
+#if CONFIG_NRF_ESB_STATS
+/* RSSI moving averages, in 1/16 of the RSSI unit. */
+static u16_t rssi_avg[CONFIG_NRF_ESB_PIPE_COUNT];
+static struct nrf_esb_stats stats;
+
+static void stats_rssi_update(u8_t pipe)
+{
+	u16_t sample = NRF_RADIO->RSSISAMPLE << 4;
+
+	if (!stats.pipe[pipe].rssi_samples++) {
+		rssi_avg[pipe] = sample;
+	} else {
+		/* Exponential moving average with a weight of 1/8 for the
+		 * new sample.
+		 */
+		rssi_avg[pipe] = rssi_avg[pipe] -
+				 (rssi_avg[pipe] >> 3) + (sample >> 3);
+	}
+
+	stats.pipe[pipe].rssi_avg = (rssi_avg[pipe] + 8) >> 4;
+}
+
+static void stats_tx_acked(u8_t pipe, u32_t attempts)
+{
+	struct nrf_esb_pipe_stats *pipe_stats = &stats.pipe[pipe];
+	u32_t rtt_us = SYS_CLOCK_HW_CYCLES_TO_NS64(k_cycle_get_32() -
+						   tx_start_cycles) / 1000;
+
+	pipe_stats->tx_success++;
+	pipe_stats->tx_attempts[min(attempts,
+				    NRF_ESB_STATS_ATTEMPTS_BUCKETS) - 1]++;
+	pipe_stats->ack_rtt_us += rtt_us;
+	pipe_stats->ack_rtt_us_max = max(pipe_stats->ack_rtt_us_max, rtt_us);
+
+	stats_rssi_update(pipe);
+}
+
+static void stats_tx_success(u8_t pipe)
+{
+	stats.pipe[pipe].tx_success++;
+}
+
+static void stats_tx_failed(u8_t pipe)
+{
+	stats.pipe[pipe].tx_failed++;
+}
+
+static void stats_rx_packet(u8_t pipe)
+{
+	stats.pipe[pipe].rx_packets++;
+}
+
+static void stats_rx_crc_error(u8_t pipe)
+{
+	stats.pipe[pipe].rx_crc_errors++;
+}
+
+int nrf_esb_get_stats(struct nrf_esb_stats *out)
+{
+	if (out == NULL) {
+		return -EINVAL;
+	}
+
+	u32_t key = irq_lock();
+
+	*out = stats;
+
+	irq_unlock(key);
+
+	return 0;
+}
+
+int nrf_esb_reset_stats(void)
+{
+	u32_t key = irq_lock();
+
+	memset(&stats, 0, sizeof(stats));
+
+	irq_unlock(key);
+
+	return 0;
+}
+#else
+static inline void stats_rssi_update(u8_t pipe) {}
+static inline void stats_tx_acked(u8_t pipe, u32_t attempts) {}
+static inline void stats_tx_success(u8_t pipe) {}
+static inline void stats_tx_failed(u8_t pipe) {}
+static inline void stats_rx_packet(u8_t pipe) {}
+static inline void stats_rx_crc_error(u8_t pipe) {}
+#endif /* CONFIG_NRF_ESB_STATS */
+
+#if CONFIG_NRF_ESB_RETRANSMIT_ADAPTIVE
+/* Maximum number of doublings of the retransmit delay window. */
+#define RETRANSMIT_BACKOFF_MAX 4
+/* Maximum number of failed attempts of one packet taken into the average.
+ * Older samples keep less than 13% of their weight after that many.
+ */
+#define RETRANSMIT_FAILED_SAMPLES_MAX 32
+
+/* Moving average of the ratio of acknowledged transmission attempts, in
+ * 1/256. It is measured per attempt rather than per packet, so that it does
+ * not depend on the number of retransmissions it is used to select.
+ */
+static u32_t ack_rate;
+/* Moving average of the number of transmission attempts of acknowledged
+ * packets, in 1/16.
+ */
+static u32_t attempts_avg;
+static u32_t rand_state;
+
+static void retransmit_adaptive_init(void)
+{
+	ack_rate = 256;
+	attempts_avg = 16;
+
+	rand_state = NRF_FICR->DEVICEID[0] ^ k_cycle_get_32();
+	if (rand_state == 0) {
+		rand_state = 1;
+	}
+}
+
+/* Xorshift pseudo-random number generator. It is seeded with the device ID,
+ * so that PTX devices sharing a PRX pick different retransmit delays.
+ */
+static u32_t rand_get(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
+
+/* Get the number of retransmissions for a new packet.
+ *
+ * While most attempts are acknowledged, a failed attempt is likely due to a
+ * collision, so more retransmissions are allowed. While almost all attempts
+ * fail, the PRX is likely out of reach, and retransmissions only waste air
+ * time. Every packet still gets a retransmission, so the rate keeps being
+ * measured and recovers as soon as the PRX is back.
+ */
+static u32_t retransmit_count_get(void)
+{
+	u32_t count = esb_cfg.retransmit_count;
+
+	if (ack_rate >= 128) {
+		return max(count, (u32_t)CONFIG_NRF_ESB_RETRANSMIT_COUNT_MAX);
+	}
+
+	if (ack_rate < 16) {
+		return min(count, 1U);
+	}
+
+	return count;
+}
+
+/* Get the delay before the retransmission that follows the given attempt.
+ *
+ * The delay is the configured retransmit delay plus a random part. The
+ * random part is drawn from a window that scales with the number of attempts
+ * recently needed to get packets through, and that doubles with every
+ * attempt of the current packet.
+ */
+static u32_t retransmit_delay_get(u32_t attempt)
+{
+	u32_t delay = esb_cfg.retransmit_delay;
+	u32_t window = (delay * attempts_avg) >> 5;
+
+	window <<= min(attempt - 1, (u32_t)RETRANSMIT_BACKOFF_MAX);
+	delay += rand_get() % (window + 1);
+
+	return max(min(delay, (u32_t)CONFIG_NRF_ESB_RETRANSMIT_DELAY_MAX),
+		   (u32_t)esb_cfg.retransmit_delay);
+}
+
+static void retransmit_adaptive_update(bool acked, u32_t attempts)
+{
+	u32_t failed = min(attempts - (acked ? 1 : 0),
+			   (u32_t)RETRANSMIT_FAILED_SAMPLES_MAX);
+
+	/* Exponential moving averages with a weight of 1/16 for the new
+	 * sample. Every attempt of the packet is a sample of the ACK rate.
+	 */
+	while (failed--) {
+		ack_rate -= ack_rate >> 4;
+	}
+
+	if (acked) {
+		ack_rate = ack_rate - (ack_rate >> 4) + 16;
+		attempts_avg = attempts_avg - (attempts_avg >> 4) + attempts;
+	}
+}
+#else
+static inline void retransmit_adaptive_init(void) {}
+
+static inline u32_t retransmit_count_get(void)
+{
+	return esb_cfg.retransmit_count;
+}
+
+static inline u32_t retransmit_delay_get(u32_t attempt)
+{
+	return esb_cfg.retransmit_delay;
+}
+
+static inline void retransmit_adaptive_update(bool acked, u32_t attempts) {}
+#endif /* CONFIG_NRF_ESB_RETRANSMIT_ADAPTIVE */
+
 static void start_tx_transaction(void)
 {
 	bool ack;
 
 	last_tx_attempts = 1;
+	retransmit_budget = retransmit_count_get();
+	tx_start_cycles = k_cycle_get_32();
 	/* Prepare the payload */
-	current_payload = tx_fifo.payload[tx_fifo.front];
+	current_payload = tx_fifo_front();
 
 	switch (esb_cfg.protocol) {
 	case NRF_ESB_PROTOCOL_ESB:
@@ -587,11 +1218,11 @@ static void start_tx_transaction(void)
 
 		NRF_RADIO->SHORTS = radio_shorts_common |
 				    RADIO_SHORTS_DISABLED_RXEN_Msk;
-		NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk |
-				      RADIO_INTENSET_READY_Msk;
+		ESB_INTENSET(NRF_RADIO, RADIO_INTENSET_DISABLED_Msk |
+			     RADIO_INTENSET_READY_Msk);
 
 		/* Configure the retransmit counter */
-		retransmits_remaining = esb_cfg.retransmit_count;
+		retransmits_remaining = retransmit_budget;
 		on_radio_disabled = on_radio_disabled_tx;
 		esb_state = ESB_STATE_PTX_TX_ACK;
 		break;
@@ -610,16 +1241,16 @@ static void start_tx_transaction(void)
 		if (ack) {
 			NRF_RADIO->SHORTS = radio_shorts_common |
 					    RADIO_SHORTS_DISABLED_RXEN_Msk;
-			NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk |
-					      RADIO_INTENSET_READY_Msk;
+			ESB_INTENSET(NRF_RADIO, RADIO_INTENSET_DISABLED_Msk |
+				     RADIO_INTENSET_READY_Msk);
 
 			/* Configure the retransmit counter */
-			retransmits_remaining = esb_cfg.retransmit_count;
+			retransmits_remaining = retransmit_budget;
 			on_radio_disabled = on_radio_disabled_tx;
 			esb_state = ESB_STATE_PTX_TX_ACK;
 		} else {
 			NRF_RADIO->SHORTS = radio_shorts_common;
-			NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk;
+			ESB_INTENSET(NRF_RADIO, RADIO_INTENSET_DISABLED_Msk);
 			on_radio_disabled = on_radio_disabled_tx_noack;
 			esb_state = ESB_STATE_PTX_TX;
 		}
@@ -643,15 +1274,16 @@ static void start_tx_transaction(void)
 	NRF_RADIO->EVENTS_PAYLOAD = 0;
 	NRF_RADIO->EVENTS_DISABLED = 0;
 
-	NRF_RADIO->TASKS_TXEN = 1;
+	ESB_TASK(NRF_RADIO->TASKS_TXEN);
 }
 
 static void on_radio_disabled_tx_noack(void)
 {
 	interrupt_flags |= INT_TX_SUCCESS_MSK;
+	stats_tx_success(current_payload->pipe);
 	tx_fifo_remove_last();
 
-	if (tx_fifo.count == 0) {
+	if (tx_fifo_count() == 0) {
 		esb_state = ESB_STATE_IDLE;
 		NVIC_SetPendingIRQ(ESB_EVT_IRQ);
 	} else {
@@ -672,24 +1304,26 @@ static void on_radio_disabled_tx(void)
 	 * received by the time defined in wait_for_ack_timeout_us
 	 */
 	ESB_SYS_TIMER->CC[0] = wait_for_ack_timeout_us;
-	ESB_SYS_TIMER->CC[1] = esb_cfg.retransmit_delay - 130;
-	ESB_SYS_TIMER->TASKS_CLEAR = 1;
+	ESB_SYS_TIMER->CC[1] = retransmit_delay_get(retransmit_budget -
+						    retransmits_remaining + 1) -
+			       130;
+	ESB_TASK(ESB_SYS_TIMER->TASKS_CLEAR);
 	ESB_SYS_TIMER->EVENTS_COMPARE[0] = 0;
 	ESB_SYS_TIMER->EVENTS_COMPARE[1] = 0;
 	/* Remove */
-	ESB_SYS_TIMER->TASKS_START = 1;
+	ESB_TASK(ESB_SYS_TIMER->TASKS_START);
 
-	NRF_PPI->CHENSET = (1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
-			   (1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
-			   (1 << CONFIG_NRF_ESB_PPI_TIMER_STOP);
-	NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TX_START);
+	ESB_PPI_CHENSET((1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
+			(1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
+			(1 << CONFIG_NRF_ESB_PPI_TIMER_STOP));
+	ESB_PPI_CHENCLR(1 << CONFIG_NRF_ESB_PPI_TX_START);
 	NRF_RADIO->EVENTS_END = 0;
 
 	if (esb_cfg.protocol == NRF_ESB_PROTOCOL_ESB) {
 		update_rf_payload_format(0);
 	}
 
-	NRF_RADIO->PACKETPTR = (u32_t)rx_payload_buffer;
+	rx_radio_buffer_set();
 	on_radio_disabled = on_radio_disabled_tx_wait_for_ack;
 	esb_state = ESB_STATE_PTX_RX_ACK;
 }
@@ -701,30 +1335,34 @@ static void on_radio_disabled_tx_wait_for_ack(void)
 	/* Make sure the timer will not deactivate the radio if a packet is
 	 * received.
 	 */
-	NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
-			   (1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
-			   (1 << CONFIG_NRF_ESB_PPI_TIMER_STOP);
+	ESB_PPI_CHENCLR((1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
+			(1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
+			(1 << CONFIG_NRF_ESB_PPI_TIMER_STOP));
 
 	/* If the radio has received a packet and the CRC status is OK */
 	if (NRF_RADIO->EVENTS_END && NRF_RADIO->CRCSTATUS != 0) {
-		ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
-		NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TX_START);
+		ESB_TASK(ESB_SYS_TIMER->TASKS_SHUTDOWN);
+		ESB_PPI_CHENCLR(1 << CONFIG_NRF_ESB_PPI_TX_START);
 		interrupt_flags |= INT_TX_SUCCESS_MSK;
-		last_tx_attempts = esb_cfg.retransmit_count -
+		last_tx_attempts = retransmit_budget -
 				   retransmits_remaining + 1;
 
+		stats_tx_acked(current_payload->pipe, last_tx_attempts);
+		esb_hop_tx_success(esb_addr.rf_channel);
+		retransmit_adaptive_update(true, last_tx_attempts);
 		tx_fifo_remove_last();
 
 		if (esb_cfg.protocol != NRF_ESB_PROTOCOL_ESB &&
-		    rx_payload_buffer[0] > 0) {
+		    rx_radio_buffer[0] > 0) {
 			if (rx_fifo_push_rfbuf((u8_t)NRF_RADIO->TXADDRESS,
-					       rx_payload_buffer[1] >> 1)) {
+					       rx_radio_buffer[1] >> 1)) {
 				interrupt_flags |=
 					INT_RX_DATA_RECEIVED_MSK;
+				stats_rx_packet(NRF_RADIO->TXADDRESS);
 			}
 		}
 
-		if ((tx_fifo.count == 0) ||
+		if ((tx_fifo_count() == 0) ||
 		    (esb_cfg.tx_mode == NRF_ESB_TXMODE_MANUAL)) {
 			esb_state = ESB_STATE_IDLE;
 			NVIC_SetPendingIRQ(ESB_EVT_IRQ);
@@ -733,14 +1371,29 @@ static void on_radio_disabled_tx_wait_for_ack(void)
 			start_tx_transaction();
 		}
 	} else {
+		if (NRF_RADIO->EVENTS_END) {
+			stats_rx_crc_error(current_payload->pipe);
+		}
+
 		if (retransmits_remaining-- == 0) {
-			ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
-			NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TX_START);
+			ESB_TASK(ESB_SYS_TIMER->TASKS_SHUTDOWN);
+			ESB_PPI_CHENCLR(1 << CONFIG_NRF_ESB_PPI_TX_START);
+
+			/* Retry the packet on the next channel */
+			if (esb_hop_tx_failed(&esb_addr.rf_channel)) {
+				retransmit_adaptive_update(false,
+							   retransmit_budget + 1);
+				start_tx_transaction();
+				return;
+			}
+
 			/* All retransmits are expended, and the TX operation is
 			 * suspended
 			 */
-			last_tx_attempts = esb_cfg.retransmit_count + 1;
+			last_tx_attempts = retransmit_budget + 1;
 			interrupt_flags |= INT_TX_FAILED_MSK;
+			stats_tx_failed(current_payload->pipe);
+			retransmit_adaptive_update(false, last_tx_attempts);
 
 			esb_state = ESB_STATE_IDLE;
 			NVIC_SetPendingIRQ(ESB_EVT_IRQ);
@@ -755,10 +1408,10 @@ static void on_radio_disabled_tx_wait_for_ack(void)
 			NRF_RADIO->PACKETPTR = (u32_t)tx_payload_buffer;
 			on_radio_disabled = on_radio_disabled_tx;
 			esb_state = ESB_STATE_PTX_TX_ACK;
-			ESB_SYS_TIMER->TASKS_START = 1;
-			NRF_PPI->CHENSET = (1 << CONFIG_NRF_ESB_PPI_TX_START);
+			ESB_TASK(ESB_SYS_TIMER->TASKS_START);
+			ESB_PPI_CHENSET(1 << CONFIG_NRF_ESB_PPI_TX_START);
 			if (ESB_SYS_TIMER->EVENTS_COMPARE[1]) {
-				NRF_RADIO->TASKS_TXEN = 1;
+				ESB_TASK(NRF_RADIO->TASKS_TXEN);
 			}
 		}
 	}
@@ -768,9 +1421,9 @@ static void clear_events_restart_rx(void)
 {
 	NRF_RADIO->SHORTS = radio_shorts_common;
 	update_rf_payload_format(esb_cfg.payload_length);
-	NRF_RADIO->PACKETPTR = (u32_t)rx_payload_buffer;
+	rx_radio_buffer_set();
 	NRF_RADIO->EVENTS_DISABLED = 0;
-	NRF_RADIO->TASKS_DISABLE = 1;
+	ESB_TASK(NRF_RADIO->TASKS_DISABLE);
 
 	while (NRF_RADIO->EVENTS_DISABLED == 0) {
 		/* wait for register to settle */
@@ -780,46 +1433,53 @@ static void clear_events_restart_rx(void)
 	NRF_RADIO->SHORTS = radio_shorts_common |
 			    RADIO_SHORTS_DISABLED_TXEN_Msk;
 
-	NRF_RADIO->TASKS_RXEN = 1;
+	ESB_TASK(NRF_RADIO->TASKS_RXEN);
 }
 
-static void on_radio_disabled_rx_dpl(bool retransmit_payload,
-				     struct pipe_info *pipe_info)
+/* Prepare the ACK of a received packet and return the packet to send. */
+static u8_t *on_radio_disabled_rx_dpl(bool retransmit_payload,
+				      struct pipe_info *pipe_info, u8_t s1)
 {
-	if (tx_fifo.count > 0 &&
-	    (tx_fifo.payload[tx_fifo.front]->pipe == NRF_RADIO->RXMATCH)) {
-		/* Pipe stays in ACK with payload until TX FIFO is empty */
-		/* Do not report TX success on first ack payload or retransmit
+	u8_t pipe = NRF_RADIO->RXMATCH;
+	struct nrf_esb_payload *ack = ack_payload_front(pipe);
+	u8_t *packet;
+
+	/* Pipe stays in ACK with payload until it has no more payloads */
+	/* Do not report TX success on first ack payload or retransmit */
+	if (ack && pipe_info->ack_payload && !retransmit_payload) {
+		stats_tx_success(pipe);
+		ack_payload_pop(pipe);
+
+		/* ACK payloads also require TX_DS */
+		/* (page 40 of the
+		 * 'nRF24LE1_Product_Specification_rev1_6.pdf').
 		 */
-		if (pipe_info->ack_payload && !retransmit_payload) {
-			if (++tx_fifo.front >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
-				tx_fifo.front = 0;
-			}
-
-			tx_fifo.count--;
+		interrupt_flags |= INT_TX_SUCCESS_MSK;
 
-			/* ACK payloads also require TX_DS */
-			/* (page 40 of the
-			 * 'nRF24LE1_Product_Specification_rev1_6.pdf').
-			 */
-			interrupt_flags |= INT_TX_SUCCESS_MSK;
-		}
+		ack = ack_payload_front(pipe);
+	}
 
+	if (ack) {
 		pipe_info->ack_payload = true;
 
-		current_payload = tx_fifo.payload[tx_fifo.front];
+		current_payload = ack;
 
+		/* The ACK payload is sent from its TX FIFO entry. */
+		packet = fifo_entry_rfbuf(CONTAINER_OF(ack, struct fifo_entry,
+						       payload));
 		update_rf_payload_format(current_payload->length);
-		tx_payload_buffer[0] = current_payload->length;
-		memcpy(&tx_payload_buffer[2], current_payload->data,
-		       current_payload->length);
+		packet[0] = current_payload->length;
 	} else {
 		pipe_info->ack_payload = false;
+
+		packet = tx_payload_buffer;
 		update_rf_payload_format(0);
-		tx_payload_buffer[0] = 0;
+		packet[0] = 0;
 	}
 
-	tx_payload_buffer[1] = rx_payload_buffer[1];
+	packet[1] = s1;
+
+	return packet;
 }
 
 static void on_radio_disabled_rx(void)
@@ -827,41 +1487,66 @@ static void on_radio_disabled_rx(void)
 	bool retransmit_payload = false;
 	bool send_rx_event = true;
 	struct pipe_info *pipe_info;
+	u8_t *ack_packet = tx_payload_buffer;
+	u8_t s0;
+	u8_t s1;
 
 	if (NRF_RADIO->CRCSTATUS == 0) {
+		stats_rx_crc_error(NRF_RADIO->RXMATCH);
+		esb_hop_rx(esb_addr.rf_channel, false);
 		clear_events_restart_rx();
 		return;
 	}
 
-	if (rx_fifo.count >= CONFIG_NRF_ESB_RX_FIFO_SIZE) {
+	stats_rssi_update(NRF_RADIO->RXMATCH);
+	esb_hop_rx(esb_addr.rf_channel, true);
+
+	if (rx_fifo_count() >= CONFIG_NRF_ESB_RX_FIFO_SIZE) {
 		clear_events_restart_rx();
 		return;
 	}
 
+	/* The packet header is overwritten when the packet is pushed to the
+	 * RX FIFO.
+	 */
+	s0 = rx_radio_buffer[0];
+	s1 = rx_radio_buffer[1];
+
 	pipe_info = &rx_pipe_info[NRF_RADIO->RXMATCH];
 	if (NRF_RADIO->RXCRC == pipe_info->crc &&
-	    (rx_payload_buffer[1] >> 1) == pipe_info->pid) {
+	    (s1 >> 1) == pipe_info->pid) {
 		retransmit_payload = true;
 		send_rx_event = false;
 	}
 
-	pipe_info->pid = rx_payload_buffer[1] >> 1;
+	pipe_info->pid = s1 >> 1;
 	pipe_info->crc = NRF_RADIO->RXCRC;
 
+	/* Push the new packet to the RX buffer before the radio is pointed to
+	 * the buffer for the next packet.
+	 */
+	if (send_rx_event) {
+		if (rx_fifo_push_rfbuf(NRF_RADIO->RXMATCH, pipe_info->pid)) {
+			stats_rx_packet(NRF_RADIO->RXMATCH);
+		} else {
+			send_rx_event = false;
+		}
+	}
+
 	/* Check if an ack should be sent */
-	if ((esb_cfg.selective_auto_ack == false) ||
-	    ((rx_payload_buffer[1] & 0x01) == 1)) {
+	if ((esb_cfg.selective_auto_ack == false) || ((s1 & 0x01) == 1)) {
 		NRF_RADIO->SHORTS = radio_shorts_common |
 				    RADIO_SHORTS_DISABLED_RXEN_Msk;
 
 		switch (esb_cfg.protocol) {
 		case NRF_ESB_PROTOCOL_ESB_DPL:
-			on_radio_disabled_rx_dpl(retransmit_payload, pipe_info);
+			ack_packet = on_radio_disabled_rx_dpl(retransmit_payload,
+							      pipe_info, s1);
 			break;
 
 		case NRF_ESB_PROTOCOL_ESB:
 			update_rf_payload_format(0);
-			tx_payload_buffer[0] = rx_payload_buffer[0];
+			tx_payload_buffer[0] = s0;
 			tx_payload_buffer[1] = 0;
 			break;
 		}
@@ -869,21 +1554,16 @@ static void on_radio_disabled_rx(void)
 		esb_state = ESB_STATE_PRX_SEND_ACK;
 		NRF_RADIO->TXADDRESS = NRF_RADIO->RXMATCH;
 
-		NRF_RADIO->PACKETPTR = (u32_t)tx_payload_buffer;
+		NRF_RADIO->PACKETPTR = (u32_t)ack_packet;
 		on_radio_disabled = on_radio_disabled_rx_ack;
 	} else {
 		clear_events_restart_rx();
 	}
 
 	if (send_rx_event) {
-		/* Push the new packet to the RX buffer and trigger a received
-		 * event if the operation was
-		 * successful.
-		 */
-		if (rx_fifo_push_rfbuf(NRF_RADIO->RXMATCH, pipe_info->pid)) {
-			interrupt_flags |= INT_RX_DATA_RECEIVED_MSK;
-			NVIC_SetPendingIRQ(ESB_EVT_IRQ);
-		}
+		/* Trigger a received event, the packet is in the RX buffer. */
+		interrupt_flags |= INT_RX_DATA_RECEIVED_MSK;
+		NVIC_SetPendingIRQ(ESB_EVT_IRQ);
 	}
 }
 
@@ -893,7 +1573,7 @@ static void on_radio_disabled_rx_ack(void)
 			    RADIO_SHORTS_DISABLED_TXEN_Msk;
 	update_rf_payload_format(esb_cfg.payload_length);
 
-	NRF_RADIO->PACKETPTR = (u32_t)rx_payload_buffer;
+	rx_radio_buffer_set();
 	on_radio_disabled = on_radio_disabled_rx;
 
 	esb_state = ESB_STATE_PRX;
@@ -985,7 +1665,7 @@ static void NRF_ESB_BUGFIX_TIMER_IRQHandler(void)
 		 * state, disable the radio
 		 */
 		if (esb_state == ESB_STATE_PTX_RX_ACK) {
-			NRF_RADIO->TASKS_DISABLE = 1;
+			ESB_TASK(NRF_RADIO->TASKS_DISABLE);
 		}
 	}
 }
@@ -1010,6 +1690,7 @@ int nrf_esb_init(const struct nrf_esb_config *config)
 	memset(rx_pipe_info, 0, sizeof(rx_pipe_info));
 	memset(pids, 0, sizeof(pids));
 
+	retransmit_adaptive_init();
 	update_radio_parameters();
 
 	/* Configure radio address registers according to ESB default values */
@@ -1018,7 +1699,7 @@ int nrf_esb_init(const struct nrf_esb_config *config)
 	NRF_RADIO->PREFIX0 = 0x23C343E7;
 	NRF_RADIO->PREFIX1 = 0x13E363A3;
 
-	initialize_fifos();
+	reset_fifos();
 	sys_timer_init();
 	ppi_init();
 
@@ -1054,7 +1735,7 @@ int nrf_esb_init(const struct nrf_esb_config *config)
 		ESB_BUGFIX_TIMER->MODE = TIMER_MODE_MODE_Timer
 					 << TIMER_MODE_MODE_Pos;
 		ESB_BUGFIX_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
-		ESB_BUGFIX_TIMER->TASKS_CLEAR = 1;
+		ESB_TASK(ESB_BUGFIX_TIMER->TASKS_CLEAR);
 
 		IRQ_DIRECT_CONNECT(ESB_BUGFIX_TIMER_IRQn,
 				   config->event_irq_priority,
@@ -1075,9 +1756,9 @@ int nrf_esb_init(const struct nrf_esb_config *config)
 		NRF_PPI->CH[CONFIG_NRF_ESB_PPI_BUGFIX3].TEP =
 		    (u32_t)&ESB_BUGFIX_TIMER->TASKS_CLEAR;
 
-		NRF_PPI->CHENSET = (1 << CONFIG_NRF_ESB_PPI_BUGFIX1) |
-				   (1 << CONFIG_NRF_ESB_PPI_BUGFIX2) |
-				   (1 << CONFIG_NRF_ESB_PPI_BUGFIX3);
+		ESB_PPI_CHENSET((1 << CONFIG_NRF_ESB_PPI_BUGFIX1) |
+				(1 << CONFIG_NRF_ESB_PPI_BUGFIX2) |
+				(1 << CONFIG_NRF_ESB_PPI_BUGFIX3));
 	}
 #endif
 
@@ -1102,10 +1783,10 @@ int nrf_esb_suspend(void)
 	}
 
 	/*  Clear PPI */
-	NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
-			   (1 << CONFIG_NRF_ESB_PPI_TIMER_STOP) |
-			   (1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
-			   (1 << CONFIG_NRF_ESB_PPI_TX_START);
+	ESB_PPI_CHENCLR((1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
+			(1 << CONFIG_NRF_ESB_PPI_TIMER_STOP) |
+			(1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
+			(1 << CONFIG_NRF_ESB_PPI_TX_START));
 
 	esb_state = ESB_STATE_IDLE;
 
@@ -1115,10 +1796,10 @@ int nrf_esb_suspend(void)
 void nrf_esb_disable(void)
 {
 	/*  Clear PPI */
-	NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
-			   (1 << CONFIG_NRF_ESB_PPI_TIMER_STOP) |
-			   (1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
-			   (1 << CONFIG_NRF_ESB_PPI_TX_START);
+	ESB_PPI_CHENCLR((1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
+			(1 << CONFIG_NRF_ESB_PPI_TIMER_STOP) |
+			(1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
+			(1 << CONFIG_NRF_ESB_PPI_TX_START));
 
 	esb_state = ESB_STATE_IDLE;
 	esb_initialized = false;
@@ -1141,53 +1822,181 @@ bool nrf_esb_is_idle(void)
 	return (esb_state == ESB_STATE_IDLE);
 }
 
-int nrf_esb_write_payload(const struct nrf_esb_payload *payload)
+static void tx_payload_copy(struct nrf_esb_payload *dst,
+			    const struct nrf_esb_payload *src)
 {
-	if (!esb_initialized) {
-		return -EACCES;
-	}
-	if (payload == NULL) {
-		return -EINVAL;
+	dst->length = src->length;
+	dst->pipe = src->pipe;
+	dst->noack = src->noack;
+	memcpy(dst->data, src->data, src->length);
+}
+
+static void rx_payload_copy(struct nrf_esb_payload *dst,
+			    const struct nrf_esb_payload *src)
+{
+	dst->length = src->length;
+	dst->pipe = src->pipe;
+	dst->rssi = src->rssi;
+	dst->pid = src->pid;
+	dst->noack = src->noack;
+	memcpy(dst->data, src->data, src->length);
+}
+
+static void tx_payload_set_pid(struct nrf_esb_payload *payload)
+{
+	pids[payload->pipe] = (pids[payload->pipe] + 1) % (PID_MAX + 1);
+	payload->pid = pids[payload->pipe];
+}
+
+static void tx_start_auto(void)
+{
+	if (esb_cfg.mode == NRF_ESB_MODE_PTX &&
+	    esb_cfg.tx_mode == NRF_ESB_TXMODE_AUTO &&
+	    esb_state == ESB_STATE_IDLE) {
+		start_tx_transaction();
 	}
+}
+
+static int tx_payload_check(const struct nrf_esb_payload *payload)
+{
 	if (payload->length == 0 ||
 	    payload->length > CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH ||
 	    (esb_cfg.protocol == NRF_ESB_PROTOCOL_ESB &&
 	     payload->length > esb_cfg.payload_length)) {
 		return -EMSGSIZE;
 	}
-	if (tx_fifo.count >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
+	if (payload->pipe >= CONFIG_NRF_ESB_PIPE_COUNT) {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int nrf_esb_tx_reserve(struct nrf_esb_payload **payload)
+{
+	if (!esb_initialized) {
+		return -EACCES;
+	}
+	if (payload == NULL) {
+		return -EINVAL;
+	}
+
+	/* The back of the TX FIFO is not accessed by the radio interrupt
+	 * until it is committed.
+	 */
+	*payload = tx_fifo_reserve(atomic_get(&tx_fifo.back));
+	if (*payload == NULL) {
 		return -ENOMEM;
 	}
-	if (payload->pipe >= CONFIG_NRF_ESB_PIPE_COUNT) {
+
+	return 0;
+}
+
+int nrf_esb_tx_commit(void)
+{
+	struct nrf_esb_payload *payload;
+	u32_t back;
+	int err;
+
+	if (!esb_initialized) {
+		return -EACCES;
+	}
+
+	back = atomic_get(&tx_fifo.back);
+	payload = tx_fifo_reserve(back);
+	if (payload == NULL) {
+		return -ENOMEM;
+	}
+
+	err = tx_payload_check(payload);
+	if (err) {
+		return err;
+	}
+
+	tx_payload_set_pid(payload);
+	tx_fifo_push(fifo_index_next(back, CONFIG_NRF_ESB_TX_FIFO_SIZE));
+	tx_start_auto();
+
+	return 0;
+}
+
+int nrf_esb_write_payload(const struct nrf_esb_payload *payload)
+{
+	struct nrf_esb_payload *tx_payload;
+	int err;
+
+	if (!esb_initialized) {
+		return -EACCES;
+	}
+	if (payload == NULL) {
 		return -EINVAL;
 	}
 
-	u32_t key = irq_lock();
+	err = tx_payload_check(payload);
+	if (err) {
+		return err;
+	}
 
-	memcpy(tx_fifo.payload[tx_fifo.back], payload,
-	       sizeof(struct nrf_esb_payload));
+	err = nrf_esb_tx_reserve(&tx_payload);
+	if (err) {
+		return err;
+	}
 
-	pids[payload->pipe] = (pids[payload->pipe] + 1) % (PID_MAX + 1);
-	tx_fifo.payload[tx_fifo.back]->pid = pids[payload->pipe];
+	tx_payload_copy(tx_payload, payload);
+
+	return nrf_esb_tx_commit();
+}
 
-	if (++tx_fifo.back >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
-		tx_fifo.back = 0;
+int nrf_esb_write_payloads(const struct nrf_esb_payload *payloads,
+			   size_t count)
+{
+	size_t i;
+	u32_t back;
+	int err = 0;
+
+	if (!esb_initialized) {
+		return -EACCES;
+	}
+	if (payloads == NULL) {
+		return -EINVAL;
+	}
+	if (count == 0) {
+		return 0;
 	}
 
-	tx_fifo.count++;
+	back = atomic_get(&tx_fifo.back);
 
-	irq_unlock(key);
+	for (i = 0; i < count; i++) {
+		struct nrf_esb_payload *tx_payload;
 
-	if (esb_cfg.mode == NRF_ESB_MODE_PTX &&
-	    esb_cfg.tx_mode == NRF_ESB_TXMODE_AUTO &&
-	    esb_state == ESB_STATE_IDLE) {
-		start_tx_transaction();
+		err = tx_payload_check(&payloads[i]);
+		if (err) {
+			break;
+		}
+
+		tx_payload = tx_fifo_reserve(back);
+		if (tx_payload == NULL) {
+			break;
+		}
+
+		tx_payload_copy(tx_payload, &payloads[i]);
+		tx_payload_set_pid(tx_payload);
+
+		back = fifo_index_next(back, CONFIG_NRF_ESB_TX_FIFO_SIZE);
 	}
 
-	return 0;
+	if (i == 0) {
+		return err ? err : -ENOMEM;
+	}
+
+	/* Queue all payloads at once, and start transmitting them. */
+	tx_fifo_push(back);
+	tx_start_auto();
+
+	return i;
 }
 
-int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload)
+int nrf_esb_borrow_rx_payload(const struct nrf_esb_payload **payload)
 {
 	if (!esb_initialized) {
 		return -EACCES;
@@ -1196,38 +2005,93 @@ int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload)
 		return -EINVAL;
 	}
 
-	if (rx_fifo.count == 0) {
+	if (rx_fifo_count() == 0) {
 		return -ENODATA;
 	}
 
-	u32_t key = irq_lock();
+	/* The radio only receives into the front of the RX FIFO once the
+	 * payload has been released, so it can be accessed without locking.
+	 */
+	*payload = &rx_fifo_front()->payload;
 
-	payload->length = rx_fifo.payload[rx_fifo.front]->length;
-	payload->pipe = rx_fifo.payload[rx_fifo.front]->pipe;
-	payload->rssi = rx_fifo.payload[rx_fifo.front]->rssi;
-	payload->pid = rx_fifo.payload[rx_fifo.front]->pid;
-	payload->noack = rx_fifo.payload[rx_fifo.front]->noack;
-	memcpy(payload->data, rx_fifo.payload[rx_fifo.front]->data,
-	       payload->length);
+	return 0;
+}
 
-	if (++rx_fifo.front >= CONFIG_NRF_ESB_RX_FIFO_SIZE) {
-		rx_fifo.front = 0;
+int nrf_esb_release_rx_payload(void)
+{
+	if (!esb_initialized) {
+		return -EACCES;
 	}
 
-	rx_fifo.count--;
+	if (rx_fifo_count() == 0) {
+		return -ENODATA;
+	}
 
-	irq_unlock(key);
+	rx_fifo_pop();
 
 	return 0;
 }
 
+int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload)
+{
+	const struct nrf_esb_payload *rx_payload;
+	int err;
+
+	if (payload == NULL) {
+		return -EINVAL;
+	}
+
+	err = nrf_esb_borrow_rx_payload(&rx_payload);
+	if (err) {
+		return err;
+	}
+
+	rx_payload_copy(payload, rx_payload);
+
+	return nrf_esb_release_rx_payload();
+}
+
+int nrf_esb_read_rx_payloads(struct nrf_esb_payload *payloads,
+			     size_t max_count)
+{
+	size_t count;
+	u32_t front;
+
+	if (!esb_initialized) {
+		return -EACCES;
+	}
+	if (payloads == NULL) {
+		return -EINVAL;
+	}
+
+	count = min(rx_fifo_count(), max_count);
+	if (count == 0) {
+		return -ENODATA;
+	}
+
+	front = atomic_get(&rx_fifo.front);
+
+	for (size_t i = 0; i < count; i++) {
+		rx_payload_copy(&payloads[i],
+				&rx_fifo.entry[fifo_index_entry(front,
+					CONFIG_NRF_ESB_RX_FIFO_SIZE)].payload);
+
+		front = fifo_index_next(front, CONFIG_NRF_ESB_RX_FIFO_SIZE);
+	}
+
+	/* Release all payloads at once. */
+	atomic_set(&rx_fifo.front, front);
+
+	return count;
+}
+
 int nrf_esb_start_tx(void)
 {
 	if (esb_state != ESB_STATE_IDLE) {
 		return -EBUSY;
 	}
 
-	if (tx_fifo.count == 0) {
+	if (tx_fifo_count() == 0) {
 		return -ENODATA;
 	}
 
@@ -1242,18 +2106,18 @@ int nrf_esb_start_rx(void)
 		return -EBUSY;
 	}
 
-	NRF_RADIO->INTENCLR = 0xFFFFFFFF;
+	ESB_INTENCLR(NRF_RADIO, 0xFFFFFFFF);
 	NRF_RADIO->EVENTS_DISABLED = 0;
 	on_radio_disabled = on_radio_disabled_rx;
 
 	NRF_RADIO->SHORTS = radio_shorts_common |
 			    RADIO_SHORTS_DISABLED_TXEN_Msk;
-	NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk;
+	ESB_INTENSET(NRF_RADIO, RADIO_INTENSET_DISABLED_Msk);
 	esb_state = ESB_STATE_PRX;
 
 	NRF_RADIO->RXADDRESSES = esb_addr.rx_pipes_enabled;
 	NRF_RADIO->FREQUENCY = esb_addr.rf_channel;
-	NRF_RADIO->PACKETPTR = (u32_t)rx_payload_buffer;
+	rx_radio_buffer_set();
 
 	NVIC_ClearPendingIRQ(RADIO_IRQn);
 	irq_enable(RADIO_IRQn);
@@ -1262,7 +2126,9 @@ int nrf_esb_start_rx(void)
 	NRF_RADIO->EVENTS_PAYLOAD = 0;
 	NRF_RADIO->EVENTS_DISABLED = 0;
 
-	NRF_RADIO->TASKS_RXEN = 1;
+	ESB_TASK(NRF_RADIO->TASKS_RXEN);
+
+	esb_hop_rx_started();
 
 	return 0;
 }
@@ -1274,10 +2140,10 @@ int nrf_esb_stop_rx(void)
 	}
 
 	NRF_RADIO->SHORTS = 0;
-	NRF_RADIO->INTENCLR = 0xFFFFFFFF;
+	ESB_INTENCLR(NRF_RADIO, 0xFFFFFFFF);
 	on_radio_disabled = NULL;
 	NRF_RADIO->EVENTS_DISABLED = 0;
-	NRF_RADIO->TASKS_DISABLE = 1;
+	ESB_TASK(NRF_RADIO->TASKS_DISABLE);
 	while (NRF_RADIO->EVENTS_DISABLED == 0) {
 		/* wait for register to settle */
 	}
@@ -1293,11 +2159,17 @@ int nrf_esb_flush_tx(void)
 		return -EACCES;
 	}
 
+	/* The radio interrupt is the consumer of the TX FIFO, so it must not
+	 * run while the front index is changed from here.
+	 */
 	u32_t key = irq_lock();
 
-	tx_fifo.count = 0;
-	tx_fifo.back = 0;
-	tx_fifo.front = 0;
+	/* ACK payloads are sent from their TX FIFO entry. The back index is
+	 * kept, so that the next payloads are not written to the entry of an
+	 * ACK payload that the radio may still be sending.
+	 */
+	atomic_set(&tx_fifo.front, atomic_get(&tx_fifo.back));
+	ack_queues_reset();
 
 	irq_unlock(key);
 
@@ -1309,16 +2181,13 @@ int nrf_esb_pop_tx(void)
 	if (!esb_initialized) {
 		return -EACCES;
 	}
-	if (tx_fifo.count == 0) {
-		return -ENODATA;
-	}
 
 	u32_t key = irq_lock();
 
-	if (++tx_fifo.back >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
-		tx_fifo.back = 0;
+	if (!ack_tx_fifo_pop()) {
+		irq_unlock(key);
+		return -ENODATA;
 	}
-	tx_fifo.count--;
 
 	irq_unlock(key);
 
@@ -1331,11 +2200,13 @@ int nrf_esb_flush_rx(void)
 		return -EACCES;
 	}
 
+	/* The radio interrupt is the producer of the RX FIFO, so it must not
+	 * run while the back index is changed from here.
+	 */
 	u32_t key = irq_lock();
 
-	rx_fifo.count = 0;
-	rx_fifo.back = 0;
-	rx_fifo.front = 0;
+	atomic_set(&rx_fifo.back, 0);
+	atomic_set(&rx_fifo.front, 0);
 
 	memset(rx_pipe_info, 0, sizeof(rx_pipe_info));
 
@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <errno.h>
+#include <irq.h>
+#include <kernel.h>
+#include <misc/byteorder.h>
+#include <misc/util.h>
+#include <nrf_esb.h>
+#include <nrf_esb_frag.h>
+#include <string.h>
+
+/* Fragment header:
+ *   [0]    Type, poll sequence and flags.
+ *   [1]    Message ID.
+ *   [2..3] Fragment index, or first missing fragment in a status.
+ *   [4..5] Number of fragments of the message.
+ * A status is followed by a bitmap of the received fragments, starting at
+ * the first missing one. It carries the sequence of the poll it answers, so
+ * that the sender can discard statuses that were queued for earlier polls.
+ */
+#define HDR_TYPE	0
+#define HDR_ID		1
+#define HDR_INDEX	2
+#define HDR_COUNT	4
+
+#define TYPE_MASK	0x0F
+#define TYPE_DATA	0x01
+#define TYPE_POLL	0x02
+#define TYPE_STATUS	0x03
+
+#define SEQ_POS		4
+#define SEQ_MASK	0x70
+
+/* The receiver replies with a status. */
+#define FLAG_POLL	0x80
+
+#define BITMAP_SIZE	((CONFIG_NRF_ESB_FRAG_COUNT_MAX + 7) / 8)
+#define STATUS_BITS_MAX	(NRF_ESB_FRAG_DATA_MAX * 8)
+
+BUILD_ASSERT(CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH > NRF_ESB_FRAG_HDR_SIZE);
+
+enum tx_state {
+	TX_IDLE,
+	TX_SENDING,
+	TX_WAIT_STATUS,
+};
+
+struct tx_msg {
+	const u8_t *data;
+	size_t len;
+	u16_t count;
+	u16_t next;		/* Next fragment to queue in this pass. */
+	u16_t last;		/* Last fragment to queue in this pass. */
+	u8_t pipe;
+	u8_t id;
+	u8_t seq;		/* Poll sequence of this pass. */
+	u8_t polls;		/* Polls sent without a status. */
+	enum tx_state state;
+	u8_t missing[BITMAP_SIZE];
+};
+
+struct rx_msg {
+	u8_t *buf;
+	size_t size;
+	size_t len;
+	u16_t count;
+	u16_t received;
+	u8_t pipe;
+	u8_t id;
+	bool active;
+	bool done;
+	u8_t received_map[BITMAP_SIZE];
+};
+
+static const struct nrf_esb_frag_cb *callbacks;
+static struct tx_msg tx;
+static struct rx_msg rx;
+static struct k_delayed_work poll_work;
+
+/* The state is shared with the ESB event handler. Threads mask only the
+ * ESB event interrupt, so that the radio interrupt is never delayed.
+ */
+static bool evt_irq_lock(void)
+{
+	bool enabled = irq_is_enabled(ESB_EVT_IRQ);
+
+	irq_disable(ESB_EVT_IRQ);
+
+	return enabled;
+}
+
+static void evt_irq_unlock(bool enabled)
+{
+	if (enabled) {
+		irq_enable(ESB_EVT_IRQ);
+	}
+}
+
+static bool bit_get(const u8_t *map, u16_t i)
+{
+	return map[i / 8] & BIT(i % 8);
+}
+
+static void bit_set(u8_t *map, u16_t i)
+{
+	map[i / 8] |= BIT(i % 8);
+}
+
+static void bit_clear(u8_t *map, u16_t i)
+{
+	map[i / 8] &= ~BIT(i % 8);
+}
+
+static u8_t seq_get(const u8_t *hdr)
+{
+	return (hdr[HDR_TYPE] & SEQ_MASK) >> SEQ_POS;
+}
+
+static void hdr_set(u8_t *hdr, u8_t type, u8_t id, u16_t index, u16_t count)
+{
+	hdr[HDR_TYPE] = type;
+	hdr[HDR_ID] = id;
+	sys_put_le16(index, &hdr[HDR_INDEX]);
+	sys_put_le16(count, &hdr[HDR_COUNT]);
+}
+
+static int poll_send(void)
+{
+	struct nrf_esb_payload *payload;
+	int err;
+
+	err = nrf_esb_tx_reserve(&payload);
+	if (err) {
+		return err;
+	}
+
+	hdr_set(payload->data, TYPE_POLL | (tx.seq << SEQ_POS), tx.id, 0,
+		tx.count);
+	payload->length = NRF_ESB_FRAG_HDR_SIZE;
+	payload->pipe = tx.pipe;
+	payload->noack = false;
+
+	return nrf_esb_tx_commit();
+}
+
+/* Queue the missing fragments of the current pass while there is room in
+ * the TX FIFO. Must be called from the ESB event handler or with the ESB
+ * event interrupt masked.
+ */
+static void tx_continue(void)
+{
+	struct nrf_esb_payload *payload;
+
+	if (tx.state != TX_SENDING) {
+		return;
+	}
+
+	while (tx.next <= tx.last) {
+		u16_t i = tx.next;
+		size_t offset = (size_t)i * NRF_ESB_FRAG_DATA_MAX;
+		size_t len = min(tx.len - offset, NRF_ESB_FRAG_DATA_MAX);
+		u8_t type = TYPE_DATA | (tx.seq << SEQ_POS);
+
+		if (!bit_get(tx.missing, i)) {
+			tx.next++;
+			continue;
+		}
+
+		if (nrf_esb_tx_reserve(&payload)) {
+			/* Continued when the TX FIFO has room again */
+			return;
+		}
+
+		/* Ask for a status with the last fragment of the pass */
+		if (i == tx.last) {
+			type |= FLAG_POLL;
+		}
+
+		hdr_set(payload->data, type, tx.id, i, tx.count);
+		memcpy(&payload->data[NRF_ESB_FRAG_HDR_SIZE], &tx.data[offset],
+		       len);
+		payload->length = NRF_ESB_FRAG_HDR_SIZE + len;
+		payload->pipe = tx.pipe;
+		payload->noack = false;
+		(void)nrf_esb_tx_commit();
+
+		tx.next++;
+	}
+
+	/* A receiver in PRX mode returns the status as an ACK payload, which
+	 * goes out with the next packet. Follow the last fragment with a
+	 * poll, so that the status does not wait for the poll timer.
+	 */
+	if (poll_send()) {
+		/* Continued when the TX FIFO has room again */
+		return;
+	}
+
+	tx.state = TX_WAIT_STATUS;
+	tx.polls = 0;
+	k_delayed_work_submit(&poll_work,
+			      K_MSEC(CONFIG_NRF_ESB_FRAG_POLL_INTERVAL_MS));
+}
+
+static void tx_pass_start(u16_t first)
+{
+	tx.next = first;
+	tx.last = first;
+	tx.seq = (tx.seq + 1) & (SEQ_MASK >> SEQ_POS);
+
+	for (u16_t i = first; i < tx.count; i++) {
+		if (bit_get(tx.missing, i)) {
+			tx.last = i;
+		}
+	}
+
+	tx.state = TX_SENDING;
+	tx_continue();
+}
+
+static void tx_done(int err)
+{
+	tx.state = TX_IDLE;
+	k_delayed_work_cancel(&poll_work);
+
+	if (callbacks && callbacks->sent) {
+		callbacks->sent(err);
+	}
+}
+
+static void status_received(const struct nrf_esb_payload *payload)
+{
+	const u8_t *bitmap = &payload->data[NRF_ESB_FRAG_HDR_SIZE];
+	size_t bits = (payload->length - NRF_ESB_FRAG_HDR_SIZE) * 8;
+	u16_t base = sys_get_le16(&payload->data[HDR_INDEX]);
+
+	if ((tx.state != TX_WAIT_STATUS) ||
+	    (payload->pipe != tx.pipe) ||
+	    (payload->data[HDR_ID] != tx.id) ||
+	    (seq_get(payload->data) != tx.seq)) {
+		return;
+	}
+
+	if (base >= tx.count) {
+		tx_done(0);
+		return;
+	}
+
+	/* Fragments after the bitmap are treated as missing */
+	for (u16_t i = 0; i < tx.count; i++) {
+		if ((i < base) ||
+		    ((i - base < bits) && bit_get(bitmap, i - base))) {
+			bit_clear(tx.missing, i);
+		} else {
+			bit_set(tx.missing, i);
+		}
+	}
+
+	k_delayed_work_cancel(&poll_work);
+	tx_pass_start(base);
+}
+
+static void status_send(u8_t seq)
+{
+	struct nrf_esb_payload *payload;
+	size_t bits;
+	u16_t base = 0;
+
+	if (nrf_esb_tx_reserve(&payload)) {
+		/* The sender polls again */
+		return;
+	}
+
+	while ((base < rx.count) && bit_get(rx.received_map, base)) {
+		base++;
+	}
+
+	bits = min(rx.count - base, STATUS_BITS_MAX);
+
+	hdr_set(payload->data, TYPE_STATUS | (seq << SEQ_POS), rx.id, base,
+		rx.count);
+	memset(&payload->data[NRF_ESB_FRAG_HDR_SIZE], 0, (bits + 7) / 8);
+	for (size_t i = 0; i < bits; i++) {
+		if (bit_get(rx.received_map, base + i)) {
+			bit_set(&payload->data[NRF_ESB_FRAG_HDR_SIZE], i);
+		}
+	}
+
+	payload->length = NRF_ESB_FRAG_HDR_SIZE + (bits + 7) / 8;
+	payload->pipe = rx.pipe;
+	payload->noack = false;
+	(void)nrf_esb_tx_commit();
+}
+
+static void rx_msg_start(u8_t pipe, u8_t id, u16_t count)
+{
+	/* The fragment belongs to the message being received, or to the
+	 * message that was just completed.
+	 */
+	if (rx.active && (rx.pipe == pipe) && (rx.id == id) &&
+	    (rx.count == count)) {
+		return;
+	}
+
+	memset(rx.received_map, 0, sizeof(rx.received_map));
+	rx.pipe = pipe;
+	rx.id = id;
+	rx.count = count;
+	rx.received = 0;
+	rx.len = 0;
+	rx.active = true;
+	rx.done = false;
+}
+
+static void data_received(const struct nrf_esb_payload *payload, u16_t index)
+{
+	size_t offset = (size_t)index * NRF_ESB_FRAG_DATA_MAX;
+	size_t len = payload->length - NRF_ESB_FRAG_HDR_SIZE;
+
+	if (rx.done || bit_get(rx.received_map, index)) {
+		return;
+	}
+
+	/* Only the last fragment can be shorter */
+	if (((index < rx.count - 1) && (len != NRF_ESB_FRAG_DATA_MAX)) ||
+	    (offset + len > rx.size)) {
+		return;
+	}
+
+	memcpy(&rx.buf[offset], &payload->data[NRF_ESB_FRAG_HDR_SIZE], len);
+	bit_set(rx.received_map, index);
+	rx.received++;
+
+	if (index == rx.count - 1) {
+		rx.len = offset + len;
+	}
+
+	if (rx.received == rx.count) {
+		rx.done = true;
+
+		if (callbacks && callbacks->received) {
+			callbacks->received(rx.pipe, rx.buf, rx.len);
+		}
+	}
+}
+
+static void payload_received(const struct nrf_esb_payload *payload)
+{
+	u8_t type;
+	u16_t index;
+	u16_t count;
+
+	if (payload->length < NRF_ESB_FRAG_HDR_SIZE) {
+		return;
+	}
+
+	type = payload->data[HDR_TYPE];
+	index = sys_get_le16(&payload->data[HDR_INDEX]);
+	count = sys_get_le16(&payload->data[HDR_COUNT]);
+
+	if ((type & TYPE_MASK) == TYPE_STATUS) {
+		status_received(payload);
+		return;
+	}
+
+	if ((count == 0) || (count > CONFIG_NRF_ESB_FRAG_COUNT_MAX) ||
+	    (index >= count)) {
+		return;
+	}
+
+	rx_msg_start(payload->pipe, payload->data[HDR_ID], count);
+
+	switch (type & TYPE_MASK) {
+	case TYPE_DATA:
+		data_received(payload, index);
+		if (type & FLAG_POLL) {
+			status_send(seq_get(payload->data));
+		}
+		break;
+
+	case TYPE_POLL:
+		status_send(seq_get(payload->data));
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void poll_work_handler(struct k_work *work)
+{
+	bool key = evt_irq_lock();
+	bool timeout = false;
+
+	if (tx.state == TX_WAIT_STATUS) {
+		if (tx.polls++ >= CONFIG_NRF_ESB_FRAG_POLL_RETRIES) {
+			tx.state = TX_IDLE;
+			timeout = true;
+		} else {
+			(void)poll_send();
+			k_delayed_work_submit(&poll_work,
+				K_MSEC(CONFIG_NRF_ESB_FRAG_POLL_INTERVAL_MS));
+		}
+	}
+
+	evt_irq_unlock(key);
+
+	if (timeout && callbacks && callbacks->sent) {
+		callbacks->sent(-ETIMEDOUT);
+	}
+}
+
+void nrf_esb_frag_event_handler(const struct nrf_esb_evt *event)
+{
+	const struct nrf_esb_payload *payload;
+
+	switch (event->evt_id) {
+	case NRF_ESB_EVENT_TX_SUCCESS:
+		tx_continue();
+		break;
+
+	case NRF_ESB_EVENT_TX_FAILED:
+		/* Drop the fragment. The receiver reports it as missing. */
+		(void)nrf_esb_pop_tx();
+		tx_continue();
+		(void)nrf_esb_start_tx();
+		break;
+
+	case NRF_ESB_EVENT_RX_RECEIVED:
+		while (nrf_esb_borrow_rx_payload(&payload) == 0) {
+			payload_received(payload);
+			nrf_esb_release_rx_payload();
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+int nrf_esb_frag_send(u8_t pipe, const u8_t *data, size_t len)
+{
+	bool key;
+	size_t count;
+
+	if ((data == NULL) || (len == 0)) {
+		return -EINVAL;
+	}
+
+	count = ceiling_fraction(len, NRF_ESB_FRAG_DATA_MAX);
+	if (count > CONFIG_NRF_ESB_FRAG_COUNT_MAX) {
+		return -EMSGSIZE;
+	}
+
+	key = evt_irq_lock();
+
+	if (tx.state != TX_IDLE) {
+		evt_irq_unlock(key);
+		return -EBUSY;
+	}
+
+	tx.data = data;
+	tx.len = len;
+	tx.count = count;
+	tx.pipe = pipe;
+	tx.id++;
+
+	memset(tx.missing, 0, sizeof(tx.missing));
+	for (u16_t i = 0; i < count; i++) {
+		bit_set(tx.missing, i);
+	}
+
+	tx_pass_start(0);
+
+	evt_irq_unlock(key);
+
+	return 0;
+}
+
+int nrf_esb_frag_init(const struct nrf_esb_frag_cb *cb, u8_t *rx_buf,
+		      size_t rx_buf_size)
+{
+	if ((cb == NULL) || (rx_buf == NULL)) {
+		return -EINVAL;
+	}
+
+	callbacks = cb;
+	rx.buf = rx_buf;
+	rx.size = rx_buf_size;
+	rx.active = false;
+	tx.state = TX_IDLE;
+
+	k_delayed_work_init(&poll_work, poll_work_handler);
+
+	return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef NRF_ESB_HAL_PRIV_H_
+#define NRF_ESB_HAL_PRIV_H_
+
+#include <nrf.h>
+
+/* Register writes with side effects beyond storing the value. All other
+ * registers are plain memory in the simulated radio, so only these need
+ * to go through the simulation.
+ */
+#if CONFIG_NRF_ESB_SIM
+#include <esb_sim_hw.h>
+
+#define ESB_TASK(task) esb_sim_task(&(task))
+#define ESB_INTENSET(periph, mask) esb_sim_reg_set(&(periph)->INTENSET, (mask))
+#define ESB_INTENCLR(periph, mask) esb_sim_reg_clr(&(periph)->INTENSET, (mask))
+#define ESB_PPI_CHENSET(mask) esb_sim_reg_set(&NRF_PPI->CHEN, (mask))
+#define ESB_PPI_CHENCLR(mask) esb_sim_reg_clr(&NRF_PPI->CHEN, (mask))
+#else
+#define ESB_TASK(task) ((task) = 1)
+#define ESB_INTENSET(periph, mask) ((periph)->INTENSET = (mask))
+#define ESB_INTENCLR(periph, mask) ((periph)->INTENCLR = (mask))
+#define ESB_PPI_CHENSET(mask) (NRF_PPI->CHENSET = (mask))
+#define ESB_PPI_CHENCLR(mask) (NRF_PPI->CHENCLR = (mask))
+#endif /* CONFIG_NRF_ESB_SIM */
+
+#endif /* NRF_ESB_HAL_PRIV_H_ */
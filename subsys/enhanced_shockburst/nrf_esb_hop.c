@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <errno.h>
+#include <kernel.h>
+#include <misc/util.h>
+#include <nrf_esb.h>
+#include <string.h>
+
+#include "nrf_esb_hop_priv.h"
+
+/* Highest radio channel. */
+#define CHANNEL_MAX 100
+
+/* Failure rate above which a channel is blacklisted, in 1/256. */
+#define FAIL_RATE_BLACKLIST                                                    \
+	((CONFIG_NRF_ESB_HOP_BLACKLIST_THRESHOLD * 256) / 100)
+
+/* Number of tries on a channel before it can be blacklisted. */
+#define BLACKLIST_TRIES_MIN 8
+
+struct hop_channel {
+	struct nrf_esb_hop_channel_stats stats;
+	u32_t blacklist_end;	/* Uptime at which the blacklisting ends. */
+	u16_t fail_rate;	/* Moving average of failed tries, in 1/256. */
+	u8_t tries;		/* Tries since the channel was blacklisted. */
+};
+
+/* Channels in the order of the hop sequence. */
+static struct hop_channel channels[CONFIG_NRF_ESB_HOP_CHANNEL_COUNT_MAX];
+static u8_t channel_count;
+static u8_t current;
+/* Number of channels tried for the current packet. */
+static u8_t packet_tries;
+static volatile bool enabled;
+static volatile u32_t last_rx_time;
+static struct k_delayed_work rx_hop_work;
+
+static int channel_find(u8_t channel)
+{
+	for (size_t i = 0; i < channel_count; i++) {
+		if (channels[i].stats.channel == channel) {
+			return i;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static bool channel_usable(struct hop_channel *ch, u32_t now)
+{
+	if (ch->stats.blacklisted && ((s32_t)(now - ch->blacklist_end) >= 0)) {
+		ch->stats.blacklisted = false;
+	}
+
+	return !ch->stats.blacklisted;
+}
+
+static u8_t usable_count(u32_t now)
+{
+	u8_t count = 0;
+
+	for (size_t i = 0; i < channel_count; i++) {
+		if (channel_usable(&channels[i], now)) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/* Move to the next channel of the hop sequence that is not blacklisted. */
+static u8_t channel_next(u32_t now)
+{
+	for (size_t i = 1; i <= channel_count; i++) {
+		u8_t next = (current + i) % channel_count;
+
+		if (channel_usable(&channels[next], now)) {
+			current = next;
+			break;
+		}
+	}
+
+	return channels[current].stats.channel;
+}
+
+static void channel_try_update(struct hop_channel *ch, bool success,
+			       u32_t now)
+{
+	/* Exponential moving average with a weight of 1/8 for the new
+	 * sample.
+	 */
+	ch->fail_rate = ch->fail_rate - (ch->fail_rate >> 3) +
+			(success ? 0 : (256 >> 3));
+
+	if (ch->tries < BLACKLIST_TRIES_MIN) {
+		ch->tries++;
+		return;
+	}
+
+	/* Always keep one channel to hop to. */
+	if (!success && (ch->fail_rate > FAIL_RATE_BLACKLIST) &&
+	    (usable_count(now) > 1)) {
+		ch->stats.blacklisted = true;
+		ch->stats.blacklist_count++;
+		ch->blacklist_end = now + CONFIG_NRF_ESB_HOP_BLACKLIST_MS;
+		ch->fail_rate = 0;
+		ch->tries = 0;
+	}
+}
+
+void esb_hop_tx_success(u8_t channel)
+{
+	int i;
+
+	if (!enabled) {
+		return;
+	}
+
+	packet_tries = 0;
+
+	i = channel_find(channel);
+	if (i < 0) {
+		return;
+	}
+
+	channels[i].stats.tx_success++;
+	channel_try_update(&channels[i], true, k_uptime_get_32());
+}
+
+bool esb_hop_tx_failed(u8_t *channel)
+{
+	u32_t now = k_uptime_get_32();
+	int i;
+
+	if (!enabled) {
+		return false;
+	}
+
+	i = channel_find(*channel);
+	if (i >= 0) {
+		channels[i].stats.tx_failed++;
+		channel_try_update(&channels[i], false, now);
+	}
+
+	*channel = channel_next(now);
+
+	/* Give up on the packet once it has been tried on every channel,
+	 * but start the next packet on a new channel.
+	 */
+	if (++packet_tries >= usable_count(now)) {
+		packet_tries = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void esb_hop_rx(u8_t channel, bool crc_ok)
+{
+	int i;
+
+	if (!enabled) {
+		return;
+	}
+
+	if (crc_ok) {
+		last_rx_time = k_uptime_get_32();
+	}
+
+	i = channel_find(channel);
+	if (i < 0) {
+		return;
+	}
+
+	if (crc_ok) {
+		channels[i].stats.rx_packets++;
+	} else {
+		channels[i].stats.rx_crc_errors++;
+	}
+}
+
+void esb_hop_rx_started(void)
+{
+	if (enabled) {
+		k_delayed_work_submit(&rx_hop_work,
+				      K_MSEC(CONFIG_NRF_ESB_HOP_RX_DWELL_MS));
+	}
+}
+
+static void rx_hop_work_handler(struct k_work *work)
+{
+	u32_t silence;
+
+	/* Stop hopping if the reception was stopped. */
+	if (!enabled || nrf_esb_is_idle()) {
+		return;
+	}
+
+	silence = k_uptime_get_32() - last_rx_time;
+
+	/* While nothing is received, visit all channels of the hop sequence,
+	 * including the ones blacklisted by the PTX, until the PTX is found.
+	 * If the radio is busy sending an acknowledgment, try again later.
+	 */
+	if ((silence >= CONFIG_NRF_ESB_HOP_RX_TIMEOUT_MS) &&
+	    (nrf_esb_stop_rx() == 0)) {
+		current = (current + 1) % channel_count;
+		(void)nrf_esb_set_rf_channel(channels[current].stats.channel);
+		(void)nrf_esb_start_rx();
+		return;
+	}
+
+	k_delayed_work_submit(&rx_hop_work,
+			      K_MSEC(CONFIG_NRF_ESB_HOP_RX_DWELL_MS));
+}
+
+static u32_t rand_next(u32_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+int nrf_esb_hop_enable(const u8_t *hop_channels, u8_t count, u32_t seed)
+{
+	static bool work_initialized;
+	u32_t rand_state = seed ? seed : 1;
+	int err;
+
+	if (!nrf_esb_is_idle()) {
+		return -EBUSY;
+	}
+	if ((hop_channels == NULL) || (count == 0) ||
+	    (count > CONFIG_NRF_ESB_HOP_CHANNEL_COUNT_MAX)) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (hop_channels[i] > CHANNEL_MAX) {
+			return -EINVAL;
+		}
+	}
+
+	enabled = false;
+
+	if (work_initialized) {
+		k_delayed_work_cancel(&rx_hop_work);
+	} else {
+		k_delayed_work_init(&rx_hop_work, rx_hop_work_handler);
+		work_initialized = true;
+	}
+
+	memset(channels, 0, sizeof(channels));
+	for (size_t i = 0; i < count; i++) {
+		channels[i].stats.channel = hop_channels[i];
+	}
+
+	/* Derive the hop sequence from the seed with a Fisher-Yates shuffle,
+	 * so that the PTX and the PRX use the same sequence.
+	 */
+	for (size_t i = count - 1; i > 0; i--) {
+		size_t j = rand_next(&rand_state) % (i + 1);
+		u8_t channel = channels[i].stats.channel;
+
+		channels[i].stats.channel = channels[j].stats.channel;
+		channels[j].stats.channel = channel;
+	}
+
+	channel_count = count;
+	current = 0;
+	packet_tries = 0;
+	last_rx_time = k_uptime_get_32();
+
+	err = nrf_esb_set_rf_channel(channels[current].stats.channel);
+	if (err) {
+		return err;
+	}
+
+	enabled = true;
+
+	return 0;
+}
+
+int nrf_esb_hop_disable(void)
+{
+	if (!enabled) {
+		return -EALREADY;
+	}
+
+	enabled = false;
+	k_delayed_work_cancel(&rx_hop_work);
+
+	return 0;
+}
+
+int nrf_esb_hop_get_stats(struct nrf_esb_hop_channel_stats *stats,
+			  u8_t *count)
+{
+	u32_t now = k_uptime_get_32();
+	unsigned int key;
+	u8_t n;
+
+	if ((stats == NULL) || (count == NULL)) {
+		return -EINVAL;
+	}
+
+	key = irq_lock();
+
+	n = min(*count, channel_count);
+	for (size_t i = 0; i < n; i++) {
+		channel_usable(&channels[i], now);
+		stats[i] = channels[i].stats;
+	}
+
+	irq_unlock(key);
+
+	*count = n;
+
+	return 0;
+}
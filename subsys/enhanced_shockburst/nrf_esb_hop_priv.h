@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef NRF_ESB_HOP_PRIV_H_
+#define NRF_ESB_HOP_PRIV_H_
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* esb_hop_tx_failed() is called when a packet used all retransmissions on
+ * a channel. It moves the channel to the next one of the hop sequence, and
+ * returns true if the packet should be retried there.
+ */
+#if CONFIG_NRF_ESB_HOP
+void esb_hop_tx_success(u8_t channel);
+bool esb_hop_tx_failed(u8_t *channel);
+void esb_hop_rx(u8_t channel, bool crc_ok);
+void esb_hop_rx_started(void);
+#else
+static inline void esb_hop_tx_success(u8_t channel) {}
+static inline bool esb_hop_tx_failed(u8_t *channel) { return false; }
+static inline void esb_hop_rx(u8_t channel, bool crc_ok) {}
+static inline void esb_hop_rx_started(void) {}
+#endif /* CONFIG_NRF_ESB_HOP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NRF_ESB_HOP_PRIV_H_ */
@@ -0,0 +1,1054 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <errno.h>
+#include <kernel.h>
+#include <misc/__assert.h>
+#include <misc/util.h>
+#include <string.h>
+#include <nrf.h>
+#include <esb_sim.h>
+
+/* Event and task registers are connected through their addresses. */
+BUILD_ASSERT(sizeof(void *) == sizeof(u32_t));
+
+#define PEER_COUNT CONFIG_NRF_ESB_SIM_PEER_COUNT
+#define PEER_NONE 0xFF
+/* Source of the packets sent by the driver. */
+#define SRC_DRIVER 0xFE
+
+/* Maximum number of packets on the medium, including the packets that
+ * ended recently and are kept to detect collisions.
+ */
+#define AIR_PACKETS 16
+/* Time for which a packet is kept after it ended. */
+#define AIR_HOLD_US 20000
+
+/* Time after the end of a packet until a PRX peer sends the
+ * acknowledgment, in addition to the ramp-up time. The PTX is then
+ * listening.
+ */
+#define PEER_ACK_DELAY_US 2
+/* Time after the ramp-up within which a PTX peer expects the
+ * acknowledgment to start.
+ */
+#define PEER_ACK_WINDOW_US 100
+
+#define EVENTS_MAX (8 + 2 * PEER_COUNT)
+
+#define DEFAULT_RAMP_UP_US 130
+
+enum radio_state {
+	RADIO_DISABLED,
+	RADIO_RXRU,
+	RADIO_RXIDLE,
+	RADIO_RX,
+	RADIO_TXRU,
+	RADIO_TXIDLE,
+	RADIO_TX,
+};
+
+enum evt_type {
+	EVT_RADIO_READY,
+	EVT_RADIO_ADDRESS,
+	EVT_RADIO_END,
+	EVT_TIMER_COMPARE,
+	EVT_PEER_TX,
+	EVT_PEER_TX_END,
+	EVT_PEER_RX_END,
+	EVT_PEER_ACK_TIMEOUT,
+};
+
+struct sim_evt {
+	bool used;
+	u8_t type;
+	u8_t node;	/* Timer or peer index. */
+	u8_t arg;	/* Compare channel or packet index. */
+	u32_t seq;	/* Orders events at the same time. */
+	u64_t time;
+};
+
+struct air_packet {
+	u64_t start;
+	u64_t end;
+	u32_t base;
+	u8_t prefix;
+	u8_t channel;
+	u8_t src;
+	u8_t rssi;
+	bool used;
+	bool truncated;
+	u8_t len;
+	u8_t hdr[2];
+	u8_t data[CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH];
+};
+
+enum peer_state {
+	PEER_IDLE,
+	PEER_TX,
+	PEER_WAIT_ACK,
+	PEER_RX,
+};
+
+struct peer {
+	bool used;
+	enum peer_state state;
+	struct esb_sim_peer_config cfg;
+	struct esb_sim_peer_stats stats;
+	u32_t base;
+	u8_t prefix;
+	u8_t rx_pkt;
+	u8_t pid;
+	u8_t attempts;
+	u64_t first_tx;
+	u64_t attempt_tx;
+	/* PRX: last packet received, to detect retransmissions */
+	u8_t last_pid;
+	u32_t last_crc;
+	/* Payload of the current packet or acknowledgment */
+	u8_t len;
+	u8_t data[CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH];
+};
+
+struct sim_timer {
+	bool running;
+	u64_t start;
+	u32_t counter;
+};
+
+NRF_RADIO_Type esb_sim_radio;
+NRF_TIMER_Type esb_sim_timer[5];
+NRF_PPI_Type esb_sim_ppi;
+NRF_FICR_Type esb_sim_ficr = {
+	.DEVICEID = { 0x12345678, 0x9ABCDEF0 },
+};
+
+static enum radio_state radio_state;
+/* Packet being sent or received by the driver. */
+static u8_t radio_pkt = PEER_NONE;
+static u8_t radio_rx_pipe;
+static struct sim_timer timers[ARRAY_SIZE(esb_sim_timer)];
+
+static struct air_packet air[AIR_PACKETS];
+static struct peer peers[PEER_COUNT];
+static struct sim_evt events[EVENTS_MAX];
+static u32_t evt_seq;
+
+static struct esb_sim_medium_config medium = {
+	.ramp_up_us = DEFAULT_RAMP_UP_US,
+	.seed = 1,
+};
+static u32_t rand_state = 1;
+static struct esb_sim_stats stats;
+
+static u32_t last_cycles;
+static u64_t total_cycles;
+
+static K_SEM_DEFINE(wakeup, 0, 1);
+
+static void task_trigger(volatile u32_t *task);
+
+static u64_t now(void)
+{
+	u32_t cycles = k_cycle_get_32();
+
+	total_cycles += cycles - last_cycles;
+	last_cycles = cycles;
+
+	return SYS_CLOCK_HW_CYCLES_TO_NS64(total_cycles) / 1000;
+}
+
+static u32_t rand_get(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
+
+static bool lost(void)
+{
+	if (medium.loss_permille &&
+	    ((rand_get() % 1000) < medium.loss_permille)) {
+		stats.lost++;
+		return true;
+	}
+
+	return false;
+}
+
+static u8_t bit_reverse(u8_t value)
+{
+	u8_t result = 0;
+
+	for (int i = 0; i < 8; i++) {
+		result = (result << 1) | ((value >> i) & 1);
+	}
+
+	return result;
+}
+
+static u32_t crc_len_get(void)
+{
+	return esb_sim_radio.CRCCNF & RADIO_CRCCNF_LEN_Msk;
+}
+
+/* The CRC is modelled with a hash truncated to the configured CRC length,
+ * so that it compares the same way as the CRC received by the hardware.
+ */
+static u32_t crc_get(const struct air_packet *pkt)
+{
+	u32_t hash = 2166136261;
+
+	hash = (hash ^ pkt->hdr[0]) * 16777619;
+	hash = (hash ^ pkt->hdr[1]) * 16777619;
+	for (size_t i = 0; i < pkt->len; i++) {
+		hash = (hash ^ pkt->data[i]) * 16777619;
+	}
+
+	return hash & ((1UL << (8 * crc_len_get())) - 1);
+}
+
+/* Event queue */
+
+static void evt_schedule(u8_t type, u8_t node, u8_t arg, u64_t time)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
+		struct sim_evt *evt = &events[i];
+
+		if (!evt->used) {
+			evt->used = true;
+			evt->type = type;
+			evt->node = node;
+			evt->arg = arg;
+			evt->seq = evt_seq++;
+			evt->time = time;
+			k_sem_give(&wakeup);
+			return;
+		}
+	}
+
+	__ASSERT(false, "Simulation event queue full");
+}
+
+static void evt_cancel(u8_t type, u8_t node)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
+		if (events[i].used && (events[i].type == type) &&
+		    (events[i].node == node)) {
+			events[i].used = false;
+		}
+	}
+}
+
+static struct sim_evt *evt_next(void)
+{
+	struct sim_evt *next = NULL;
+
+	for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
+		struct sim_evt *evt = &events[i];
+
+		if (evt->used &&
+		    (!next || (evt->time < next->time) ||
+		     ((evt->time == next->time) && (evt->seq < next->seq)))) {
+			next = evt;
+		}
+	}
+
+	return next;
+}
+
+/* PPI and interrupts */
+
+static void ppi_event(volatile u32_t *event)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(esb_sim_ppi.CH); i++) {
+		if ((esb_sim_ppi.CHEN & BIT(i)) &&
+		    (esb_sim_ppi.CH[i].EEP == (u32_t)event)) {
+			task_trigger((volatile u32_t *)esb_sim_ppi.CH[i].TEP);
+		}
+	}
+}
+
+static void radio_event(volatile u32_t *event, u32_t int_mask)
+{
+	*event = 1;
+	ppi_event(event);
+
+	if (esb_sim_radio.INTENSET & int_mask) {
+		NVIC_SetPendingIRQ(RADIO_IRQn);
+	}
+}
+
+/* Medium */
+
+static u32_t us_per_byte(void)
+{
+	switch (esb_sim_radio.MODE >> RADIO_MODE_MODE_Pos) {
+	case RADIO_MODE_MODE_Nrf_2Mbit:
+	case RADIO_MODE_MODE_Ble_2Mbit:
+		return 4;
+	case RADIO_MODE_MODE_Nrf_250Kbit:
+		return 32;
+	default:
+		return 8;
+	}
+}
+
+/* Time from the start of a packet to the end of its address. */
+static u32_t address_time(void)
+{
+	u32_t preamble = (us_per_byte() == 4) ? 2 : 1;
+	u32_t balen = (esb_sim_radio.PCNF1 & RADIO_PCNF1_BALEN_Msk) >>
+		      RADIO_PCNF1_BALEN_Pos;
+
+	return (preamble + balen + 1) * us_per_byte();
+}
+
+static u32_t air_time(u8_t len)
+{
+	/* Header of 9 bits rounded up to two bytes */
+	return address_time() + (2 + len + crc_len_get()) * us_per_byte();
+}
+
+static struct air_packet *air_alloc(void)
+{
+	u64_t t = now();
+
+	for (size_t i = 0; i < ARRAY_SIZE(air); i++) {
+		if (!air[i].used || (air[i].end + AIR_HOLD_US < t)) {
+			memset(&air[i], 0, sizeof(air[i]));
+			air[i].used = true;
+			return &air[i];
+		}
+	}
+
+	__ASSERT(false, "Too many packets on the simulated medium");
+	return NULL;
+}
+
+static bool collided(const struct air_packet *pkt)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(air); i++) {
+		const struct air_packet *other = &air[i];
+
+		if ((other != pkt) && other->used &&
+		    (other->channel == pkt->channel) &&
+		    (other->start < pkt->end) && (other->end > pkt->start)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool received_ok(const struct air_packet *pkt)
+{
+	if (pkt->truncated) {
+		return false;
+	}
+
+	if (collided(pkt)) {
+		stats.collisions++;
+		return false;
+	}
+
+	return true;
+}
+
+static void pipe_address(u8_t pipe, u32_t *base, u8_t *prefix)
+{
+	u32_t prefixes = (pipe < 4) ? esb_sim_radio.PREFIX0 :
+				      esb_sim_radio.PREFIX1;
+
+	*base = pipe ? esb_sim_radio.BASE1 : esb_sim_radio.BASE0;
+	*prefix = prefixes >> (8 * (pipe % 4));
+}
+
+static int radio_pipe_match(const struct air_packet *pkt)
+{
+	for (u8_t pipe = 0; pipe < 8; pipe++) {
+		u32_t base;
+		u8_t prefix;
+
+		if (!(esb_sim_radio.RXADDRESSES & BIT(pipe))) {
+			continue;
+		}
+
+		pipe_address(pipe, &base, &prefix);
+		if ((base == pkt->base) && (prefix == pkt->prefix)) {
+			return pipe;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static void peer_listen(u8_t index, struct air_packet *pkt);
+
+static void air_send(struct air_packet *pkt)
+{
+	int pipe;
+
+	pkt->start = now();
+	pkt->end = pkt->start + air_time(pkt->len);
+	stats.transmissions++;
+
+	if ((pkt->src != SRC_DRIVER) && (radio_state == RADIO_RX) &&
+	    (radio_pkt == PEER_NONE) &&
+	    (esb_sim_radio.FREQUENCY == pkt->channel)) {
+		pipe = radio_pipe_match(pkt);
+		if ((pipe >= 0) && !lost()) {
+			radio_pkt = pkt - air;
+			radio_rx_pipe = pipe;
+			evt_schedule(EVT_RADIO_ADDRESS, 0, 0,
+				     pkt->start + address_time());
+			evt_schedule(EVT_RADIO_END, 0, 0, pkt->end);
+		}
+	}
+
+	for (u8_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		if (peers[i].used && (i != pkt->src)) {
+			peer_listen(i, pkt);
+		}
+	}
+}
+
+/* Radio of the driver */
+
+static void radio_enable(enum radio_state ramp_up)
+{
+	if (radio_state != RADIO_DISABLED) {
+		return;
+	}
+
+	radio_state = ramp_up;
+	evt_schedule(EVT_RADIO_READY, 0, 0, now() + medium.ramp_up_us);
+}
+
+static void radio_tx(void)
+{
+	const u8_t *buf = (const u8_t *)esb_sim_radio.PACKETPTR;
+	u32_t lflen = (esb_sim_radio.PCNF0 & RADIO_PCNF0_LFLEN_Msk) >>
+		      RADIO_PCNF0_LFLEN_Pos;
+	u32_t statlen = (esb_sim_radio.PCNF1 & RADIO_PCNF1_STATLEN_Msk) >>
+			RADIO_PCNF1_STATLEN_Pos;
+	u32_t maxlen = (esb_sim_radio.PCNF1 & RADIO_PCNF1_MAXLEN_Msk) >>
+		       RADIO_PCNF1_MAXLEN_Pos;
+	struct air_packet *pkt = air_alloc();
+
+	/* The packet in RAM is S0 or LENGTH, S1, and the payload */
+	pkt->len = lflen ? (buf[0] & ((1 << lflen) - 1)) : statlen;
+	maxlen = min(maxlen, CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH);
+	pkt->len = min(pkt->len, maxlen);
+	pkt->hdr[0] = buf[0];
+	pkt->hdr[1] = buf[1];
+	memcpy(pkt->data, &buf[2], pkt->len);
+
+	pipe_address(esb_sim_radio.TXADDRESS, &pkt->base, &pkt->prefix);
+	pkt->channel = esb_sim_radio.FREQUENCY;
+	pkt->src = SRC_DRIVER;
+
+	radio_state = RADIO_TX;
+	radio_pkt = pkt - air;
+
+	air_send(pkt);
+
+	evt_schedule(EVT_RADIO_ADDRESS, 0, 0, pkt->start + address_time());
+	evt_schedule(EVT_RADIO_END, 0, 0, pkt->end);
+}
+
+static void radio_start(void)
+{
+	if (radio_state == RADIO_TXIDLE) {
+		radio_tx();
+	} else if (radio_state == RADIO_RXIDLE) {
+		radio_state = RADIO_RX;
+		radio_pkt = PEER_NONE;
+	}
+}
+
+static void radio_disable(void)
+{
+	evt_cancel(EVT_RADIO_READY, 0);
+	evt_cancel(EVT_RADIO_ADDRESS, 0);
+	evt_cancel(EVT_RADIO_END, 0);
+
+	if ((radio_state == RADIO_TX) && (radio_pkt != PEER_NONE)) {
+		air[radio_pkt].end = now();
+		air[radio_pkt].truncated = true;
+	}
+
+	radio_state = RADIO_DISABLED;
+	radio_pkt = PEER_NONE;
+
+	radio_event(&esb_sim_radio.EVENTS_DISABLED,
+		    RADIO_INTENSET_DISABLED_Msk);
+
+	if (esb_sim_radio.SHORTS & RADIO_SHORTS_DISABLED_TXEN_Msk) {
+		radio_enable(RADIO_TXRU);
+	} else if (esb_sim_radio.SHORTS & RADIO_SHORTS_DISABLED_RXEN_Msk) {
+		radio_enable(RADIO_RXRU);
+	}
+}
+
+static void radio_ready(void)
+{
+	radio_state = (radio_state == RADIO_TXRU) ? RADIO_TXIDLE :
+						    RADIO_RXIDLE;
+
+	radio_event(&esb_sim_radio.EVENTS_READY, RADIO_INTENSET_READY_Msk);
+
+	if (esb_sim_radio.SHORTS & RADIO_SHORTS_READY_START_Msk) {
+		radio_start();
+	}
+}
+
+static void radio_rx_end(void)
+{
+	struct air_packet *pkt = &air[radio_pkt];
+	u8_t *buf = (u8_t *)esb_sim_radio.PACKETPTR;
+	u32_t lflen = (esb_sim_radio.PCNF0 & RADIO_PCNF0_LFLEN_Msk) >>
+		      RADIO_PCNF0_LFLEN_Pos;
+	u32_t statlen = (esb_sim_radio.PCNF1 & RADIO_PCNF1_STATLEN_Msk) >>
+			RADIO_PCNF1_STATLEN_Pos;
+	u32_t maxlen = (esb_sim_radio.PCNF1 & RADIO_PCNF1_MAXLEN_Msk) >>
+		       RADIO_PCNF1_MAXLEN_Pos;
+	u8_t len = lflen ? min(pkt->len, maxlen) : statlen;
+
+	buf[0] = lflen ? len : pkt->hdr[0];
+	buf[1] = pkt->hdr[1];
+	memset(&buf[2], 0, len);
+	memcpy(&buf[2], pkt->data, min(len, pkt->len));
+
+	esb_sim_radio.CRCSTATUS = received_ok(pkt);
+	esb_sim_radio.RXCRC = crc_get(pkt);
+	esb_sim_radio.RXMATCH = radio_rx_pipe;
+	esb_sim_radio.RSSISAMPLE = pkt->rssi;
+
+	radio_event(&esb_sim_radio.EVENTS_PAYLOAD, RADIO_INTENSET_PAYLOAD_Msk);
+}
+
+static void radio_end(void)
+{
+	if (radio_state == RADIO_RX) {
+		radio_rx_end();
+		radio_state = RADIO_RXIDLE;
+	} else {
+		radio_state = RADIO_TXIDLE;
+	}
+
+	radio_pkt = PEER_NONE;
+
+	radio_event(&esb_sim_radio.EVENTS_END, RADIO_INTENSET_END_Msk);
+
+	if (esb_sim_radio.SHORTS & RADIO_SHORTS_END_DISABLE_Msk) {
+		radio_disable();
+	}
+}
+
+/* Timers, counting at 1 MHz */
+
+static u32_t timer_mask(const NRF_TIMER_Type *timer)
+{
+	switch (timer->BITMODE) {
+	case TIMER_BITMODE_BITMODE_08Bit:
+		return 0xFF;
+	case TIMER_BITMODE_BITMODE_24Bit:
+		return 0xFFFFFF;
+	case TIMER_BITMODE_BITMODE_32Bit:
+		return 0xFFFFFFFF;
+	default:
+		return 0xFFFF;
+	}
+}
+
+static u32_t timer_counter(u8_t index)
+{
+	struct sim_timer *t = &timers[index];
+
+	if (!t->running) {
+		return t->counter;
+	}
+
+	return (t->counter + (now() - t->start)) &
+	       timer_mask(&esb_sim_timer[index]);
+}
+
+static void timer_schedule(u8_t index)
+{
+	NRF_TIMER_Type *timer = &esb_sim_timer[index];
+	u32_t counter = timer_counter(index);
+	u64_t t = now();
+
+	evt_cancel(EVT_TIMER_COMPARE, index);
+
+	if (!timers[index].running) {
+		return;
+	}
+
+	for (u8_t i = 0; i < ARRAY_SIZE(timer->CC); i++) {
+		u32_t cc = timer->CC[i] & timer_mask(timer);
+
+		if (cc > counter) {
+			evt_schedule(EVT_TIMER_COMPARE, index, i,
+				     t + (cc - counter));
+		}
+	}
+}
+
+static void timer_task(u8_t index, volatile u32_t *task)
+{
+	NRF_TIMER_Type *timer = &esb_sim_timer[index];
+	struct sim_timer *t = &timers[index];
+
+	if (task == &timer->TASKS_START) {
+		if (t->running) {
+			return;
+		}
+		t->start = now();
+		t->running = true;
+	} else if (task == &timer->TASKS_STOP) {
+		t->counter = timer_counter(index);
+		t->running = false;
+	} else if (task == &timer->TASKS_CLEAR) {
+		t->counter = 0;
+		t->start = now();
+	} else if (task == &timer->TASKS_SHUTDOWN) {
+		t->counter = 0;
+		t->running = false;
+	}
+
+	timer_schedule(index);
+}
+
+static void timer_compare(u8_t index, u8_t cc)
+{
+	NRF_TIMER_Type *timer = &esb_sim_timer[index];
+
+	timer->EVENTS_COMPARE[cc] = 1;
+	ppi_event(&timer->EVENTS_COMPARE[cc]);
+
+	if (timer->SHORTS & BIT(TIMER_SHORTS_COMPARE0_CLEAR_Pos + cc)) {
+		timers[index].counter = 0;
+		timers[index].start = now();
+	}
+	if (timer->SHORTS & BIT(TIMER_SHORTS_COMPARE0_STOP_Pos + cc)) {
+		timers[index].counter = timer_counter(index);
+		timers[index].running = false;
+	}
+
+	timer_schedule(index);
+
+	if (timer->INTENSET & BIT(TIMER_INTENSET_COMPARE0_Pos + cc)) {
+		NVIC_SetPendingIRQ(TIMER0_IRQn + index);
+	}
+}
+
+static void task_trigger(volatile u32_t *task)
+{
+	if (task == &esb_sim_radio.TASKS_TXEN) {
+		radio_enable(RADIO_TXRU);
+	} else if (task == &esb_sim_radio.TASKS_RXEN) {
+		radio_enable(RADIO_RXRU);
+	} else if (task == &esb_sim_radio.TASKS_START) {
+		radio_start();
+	} else if (task == &esb_sim_radio.TASKS_DISABLE) {
+		radio_disable();
+	} else {
+		for (u8_t i = 0; i < ARRAY_SIZE(esb_sim_timer); i++) {
+			if ((task >= &esb_sim_timer[i].TASKS_START) &&
+			    (task <= &esb_sim_timer[i].TASKS_SHUTDOWN)) {
+				timer_task(i, task);
+			}
+		}
+	}
+}
+
+void esb_sim_task(volatile u32_t *task)
+{
+	unsigned int key = irq_lock();
+
+	task_trigger(task);
+	irq_unlock(key);
+}
+
+void esb_sim_reg_set(volatile u32_t *reg, u32_t mask)
+{
+	unsigned int key = irq_lock();
+	const NRF_RADIO_Type *r = &esb_sim_radio;
+
+	*reg |= mask;
+
+	/* Enabling the interrupt of a pending event raises the interrupt */
+	if ((reg == &esb_sim_radio.INTENSET) &&
+	    (((mask & RADIO_INTENSET_READY_Msk) && r->EVENTS_READY) ||
+	     ((mask & RADIO_INTENSET_END_Msk) && r->EVENTS_END) ||
+	     ((mask & RADIO_INTENSET_DISABLED_Msk) && r->EVENTS_DISABLED))) {
+		NVIC_SetPendingIRQ(RADIO_IRQn);
+	}
+
+	irq_unlock(key);
+}
+
+void esb_sim_reg_clr(volatile u32_t *reg, u32_t mask)
+{
+	unsigned int key = irq_lock();
+
+	*reg &= ~mask;
+	irq_unlock(key);
+}
+
+/* Peers */
+
+static void peer_payload_get(struct peer *peer)
+{
+	if (peer->cfg.payload_cb) {
+		peer->len = peer->cfg.payload_cb(peer - peers, peer->data,
+						 sizeof(peer->data));
+		peer->len = min(peer->len, sizeof(peer->data));
+	} else {
+		peer->len = min(peer->cfg.payload_length, sizeof(peer->data));
+		memset(peer->data, peer - peers, peer->len);
+	}
+}
+
+static void peer_next_packet(struct peer *peer)
+{
+	u64_t t = max(now(), peer->first_tx + peer->cfg.interval_us);
+
+	peer->attempts = 0;
+	peer->state = PEER_IDLE;
+	evt_schedule(EVT_PEER_TX, peer - peers, 0, t);
+}
+
+static void peer_retry(struct peer *peer)
+{
+	if (peer->attempts > peer->cfg.retransmit_count) {
+		peer->stats.tx_failed++;
+		peer->pid = (peer->pid + 1) & 0x03;
+		peer_next_packet(peer);
+		return;
+	}
+
+	peer->state = PEER_IDLE;
+	evt_schedule(EVT_PEER_TX, peer - peers, 0,
+		     max(now(), peer->attempt_tx +
+				peer->cfg.retransmit_delay_us));
+}
+
+static void peer_tx(struct peer *peer)
+{
+	struct air_packet *pkt = air_alloc();
+	u8_t index = peer - peers;
+
+	pkt->base = peer->base;
+	pkt->prefix = peer->prefix;
+	pkt->channel = peer->cfg.channel;
+	pkt->src = index;
+	pkt->rssi = peer->cfg.rssi;
+
+	if (peer->cfg.role == ESB_SIM_PEER_PTX) {
+		if (peer->attempts++ == 0) {
+			peer->first_tx = now();
+			peer_payload_get(peer);
+		}
+		peer->attempt_tx = now();
+		/* Request an acknowledgment */
+		pkt->hdr[1] = (peer->pid << 1) | 0x01;
+	} else {
+		pkt->hdr[1] = peer->last_pid << 1;
+	}
+
+	/* Retransmissions repeat the payload */
+	pkt->len = peer->len;
+	pkt->hdr[0] = pkt->len;
+	memcpy(pkt->data, peer->data, pkt->len);
+
+	peer->stats.tx_packets++;
+	peer->state = PEER_TX;
+
+	air_send(pkt);
+	evt_schedule(EVT_PEER_TX_END, index, 0, pkt->end);
+}
+
+static void peer_tx_end(struct peer *peer)
+{
+	if (peer->cfg.role == ESB_SIM_PEER_PRX) {
+		peer->state = PEER_IDLE;
+		return;
+	}
+
+	peer->state = PEER_WAIT_ACK;
+	evt_schedule(EVT_PEER_ACK_TIMEOUT, peer - peers, 0,
+		     now() + medium.ramp_up_us + PEER_ACK_WINDOW_US);
+}
+
+static void peer_listen(u8_t index, struct air_packet *pkt)
+{
+	struct peer *peer = &peers[index];
+	bool listening = (peer->cfg.role == ESB_SIM_PEER_PRX) ?
+				 (peer->state == PEER_IDLE) :
+				 (peer->state == PEER_WAIT_ACK);
+
+	if (!listening || (pkt->channel != peer->cfg.channel) ||
+	    (pkt->base != peer->base) || (pkt->prefix != peer->prefix) ||
+	    lost()) {
+		return;
+	}
+
+	evt_cancel(EVT_PEER_ACK_TIMEOUT, index);
+	peer->state = PEER_RX;
+	peer->rx_pkt = pkt - air;
+	evt_schedule(EVT_PEER_RX_END, index, 0, pkt->end);
+}
+
+static void peer_rx_end(struct peer *peer)
+{
+	struct air_packet *pkt = &air[peer->rx_pkt];
+	bool ok = received_ok(pkt);
+
+	if (!ok) {
+		peer->stats.rx_crc_errors++;
+	}
+
+	if (peer->cfg.role == ESB_SIM_PEER_PTX) {
+		u32_t latency;
+
+		if (!ok) {
+			peer_retry(peer);
+			return;
+		}
+
+		latency = now() - peer->first_tx;
+		peer->stats.tx_success++;
+		peer->stats.latency_us += latency;
+		peer->stats.latency_us_max =
+			max(peer->stats.latency_us_max, latency);
+
+		if (pkt->len) {
+			peer->stats.rx_packets++;
+			peer->stats.rx_bytes += pkt->len;
+			if (peer->cfg.rx_cb) {
+				peer->cfg.rx_cb(peer - peers, pkt->data,
+						pkt->len);
+			}
+		}
+
+		peer->pid = (peer->pid + 1) & 0x03;
+		peer_next_packet(peer);
+		return;
+	}
+
+	peer->state = PEER_IDLE;
+	if (!ok) {
+		return;
+	}
+
+	/* A retransmission has the same packet ID and CRC */
+	if (((pkt->hdr[1] >> 1) != peer->last_pid) ||
+	    (crc_get(pkt) != peer->last_crc)) {
+		peer->last_pid = pkt->hdr[1] >> 1;
+		peer->last_crc = crc_get(pkt);
+		peer->stats.rx_packets++;
+		peer->stats.rx_bytes += pkt->len;
+		if (peer->cfg.rx_cb) {
+			peer->cfg.rx_cb(peer - peers, pkt->data, pkt->len);
+		}
+		if (pkt->hdr[1] & 0x01) {
+			peer_payload_get(peer);
+		}
+	}
+
+	if (pkt->hdr[1] & 0x01) {
+		peer->state = PEER_TX;
+		evt_schedule(EVT_PEER_TX, peer - peers, 0,
+			     now() + medium.ramp_up_us + PEER_ACK_DELAY_US);
+	}
+}
+
+static void evt_process(const struct sim_evt *evt)
+{
+	switch (evt->type) {
+	case EVT_RADIO_READY:
+		radio_ready();
+		break;
+
+	case EVT_RADIO_ADDRESS:
+		radio_event(&esb_sim_radio.EVENTS_ADDRESS,
+			    RADIO_INTENSET_ADDRESS_Msk);
+		break;
+
+	case EVT_RADIO_END:
+		radio_end();
+		break;
+
+	case EVT_TIMER_COMPARE:
+		timer_compare(evt->node, evt->arg);
+		break;
+
+	case EVT_PEER_TX:
+		peer_tx(&peers[evt->node]);
+		break;
+
+	case EVT_PEER_TX_END:
+		peer_tx_end(&peers[evt->node]);
+		break;
+
+	case EVT_PEER_RX_END:
+		peer_rx_end(&peers[evt->node]);
+		break;
+
+	case EVT_PEER_ACK_TIMEOUT:
+		peer_retry(&peers[evt->node]);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void sim_thread(void)
+{
+	for (;;) {
+		unsigned int key = irq_lock();
+		struct sim_evt *evt = evt_next();
+		u64_t t = now();
+		struct sim_evt current;
+
+		if (evt && (evt->time <= t)) {
+			current = *evt;
+			evt->used = false;
+			evt_process(&current);
+			irq_unlock(key);
+			continue;
+		}
+
+		irq_unlock(key);
+
+		/* Short waits advance the simulated time without leaving
+		 * the thread, so that the radio timing is kept. Threads of
+		 * the application preempt the simulation when they are
+		 * woken up.
+		 */
+		if (!evt) {
+			k_sem_take(&wakeup, K_FOREVER);
+		} else if (evt->time - t >= 1000) {
+			k_sem_take(&wakeup, K_MSEC((evt->time - t) / 1000));
+		} else {
+			k_busy_wait(evt->time - t);
+		}
+	}
+}
+
+K_THREAD_DEFINE(esb_sim, CONFIG_NRF_ESB_SIM_STACK_SIZE, sim_thread,
+		NULL, NULL, NULL,
+		K_PRIO_PREEMPT(CONFIG_NRF_ESB_SIM_PRIORITY), 0, K_NO_WAIT);
+
+void esb_sim_medium_configure(const struct esb_sim_medium_config *config)
+{
+	unsigned int key = irq_lock();
+
+	medium = *config;
+	rand_state = config->seed ? config->seed : 1;
+	irq_unlock(key);
+}
+
+int esb_sim_peer_add(const struct esb_sim_peer_config *config)
+{
+	unsigned int key = irq_lock();
+
+	for (u8_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		struct peer *peer = &peers[i];
+
+		if (peer->used) {
+			continue;
+		}
+
+		memset(peer, 0, sizeof(*peer));
+		peer->used = true;
+		peer->cfg = *config;
+		peer->base = (bit_reverse(config->base_addr[0]) << 24) |
+			     (bit_reverse(config->base_addr[1]) << 16) |
+			     (bit_reverse(config->base_addr[2]) << 8) |
+			     bit_reverse(config->base_addr[3]);
+		peer->prefix = bit_reverse(config->prefix);
+		peer->last_pid = 0xFF;
+		peer->first_tx = now();
+
+		if (config->role == ESB_SIM_PEER_PTX) {
+			evt_schedule(EVT_PEER_TX, i, 0, now());
+		}
+
+		irq_unlock(key);
+		return i;
+	}
+
+	irq_unlock(key);
+
+	return -ENOMEM;
+}
+
+void esb_sim_peers_clear(void)
+{
+	unsigned int key = irq_lock();
+
+	for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
+		if (events[i].type >= EVT_PEER_TX) {
+			events[i].used = false;
+		}
+	}
+
+	memset(peers, 0, sizeof(peers));
+	irq_unlock(key);
+}
+
+int esb_sim_peer_stats_get(int peer, struct esb_sim_peer_stats *peer_stats)
+{
+	unsigned int key;
+
+	if ((peer < 0) || (peer >= (int)ARRAY_SIZE(peers)) ||
+	    !peers[peer].used) {
+		return -EINVAL;
+	}
+
+	key = irq_lock();
+	*peer_stats = peers[peer].stats;
+	irq_unlock(key);
+
+	return 0;
+}
+
+void esb_sim_stats_get(struct esb_sim_stats *medium_stats)
+{
+	unsigned int key = irq_lock();
+
+	*medium_stats = stats;
+	irq_unlock(key);
+}
+
+void esb_sim_stats_reset(void)
+{
+	unsigned int key = irq_lock();
+
+	memset(&stats, 0, sizeof(stats));
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		memset(&peers[i].stats, 0, sizeof(peers[i].stats));
+	}
+
+	irq_unlock(key);
+}
+
+u64_t esb_sim_time_us(void)
+{
+	unsigned int key = irq_lock();
+	u64_t t = now();
+
+	irq_unlock(key);
+
+	return t;
+}
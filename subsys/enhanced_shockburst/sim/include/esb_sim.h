@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ESB_SIM_H_
+#define ESB_SIM_H_
+
+/**
+ * @file
+ * @defgroup esb_sim Enhanced ShockBurst radio simulation
+ * @{
+ * @brief Simulated radio medium for the Enhanced ShockBurst driver.
+ *
+ * The driver runs unchanged on simulated radio, timer, and PPI
+ * peripherals. Other devices on the medium are simulated peers that
+ * implement the PTX or PRX side of the protocol with dynamic payload
+ * length. Peers use the same bitrate as the driver. By default, peers send
+ * dummy payloads; callbacks can provide the payloads and receive the
+ * payloads of the driver, to simulate a protocol on top of ESB.
+ */
+
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Configuration of the simulated medium.
+ *
+ * @param loss_permille Share of receptions that are lost, in 1/1000.
+ * @param ramp_up_us Time from enabling the radio until it is ready
+ *		     (in microseconds).
+ * @param seed Seed of the random packet loss.
+ */
+struct esb_sim_medium_config {
+	u32_t loss_permille;
+	u32_t ramp_up_us;
+	u32_t seed;
+};
+
+/** Role of a simulated peer. */
+enum esb_sim_peer_role {
+	/** Send packets and wait for acknowledgments. */
+	ESB_SIM_PEER_PTX,
+
+	/** Receive packets and acknowledge them. */
+	ESB_SIM_PEER_PRX,
+};
+
+/** @brief Callback to provide the payload of a simulated peer.
+ *
+ * Called from the simulation thread with interrupts locked, so it must not
+ * block.
+ *
+ * @param peer Index of the peer.
+ * @param[out] data Payload.
+ * @param size Size of the payload buffer.
+ *
+ * @return Length of the payload.
+ */
+typedef u8_t (*esb_sim_peer_payload_cb_t)(int peer, u8_t *data, u8_t size);
+
+/** @brief Callback to pass a received payload to a simulated peer.
+ *
+ * Called from the simulation thread with interrupts locked, so it must not
+ * block.
+ *
+ * @param peer Index of the peer.
+ * @param data Payload.
+ * @param len Length of the payload.
+ */
+typedef void (*esb_sim_peer_rx_cb_t)(int peer, const u8_t *data, u8_t len);
+
+/** @brief Configuration of a simulated peer.
+ *
+ * @param role Role of the peer.
+ * @param base_addr Base address, as passed to nrf_esb_set_base_address_0().
+ * @param prefix Address prefix.
+ * @param channel Radio channel.
+ * @param rssi RSSI of the packets of the peer, in -dBm.
+ * @param payload_length PTX: length of the packets sent.
+ *			 PRX: length of the ACK payloads, or zero for empty
+ *			 acknowledgments.
+ * @param interval_us PTX: time between the first transmissions of two
+ *		      packets (in microseconds). Zero sends the next packet
+ *		      as soon as the previous one is done.
+ * @param retransmit_delay_us PTX: time between transmission attempts
+ *			      (in microseconds).
+ * @param retransmit_count PTX: number of retransmissions.
+ * @param payload_cb Optional. PTX: called for each new packet. PRX: called
+ *		     for each new packet that requests an acknowledgment,
+ *		     after rx_cb, to fill the ACK payload. Replaces the
+ *		     dummy payload of payload_length bytes.
+ * @param rx_cb Optional. PRX: called for each received packet, without
+ *		retransmissions. PTX: called for each ACK payload.
+ */
+struct esb_sim_peer_config {
+	enum esb_sim_peer_role role;
+	u8_t base_addr[4];
+	u8_t prefix;
+	u8_t channel;
+	u8_t rssi;
+	u8_t payload_length;
+	u32_t interval_us;
+	u32_t retransmit_delay_us;
+	u8_t retransmit_count;
+	esb_sim_peer_payload_cb_t payload_cb;
+	esb_sim_peer_rx_cb_t rx_cb;
+};
+
+/** @brief Statistics of a simulated peer.
+ *
+ * @param tx_packets Number of transmissions, including retransmissions and
+ *		     acknowledgments.
+ * @param tx_success PTX: number of acknowledged packets.
+ * @param tx_failed PTX: number of packets that were not acknowledged.
+ * @param rx_packets PRX: number of received packets, without
+ *		     retransmissions. PTX: number of ACK payloads.
+ * @param rx_bytes Number of payload bytes in rx_packets.
+ * @param rx_crc_errors Number of corrupted receptions.
+ * @param latency_us PTX: total time from the first transmission of a
+ *		     packet to its acknowledgment (in microseconds).
+ * @param latency_us_max PTX: longest time from the first transmission of a
+ *			 packet to its acknowledgment (in microseconds).
+ */
+struct esb_sim_peer_stats {
+	u32_t tx_packets;
+	u32_t tx_success;
+	u32_t tx_failed;
+	u32_t rx_packets;
+	u32_t rx_bytes;
+	u32_t rx_crc_errors;
+	u64_t latency_us;
+	u32_t latency_us_max;
+};
+
+/** @brief Statistics of the simulated medium.
+ *
+ * @param transmissions Number of packets sent by all devices.
+ * @param collisions Number of receptions corrupted by another packet on the
+ *		     same channel.
+ * @param lost Number of receptions lost to the configured packet loss.
+ */
+struct esb_sim_stats {
+	u32_t transmissions;
+	u32_t collisions;
+	u32_t lost;
+};
+
+/** @brief Configure the simulated medium.
+ *
+ * @param config Configuration.
+ */
+void esb_sim_medium_configure(const struct esb_sim_medium_config *config);
+
+/** @brief Add a simulated peer.
+ *
+ * A PTX peer starts sending immediately.
+ *
+ * @param config Configuration.
+ *
+ * @return Index of the peer on success or (negative) error code otherwise.
+ */
+int esb_sim_peer_add(const struct esb_sim_peer_config *config);
+
+/** @brief Remove all simulated peers.
+ */
+void esb_sim_peers_clear(void);
+
+/** @brief Get the statistics of a simulated peer.
+ *
+ * @param peer Index of the peer.
+ * @param[out] stats Statistics.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int esb_sim_peer_stats_get(int peer, struct esb_sim_peer_stats *stats);
+
+/** @brief Get the statistics of the simulated medium.
+ *
+ * @param[out] stats Statistics.
+ */
+void esb_sim_stats_get(struct esb_sim_stats *stats);
+
+/** @brief Reset the statistics of the medium and of all peers.
+ */
+void esb_sim_stats_reset(void);
+
+/** @brief Get the simulation time.
+ *
+ * @return Time in microseconds.
+ */
+u64_t esb_sim_time_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ESB_SIM_H_ */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ESB_SIM_HW_H_
+#define ESB_SIM_HW_H_
+
+/* Simulated nRF5 peripherals used by the Enhanced ShockBurst driver.
+ *
+ * Only the registers used by the driver are provided. Registers are plain
+ * memory, except for the tasks and the set and clear registers, which are
+ * written through esb_sim_task(), esb_sim_reg_set(), and esb_sim_reg_clr().
+ * The INTENSET and CHEN registers hold the enabled interrupts and PPI
+ * channels.
+ */
+
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	volatile u32_t TASKS_TXEN;
+	volatile u32_t TASKS_RXEN;
+	volatile u32_t TASKS_START;
+	volatile u32_t TASKS_STOP;
+	volatile u32_t TASKS_DISABLE;
+	volatile u32_t EVENTS_READY;
+	volatile u32_t EVENTS_ADDRESS;
+	volatile u32_t EVENTS_PAYLOAD;
+	volatile u32_t EVENTS_END;
+	volatile u32_t EVENTS_DISABLED;
+	volatile u32_t EVENTS_BCMATCH;
+	volatile u32_t SHORTS;
+	volatile u32_t INTENSET;
+	volatile u32_t INTENCLR;
+	volatile u32_t CRCSTATUS;
+	volatile u32_t RXMATCH;
+	volatile u32_t RXCRC;
+	volatile u32_t PACKETPTR;
+	volatile u32_t FREQUENCY;
+	volatile u32_t TXPOWER;
+	volatile u32_t MODE;
+	volatile u32_t PCNF0;
+	volatile u32_t PCNF1;
+	volatile u32_t BASE0;
+	volatile u32_t BASE1;
+	volatile u32_t PREFIX0;
+	volatile u32_t PREFIX1;
+	volatile u32_t TXADDRESS;
+	volatile u32_t RXADDRESSES;
+	volatile u32_t CRCCNF;
+	volatile u32_t CRCPOLY;
+	volatile u32_t CRCINIT;
+	volatile u32_t RSSISAMPLE;
+	volatile u32_t BCC;
+	volatile u32_t MODECNF0;
+} NRF_RADIO_Type;
+
+typedef struct {
+	volatile u32_t TASKS_START;
+	volatile u32_t TASKS_STOP;
+	volatile u32_t TASKS_CLEAR;
+	volatile u32_t TASKS_SHUTDOWN;
+	volatile u32_t EVENTS_COMPARE[4];
+	volatile u32_t SHORTS;
+	volatile u32_t INTENSET;
+	volatile u32_t INTENCLR;
+	volatile u32_t MODE;
+	volatile u32_t BITMODE;
+	volatile u32_t PRESCALER;
+	volatile u32_t CC[4];
+} NRF_TIMER_Type;
+
+typedef struct {
+	volatile u32_t CHEN;
+	volatile u32_t CHENSET;
+	volatile u32_t CHENCLR;
+	struct {
+		volatile u32_t EEP;
+		volatile u32_t TEP;
+	} CH[20];
+} NRF_PPI_Type;
+
+typedef struct {
+	volatile u32_t DEVICEID[2];
+	struct {
+		volatile u32_t PART;
+		volatile u32_t VARIANT;
+	} INFO;
+} NRF_FICR_Type;
+
+extern NRF_RADIO_Type esb_sim_radio;
+extern NRF_TIMER_Type esb_sim_timer[5];
+extern NRF_PPI_Type esb_sim_ppi;
+extern NRF_FICR_Type esb_sim_ficr;
+
+#define NRF_RADIO (&esb_sim_radio)
+#define NRF_TIMER0 (&esb_sim_timer[0])
+#define NRF_TIMER1 (&esb_sim_timer[1])
+#define NRF_TIMER2 (&esb_sim_timer[2])
+#define NRF_TIMER3 (&esb_sim_timer[3])
+#define NRF_TIMER4 (&esb_sim_timer[4])
+#define NRF_PPI (&esb_sim_ppi)
+#define NRF_FICR (&esb_sim_ficr)
+
+/* Interrupt lines of the simulated peripherals. */
+#define RADIO_IRQn 1
+#define TIMER0_IRQn 8
+#define TIMER1_IRQn 9
+#define TIMER2_IRQn 10
+#define TIMER3_IRQn 11
+#define TIMER4_IRQn 12
+#define SWI0_IRQn 20
+
+/** @brief Trigger a task of a simulated peripheral. */
+void esb_sim_task(volatile u32_t *task);
+
+/** @brief Set bits in a register, like writing to a SET register. */
+void esb_sim_reg_set(volatile u32_t *reg, u32_t mask);
+
+/** @brief Clear bits in a register, like writing to a CLR register. */
+void esb_sim_reg_clr(volatile u32_t *reg, u32_t mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ESB_SIM_HW_H_ */
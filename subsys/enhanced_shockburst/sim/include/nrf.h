@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ESB_SIM_NRF_H_
+#define ESB_SIM_NRF_H_
+
+/* Replaces the nRF MDK device header when the Enhanced ShockBurst driver
+ * runs on the simulated radio. The register bit fields are taken from the
+ * MDK, the registers from the simulation.
+ */
+
+#include <nrf52_bitfields.h>
+#include <board_irq.h>
+#include <esb_sim_hw.h>
+
+#define NVIC_SetPendingIRQ(irq) posix_sw_set_pending_IRQ(irq)
+#define NVIC_ClearPendingIRQ(irq) posix_sw_clear_pending_IRQ(irq)
+
+static inline u32_t __REV(u32_t value)
+{
+	return __builtin_bswap32(value);
+}
+
+static inline u32_t __RBIT(u32_t value)
+{
+	u32_t result = 0;
+
+	for (int i = 0; i < 32; i++) {
+		result = (result << 1) | ((value >> i) & 1);
+	}
+
+	return result;
+}
+
+#endif /* ESB_SIM_NRF_H_ */
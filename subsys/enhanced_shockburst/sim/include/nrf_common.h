@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ESB_SIM_NRF_COMMON_H_
+#define ESB_SIM_NRF_COMMON_H_
+
+/* Interrupt numbers used by the Enhanced ShockBurst driver on the
+ * simulated radio.
+ */
+
+#include <esb_sim_hw.h>
+
+#define NRF5_IRQ_RADIO_IRQn RADIO_IRQn
+#define NRF5_IRQ_SWI0_IRQn SWI0_IRQn
+
+#endif /* ESB_SIM_NRF_COMMON_H_ */
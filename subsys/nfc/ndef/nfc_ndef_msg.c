@@ -32,12 +32,47 @@ static enum nfc_ndef_record_location record_location_get(u32_t index,
 	return record_location;
 }
 
+int nfc_ndef_msg_size_get(struct nfc_ndef_msg_desc const *ndef_msg_desc,
+			  u32_t *msg_len)
+{
+	u32_t sum_of_len = 0;
+
+	if (!ndef_msg_desc || !msg_len || !ndef_msg_desc->record) {
+		return -EINVAL;
+	}
+
+	if (IS_ENABLED(CONFIG_NFC_NDEF_MSG_WITH_NLEN)) {
+		sum_of_len += NLEN_FIELD_SIZE;
+	}
+
+	for (u32_t i = 0; i < ndef_msg_desc->record_count; i++) {
+		u32_t record_len;
+		int err;
+
+		err = nfc_ndef_record_size_get(ndef_msg_desc->record[i],
+					       &record_len);
+		if (err) {
+			return err;
+		}
+
+		sum_of_len += record_len;
+	}
+
+	*msg_len = sum_of_len;
+
+	return 0;
+}
+
 int nfc_ndef_msg_encode(struct nfc_ndef_msg_desc const *ndef_msg_desc,
 			u8_t *msg_buffer,
 			u32_t *msg_len)
 {
 	u32_t sum_of_len = 0;
 
+	if (!msg_buffer) {
+		return nfc_ndef_msg_size_get(ndef_msg_desc, msg_len);
+	}
+
 	if (!ndef_msg_desc || !msg_len) {
 		return -EINVAL;
 	}
@@ -68,8 +103,7 @@ int nfc_ndef_msg_encode(struct nfc_ndef_msg_desc const *ndef_msg_desc,
 
 		err = nfc_ndef_record_encode(*pp_record_rec_desc,
 					     record_location,
-					     msg_buffer ?
-						&msg_buffer[sum_of_len] : NULL,
+					     &msg_buffer[sum_of_len],
 					     &temp_len);
 		if (err) {
 			return err;
@@ -81,13 +115,11 @@ int nfc_ndef_msg_encode(struct nfc_ndef_msg_desc const *ndef_msg_desc,
 		pp_record_rec_desc++;
 	}
 	if (IS_ENABLED(CONFIG_NFC_NDEF_MSG_WITH_NLEN)) {
-		if (msg_buffer) {
-			if (sum_of_len - NLEN_FIELD_SIZE > UINT16_MAX) {
-				return -ENOTSUP;
-			}
-			*(u16_t *)msg_buffer =
-				sys_cpu_to_be16(sum_of_len - NLEN_FIELD_SIZE);
+		if (sum_of_len - NLEN_FIELD_SIZE > UINT16_MAX) {
+			return -ENOTSUP;
 		}
+		*(u16_t *)msg_buffer =
+			sys_cpu_to_be16(sum_of_len - NLEN_FIELD_SIZE);
 	}
 
 	*msg_len = sum_of_len;
@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <nfc/ndef/nfc_ndef_parser.h>
+#include <misc/byteorder.h>
+
+/** Mask of the Message Begin flag. */
+#define NDEF_RECORD_MB_MASK        NDEF_FIRST_RECORD
+/** Mask of the Message End flag. */
+#define NDEF_RECORD_ME_MASK        NDEF_LAST_RECORD
+
+/** Type of the text record. */
+#define TEXT_REC_TYPE              'T'
+/** Size of the status. */
+#define TEXT_REC_STATUS_SIZE       1
+/** Position of a character encoding type. */
+#define TEXT_REC_STATUS_UTF_POS    7
+/** Reserved position. */
+#define TEXT_REC_RESERVED_POS      6
+/** Mask of the length of the IANA language code. */
+#define TEXT_REC_LANG_CODE_LEN_MSK 0x3F
+
+/** Type of the URI record. */
+#define URI_REC_TYPE               'U'
+/** Size of the URI identifier code. */
+#define URI_REC_ID_CODE_SIZE       1
+
+/* Fields of one encoded record, or of one chunk of a chunked record. */
+struct record_hdr {
+	u8_t flags;
+	u8_t type_length;
+	u8_t id_length;
+	u32_t payload_length;
+	const u8_t *type;
+	const u8_t *id;
+	const u8_t *payload;
+	u32_t len;	/* Length of the encoded record. */
+};
+
+/* Parse the header of a record and check that the record fits in the
+ * buffer. The remaining length is compared with each field, so that large
+ * length fields cannot overflow the offset.
+ */
+static int record_hdr_parse(const u8_t *buf, u32_t len,
+			    struct record_hdr *hdr)
+{
+	u32_t offset = 2;
+
+	if (len < offset) {
+		return -EBADMSG;
+	}
+
+	hdr->flags = buf[0];
+	hdr->type_length = buf[1];
+
+	if (hdr->flags & NDEF_RECORD_SR_MASK) {
+		if (len - offset < NDEF_RECORD_PAYLOAD_LEN_SHORT_SIZE) {
+			return -EBADMSG;
+		}
+		hdr->payload_length = buf[offset];
+		offset += NDEF_RECORD_PAYLOAD_LEN_SHORT_SIZE;
+	} else {
+		if (len - offset < NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE) {
+			return -EBADMSG;
+		}
+		hdr->payload_length = sys_get_be32(&buf[offset]);
+		offset += NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE;
+	}
+
+	hdr->id_length = 0;
+	if (hdr->flags & NDEF_RECORD_IL_MASK) {
+		if (len - offset < NDEF_RECORD_ID_LEN_SIZE) {
+			return -EBADMSG;
+		}
+		hdr->id_length = buf[offset];
+		offset += NDEF_RECORD_ID_LEN_SIZE;
+	}
+
+	if (len - offset < hdr->type_length) {
+		return -EBADMSG;
+	}
+	hdr->type = &buf[offset];
+	offset += hdr->type_length;
+
+	if (len - offset < hdr->id_length) {
+		return -EBADMSG;
+	}
+	hdr->id = &buf[offset];
+	offset += hdr->id_length;
+
+	if (len - offset < hdr->payload_length) {
+		return -EBADMSG;
+	}
+	hdr->payload = &buf[offset];
+	offset += hdr->payload_length;
+
+	hdr->len = offset;
+
+	return 0;
+}
+
+int nfc_ndef_parser_init(struct nfc_ndef_parser *parser, const u8_t *buf,
+			 u32_t len)
+{
+	if (!parser || !buf) {
+		return -EINVAL;
+	}
+
+	parser->buf = buf;
+	parser->len = len;
+	parser->offset = 0;
+	parser->done = false;
+
+	return 0;
+}
+
+/* Add the chunks that follow the first chunk of a record. */
+static int record_chunks_parse(const u8_t *buf, u32_t len,
+			       struct record_hdr *hdr,
+			       struct nfc_ndef_parsed_record *record)
+{
+	u32_t offset = hdr->len;
+
+	while (hdr->flags & NDEF_RECORD_CF_MASK) {
+		/* Only the last chunk can end the message. */
+		if (hdr->flags & NDEF_RECORD_ME_MASK) {
+			return -EBADMSG;
+		}
+
+		if (record_hdr_parse(&buf[offset], len - offset, hdr)) {
+			return -EBADMSG;
+		}
+
+		/* The following chunks have no type and no ID. */
+		if (((hdr->flags & NDEF_RECORD_TNF_MASK) != TNF_UNCHANGED) ||
+		    (hdr->flags & NDEF_RECORD_MB_MASK) ||
+		    (hdr->flags & NDEF_RECORD_IL_MASK) ||
+		    hdr->type_length) {
+			return -EBADMSG;
+		}
+
+		if (hdr->payload_length >
+		    UINT32_MAX - record->payload_length) {
+			return -EBADMSG;
+		}
+
+		record->payload_length += hdr->payload_length;
+		record->chunk_count++;
+		offset += hdr->len;
+	}
+
+	record->chunks_len = offset;
+
+	return 0;
+}
+
+int nfc_ndef_parser_next(struct nfc_ndef_parser *parser,
+			 struct nfc_ndef_parsed_record *record)
+{
+	const u8_t *buf;
+	u32_t len;
+	struct record_hdr hdr;
+	bool first;
+
+	if (!parser || !record) {
+		return -EINVAL;
+	}
+
+	if (parser->done) {
+		return -ENOENT;
+	}
+
+	buf = &parser->buf[parser->offset];
+	len = parser->len - parser->offset;
+	first = (parser->offset == 0);
+
+	if (record_hdr_parse(buf, len, &hdr)) {
+		goto malformed;
+	}
+
+	/* Only the first record begins the message, and a record cannot
+	 * continue the payload of a previous one.
+	 */
+	if ((first != !!(hdr.flags & NDEF_RECORD_MB_MASK)) ||
+	    ((hdr.flags & NDEF_RECORD_TNF_MASK) == TNF_UNCHANGED)) {
+		goto malformed;
+	}
+
+	record->tnf = hdr.flags & NDEF_RECORD_TNF_MASK;
+	record->type_length = hdr.type_length;
+	record->type = hdr.type;
+	record->id_length = hdr.id_length;
+	record->id = hdr.id;
+	record->payload_length = hdr.payload_length;
+	record->payload = hdr.payload;
+	record->chunk_count = 1;
+	record->chunks = buf;
+
+	if (record_chunks_parse(buf, len, &hdr, record)) {
+		goto malformed;
+	}
+
+	/* The payload of a chunked record is not contiguous. */
+	if (record->chunk_count > 1) {
+		record->payload = NULL;
+	}
+
+	parser->offset += record->chunks_len;
+	if (hdr.flags & NDEF_RECORD_ME_MASK) {
+		parser->done = true;
+	}
+
+	return 0;
+
+malformed:
+	parser->done = true;
+
+	return -EBADMSG;
+}
+
+int nfc_ndef_record_chunk_get(const struct nfc_ndef_parsed_record *record,
+			      u32_t index,
+			      const u8_t **payload,
+			      u32_t *payload_length)
+{
+	const u8_t *buf;
+	u32_t len;
+	struct record_hdr hdr;
+
+	if (!record || !payload || !payload_length ||
+	    (index >= record->chunk_count)) {
+		return -EINVAL;
+	}
+
+	buf = record->chunks;
+	len = record->chunks_len;
+
+	for (u32_t i = 0; ; i++) {
+		int err = record_hdr_parse(buf, len, &hdr);
+
+		if (err) {
+			return err;
+		}
+
+		if (i == index) {
+			break;
+		}
+
+		buf += hdr.len;
+		len -= hdr.len;
+	}
+
+	*payload = hdr.payload;
+	*payload_length = hdr.payload_length;
+
+	return 0;
+}
+
+int nfc_ndef_record_payload_copy(const struct nfc_ndef_parsed_record *record,
+				 u8_t *buf,
+				 u32_t *len)
+{
+	const u8_t *chunk;
+	u32_t chunks_len;
+	u32_t offset = 0;
+
+	if (!record || !buf || !len) {
+		return -EINVAL;
+	}
+
+	if (*len < record->payload_length) {
+		return -ENOSR;
+	}
+
+	chunk = record->chunks;
+	chunks_len = record->chunks_len;
+
+	/* Walk the chunks once instead of looking up each one by index. */
+	for (u32_t i = 0; i < record->chunk_count; i++) {
+		struct record_hdr hdr;
+		int err;
+
+		err = record_hdr_parse(chunk, chunks_len, &hdr);
+		if (err) {
+			return err;
+		}
+
+		memcpy(&buf[offset], hdr.payload, hdr.payload_length);
+		offset += hdr.payload_length;
+		chunk += hdr.len;
+		chunks_len -= hdr.len;
+	}
+
+	*len = offset;
+
+	return 0;
+}
+
+static bool record_type_is(const struct nfc_ndef_parsed_record *record,
+			   u8_t type)
+{
+	return (record->tnf == TNF_WELL_KNOWN) &&
+	       (record->type_length == 1) &&
+	       (record->type[0] == type);
+}
+
+int nfc_ndef_text_rec_parse(const struct nfc_ndef_parsed_record *record,
+			    struct nfc_text_rec_payload_desc *text)
+{
+	u8_t status;
+	u8_t lang_code_len;
+
+	if (!record || !text || !record_type_is(record, TEXT_REC_TYPE)) {
+		return -EINVAL;
+	}
+
+	if (record->chunk_count > 1) {
+		return -ENOTSUP;
+	}
+
+	if (record->payload_length < TEXT_REC_STATUS_SIZE) {
+		return -EBADMSG;
+	}
+
+	status = record->payload[0];
+	lang_code_len = status & TEXT_REC_LANG_CODE_LEN_MSK;
+
+	if ((status & (1 << TEXT_REC_RESERVED_POS)) ||
+	    !lang_code_len ||
+	    (lang_code_len > record->payload_length - TEXT_REC_STATUS_SIZE)) {
+		return -EBADMSG;
+	}
+
+	text->utf = (status & (1 << TEXT_REC_STATUS_UTF_POS)) ? UTF_16 : UTF_8;
+	text->lang_code = &record->payload[TEXT_REC_STATUS_SIZE];
+	text->lang_code_len = lang_code_len;
+	text->data = &text->lang_code[lang_code_len];
+	text->data_len = record->payload_length - TEXT_REC_STATUS_SIZE -
+			 lang_code_len;
+
+	return 0;
+}
+
+int nfc_ndef_uri_rec_parse(const struct nfc_ndef_parsed_record *record,
+			   struct uri_payload_desc *uri)
+{
+	u8_t uri_id_code;
+
+	if (!record || !uri || !record_type_is(record, URI_REC_TYPE)) {
+		return -EINVAL;
+	}
+
+	if (record->chunk_count > 1) {
+		return -ENOTSUP;
+	}
+
+	if (record->payload_length < URI_REC_ID_CODE_SIZE) {
+		return -EBADMSG;
+	}
+
+	if (record->payload_length - URI_REC_ID_CODE_SIZE > UINT8_MAX) {
+		return -ENOTSUP;
+	}
+
+	uri_id_code = record->payload[0];
+
+	uri->uri_id_code = (uri_id_code <= NFC_URI_URN_NFC) ?
+			   uri_id_code : NFC_URI_RFU;
+	uri->uri_data = &record->payload[URI_REC_ID_CODE_SIZE];
+	uri->uri_data_len = record->payload_length - URI_REC_ID_CODE_SIZE;
+
+	return 0;
+}
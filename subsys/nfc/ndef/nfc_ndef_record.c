@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
  */
 
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
 #include <nfc/ndef/nfc_ndef_record.h>
@@ -13,14 +14,23 @@
  * NDEF record.
  */
 #define NDEF_RECORD_BASE_LONG_SIZE (2 + NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE)
+/* Sum of sizes of fields: TNF-flags, Type Length, Payload Length in short
+ * NDEF record.
+ */
+#define NDEF_RECORD_BASE_SHORT_SIZE (2 + NDEF_RECORD_PAYLOAD_LEN_SHORT_SIZE)
+/* Difference between the sizes of the long and the short record headers. */
+#define LONG_SHORT_DIFF (NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE - \
+			 NDEF_RECORD_PAYLOAD_LEN_SHORT_SIZE)
 
 static u32_t record_header_size_calc(
-			struct nfc_ndef_record_desc const *ndef_record_desc)
+			struct nfc_ndef_record_desc const *ndef_record_desc,
+			bool short_record)
 {
 	u32_t len;
 
-	len = NDEF_RECORD_BASE_LONG_SIZE + ndef_record_desc->id_length +
-			ndef_record_desc->type_length;
+	len = (short_record ? NDEF_RECORD_BASE_SHORT_SIZE :
+			      NDEF_RECORD_BASE_LONG_SIZE) +
+	      ndef_record_desc->id_length + ndef_record_desc->type_length;
 
 	if (ndef_record_desc->id_length > 0) {
 		len++;
@@ -29,90 +39,172 @@ static u32_t record_header_size_calc(
 	return len;
 }
 
+/* Get the payload size by calling the payload constructor without a
+ * buffer, which only calculates the size.
+ */
+static int payload_size_get(struct nfc_ndef_record_desc const *ndef_record_desc,
+			    u32_t *payload_len)
+{
+	if (!ndef_record_desc->payload_constructor) {
+		return -EINVAL;
+	}
+
+	*payload_len = UINT32_MAX;
+
+	return ndef_record_desc->payload_constructor(
+					ndef_record_desc->payload_descriptor,
+					NULL,
+					payload_len);
+}
+
+int nfc_ndef_record_size_get(
+			struct nfc_ndef_record_desc const *ndef_record_desc,
+			u32_t *record_len)
+{
+	u32_t payload_len;
+	int err;
+
+	if (!ndef_record_desc || !record_len) {
+		return -EINVAL;
+	}
+
+	err = payload_size_get(ndef_record_desc, &payload_len);
+	if (err) {
+		return err;
+	}
+
+	*record_len = record_header_size_calc(ndef_record_desc,
+				payload_len <= NDEF_RECORD_SHORT_PAYLOAD_MAX) +
+		      payload_len;
+
+	return 0;
+}
+
 int nfc_ndef_record_encode(struct nfc_ndef_record_desc const *ndef_record_desc,
 			   enum nfc_ndef_record_location const record_location,
 			   u8_t *record_buffer,
 			   u32_t *record_len)
 {
-	u8_t *payload_len = NULL; /* use as pointer to payload length field */
+	u8_t *payload_len; /* use as pointer to payload length field */
+	u8_t *flags; /* use as pointer to TNF + flags field */
+	u8_t *payload;
+	u32_t record_header_len;
 	u32_t record_payload_len;
+	bool short_record;
+	int err;
+
+	if (!record_buffer) {
+		return nfc_ndef_record_size_get(ndef_record_desc, record_len);
+	}
 
-	if (!ndef_record_desc) {
+	if (!ndef_record_desc || !record_len) {
+		return -EINVAL;
+	}
+	/* verify location range */
+	if (record_location & (~NDEF_RECORD_LOCATION_MASK)) {
 		return -EINVAL;
 	}
+	if (!ndef_record_desc->payload_constructor) {
+		return -EINVAL;
+	}
+
 	/* count record length without payload */
-	u32_t record_header_len = record_header_size_calc(ndef_record_desc);
+	record_header_len = record_header_size_calc(ndef_record_desc, true);
 
-	if (record_buffer) {
-		u8_t *flags; /* use as pointer to TNF + flags field */
+	/* verify if there is enough available memory */
+	if (record_header_len > *record_len) {
+		return -ENOSR;
+	}
 
-		/* verify location range */
-		if (record_location & (~NDEF_RECORD_LOCATION_MASK)) {
-			return -EINVAL;
-		}
-		/* verify if there is enough available memory */
-		if (record_header_len > *record_len) {
-			return -ENOSR;
-		}
+	/* The payload length is known only after the payload is constructed.
+	 * If the buffer has no room for a long record, the record must be
+	 * short. Otherwise, a long header is written and the record is
+	 * compacted to a short one if the payload turns out to fit.
+	 */
+	short_record = (*record_len - record_header_len <=
+			NDEF_RECORD_SHORT_PAYLOAD_MAX + LONG_SHORT_DIFF);
+	if (!short_record) {
+		record_header_len += LONG_SHORT_DIFF;
+	}
 
-		flags = record_buffer;
-		record_buffer++;
+	flags = record_buffer;
+	record_buffer++;
 
-		/* set location bits and clear other bits in 1st byte. */
-		*flags = record_location;
-		*flags |= ndef_record_desc->tnf;
+	/* set location bits and clear other bits in 1st byte. */
+	*flags = record_location;
+	*flags |= ndef_record_desc->tnf;
 
-		/* TYPE LENGTH */
-		*record_buffer = ndef_record_desc->type_length;
-		record_buffer++;
-		/* use always long record and remember payload len field memory
-		 * offset.
-		 */
-		payload_len = record_buffer;
+	/* TYPE LENGTH */
+	*record_buffer = ndef_record_desc->type_length;
+	record_buffer++;
+	/* remember payload len field memory offset. */
+	payload_len = record_buffer;
+	if (short_record) {
+		record_buffer += NDEF_RECORD_PAYLOAD_LEN_SHORT_SIZE;
+	} else {
 		record_buffer += NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE;
-		/* ID LENGTH - option */
-		if (ndef_record_desc->id_length > 0) {
-			*record_buffer = ndef_record_desc->id_length;
-			record_buffer++;
-			/* IL flag */
-			*flags |= NDEF_RECORD_IL_MASK;
-		}
-		/* TYPE */
+	}
+	/* ID LENGTH - option */
+	if (ndef_record_desc->id_length > 0) {
+		*record_buffer = ndef_record_desc->id_length;
+		record_buffer++;
+		/* IL flag */
+		*flags |= NDEF_RECORD_IL_MASK;
+	}
+	/* TYPE */
+	memcpy(record_buffer,
+	       ndef_record_desc->type,
+	       ndef_record_desc->type_length);
+	record_buffer += ndef_record_desc->type_length;
+	/* ID */
+	if (ndef_record_desc->id_length > 0) {
 		memcpy(record_buffer,
-		       ndef_record_desc->type,
-		       ndef_record_desc->type_length);
-		record_buffer += ndef_record_desc->type_length;
-		/* ID */
-		if (ndef_record_desc->id_length > 0) {
-			memcpy(record_buffer,
-			       ndef_record_desc->id,
-			       ndef_record_desc->id_length);
-			record_buffer += ndef_record_desc->id_length;
-		}
-		/* count how much memory is left in record buffer for payload
-		 * field.
-		 */
-		record_payload_len = (*record_len - record_header_len);
+		       ndef_record_desc->id,
+		       ndef_record_desc->id_length);
+		record_buffer += ndef_record_desc->id_length;
 	}
+	payload = record_buffer;
+
+	/* count how much memory is left in record buffer for payload
+	 * field.
+	 */
+	record_payload_len = (*record_len - record_header_len);
+
 	/* PAYLOAD */
-	if (ndef_record_desc->payload_constructor) {
-		int err;
+	err = ndef_record_desc->payload_constructor(
+				ndef_record_desc->payload_descriptor,
+				payload,
+				&record_payload_len);
+	if (err) {
+		return err;
+	}
 
-		err = ndef_record_desc->payload_constructor(
-					ndef_record_desc->payload_descriptor,
-					record_buffer,
-					&record_payload_len);
+	if (short_record &&
+	    (record_payload_len > NDEF_RECORD_SHORT_PAYLOAD_MAX)) {
+		/* The payload does not fit in the long record format either. */
+		return -ENOSR;
+	}
 
-		if (err) {
-			return err;
-		}
-	} else {
-		return -EINVAL;
+	if (!short_record &&
+	    (record_payload_len <= NDEF_RECORD_SHORT_PAYLOAD_MAX)) {
+		/* Move the ID length, type, ID and payload next to the
+		 * 1-byte Payload Length field.
+		 */
+		memmove(payload_len + NDEF_RECORD_PAYLOAD_LEN_SHORT_SIZE,
+			payload_len + NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE,
+			payload - payload_len -
+			NDEF_RECORD_PAYLOAD_LEN_LONG_SIZE + record_payload_len);
+		record_header_len -= LONG_SHORT_DIFF;
+		short_record = true;
 	}
 
-	if (record_buffer) {
-		/* PAYLOAD LENGTH */
-		*(u32_t *)payload_len = sys_cpu_to_be32(record_payload_len);
+	/* PAYLOAD LENGTH */
+	if (short_record) {
+		*payload_len = record_payload_len;
+		/* SR flag */
+		*flags |= NDEF_RECORD_SR_MASK;
+	} else {
+		sys_put_be32(record_payload_len, payload_len);
 	}
 
 	*record_len = record_header_len + record_payload_len;
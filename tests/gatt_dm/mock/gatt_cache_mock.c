@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <stdbool.h>
+#include <errno.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/hci.h>
+#include <misc/byteorder.h>
+#include <ztest.h>
+
+
+/* The functions defined in the Bluetooth host and in the settings are
+ * replaced with the __wrap_ versions by the linker.
+ */
+static struct bt_gatt_cache_mock {
+	bool bonded;
+	size_t save_cnt;
+	struct bt_conn_cb *conn_cb;
+	struct bt_gatt_subscribe_params *subscribe_params;
+} cache_mock_data;
+
+static const bt_addr_le_t cache_mock_peer = {
+	.type = BT_ADDR_LE_PUBLIC,
+	.a.val = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 },
+};
+
+
+void bt_gatt_cache_mock_bonded_set(bool bonded)
+{
+	cache_mock_data.bonded = bonded;
+}
+
+size_t bt_gatt_cache_mock_save_cnt(void)
+{
+	return cache_mock_data.save_cnt;
+}
+
+void bt_gatt_cache_mock_security_changed(struct bt_conn *conn)
+{
+	zassert_not_null(cache_mock_data.conn_cb, "No connection callbacks");
+	cache_mock_data.conn_cb->security_changed(conn, BT_SECURITY_MEDIUM);
+}
+
+void bt_gatt_cache_mock_disconnected(struct bt_conn *conn)
+{
+	zassert_not_null(cache_mock_data.conn_cb, "No connection callbacks");
+	cache_mock_data.conn_cb->disconnected(conn,
+					      BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+}
+
+int bt_gatt_cache_mock_indicate(struct bt_conn *conn,
+				u16_t start_handle,
+				u16_t end_handle)
+{
+	struct bt_gatt_subscribe_params *params =
+		cache_mock_data.subscribe_params;
+	u8_t data[2 * sizeof(u16_t)];
+
+	if (!params) {
+		return -ENOENT;
+	}
+
+	sys_put_le16(start_handle, &data[0]);
+	sys_put_le16(end_handle, &data[sizeof(u16_t)]);
+	(void)params->notify(conn, params, data, sizeof(data));
+
+	return 0;
+}
+
+int __wrap_bt_conn_get_info(const struct bt_conn *conn,
+			    struct bt_conn_info *info)
+{
+	info->type = BT_CONN_TYPE_LE;
+	info->role = BT_CONN_ROLE_MASTER;
+	info->id = BT_ID_DEFAULT;
+	info->le.dst = &cache_mock_peer;
+
+	return 0;
+}
+
+bool __wrap_bt_addr_le_is_bonded(u8_t id, const bt_addr_le_t *addr)
+{
+	return cache_mock_data.bonded &&
+	       !bt_addr_le_cmp(addr, &cache_mock_peer);
+}
+
+void __wrap_bt_conn_cb_register(struct bt_conn_cb *cb)
+{
+	cache_mock_data.conn_cb = cb;
+}
+
+int __wrap_settings_save_one(const char *name, void *value, size_t val_len)
+{
+	printk("Running %s mock: %s\n", __func__, name);
+	if (value) {
+		cache_mock_data.save_cnt++;
+	}
+
+	return 0;
+}
+
+/* Mocked version of the bt_gatt_subscribe, the GATT client is disabled */
+int bt_gatt_subscribe(struct bt_conn *conn,
+		      struct bt_gatt_subscribe_params *params)
+{
+	printk("Running %s mock\n", __func__);
+	zassert_equal(BT_GATT_CCC_INDICATE, params->value,
+		      "Unexpected subscription value");
+	cache_mock_data.subscribe_params = params;
+
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2019 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef BT_GATT_CACHE_MOCK_H_
+#define BT_GATT_CACHE_MOCK_H_
+
+#include <stdbool.h>
+#include <bluetooth/conn.h>
+
+
+/**
+ * @file
+ * @defgroup bt_gatt_cache_mock API
+ * @{
+ * @brief The API used to setup the mock of the connection, bond and
+ *        settings functions used by the discovery cache
+ */
+
+/**
+ * @brief Set the bond state of the peer
+ *
+ * @param bonded True if the peer of every connection is bonded.
+ */
+void bt_gatt_cache_mock_bonded_set(bool bonded);
+
+/**
+ * @brief Get the number of settings writes with data
+ *
+ * @return Number of calls to settings_save_one with a value.
+ */
+size_t bt_gatt_cache_mock_save_cnt(void);
+
+/**
+ * @brief Report that the security of the connection changed
+ *
+ * @param conn Connection object.
+ */
+void bt_gatt_cache_mock_security_changed(struct bt_conn *conn);
+
+/**
+ * @brief Report that the connection was terminated
+ *
+ * @param conn Connection object.
+ */
+void bt_gatt_cache_mock_disconnected(struct bt_conn *conn);
+
+/**
+ * @brief Indicate Service Changed to the subscriber
+ *
+ * @param conn         Connection object.
+ * @param start_handle First handle of the affected range.
+ * @param end_handle   Last handle of the affected range.
+ *
+ * @retval 0 If the indication was delivered.
+ * @retval -ENOENT If there is no subscription.
+ */
+int bt_gatt_cache_mock_indicate(struct bt_conn *conn,
+				u16_t start_handle,
+				u16_t end_handle);
+
+/** @} */
+#endif /* BT_GATT_CACHE_MOCK_H_ */
@@ -19,6 +19,7 @@ static struct bt_discover_mock {
 	struct bt_conn *conn;
 	struct bt_gatt_discover_params *params;
 	struct k_delayed_work work;
+	size_t call_cnt;
 } discover_mock_data;
 
 
@@ -26,6 +27,12 @@ void bt_gatt_discover_mock_setup(const struct bt_gatt_attr *attr, size_t len)
 {
 	discover_mock_data.attr = attr;
 	discover_mock_data.len  = len;
+	discover_mock_data.call_cnt = 0;
+}
+
+size_t bt_gatt_discover_mock_call_cnt(void)
+{
+	return discover_mock_data.call_cnt;
 }
 
 static bool bt_gatt_primary_check(const struct bt_gatt_attr *attr_cur,
@@ -41,6 +48,18 @@ static bool bt_gatt_primary_check(const struct bt_gatt_attr *attr_cur,
 	return false;
 }
 
+static bool bt_gatt_chrc_check(const struct bt_gatt_attr *attr_cur,
+			       const struct bt_uuid *uuid)
+{
+	if (!bt_uuid_cmp(BT_UUID_GATT_CHRC, attr_cur->uuid)) {
+		if (!uuid || !bt_uuid_cmp(uuid, ((struct bt_gatt_chrc *)
+					  attr_cur->user_data)->uuid)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static void bt_gatt_discover_work(struct k_work *work)
 {
 	struct bt_discover_mock *mock_data =
@@ -82,13 +101,18 @@ static void bt_gatt_discover_work(struct k_work *work)
 			}
 			continue; /* Skip */
 		case BT_GATT_DISCOVER_CHARACTERISTIC:
-			if (!bt_uuid_cmp(BT_UUID_GATT_CHRC,
-					 attr_cur->uuid)) {
+			if (bt_gatt_chrc_check(attr_cur,
+					       mock_data->params->uuid)) {
 				break;
 			}
 			continue; /* Skip */
 		case BT_GATT_DISCOVER_DESCRIPTOR:
-			break;
+			if (!mock_data->params->uuid ||
+			    !bt_uuid_cmp(mock_data->params->uuid,
+					 attr_cur->uuid)) {
+				break;
+			}
+			continue; /* Skip */
 		default:
 			zassert_unreachable(
 				"Invalid discovery type: %u",
@@ -120,6 +144,7 @@ int bt_gatt_discover(struct bt_conn *conn,
 		     struct bt_gatt_discover_params *params)
 {
 	printk("Running %s mock\n", __func__);
+	discover_mock_data.call_cnt++;
 	discover_mock_data.conn = conn;
 	discover_mock_data.params = params;
 
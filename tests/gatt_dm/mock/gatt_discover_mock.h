@@ -90,5 +90,13 @@
  */
 void bt_gatt_discover_mock_setup(const struct bt_gatt_attr *attr, size_t len);
 
+/**
+ * @brief Get the number of discovery requests
+ *
+ * @return Number of calls to @ref bt_gatt_discover since the last
+ *         @ref bt_gatt_discover_mock_setup.
+ */
+size_t bt_gatt_discover_mock_call_cnt(void);
+
 /** @} */
 #endif /* #define BT_GATT_DISCOVERY_MOCK_H_ */
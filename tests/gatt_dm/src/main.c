@@ -6,10 +6,14 @@
 #include <ztest.h>
 #include <kernel.h>
 #include <stddef.h>
+#include <errno.h>
 #include <misc/util.h>
 #include <bluetooth/uuid.h>
 #include <bluetooth/common/gatt_dm.h>
 #include "../mock/gatt_discover_mock.h"
+#if CONFIG_BT_GATT_DM_CACHE
+#include "../mock/gatt_cache_mock.h"
+#endif
 
 static char dummy_conn;
 K_SEM_DEFINE(discovery_finished, 0, 1);
@@ -309,8 +313,358 @@ void test_gatt_HIDS_chrc_by_uuid(void)
 	zassert_equal(0, bt_gatt_dm_attr_cnt(dm), "Parameter count after clearing: %d", bt_gatt_dm_attr_cnt(dm));
 }
 
+void test_gatt_HIDS_chrc_by_uuid_all(void)
+{
+	static const struct {
+		const struct bt_uuid *uuid;
+		u16_t handle;
+	} chrcs[] = {
+		{ BT_UUID_HIDS_CTRL_POINT, 10 },
+		{ BT_UUID_HIDS_REPORT, 6 },
+		{ BT_UUID_HIDS_INFO, 2 },
+		{ BT_UUID_HIDS_REPORT_MAP, 4 },
+	};
+	const struct bt_gatt_attr *attr_chrc;
+	struct bt_gatt_dm *dm = run_dm(BT_UUID_HIDS);
+
+	for (size_t i = 0; i < ARRAY_SIZE(chrcs); ++i) {
+		attr_chrc = bt_gatt_dm_char_by_uuid(dm, chrcs[i].uuid);
+		zassert_not_null(attr_chrc, "Characteristic %zu not found", i);
+		zassert_equal(chrcs[i].handle, attr_chrc->handle,
+			      "Unexpected handle: %d", attr_chrc->handle);
+	}
+
+	/* Descriptor UUIDs must not be found as characteristics */
+	attr_chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_GATT_CCC);
+	zassert_is_null(attr_chrc, "Expected NULL");
+
+	bt_gatt_dm_data_release(dm);
+	zassert_equal(0, bt_gatt_dm_attr_cnt(dm), "Parameter count after clearing: %d", bt_gatt_dm_attr_cnt(dm));
+}
+
+static struct {
+	struct bt_gatt_dm *dm;
+	bool not_found;
+} multi_result;
+
+void test_multi_cb_completed(struct bt_gatt_dm *dm, void *context)
+{
+	printk("%s\n", __func__);
+	multi_result.dm = dm;
+	multi_result.not_found = false;
+	k_sem_give(&discovery_finished);
+}
+
+void test_multi_cb_service_not_found(struct bt_conn *conn, void *context)
+{
+	printk("%s\n", __func__);
+	multi_result.dm = NULL;
+	multi_result.not_found = true;
+	k_sem_give(&discovery_finished);
+}
+
+struct bt_gatt_dm_cb test_multi_cb = {
+	.completed         = test_multi_cb_completed,
+	.service_not_found = test_multi_cb_service_not_found,
+	.error_found       = test_hids_cb_error_found
+};
+
+static const struct bt_uuid *wait_multi_service(void)
+{
+	const struct bt_gatt_service_val *serv_val;
+	int err;
+
+	err = k_sem_take(&discovery_finished, K_MSEC(2000));
+	zassert_equal(0, err, "It seems that no callback function was called: %d", err);
+
+	if (multi_result.not_found) {
+		return NULL;
+	}
+
+	zassert_not_null(multi_result.dm, "Device Manager pointer not set");
+	serv_val = bt_gatt_dm_attr_service_val(
+		bt_gatt_dm_service_get(multi_result.dm));
+	zassert_not_null(serv_val, "Unexpected NULL service value");
+
+	return serv_val->uuid;
+}
+
+void test_gatt_all_services(void)
+{
+	const struct bt_uuid *uuid;
+	int err = bt_gatt_dm_start((struct bt_conn *)&dummy_conn,
+				   NULL,
+				   &test_multi_cb,
+				   NULL);
+	zassert_false(err, "bt_gatt_dm_start finished with error: %d", err);
+
+	uuid = wait_multi_service();
+	zassert_not_null(uuid, "HIDS not found");
+	zassert_true(!bt_uuid_cmp(BT_UUID_HIDS, uuid), "Invalid service detected");
+	zassert_equal(11, bt_gatt_dm_attr_cnt(multi_result.dm), "Unexpected number of attributes");
+	bt_gatt_dm_data_release(multi_result.dm);
+
+	err = bt_gatt_dm_continue(multi_result.dm, NULL);
+	zassert_false(err, "bt_gatt_dm_continue finished with error: %d", err);
+	uuid = wait_multi_service();
+	zassert_not_null(uuid, "DIS not found");
+	zassert_true(!bt_uuid_cmp(BT_UUID_DIS, uuid), "Invalid service detected");
+	zassert_equal(5, bt_gatt_dm_attr_cnt(multi_result.dm), "Unexpected number of attributes");
+	bt_gatt_dm_data_release(multi_result.dm);
+
+	err = bt_gatt_dm_continue(multi_result.dm, NULL);
+	zassert_false(err, "bt_gatt_dm_continue finished with error: %d", err);
+	uuid = wait_multi_service();
+	zassert_is_null(uuid, "Unexpected service detected");
+}
+
+void test_gatt_service_list(void)
+{
+	static const struct bt_uuid *const svc_uuids[] = {
+		BT_UUID_DIS,
+		BT_UUID_BAS,
+	};
+	const struct bt_uuid *uuid;
+	int err = bt_gatt_dm_start_list((struct bt_conn *)&dummy_conn,
+					svc_uuids,
+					ARRAY_SIZE(svc_uuids),
+					&test_multi_cb,
+					NULL);
+	zassert_false(err, "bt_gatt_dm_start_list finished with error: %d", err);
+
+	uuid = wait_multi_service();
+	zassert_not_null(uuid, "DIS not found");
+	zassert_true(!bt_uuid_cmp(BT_UUID_DIS, uuid), "Invalid service detected");
+	zassert_not_null(bt_gatt_dm_char_by_uuid(multi_result.dm, BT_UUID_DIS_MODEL_NUMBER),
+			 "Unexpected NULL");
+	bt_gatt_dm_data_release(multi_result.dm);
+
+	err = bt_gatt_dm_continue(multi_result.dm, NULL);
+	zassert_false(err, "bt_gatt_dm_continue finished with error: %d", err);
+	uuid = wait_multi_service();
+	zassert_is_null(uuid, "Unexpected service detected");
+}
+
+#define BT_UUID_ARENA_SVC BT_UUID_DECLARE_128( \
+	0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0, \
+	0x93, 0xf3, 0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e)
+#define BT_UUID_ARENA_CHRC BT_UUID_DECLARE_128( \
+	0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0, \
+	0x93, 0xf3, 0xa3, 0xb5, 0x02, 0x00, 0x40, 0x6e)
+#define ARENA_CHRC(_handle) \
+	BT_GATT_DISCOVER_MOCK_CHRC(_handle, BT_UUID_ARENA_CHRC, BT_GATT_CHRC_READ)
+
+/* Service with 128-bit UUIDs whose data does not fit in
+ * CONFIG_BT_GATT_DM_DATA_SIZE, with the attribute count within
+ * CONFIG_BT_GATT_DM_MAX_ATTRS.
+ */
+const struct bt_gatt_attr discover_arena_sim[] = {
+	BT_GATT_DISCOVER_MOCK_SERV(1, BT_UUID_ARENA_SVC, 35),
+	ARENA_CHRC(2),  ARENA_CHRC(3),  ARENA_CHRC(4),  ARENA_CHRC(5),
+	ARENA_CHRC(6),  ARENA_CHRC(7),  ARENA_CHRC(8),  ARENA_CHRC(9),
+	ARENA_CHRC(10), ARENA_CHRC(11), ARENA_CHRC(12), ARENA_CHRC(13),
+	ARENA_CHRC(14), ARENA_CHRC(15), ARENA_CHRC(16), ARENA_CHRC(17),
+	ARENA_CHRC(18), ARENA_CHRC(19), ARENA_CHRC(20), ARENA_CHRC(21),
+	ARENA_CHRC(22), ARENA_CHRC(23), ARENA_CHRC(24), ARENA_CHRC(25),
+	ARENA_CHRC(26), ARENA_CHRC(27), ARENA_CHRC(28), ARENA_CHRC(29),
+	ARENA_CHRC(30), ARENA_CHRC(31), ARENA_CHRC(32), ARENA_CHRC(33),
+	ARENA_CHRC(34), ARENA_CHRC(35),
+};
+
+static int arena_err;
+
+void test_arena_cb_completed(struct bt_gatt_dm *dm, void *context)
+{
+	printk("%s\n", __func__);
+	zassert_unreachable("Discovery data should not fit");
+}
+
+void test_arena_cb_error_found(struct bt_conn *conn, int err, void *context)
+{
+	printk("%s\n", __func__);
+	arena_err = err;
+	k_sem_give(&discovery_finished);
+}
+
+struct bt_gatt_dm_cb test_arena_cb = {
+	.completed         = test_arena_cb_completed,
+	.service_not_found = test_hids_cb_service_not_found,
+	.error_found       = test_arena_cb_error_found
+};
+
+void test_gatt_arena_overflow(void)
+{
+	struct bt_gatt_dm *dm;
+	int err;
+
+	zassert_true(ARRAY_SIZE(discover_arena_sim) <= CONFIG_BT_GATT_DM_MAX_ATTRS,
+		     "Too many attributes to overflow the data");
+	bt_gatt_discover_mock_setup(discover_arena_sim,
+				    ARRAY_SIZE(discover_arena_sim));
+
+	arena_err = 0;
+	err = bt_gatt_dm_start((struct bt_conn *)&dummy_conn,
+			       BT_UUID_ARENA_SVC,
+			       &test_arena_cb,
+			       NULL);
+	zassert_false(err, "bt_gatt_dm_start finished with error: %d", err);
+
+	err = k_sem_take(&discovery_finished, K_MSEC(2000));
+	zassert_equal(0, err, "It seems that no callback function was called: %d", err);
+	zassert_equal(-ENOMEM, arena_err, "Unexpected error: %d", arena_err);
+
+	/* The discovery manager is usable again */
+	bt_gatt_discover_mock_setup(discover_sim, ARRAY_SIZE(discover_sim));
+	dm = run_dm(BT_UUID_DIS);
+	zassert_equal(5,
+		      bt_gatt_dm_attr_cnt(dm),
+		      "Unexpected number of attributes detected: %d",
+		      bt_gatt_dm_attr_cnt(dm));
+	bt_gatt_dm_data_release(dm);
+}
+
+#if CONFIG_BT_GATT_DM_CACHE
+/* HIDS followed by the GATT service with Service Changed */
+const struct bt_gatt_attr discover_cache_sim[] = {
+	BT_GATT_DISCOVER_MOCK_SERV(1, BT_UUID_HIDS, 11),
+	BT_GATT_DISCOVER_MOCK_CHRC(2, BT_UUID_HIDS_INFO, BT_GATT_CHRC_READ),
+	BT_GATT_DISCOVER_MOCK_DESC(3, BT_UUID_HIDS_INFO),
+
+	BT_GATT_DISCOVER_MOCK_CHRC(4, BT_UUID_HIDS_REPORT_MAP, BT_GATT_CHRC_READ),
+	BT_GATT_DISCOVER_MOCK_DESC(5, BT_UUID_HIDS_REPORT_MAP),
+
+	BT_GATT_DISCOVER_MOCK_CHRC(6, BT_UUID_HIDS_REPORT, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY),
+	BT_GATT_DISCOVER_MOCK_DESC(7, BT_UUID_HIDS_REPORT),
+	BT_GATT_DISCOVER_MOCK_DESC(8, BT_UUID_GATT_CCC),
+	BT_GATT_DISCOVER_MOCK_DESC(9, BT_UUID_HIDS_REPORT_REF),
+
+	BT_GATT_DISCOVER_MOCK_CHRC(10, BT_UUID_HIDS_CTRL_POINT, BT_GATT_CHRC_WRITE_WITHOUT_RESP),
+	BT_GATT_DISCOVER_MOCK_DESC(11, BT_UUID_HIDS_CTRL_POINT),
+
+	/* GATT */
+	BT_GATT_DISCOVER_MOCK_SERV(12, BT_UUID_GATT, 15),
+	BT_GATT_DISCOVER_MOCK_CHRC(13, BT_UUID_GATT_SC, BT_GATT_CHRC_INDICATE),
+	BT_GATT_DISCOVER_MOCK_DESC(14, BT_UUID_GATT_SC),
+	BT_GATT_DISCOVER_MOCK_DESC(15, BT_UUID_GATT_CCC),
+};
+
+void test_cache_setup(void)
+{
+	k_sem_reset(&discovery_finished);
+	bt_gatt_discover_mock_setup(discover_cache_sim,
+				    ARRAY_SIZE(discover_cache_sim));
+	bt_gatt_cache_mock_bonded_set(true);
+	zassert_false(bt_gatt_dm_cache_invalidate(BT_ADDR_LE_ANY, 0x0001, 0xffff),
+		      "Cannot clear the cache");
+}
+
+void test_cache_teardown(void)
+{
+	bt_gatt_cache_mock_bonded_set(false);
+}
+
+/* Run the HIDS discovery, return the number of discovery requests */
+static size_t run_cached_hids(void)
+{
+	const struct bt_gatt_attr *attr_chrc;
+	const struct bt_gatt_attr *attr_desc;
+	struct bt_gatt_dm *dm;
+	size_t call_cnt;
+
+	bt_gatt_discover_mock_setup(discover_cache_sim,
+				    ARRAY_SIZE(discover_cache_sim));
+	dm = run_dm(BT_UUID_HIDS);
+	call_cnt = bt_gatt_discover_mock_call_cnt();
+
+	zassert_equal(11,
+		      bt_gatt_dm_attr_cnt(dm),
+		      "Unexpected number of attributes detected: %d",
+		      bt_gatt_dm_attr_cnt(dm));
+	attr_chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_HIDS_REPORT);
+	zassert_not_null(attr_chrc, "Unexpected NULL");
+	zassert_equal(6, attr_chrc->handle, "Unexpected handle: %d", attr_chrc->handle);
+	zassert_equal(BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+		      bt_gatt_dm_attr_chrc_val(attr_chrc)->properties,
+		      "Unexpected HIDS_REPORT properties");
+	attr_desc = bt_gatt_dm_desc_by_uuid(dm, attr_chrc, BT_UUID_GATT_CCC);
+	zassert_not_null(attr_desc, "Unexpected NULL");
+	zassert_equal(8, attr_desc->handle, "Unexpected handle: %d", attr_desc->handle);
+
+	bt_gatt_dm_data_release(dm);
+
+	return call_cnt;
+}
+
+void test_cache_hit(void)
+{
+	size_t save_cnt = bt_gatt_cache_mock_save_cnt();
+
+	zassert_not_equal(0, run_cached_hids(), "Service not discovered");
+	zassert_equal(0, run_cached_hids(), "Service not served from the cache");
+
+	/* The entry is written from the system workqueue */
+	k_sleep(K_MSEC(100));
+	zassert_true(bt_gatt_cache_mock_save_cnt() > save_cnt,
+		     "Cache entry not written to the settings");
+}
+
+void test_cache_unbonded(void)
+{
+	bt_gatt_cache_mock_bonded_set(false);
+
+	zassert_not_equal(0, run_cached_hids(), "Service not discovered");
+	zassert_not_equal(0, run_cached_hids(), "Unbonded peer was cached");
+}
+
+void test_cache_service_changed(void)
+{
+	int err;
+
+	zassert_not_equal(0, run_cached_hids(), "Service not discovered");
+
+	/* Subscription to Service Changed, discovered in two steps */
+	bt_gatt_cache_mock_security_changed((struct bt_conn *)&dummy_conn);
+	k_sleep(K_MSEC(100));
+
+	/* Change outside of the cached service */
+	err = bt_gatt_cache_mock_indicate((struct bt_conn *)&dummy_conn, 12, 15);
+	zassert_equal(0, err, "Not subscribed to Service Changed");
+	zassert_equal(0, run_cached_hids(), "Service not served from the cache");
+
+	/* Change overlapping the cached service */
+	err = bt_gatt_cache_mock_indicate((struct bt_conn *)&dummy_conn, 11, 15);
+	zassert_equal(0, err, "Not subscribed to Service Changed");
+	zassert_not_equal(0, run_cached_hids(), "Service not invalidated");
+	zassert_equal(0, run_cached_hids(), "Service not served from the cache");
+}
+
+void test_cache_unpair(void)
+{
+	zassert_not_equal(0, run_cached_hids(), "Service not discovered");
+
+	/* The bond is removed, which terminates the connection */
+	bt_gatt_cache_mock_bonded_set(false);
+	bt_gatt_cache_mock_disconnected((struct bt_conn *)&dummy_conn);
+	bt_gatt_cache_mock_bonded_set(true);
+
+	zassert_not_equal(0, run_cached_hids(), "Service not invalidated");
+}
+#endif /* CONFIG_BT_GATT_DM_CACHE */
+
 void test_main(void)
 {
+#if CONFIG_BT_GATT_DM_CACHE
+	ztest_test_suite(
+		test_gatt_cache,
+		ztest_unit_test_setup_teardown(test_cache_hit, test_cache_setup, test_cache_teardown),
+		ztest_unit_test_setup_teardown(test_cache_unbonded, test_cache_setup, test_cache_teardown),
+		ztest_unit_test_setup_teardown(test_cache_service_changed, test_cache_setup, test_cache_teardown),
+		ztest_unit_test_setup_teardown(test_cache_unpair, test_cache_setup, test_cache_teardown)
+	);
+
+	ztest_run_test_suite(test_gatt_cache);
+#endif
+
 	ztest_test_suite(
 		test_gatt,
 		ztest_unit_test_setup_teardown(test_gatt_DIS_simple_next_attr, test_setup, unit_test_noop),
@@ -318,7 +672,11 @@ void test_main(void)
 		ztest_unit_test_setup_teardown(test_gatt_HIDS_simple_next_attr, test_setup, unit_test_noop),
 		ztest_unit_test_setup_teardown(test_gatt_HIDS_attr_by_handle, test_setup, unit_test_noop),
 		ztest_unit_test_setup_teardown(test_gatt_HIDS_next_chrc_access, test_setup, unit_test_noop),
-		ztest_unit_test_setup_teardown(test_gatt_HIDS_chrc_by_uuid, test_setup, unit_test_noop)
+		ztest_unit_test_setup_teardown(test_gatt_HIDS_chrc_by_uuid, test_setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_gatt_HIDS_chrc_by_uuid_all, test_setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_gatt_all_services, test_setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_gatt_service_list, test_setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_gatt_arena_overflow, test_setup, unit_test_noop)
 	);
 
 	ztest_run_test_suite(test_gatt);
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <esb_sim.h>
+#include <misc/byteorder.h>
+#include <misc/util.h>
+#include <nrf_esb.h>
+#include <nrf_esb_frag.h>
+#include <string.h>
+
+/* Fragment header, as defined by the transport */
+#define HDR_TYPE	0
+#define HDR_ID		1
+#define HDR_INDEX	2
+#define HDR_COUNT	4
+
+#define TYPE_MASK	0x0F
+#define TYPE_DATA	0x01
+#define TYPE_POLL	0x02
+#define TYPE_STATUS	0x03
+
+#define SEQ_POS		4
+#define SEQ_MASK	0x70
+
+#define FLAG_POLL	0x80
+
+#define MSG_LEN		1000
+#define FRAG_COUNT	ceiling_fraction(MSG_LEN, NRF_ESB_FRAG_DATA_MAX)
+#define BITMAP_SIZE	ceiling_fraction(FRAG_COUNT, 8)
+#define STATUS_BITS_MAX	(NRF_ESB_FRAG_DATA_MAX * 8)
+
+#define PEER_MSG_ID	0x5A
+#define LOSS_PERMILLE	100
+#define TIMEOUT		K_SECONDS(5)
+
+static const u8_t base_addr_0[4] = {0xE7, 0xE7, 0xE7, 0xE7};
+static const u8_t addr_prefix[1] = {0xE7};
+
+static u8_t msg[MSG_LEN];
+
+/* Receiving side of the transport, run by a simulated peer */
+static struct {
+	u8_t buf[MSG_LEN];
+	u8_t received[BITMAP_SIZE];
+	size_t len;
+	u16_t count;
+	u8_t id;
+	bool active;
+	/* A status was requested with this poll sequence */
+	bool status_requested;
+	u8_t status_seq;
+	/* Status for the next acknowledgment */
+	u8_t status[CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH];
+	u8_t status_len;
+} peer_rx;
+
+/* Sending side of the transport, run by a simulated peer */
+static struct {
+	u8_t missing[BITMAP_SIZE];
+	u16_t next;
+	u16_t last;
+	u8_t seq;
+	bool wait_status;
+	bool done;
+	/* Polls sent before the status of a pass arrived */
+	u32_t polls;
+	u32_t polls_max;
+} peer_tx;
+
+static K_SEM_DEFINE(sent_sem, 0, 1);
+static K_SEM_DEFINE(received_sem, 0, 1);
+static int sent_err;
+static u8_t rx_buf[MSG_LEN];
+static u8_t received_msg[MSG_LEN];
+static size_t received_len;
+
+static bool bit_get(const u8_t *map, u16_t i)
+{
+	return map[i / 8] & BIT(i % 8);
+}
+
+static void bit_set(u8_t *map, u16_t i)
+{
+	map[i / 8] |= BIT(i % 8);
+}
+
+static void bit_clear(u8_t *map, u16_t i)
+{
+	map[i / 8] &= ~BIT(i % 8);
+}
+
+static void hdr_set(u8_t *hdr, u8_t type, u8_t id, u16_t index, u16_t count)
+{
+	hdr[HDR_TYPE] = type;
+	hdr[HDR_ID] = id;
+	sys_put_le16(index, &hdr[HDR_INDEX]);
+	sys_put_le16(count, &hdr[HDR_COUNT]);
+}
+
+static u8_t seq_get(const u8_t *hdr)
+{
+	return (hdr[HDR_TYPE] & SEQ_MASK) >> SEQ_POS;
+}
+
+static void peer_rx_fragment(const u8_t *data, u8_t len)
+{
+	u8_t type;
+	u16_t index;
+	u16_t count;
+	size_t offset;
+
+	if (len < NRF_ESB_FRAG_HDR_SIZE) {
+		return;
+	}
+
+	type = data[HDR_TYPE];
+	index = sys_get_le16(&data[HDR_INDEX]);
+	count = sys_get_le16(&data[HDR_COUNT]);
+
+	if (((type & TYPE_MASK) == TYPE_STATUS) || (index >= count)) {
+		return;
+	}
+
+	if (!peer_rx.active || (peer_rx.id != data[HDR_ID])) {
+		memset(peer_rx.received, 0, sizeof(peer_rx.received));
+		peer_rx.id = data[HDR_ID];
+		peer_rx.count = count;
+		peer_rx.len = 0;
+		peer_rx.active = true;
+	}
+
+	if ((type & TYPE_MASK) == TYPE_DATA) {
+		offset = (size_t)index * NRF_ESB_FRAG_DATA_MAX;
+		len -= NRF_ESB_FRAG_HDR_SIZE;
+
+		if (offset + len <= sizeof(peer_rx.buf)) {
+			memcpy(&peer_rx.buf[offset],
+			       &data[NRF_ESB_FRAG_HDR_SIZE], len);
+			bit_set(peer_rx.received, index);
+			if (index == count - 1) {
+				peer_rx.len = offset + len;
+			}
+		}
+	}
+
+	if (((type & TYPE_MASK) == TYPE_POLL) || (type & FLAG_POLL)) {
+		peer_rx.status_requested = true;
+		peer_rx.status_seq = seq_get(data);
+	}
+}
+
+static u8_t peer_rx_status_build(u8_t *data)
+{
+	u16_t base = 0;
+	size_t bits;
+
+	while ((base < peer_rx.count) && bit_get(peer_rx.received, base)) {
+		base++;
+	}
+
+	bits = min(peer_rx.count - base, STATUS_BITS_MAX);
+
+	hdr_set(data, TYPE_STATUS | (peer_rx.status_seq << SEQ_POS),
+		peer_rx.id, base, peer_rx.count);
+	memset(&data[NRF_ESB_FRAG_HDR_SIZE], 0, (bits + 7) / 8);
+	for (size_t i = 0; i < bits; i++) {
+		if (bit_get(peer_rx.received, base + i)) {
+			bit_set(&data[NRF_ESB_FRAG_HDR_SIZE], i);
+		}
+	}
+
+	return NRF_ESB_FRAG_HDR_SIZE + (bits + 7) / 8;
+}
+
+static void peer_rx_cb(int peer, const u8_t *data, u8_t len)
+{
+	peer_rx_fragment(data, len);
+}
+
+/* Like the driver, the PRX peer sends the status in the acknowledgment of
+ * the packet that follows the request.
+ */
+static u8_t prx_peer_ack_cb(int peer, u8_t *data, u8_t size)
+{
+	u8_t len = peer_rx.status_len;
+
+	memcpy(data, peer_rx.status, len);
+	peer_rx.status_len = 0;
+
+	if (peer_rx.status_requested) {
+		peer_rx.status_requested = false;
+		peer_rx.status_len = peer_rx_status_build(peer_rx.status);
+	}
+
+	return len;
+}
+
+/* The PTX peer sends the status as its next packet. */
+static u8_t ptx_peer_status_cb(int peer, u8_t *data, u8_t size)
+{
+	if (!peer_rx.status_requested) {
+		return 0;
+	}
+
+	peer_rx.status_requested = false;
+
+	return peer_rx_status_build(data);
+}
+
+static void peer_tx_pass_start(u16_t first)
+{
+	peer_tx.next = first;
+	peer_tx.last = first;
+	peer_tx.seq = (peer_tx.seq + 1) & (SEQ_MASK >> SEQ_POS);
+	peer_tx.wait_status = false;
+
+	for (u16_t i = first; i < FRAG_COUNT; i++) {
+		if (bit_get(peer_tx.missing, i)) {
+			peer_tx.last = i;
+		}
+	}
+}
+
+/* Send the missing fragments, then poll until a status arrives. */
+static u8_t ptx_peer_send_cb(int peer, u8_t *data, u8_t size)
+{
+	u8_t type = peer_tx.seq << SEQ_POS;
+	size_t offset;
+	size_t len;
+	u16_t i;
+
+	if (peer_tx.done) {
+		return 0;
+	}
+
+	if (peer_tx.wait_status) {
+		peer_tx.polls++;
+		hdr_set(data, TYPE_POLL | type, PEER_MSG_ID, 0, FRAG_COUNT);
+		return NRF_ESB_FRAG_HDR_SIZE;
+	}
+
+	while (!bit_get(peer_tx.missing, peer_tx.next)) {
+		peer_tx.next++;
+	}
+
+	i = peer_tx.next++;
+	if (i == peer_tx.last) {
+		type |= FLAG_POLL;
+		peer_tx.wait_status = true;
+		peer_tx.polls = 0;
+	}
+
+	offset = (size_t)i * NRF_ESB_FRAG_DATA_MAX;
+	len = min(MSG_LEN - offset, NRF_ESB_FRAG_DATA_MAX);
+
+	hdr_set(data, TYPE_DATA | type, PEER_MSG_ID, i, FRAG_COUNT);
+	memcpy(&data[NRF_ESB_FRAG_HDR_SIZE], &msg[offset], len);
+
+	return NRF_ESB_FRAG_HDR_SIZE + len;
+}
+
+static void ptx_peer_status_rx_cb(int peer, const u8_t *data, u8_t len)
+{
+	const u8_t *bitmap = &data[NRF_ESB_FRAG_HDR_SIZE];
+	size_t bits;
+	u16_t base;
+
+	if ((len < NRF_ESB_FRAG_HDR_SIZE) ||
+	    ((data[HDR_TYPE] & TYPE_MASK) != TYPE_STATUS) ||
+	    (data[HDR_ID] != PEER_MSG_ID) ||
+	    (seq_get(data) != peer_tx.seq) ||
+	    !peer_tx.wait_status) {
+		return;
+	}
+
+	peer_tx.polls_max = max(peer_tx.polls_max, peer_tx.polls);
+
+	base = sys_get_le16(&data[HDR_INDEX]);
+	if (base >= FRAG_COUNT) {
+		peer_tx.done = true;
+		return;
+	}
+
+	bits = (len - NRF_ESB_FRAG_HDR_SIZE) * 8;
+	for (u16_t i = 0; i < FRAG_COUNT; i++) {
+		if ((i < base) ||
+		    ((i - base < bits) && bit_get(bitmap, i - base))) {
+			bit_clear(peer_tx.missing, i);
+		} else {
+			bit_set(peer_tx.missing, i);
+		}
+	}
+
+	peer_tx_pass_start(base);
+}
+
+static void frag_received(u8_t pipe, const u8_t *data, size_t len)
+{
+	received_len = min(len, sizeof(received_msg));
+	memcpy(received_msg, data, received_len);
+	k_sem_give(&received_sem);
+}
+
+static void frag_sent(int err)
+{
+	sent_err = err;
+	k_sem_give(&sent_sem);
+}
+
+static const struct nrf_esb_frag_cb frag_cb = {
+	.received = frag_received,
+	.sent = frag_sent,
+};
+
+static void setup(enum nrf_esb_mode mode, u32_t loss_permille)
+{
+	struct nrf_esb_config config = NRF_ESB_DEFAULT_CONFIG;
+	struct esb_sim_medium_config medium = {
+		.loss_permille = loss_permille,
+		.seed = 1,
+	};
+	int err;
+
+	esb_sim_peers_clear();
+	esb_sim_medium_configure(&medium);
+	esb_sim_stats_reset();
+
+	config.mode = mode;
+	config.retransmit_delay = 250;
+	config.event_handler = nrf_esb_frag_event_handler;
+
+	nrf_esb_disable();
+
+	err = nrf_esb_init(&config);
+	zassert_equal(err, 0, "ESB initialization failed");
+
+	err = nrf_esb_set_base_address_0(base_addr_0);
+	zassert_equal(err, 0, "Setting the base address failed");
+
+	err = nrf_esb_set_prefixes(addr_prefix, ARRAY_SIZE(addr_prefix));
+	zassert_equal(err, 0, "Setting the prefixes failed");
+
+	err = nrf_esb_frag_init(&frag_cb, rx_buf, sizeof(rx_buf));
+	zassert_equal(err, 0, "Fragmentation initialization failed");
+
+	memset(&peer_rx, 0, sizeof(peer_rx));
+	memset(&peer_tx, 0, sizeof(peer_tx));
+	for (u16_t i = 0; i < FRAG_COUNT; i++) {
+		bit_set(peer_tx.missing, i);
+	}
+	peer_tx_pass_start(0);
+
+	k_sem_reset(&sent_sem);
+	k_sem_reset(&received_sem);
+	received_len = 0;
+}
+
+static void peer_add(enum esb_sim_peer_role role,
+		     esb_sim_peer_payload_cb_t payload_cb,
+		     esb_sim_peer_rx_cb_t rx_cb, u32_t interval_us)
+{
+	struct esb_sim_peer_config config = {
+		.role = role,
+		.prefix = addr_prefix[0],
+		.channel = 2,
+		.rssi = 50,
+		.interval_us = interval_us,
+		.retransmit_delay_us = 250,
+		.retransmit_count = 3,
+		.payload_cb = payload_cb,
+		.rx_cb = rx_cb,
+	};
+
+	memcpy(config.base_addr, base_addr_0, sizeof(config.base_addr));
+
+	zassert_true(esb_sim_peer_add(&config) >= 0,
+		     "Could not add a simulated peer");
+}
+
+/* Send the message to a PRX peer and return the time it took. */
+static u32_t ptx_send(u32_t loss_permille)
+{
+	u64_t start;
+	int err;
+
+	setup(NRF_ESB_MODE_PTX, loss_permille);
+	peer_add(ESB_SIM_PEER_PRX, prx_peer_ack_cb, peer_rx_cb, 0);
+
+	start = esb_sim_time_us();
+
+	err = nrf_esb_frag_send(0, msg, sizeof(msg));
+	zassert_equal(err, 0, "Sending failed");
+
+	err = k_sem_take(&sent_sem, TIMEOUT);
+	zassert_equal(err, 0, "Sending did not complete");
+	zassert_equal(sent_err, 0, "Sending failed");
+
+	zassert_equal(peer_rx.len, sizeof(msg), "Wrong message length");
+	zassert_mem_equal(peer_rx.buf, msg, sizeof(msg), "Wrong message");
+
+	return esb_sim_time_us() - start;
+}
+
+static void test_ptx_send(void)
+{
+	u32_t us = ptx_send(0);
+
+	/* The status of the PRX must not wait for the poll timer */
+	zassert_true(us < CONFIG_NRF_ESB_FRAG_POLL_INTERVAL_MS * 1000,
+		     "Status was delayed to the poll timer");
+}
+
+static void test_ptx_send_lossy(void)
+{
+	(void)ptx_send(LOSS_PERMILLE);
+}
+
+static void test_ptx_send_timeout(void)
+{
+	int err;
+
+	setup(NRF_ESB_MODE_PTX, 0);
+	/* Acknowledges without a status */
+	peer_add(ESB_SIM_PEER_PRX, NULL, NULL, 0);
+
+	err = nrf_esb_frag_send(0, msg, sizeof(msg));
+	zassert_equal(err, 0, "Sending failed");
+
+	err = nrf_esb_frag_send(0, msg, sizeof(msg));
+	zassert_equal(err, -EBUSY, "Second message was accepted");
+
+	err = k_sem_take(&sent_sem, TIMEOUT);
+	zassert_equal(err, 0, "Sending did not complete");
+	zassert_equal(sent_err, -ETIMEDOUT, "Sending did not time out");
+}
+
+static void prx_receive(u32_t loss_permille)
+{
+	int err;
+
+	setup(NRF_ESB_MODE_PRX, loss_permille);
+	peer_add(ESB_SIM_PEER_PTX, ptx_peer_send_cb, ptx_peer_status_rx_cb, 0);
+
+	err = nrf_esb_start_rx();
+	zassert_equal(err, 0, "Starting RX failed");
+
+	err = k_sem_take(&received_sem, TIMEOUT);
+	zassert_equal(err, 0, "Message not received");
+	zassert_equal(received_len, sizeof(msg), "Wrong message length");
+	zassert_mem_equal(received_msg, msg, sizeof(msg), "Wrong message");
+
+	/* Let the peer get the final status */
+	k_sleep(K_MSEC(CONFIG_NRF_ESB_FRAG_POLL_INTERVAL_MS));
+	zassert_true(peer_tx.done, "Final status not received");
+
+	nrf_esb_stop_rx();
+}
+
+static void test_prx_receive(void)
+{
+	prx_receive(0);
+
+	/* The status requested with the last fragment goes out with the
+	 * acknowledgment of the first poll.
+	 */
+	zassert_equal(peer_tx.polls_max, 1, "Status was delayed");
+}
+
+static void test_prx_receive_lossy(void)
+{
+	prx_receive(LOSS_PERMILLE);
+}
+
+static void test_prx_send(void)
+{
+	int err;
+
+	setup(NRF_ESB_MODE_PRX, LOSS_PERMILLE);
+	peer_add(ESB_SIM_PEER_PTX, ptx_peer_status_cb, peer_rx_cb, 500);
+
+	err = nrf_esb_start_rx();
+	zassert_equal(err, 0, "Starting RX failed");
+
+	err = nrf_esb_frag_send(0, msg, sizeof(msg));
+	zassert_equal(err, 0, "Sending failed");
+
+	err = k_sem_take(&sent_sem, TIMEOUT);
+	zassert_equal(err, 0, "Sending did not complete");
+	zassert_equal(sent_err, 0, "Sending failed");
+
+	zassert_equal(peer_rx.len, sizeof(msg), "Wrong message length");
+	zassert_mem_equal(peer_rx.buf, msg, sizeof(msg), "Wrong message");
+
+	nrf_esb_stop_rx();
+}
+
+void test_main(void)
+{
+	for (size_t i = 0; i < sizeof(msg); i++) {
+		msg[i] = i * 7;
+	}
+
+	ztest_test_suite(esb_frag_test,
+			 ztest_unit_test(test_ptx_send),
+			 ztest_unit_test(test_ptx_send_lossy),
+			 ztest_unit_test(test_ptx_send_timeout),
+			 ztest_unit_test(test_prx_receive),
+			 ztest_unit_test(test_prx_receive_lossy),
+			 ztest_unit_test(test_prx_send)
+			 );
+
+	ztest_run_test_suite(esb_frag_test);
+}
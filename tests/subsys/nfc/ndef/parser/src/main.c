@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <errno.h>
+#include <string.h>
+#include <misc/byteorder.h>
+#include <nfc/ndef/nfc_ndef_parser.h>
+
+#define MB NDEF_FIRST_RECORD
+#define ME NDEF_LAST_RECORD
+#define CF NDEF_RECORD_CF_MASK
+#define SR NDEF_RECORD_SR_MASK
+#define IL NDEF_RECORD_IL_MASK
+
+#define LONG_PAYLOAD_LEN 300
+
+/* Text record "hi" in English, with an ID. */
+static const u8_t short_record[] = {
+	MB | ME | SR | IL | TNF_WELL_KNOWN, 1, 5, 2,
+	'T',
+	'i', 'd',
+	0x02, 'e', 'n', 'h', 'i',
+};
+
+/* URI record followed by an empty record. */
+static const u8_t two_records[] = {
+	MB | SR | TNF_WELL_KNOWN, 1, 2,
+	'U',
+	0x01, 'a',
+	ME | SR | TNF_EMPTY, 0, 0,
+};
+
+/* Media record with the payload 1 to 9 in three chunks. */
+static const u8_t chunked_record[] = {
+	MB | CF | SR | TNF_MEDIA_TYPE, 3, 4,
+	'a', '/', 'b',
+	1, 2, 3, 4,
+	CF | SR | TNF_UNCHANGED, 0, 3,
+	5, 6, 7,
+	ME | SR | TNF_UNCHANGED, 0, 2,
+	8, 9,
+};
+
+static u8_t long_record[7 + LONG_PAYLOAD_LEN];
+
+static void parse_expect(const u8_t *buf, u32_t len, int expected)
+{
+	struct nfc_ndef_parser parser;
+	struct nfc_ndef_parsed_record record;
+	int err;
+
+	err = nfc_ndef_parser_init(&parser, buf, len);
+	zassert_equal(err, 0, "Parser initialization failed");
+
+	do {
+		err = nfc_ndef_parser_next(&parser, &record);
+	} while (err == 0);
+
+	zassert_equal(err, expected, "Unexpected parsing result");
+
+	/* Parsing cannot continue after the end or an error */
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, -ENOENT, "Parsing continued");
+}
+
+static void test_short_record(void)
+{
+	struct nfc_ndef_parser parser;
+	struct nfc_ndef_parsed_record record;
+	struct nfc_text_rec_payload_desc text;
+	int err;
+
+	nfc_ndef_parser_init(&parser, short_record, sizeof(short_record));
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, 0, "Parsing failed");
+	zassert_equal(record.tnf, TNF_WELL_KNOWN, "Wrong TNF");
+	zassert_equal(record.type_length, 1, "Wrong type length");
+	zassert_equal(record.type[0], 'T', "Wrong type");
+	zassert_equal(record.id_length, 2, "Wrong ID length");
+	zassert_mem_equal(record.id, "id", 2, "Wrong ID");
+	zassert_equal(record.payload_length, 5, "Wrong payload length");
+	zassert_equal_ptr(record.payload, &short_record[7], "Wrong payload");
+	zassert_equal(record.chunk_count, 1, "Wrong chunk count");
+
+	err = nfc_ndef_text_rec_parse(&record, &text);
+	zassert_equal(err, 0, "Text parsing failed");
+	zassert_equal(text.utf, UTF_8, "Wrong encoding");
+	zassert_equal(text.lang_code_len, 2, "Wrong language code length");
+	zassert_mem_equal(text.lang_code, "en", 2, "Wrong language code");
+	zassert_equal(text.data_len, 2, "Wrong text length");
+	zassert_mem_equal(text.data, "hi", 2, "Wrong text");
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, -ENOENT, "Record after the last record");
+}
+
+static void test_long_record(void)
+{
+	struct nfc_ndef_parser parser;
+	struct nfc_ndef_parsed_record record;
+	int err;
+
+	nfc_ndef_parser_init(&parser, long_record, sizeof(long_record));
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, 0, "Parsing failed");
+	zassert_equal(record.tnf, TNF_MEDIA_TYPE, "Wrong TNF");
+	zassert_equal(record.type_length, 1, "Wrong type length");
+	zassert_equal(record.id_length, 0, "Wrong ID length");
+	zassert_equal(record.payload_length, LONG_PAYLOAD_LEN,
+		      "Wrong payload length");
+	zassert_equal_ptr(record.payload, &long_record[7], "Wrong payload");
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, -ENOENT, "Record after the last record");
+}
+
+static void test_two_records(void)
+{
+	struct nfc_ndef_parser parser;
+	struct nfc_ndef_parsed_record record;
+	struct uri_payload_desc uri;
+	int err;
+
+	nfc_ndef_parser_init(&parser, two_records, sizeof(two_records));
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, 0, "Parsing failed");
+
+	err = nfc_ndef_uri_rec_parse(&record, &uri);
+	zassert_equal(err, 0, "URI parsing failed");
+	zassert_equal(uri.uri_id_code, 0x01, "Wrong URI identifier code");
+	zassert_equal(uri.uri_data_len, 1, "Wrong URI length");
+	zassert_equal(uri.uri_data[0], 'a', "Wrong URI");
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, 0, "Parsing failed");
+	zassert_equal(record.tnf, TNF_EMPTY, "Wrong TNF");
+	zassert_equal(record.payload_length, 0, "Wrong payload length");
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, -ENOENT, "Record after the last record");
+}
+
+static void test_chunked_record(void)
+{
+	static const u8_t chunk_lengths[] = {4, 3, 2};
+	struct nfc_ndef_parser parser;
+	struct nfc_ndef_parsed_record record;
+	struct nfc_text_rec_payload_desc text;
+	const u8_t *payload;
+	u32_t payload_length;
+	u8_t buf[9];
+	u32_t len;
+	u8_t value = 1;
+	int err;
+
+	nfc_ndef_parser_init(&parser, chunked_record, sizeof(chunked_record));
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, 0, "Parsing failed");
+	zassert_equal(record.tnf, TNF_MEDIA_TYPE, "Wrong TNF");
+	zassert_mem_equal(record.type, "a/b", 3, "Wrong type");
+	zassert_equal(record.payload_length, 9, "Wrong payload length");
+	zassert_is_null(record.payload, "Payload of a chunked record");
+	zassert_equal(record.chunk_count, 3, "Wrong chunk count");
+
+	for (u32_t i = 0; i < record.chunk_count; i++) {
+		err = nfc_ndef_record_chunk_get(&record, i, &payload,
+						&payload_length);
+		zassert_equal(err, 0, "Getting a chunk failed");
+		zassert_equal(payload_length, chunk_lengths[i],
+			      "Wrong chunk length");
+
+		for (u32_t j = 0; j < payload_length; j++) {
+			zassert_equal(payload[j], value++,
+				      "Wrong chunk payload");
+		}
+	}
+
+	err = nfc_ndef_record_chunk_get(&record, record.chunk_count, &payload,
+					&payload_length);
+	zassert_equal(err, -EINVAL, "Chunk after the last chunk");
+
+	len = sizeof(buf) - 1;
+	err = nfc_ndef_record_payload_copy(&record, buf, &len);
+	zassert_equal(err, -ENOSR, "Payload copied to a short buffer");
+
+	len = sizeof(buf);
+	err = nfc_ndef_record_payload_copy(&record, buf, &len);
+	zassert_equal(err, 0, "Copying the payload failed");
+	zassert_equal(len, 9, "Wrong payload length");
+	for (u32_t i = 0; i < len; i++) {
+		zassert_equal(buf[i], i + 1, "Wrong payload");
+	}
+
+	err = nfc_ndef_text_rec_parse(&record, &text);
+	zassert_equal(err, -EINVAL, "Media record parsed as text");
+
+	err = nfc_ndef_parser_next(&parser, &record);
+	zassert_equal(err, -ENOENT, "Record after the last record");
+}
+
+static void test_truncated(void)
+{
+	/* Every truncation ends within the header or a field */
+	for (u32_t len = 0; len < sizeof(short_record); len++) {
+		parse_expect(short_record, len, -EBADMSG);
+	}
+
+	for (u32_t len = 0; len < sizeof(long_record); len++) {
+		parse_expect(long_record, len, -EBADMSG);
+	}
+
+	for (u32_t len = 0; len < sizeof(chunked_record); len++) {
+		parse_expect(chunked_record, len, -EBADMSG);
+	}
+
+	/* The first record does not end the message */
+	parse_expect(two_records, 6, -EBADMSG);
+}
+
+static void test_length_overflow(void)
+{
+	static const u8_t id_overflow[] = {
+		MB | ME | SR | IL | TNF_WELL_KNOWN, 1, 0, 0xFF,
+		'T',
+	};
+	static const u8_t type_overflow[] = {
+		MB | ME | SR | TNF_WELL_KNOWN, 0xFF, 0,
+		'T',
+	};
+	static const u8_t payload_overflow[] = {
+		MB | ME | TNF_MEDIA_TYPE, 1, 0xFF, 0xFF, 0xFF, 0xFF,
+		'a', 0,
+	};
+	static const u8_t chunk_overflow[] = {
+		MB | CF | SR | TNF_MEDIA_TYPE, 1, 1,
+		'a', 1,
+		ME | TNF_UNCHANGED, 0, 0xFF, 0xFF, 0xFF, 0xFF,
+		2,
+	};
+
+	parse_expect(id_overflow, sizeof(id_overflow), -EBADMSG);
+	parse_expect(type_overflow, sizeof(type_overflow), -EBADMSG);
+	parse_expect(payload_overflow, sizeof(payload_overflow), -EBADMSG);
+	parse_expect(chunk_overflow, sizeof(chunk_overflow), -EBADMSG);
+}
+
+static void test_flags(void)
+{
+	static const u8_t no_begin[] = {
+		ME | SR | TNF_EMPTY, 0, 0,
+	};
+	static const u8_t second_begin[] = {
+		MB | SR | TNF_EMPTY, 0, 0,
+		MB | ME | SR | TNF_EMPTY, 0, 0,
+	};
+	static const u8_t first_unchanged[] = {
+		MB | ME | SR | TNF_UNCHANGED, 0, 0,
+	};
+	static const u8_t chunk_end[] = {
+		MB | ME | CF | SR | TNF_MEDIA_TYPE, 1, 1,
+		'a', 1,
+		ME | SR | TNF_UNCHANGED, 0, 1,
+		2,
+	};
+	static const u8_t chunk_type[] = {
+		MB | CF | SR | TNF_MEDIA_TYPE, 1, 1,
+		'a', 1,
+		ME | SR | TNF_UNCHANGED, 1, 1,
+		'a', 2,
+	};
+	static const u8_t chunk_tnf[] = {
+		MB | CF | SR | TNF_MEDIA_TYPE, 1, 1,
+		'a', 1,
+		ME | SR | TNF_MEDIA_TYPE, 0, 1,
+		2,
+	};
+
+	parse_expect(no_begin, sizeof(no_begin), -EBADMSG);
+	parse_expect(second_begin, sizeof(second_begin), -EBADMSG);
+	parse_expect(first_unchanged, sizeof(first_unchanged), -EBADMSG);
+	parse_expect(chunk_end, sizeof(chunk_end), -EBADMSG);
+	parse_expect(chunk_type, sizeof(chunk_type), -EBADMSG);
+	parse_expect(chunk_tnf, sizeof(chunk_tnf), -EBADMSG);
+}
+
+void test_main(void)
+{
+	long_record[0] = MB | ME | TNF_MEDIA_TYPE;
+	long_record[1] = 1;
+	sys_put_be32(LONG_PAYLOAD_LEN, &long_record[2]);
+	long_record[6] = 'a';
+	for (size_t i = 0; i < LONG_PAYLOAD_LEN; i++) {
+		long_record[7 + i] = i;
+	}
+
+	ztest_test_suite(nfc_ndef_parser_test,
+			 ztest_unit_test(test_short_record),
+			 ztest_unit_test(test_long_record),
+			 ztest_unit_test(test_two_records),
+			 ztest_unit_test(test_chunked_record),
+			 ztest_unit_test(test_truncated),
+			 ztest_unit_test(test_length_overflow),
+			 ztest_unit_test(test_flags)
+			 );
+
+	ztest_run_test_suite(nfc_ndef_parser_test);
+}
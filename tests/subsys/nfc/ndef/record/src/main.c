@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <errno.h>
+#include <string.h>
+#include <misc/byteorder.h>
+#include <nfc/ndef/nfc_ndef_record.h>
+#include <nfc/ndef/nfc_ndef_msg.h>
+
+/* Flags, type length, payload length, ID length, type and ID */
+#define SHORT_HDR_LEN	6
+#define LONG_HDR_LEN	9
+
+#define NESTED_DEPTH	4
+
+static const u8_t type[] = {'a'};
+static const u8_t id[] = {'i'};
+
+static u8_t payload[300];
+static u8_t buf[400];
+static u32_t constructor_calls;
+
+static int counting_constructor(void *payload_descriptor, u8_t *buffer,
+				u32_t *len)
+{
+	constructor_calls++;
+
+	return nfc_ndef_bin_payload_memcopy(payload_descriptor, buffer, len);
+}
+
+static int record_encode(u32_t payload_len, u32_t *len)
+{
+	struct nfc_ndef_bin_payload_desc bin = {
+		.payload = payload,
+		.payload_length = payload_len,
+	};
+	struct nfc_ndef_record_desc record = {
+		.tnf = TNF_MEDIA_TYPE,
+		.id_length = sizeof(id),
+		.id = id,
+		.type_length = sizeof(type),
+		.type = type,
+		.payload_constructor = counting_constructor,
+		.payload_descriptor = &bin,
+	};
+	u32_t size;
+	int err;
+
+	memset(buf, 0, sizeof(buf));
+	constructor_calls = 0;
+
+	err = nfc_ndef_record_encode(&record, NDEF_LONE_RECORD, buf, len);
+	if (err) {
+		return err;
+	}
+
+	zassert_equal(constructor_calls, 1, "Constructor called %u times",
+		      constructor_calls);
+
+	err = nfc_ndef_record_size_get(&record, &size);
+	zassert_equal(err, 0, "Size calculation failed");
+	zassert_equal(size, *len, "Size does not match the encoded record");
+
+	return 0;
+}
+
+static void record_check(u32_t payload_len, u32_t len)
+{
+	bool short_record = (payload_len <= NDEF_RECORD_SHORT_PAYLOAD_MAX);
+	u32_t offset = short_record ? SHORT_HDR_LEN : LONG_HDR_LEN;
+	u8_t flags = NDEF_LONE_RECORD | NDEF_RECORD_IL_MASK | TNF_MEDIA_TYPE;
+
+	if (short_record) {
+		flags |= NDEF_RECORD_SR_MASK;
+	}
+
+	zassert_equal(len, offset + payload_len, "Wrong record length");
+	zassert_equal(buf[0], flags, "Wrong flags");
+	zassert_equal(buf[1], sizeof(type), "Wrong type length");
+
+	if (short_record) {
+		zassert_equal(buf[2], payload_len, "Wrong payload length");
+	} else {
+		zassert_equal(sys_get_be32(&buf[2]), payload_len,
+			      "Wrong payload length");
+	}
+
+	zassert_equal(buf[offset - 3], sizeof(id), "Wrong ID length");
+	zassert_equal(buf[offset - 2], type[0], "Wrong type");
+	zassert_equal(buf[offset - 1], id[0], "Wrong ID");
+	zassert_mem_equal(&buf[offset], payload, payload_len,
+			  "Wrong payload");
+}
+
+static void test_short_boundary(void)
+{
+	u32_t len = sizeof(buf);
+	int err;
+
+	err = record_encode(NDEF_RECORD_SHORT_PAYLOAD_MAX, &len);
+	zassert_equal(err, 0, "Encoding failed");
+	record_check(NDEF_RECORD_SHORT_PAYLOAD_MAX, len);
+}
+
+static void test_long_boundary(void)
+{
+	u32_t len = sizeof(buf);
+	int err;
+
+	err = record_encode(NDEF_RECORD_SHORT_PAYLOAD_MAX + 1, &len);
+	zassert_equal(err, 0, "Encoding failed");
+	record_check(NDEF_RECORD_SHORT_PAYLOAD_MAX + 1, len);
+}
+
+static void test_empty_payload(void)
+{
+	u32_t len = sizeof(buf);
+	int err;
+
+	err = record_encode(0, &len);
+	zassert_equal(err, 0, "Encoding failed");
+	record_check(0, len);
+}
+
+/* Buffers of the exact record size and slightly larger must be enough
+ * around the boundary between the short and the long format.
+ */
+static void test_buffer_size(void)
+{
+	for (u32_t payload_len = NDEF_RECORD_SHORT_PAYLOAD_MAX - 4;
+	     payload_len <= NDEF_RECORD_SHORT_PAYLOAD_MAX + 4;
+	     payload_len++) {
+		u32_t record_len = payload_len +
+			((payload_len <= NDEF_RECORD_SHORT_PAYLOAD_MAX) ?
+			 SHORT_HDR_LEN : LONG_HDR_LEN);
+		u32_t len;
+		int err;
+
+		for (u32_t extra = 0; extra <= 4; extra++) {
+			len = record_len + extra;
+			err = record_encode(payload_len, &len);
+			zassert_equal(err, 0, "Encoding %u bytes failed",
+				      payload_len);
+			record_check(payload_len, len);
+		}
+
+		len = record_len - 1;
+		err = record_encode(payload_len, &len);
+		zassert_equal(err, -ENOSR, "Encoded %u bytes in a short buffer",
+			      payload_len);
+	}
+}
+
+/* Each level of nesting adds a record header around the message below. The
+ * payload constructor of the innermost record must still be called only
+ * once.
+ */
+static void test_nested(void)
+{
+	struct nfc_ndef_bin_payload_desc bin = {
+		.payload = payload,
+		.payload_length = 250,
+	};
+	struct nfc_ndef_record_desc records[NESTED_DEPTH];
+	struct nfc_ndef_record_desc const *record_ptrs[NESTED_DEPTH];
+	struct nfc_ndef_msg_desc msgs[NESTED_DEPTH];
+	u32_t len = sizeof(buf);
+	u32_t size;
+	u32_t offset;
+	int err;
+
+	for (size_t i = 0; i < NESTED_DEPTH; i++) {
+		records[i] = (struct nfc_ndef_record_desc) {
+			.tnf = TNF_WELL_KNOWN,
+			.type_length = sizeof(type),
+			.type = type,
+		};
+
+		if (i == 0) {
+			records[i].payload_constructor = counting_constructor;
+			records[i].payload_descriptor = &bin;
+		} else {
+			records[i].payload_constructor =
+				(payload_constructor_t)nfc_ndef_msg_encode;
+			records[i].payload_descriptor = &msgs[i - 1];
+		}
+
+		record_ptrs[i] = &records[i];
+		msgs[i] = (struct nfc_ndef_msg_desc) {
+			.record = &record_ptrs[i],
+			.max_record_count = 1,
+			.record_count = 1,
+		};
+	}
+
+	memset(buf, 0, sizeof(buf));
+	constructor_calls = 0;
+
+	err = nfc_ndef_msg_encode(&msgs[NESTED_DEPTH - 1], buf, &len);
+	zassert_equal(err, 0, "Encoding failed");
+	zassert_equal(constructor_calls, 1, "Constructor called %u times",
+		      constructor_calls);
+
+	err = nfc_ndef_msg_size_get(&msgs[NESTED_DEPTH - 1], &size);
+	zassert_equal(err, 0, "Size calculation failed");
+	zassert_equal(size, len, "Size does not match the encoded message");
+
+	/* Records of 272, 265, 258 and 254 bytes from the outside in */
+	zassert_equal(len, 272, "Wrong message length");
+
+	offset = 0;
+	for (u32_t i = 0; i < NESTED_DEPTH; i++) {
+		bool short_record = (i >= 2);
+
+		zassert_equal(!!(buf[offset] & NDEF_RECORD_SR_MASK),
+			      short_record, "Wrong format at level %u", i);
+		offset += short_record ? 4 : 7;
+	}
+
+	zassert_mem_equal(&buf[offset], payload, bin.payload_length,
+			  "Wrong payload");
+}
+
+void test_main(void)
+{
+	for (size_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = i;
+	}
+
+	ztest_test_suite(nfc_ndef_record_test,
+			 ztest_unit_test(test_short_boundary),
+			 ztest_unit_test(test_long_boundary),
+			 ztest_unit_test(test_empty_payload),
+			 ztest_unit_test(test_buffer_size),
+			 ztest_unit_test(test_nested)
+			 );
+
+	ztest_run_test_suite(nfc_ndef_record_test);
+}